@@ -0,0 +1,347 @@
+#include "aes_accel.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define AES_ACCEL_X86 1
+#include <immintrin.h>
+#elif defined(__aarch64__) && defined(__linux__)
+#define AES_ACCEL_ARM 1
+#include <arm_neon.h>
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+/*
+ * Counter handling shared by all kernels: the 16-byte counter block is a
+ * 128-bit big-endian integer, kept as two native 64-bit halves.
+ */
+typedef struct {
+    uint64_t hi;
+    uint64_t lo;
+} ctr128_t;
+
+static inline uint64_t load_be64(const uint8_t *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    v = __builtin_bswap64(v);
+#endif
+    return v;
+}
+
+static inline void store_be64(uint8_t *p, uint64_t v) {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    v = __builtin_bswap64(v);
+#endif
+    memcpy(p, &v, sizeof(v));
+}
+
+static inline void ctr128_load(ctr128_t *c, const uint8_t *p) {
+    c->hi = load_be64(p);
+    c->lo = load_be64(p + 8);
+}
+
+static inline void ctr128_store(const ctr128_t *c, uint8_t *p) {
+    store_be64(p, c->hi);
+    store_be64(p + 8, c->lo);
+}
+
+// Write the current counter block to p and advance the counter
+static inline void ctr128_next(ctr128_t *c, uint8_t *p) {
+    ctr128_store(c, p);
+    if (++c->lo == 0) {
+        ++c->hi;
+    }
+}
+
+#if AES_ACCEL_X86
+
+/* ---------------------------------------------------------------- AES-NI */
+
+#define AESNI_LANES 8
+
+__attribute__((target("aes,sse2")))
+static inline __m128i aesni_encrypt1(const __m128i *k, __m128i b) {
+    b = _mm_xor_si128(b, k[0]);
+    for (int r = 1; r < 10; r++) {
+        b = _mm_aesenc_si128(b, k[r]);
+    }
+    return _mm_aesenclast_si128(b, k[10]);
+}
+
+__attribute__((target("aes,sse2")))
+static void aesni_ctr(const uint8_t *rk, uint8_t *ctr,
+                      const uint8_t *input, uint8_t *output, size_t length) {
+    __m128i k[11];
+    uint8_t blocks[AESNI_LANES * 16];
+    ctr128_t c;
+
+    for (int r = 0; r < 11; r++) {
+        k[r] = _mm_loadu_si128((const __m128i *)(rk + 16 * r));
+    }
+    ctr128_load(&c, ctr);
+
+    // 8 independent blocks keep the AES unit's pipeline full
+    while (length >= sizeof(blocks)) {
+        __m128i b[AESNI_LANES];
+
+        for (int i = 0; i < AESNI_LANES; i++) {
+            ctr128_next(&c, blocks + 16 * i);
+            b[i] = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(blocks + 16 * i)), k[0]);
+        }
+        for (int r = 1; r < 10; r++) {
+            for (int i = 0; i < AESNI_LANES; i++) {
+                b[i] = _mm_aesenc_si128(b[i], k[r]);
+            }
+        }
+        for (int i = 0; i < AESNI_LANES; i++) {
+            __m128i in = _mm_loadu_si128((const __m128i *)(input + 16 * i));
+            b[i] = _mm_aesenclast_si128(b[i], k[10]);
+            _mm_storeu_si128((__m128i *)(output + 16 * i), _mm_xor_si128(in, b[i]));
+        }
+
+        input += sizeof(blocks);
+        output += sizeof(blocks);
+        length -= sizeof(blocks);
+    }
+
+    // Remaining whole blocks, then the partial tail block
+    while (length > 0) {
+        uint8_t ks[16];
+        size_t n = length < 16 ? length : 16;
+
+        ctr128_next(&c, blocks);
+        _mm_storeu_si128((__m128i *)ks, aesni_encrypt1(k, _mm_loadu_si128((const __m128i *)blocks)));
+        for (size_t i = 0; i < n; i++) {
+            output[i] = input[i] ^ ks[i];
+        }
+
+        input += n;
+        output += n;
+        length -= n;
+    }
+
+    ctr128_store(&c, ctr);
+}
+
+/* ---------------------------------------------------------- VAES/AVX-512 */
+
+#define VAES_REGS 4                         // zmm registers in flight
+#define VAES_CHUNK (VAES_REGS * 4 * 16)     // 16 blocks, 256 bytes
+
+// Whole VAES_CHUNKs only; returns the bytes done. Never inlined, so the
+// zmm state stays out of the dispatcher below.
+__attribute__((target("avx512f,vaes,aes,sse2"), noinline))
+static size_t vaes_ctr_chunks(const uint8_t *rk, uint8_t *ctr,
+                              const uint8_t *input, uint8_t *output, size_t length) {
+    __m512i k[11];
+    uint8_t blocks[VAES_CHUNK];
+    ctr128_t c;
+    size_t done = 0;
+
+    for (int r = 0; r < 11; r++) {
+        k[r] = _mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i *)(rk + 16 * r)));
+    }
+    ctr128_load(&c, ctr);
+
+    while (length - done >= VAES_CHUNK) {
+        __m512i b[VAES_REGS];
+
+        for (int i = 0; i < VAES_REGS * 4; i++) {
+            ctr128_next(&c, blocks + 16 * i);
+        }
+        for (int i = 0; i < VAES_REGS; i++) {
+            b[i] = _mm512_xor_si512(_mm512_loadu_si512(blocks + 64 * i), k[0]);
+        }
+        for (int r = 1; r < 10; r++) {
+            for (int i = 0; i < VAES_REGS; i++) {
+                b[i] = _mm512_aesenc_epi128(b[i], k[r]);
+            }
+        }
+        for (int i = 0; i < VAES_REGS; i++) {
+            __m512i in = _mm512_loadu_si512(input + done + 64 * i);
+            b[i] = _mm512_aesenclast_epi128(b[i], k[10]);
+            _mm512_storeu_si512(output + done + 64 * i, _mm512_xor_si512(in, b[i]));
+        }
+        done += VAES_CHUNK;
+    }
+
+    ctr128_store(&c, ctr);
+    return done;
+}
+
+// The VAES kernel: AES-NI below VAES_CHUNK, where the wide registers cost
+// more to set up than they save (every packet this link sends), VAES for
+// bulk lengths. Compiled for AES-NI, not AVX-512, so short calls run the
+// plain AES-NI code.
+__attribute__((target("aes,sse2")))
+static void vaes_ctr(const uint8_t *rk, uint8_t *ctr,
+                     const uint8_t *input, uint8_t *output, size_t length) {
+    if (length >= VAES_CHUNK) {
+        size_t done = vaes_ctr_chunks(rk, ctr, input, output, length);
+
+        input += done;
+        output += done;
+        length -= done;
+    }
+    aesni_ctr(rk, ctr, input, output, length);
+}
+
+#endif // AES_ACCEL_X86
+
+#if AES_ACCEL_ARM
+
+/* ------------------------------------------------------------ ARMv8 Crypto */
+
+#define ARMV8_LANES 4
+
+__attribute__((target("+crypto")))
+static inline uint8x16_t armv8_encrypt1(const uint8x16_t *k, uint8x16_t b) {
+    // AESE = AddRoundKey + SubBytes + ShiftRows, AESMC = MixColumns
+    for (int r = 0; r < 9; r++) {
+        b = vaesmcq_u8(vaeseq_u8(b, k[r]));
+    }
+    return veorq_u8(vaeseq_u8(b, k[9]), k[10]);
+}
+
+__attribute__((target("+crypto")))
+static void armv8_ctr(const uint8_t *rk, uint8_t *ctr,
+                      const uint8_t *input, uint8_t *output, size_t length) {
+    uint8x16_t k[11];
+    uint8_t blocks[ARMV8_LANES * 16];
+    ctr128_t c;
+
+    for (int r = 0; r < 11; r++) {
+        k[r] = vld1q_u8(rk + 16 * r);
+    }
+    ctr128_load(&c, ctr);
+
+    while (length >= sizeof(blocks)) {
+        uint8x16_t b[ARMV8_LANES];
+
+        for (int i = 0; i < ARMV8_LANES; i++) {
+            ctr128_next(&c, blocks + 16 * i);
+            b[i] = vld1q_u8(blocks + 16 * i);
+        }
+        for (int r = 0; r < 9; r++) {
+            for (int i = 0; i < ARMV8_LANES; i++) {
+                b[i] = vaesmcq_u8(vaeseq_u8(b[i], k[r]));
+            }
+        }
+        for (int i = 0; i < ARMV8_LANES; i++) {
+            b[i] = veorq_u8(vaeseq_u8(b[i], k[9]), k[10]);
+            vst1q_u8(output + 16 * i, veorq_u8(vld1q_u8(input + 16 * i), b[i]));
+        }
+
+        input += sizeof(blocks);
+        output += sizeof(blocks);
+        length -= sizeof(blocks);
+    }
+
+    while (length > 0) {
+        uint8_t ks[16];
+        size_t n = length < 16 ? length : 16;
+
+        ctr128_next(&c, blocks);
+        vst1q_u8(ks, armv8_encrypt1(k, vld1q_u8(blocks)));
+        for (size_t i = 0; i < n; i++) {
+            output[i] = input[i] ^ ks[i];
+        }
+
+        input += n;
+        output += n;
+        length -= n;
+    }
+
+    ctr128_store(&c, ctr);
+}
+
+#endif // AES_ACCEL_ARM
+
+/* --------------------------------------------------------------- dispatch */
+
+int aes_accel_supported(aes_accel_impl_t impl) {
+    switch (impl) {
+#if AES_ACCEL_X86
+    case AES_ACCEL_AESNI:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("aes") != 0;
+    case AES_ACCEL_VAES:
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("aes") && __builtin_cpu_supports("vaes") &&
+               __builtin_cpu_supports("avx512f");
+#endif
+#if AES_ACCEL_ARM
+    case AES_ACCEL_ARMV8:
+        return (getauxval(AT_HWCAP) & HWCAP_AES) != 0;
+#endif
+    default:
+        return 0;
+    }
+}
+
+aes_accel_impl_t aes_accel_detect(void) {
+    static int detected = 0;
+    static aes_accel_impl_t best = AES_ACCEL_NONE;
+    const char *forced;
+
+    if (detected) {
+        return best;
+    }
+
+    if (aes_accel_supported(AES_ACCEL_VAES)) {
+        best = AES_ACCEL_VAES;
+    } else if (aes_accel_supported(AES_ACCEL_AESNI)) {
+        best = AES_ACCEL_AESNI;
+    } else if (aes_accel_supported(AES_ACCEL_ARMV8)) {
+        best = AES_ACCEL_ARMV8;
+    }
+
+    // Allow pinning a kernel (e.g. for benchmarks); only downgrade to what's supported
+    forced = getenv("CUART_AES_IMPL");
+    if (forced != NULL) {
+        for (int impl = AES_ACCEL_NONE; impl <= AES_ACCEL_ARMV8; impl++) {
+            if (strcmp(forced, aes_accel_name((aes_accel_impl_t)impl)) == 0 &&
+                (impl == AES_ACCEL_NONE || aes_accel_supported((aes_accel_impl_t)impl))) {
+                best = (aes_accel_impl_t)impl;
+            }
+        }
+    }
+
+    detected = 1;
+    return best;
+}
+
+aes_accel_ctr_fn aes_accel_kernel(aes_accel_impl_t impl) {
+    if (!aes_accel_supported(impl)) {
+        return NULL;
+    }
+    switch (impl) {
+#if AES_ACCEL_X86
+    case AES_ACCEL_AESNI:
+        return aesni_ctr;
+    case AES_ACCEL_VAES:
+        return vaes_ctr;
+#endif
+#if AES_ACCEL_ARM
+    case AES_ACCEL_ARMV8:
+        return armv8_ctr;
+#endif
+    default:
+        return NULL;
+    }
+}
+
+const char *aes_accel_name(aes_accel_impl_t impl) {
+    switch (impl) {
+    case AES_ACCEL_AESNI:
+        return "aesni";
+    case AES_ACCEL_VAES:
+        return "vaes";
+    case AES_ACCEL_ARMV8:
+        return "armv8";
+    default:
+        return "portable";
+    }
+}
@@ -0,0 +1,65 @@
+#ifndef AES_ACCEL_H
+#define AES_ACCEL_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Hardware-accelerated AES-128 CTR kernels for host builds, selected at
+ * runtime from the CPU's feature flags:
+ *   - VAES + AVX-512 : 4 blocks per zmm register, 16 blocks in flight, for
+ *                      256 bytes and up; shorter lengths and tails run
+ *                      the AES-NI code, dispatched without AVX-512
+ *   - AES-NI         : 8 blocks in flight
+ *   - ARMv8 Crypto   : AESE/AESMC, 4 blocks in flight
+ * When none is available the caller falls back to the portable T-table
+ * kernel (aes_ttable.c). All kernels produce output byte-identical to
+ * tiny-AES-c's AES_CTR_xcrypt_buffer().
+ *
+ * The CUART_AES_IMPL environment variable (portable, aesni, vaes, armv8)
+ * forces a specific kernel for benchmarking; unsupported choices fall back.
+ */
+
+// Size of the byte-ordered AES-128 key schedule (11 round keys)
+#define AES_ACCEL_RK_SIZE 176
+
+typedef enum {
+    AES_ACCEL_NONE = 0,
+    AES_ACCEL_AESNI,
+    AES_ACCEL_VAES,
+    AES_ACCEL_ARMV8,
+} aes_accel_impl_t;
+
+/**
+ * @brief CTR kernel signature
+ *
+ * @param rk Pointer to 176-byte key schedule (round keys in byte order)
+ * @param ctr Pointer to 16-byte counter block (updated, big-endian increment)
+ * @param input Pointer to input data
+ * @param output Pointer to output buffer (may be the same as input)
+ * @param length Length of data
+ */
+typedef void (*aes_accel_ctr_fn)(const uint8_t *rk, uint8_t *ctr,
+                                 const uint8_t *input, uint8_t *output, size_t length);
+
+/**
+ * @brief Best kernel supported by this CPU (detected once, cached)
+ */
+aes_accel_impl_t aes_accel_detect(void);
+
+/**
+ * @brief Whether this CPU supports a given kernel
+ */
+int aes_accel_supported(aes_accel_impl_t impl);
+
+/**
+ * @brief Kernel for an implementation, or NULL for AES_ACCEL_NONE/unsupported
+ */
+aes_accel_ctr_fn aes_accel_kernel(aes_accel_impl_t impl);
+
+/**
+ * @brief Human-readable kernel name ("portable", "aesni", "vaes", "armv8")
+ */
+const char *aes_accel_name(aes_accel_impl_t impl);
+
+#endif // AES_ACCEL_H
@@ -0,0 +1,100 @@
+#ifndef AES_GCM_H
+#define AES_GCM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "aes_wrapper.h"
+
+/*
+ * AES-128-GCM (NIST SP 800-38D) with 96-bit nonces and 128-bit tags.
+ *
+ * The keystream comes from the configured CTR backend (aes_ctr_crypt()): with
+ * a 12-byte nonce the GCM counter blocks are nonce || 2, nonce || 3, ..., and
+ * the low 32 bits never wrap for UART-sized messages, so the backend's
+ * 128-bit increment produces the same blocks as GCM's inc32. GHASH uses
+ * 4-bit tables (Shoup's method) precomputed once per key.
+ */
+
+// GCM nonce size in bytes
+#define AES_GCM_NONCE_SIZE 12
+
+// GCM authentication tag size in bytes
+#define AES_GCM_TAG_SIZE 16
+
+/**
+ * @brief AES-128-GCM context
+ *
+ * Holds the CTR key schedule and the GHASH tables for the hash subkey
+ * H = E(K, 0^128), both computed once by aes_gcm_setkey().
+ */
+typedef struct {
+    aes_ctr_ctx_t ctr;
+    uint64_t hl[16];    // low halves of i * H, i = 0..15
+    uint64_t hh[16];    // high halves of i * H
+} aes_gcm_ctx_t;
+
+/**
+ * @brief Expand a 128-bit key into a GCM context
+ *
+ * @param ctx Pointer to context to fill
+ * @param key Pointer to 16-byte key
+ */
+void aes_gcm_setkey(aes_gcm_ctx_t *ctx, const uint8_t *key);
+
+/**
+ * @brief Encrypt and authenticate a message
+ *
+ * @param ctx Pointer to keyed context
+ * @param nonce Pointer to 12-byte nonce (never reuse with the same key)
+ * @param aad Pointer to additional authenticated data (may be NULL if aad_len is 0)
+ * @param aad_len Length of additional authenticated data
+ * @param input Pointer to plaintext (may be NULL if length is 0)
+ * @param output Pointer to ciphertext buffer (may be the same as input)
+ * @param length Length of plaintext (0 to authenticate aad only)
+ * @param tag Pointer to 16-byte buffer for the authentication tag
+ */
+void aes_gcm_encrypt(aes_gcm_ctx_t *ctx, const uint8_t *nonce,
+                     const uint8_t *aad, size_t aad_len,
+                     const uint8_t *input, uint8_t *output, size_t length,
+                     uint8_t *tag);
+
+/**
+ * @brief Verify and decrypt a message
+ *
+ * The tag is checked (in constant time) before anything is decrypted; on
+ * failure output is left untouched.
+ *
+ * @param ctx Pointer to keyed context
+ * @param nonce Pointer to 12-byte nonce
+ * @param aad Pointer to additional authenticated data (may be NULL if aad_len is 0)
+ * @param aad_len Length of additional authenticated data
+ * @param input Pointer to ciphertext (may be NULL if length is 0)
+ * @param output Pointer to plaintext buffer (may be the same as input)
+ * @param length Length of ciphertext
+ * @param tag Pointer to received 16-byte tag
+ * @return true if the tag is valid and output holds the plaintext
+ */
+bool aes_gcm_decrypt(aes_gcm_ctx_t *ctx, const uint8_t *nonce,
+                     const uint8_t *aad, size_t aad_len,
+                     const uint8_t *input, uint8_t *output, size_t length,
+                     const uint8_t *tag);
+
+/**
+ * @brief Generate a random 12-byte GCM nonce
+ *
+ * @param nonce Pointer to 12-byte buffer
+ */
+void aes_gcm_generate_nonce(uint8_t *nonce);
+
+/**
+ * @brief Check the configured backend against the GCM spec test vectors
+ *
+ * Runs test cases 3 and 4 (AES-128, with and without AAD) from the
+ * McGrew/Viega GCM specification.
+ *
+ * @return true if both vectors match
+ */
+bool aes_gcm_selftest(void);
+
+#endif // AES_GCM_H
@@ -0,0 +1,60 @@
+#ifndef AES_TTABLE_H
+#define AES_TTABLE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Table-driven AES-128 (encryption only, which is all CTR mode needs).
+ *
+ * SubBytes, ShiftRows and MixColumns are folded into four 1 KB lookup tables
+ * (Te0..Te3), so a round is 16 table lookups and XORs on 32-bit words instead
+ * of tiny-AES-c's byte-wise transforms. The CTR kernel encrypts up to
+ * AES_TT_PARALLEL counter blocks per pass, interleaving their rounds.
+ *
+ * Note: lookup tables are not constant-time with respect to the cache. This
+ * is fine for our UART links (no co-resident attacker), but keep tiny-AES-c
+ * or a hardware backend where cache-timing matters.
+ */
+
+// Number of counter blocks encrypted per kernel pass
+#define AES_TT_PARALLEL 4
+
+typedef struct {
+    uint32_t rk[44];    // 11 round keys as big-endian words
+} aes_tt_key_t;
+
+/**
+ * @brief Expand a 128-bit key into round keys
+ *
+ * @param key Pointer to key schedule to fill
+ * @param k Pointer to 16-byte key
+ */
+void aes_tt_setkey(aes_tt_key_t *key, const uint8_t *k);
+
+/**
+ * @brief Encrypt a single 16-byte block
+ *
+ * @param key Pointer to expanded key
+ * @param in Pointer to 16-byte plaintext block
+ * @param out Pointer to 16-byte ciphertext block (may be the same as in)
+ */
+void aes_tt_encrypt_block(const aes_tt_key_t *key, const uint8_t *in, uint8_t *out);
+
+/**
+ * @brief AES-128 CTR encrypt/decrypt
+ *
+ * Counter semantics match tiny-AES-c's AES_CTR_xcrypt_buffer(): the whole
+ * 16-byte counter block is incremented as a big-endian integer, and on
+ * return ctr holds the next unused counter value.
+ *
+ * @param key Pointer to expanded key
+ * @param ctr Pointer to 16-byte counter block (updated)
+ * @param input Pointer to input data
+ * @param output Pointer to output buffer (may be the same as input)
+ * @param length Length of data
+ */
+void aes_tt_ctr_crypt(const aes_tt_key_t *key, uint8_t *ctr,
+                      const uint8_t *input, uint8_t *output, size_t length);
+
+#endif // AES_TTABLE_H
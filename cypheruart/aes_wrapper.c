@@ -0,0 +1,229 @@
+#include "aes_wrapper.h"
+#include "aes.h"
+#include "cuart_port.h"
+#include <string.h>
+
+// Global AES context (key schedule expanded once in aes_init)
+static aes_ctr_ctx_t default_ctx;
+
+void aes_ctr_setkey(aes_ctr_ctx_t *ctx, const uint8_t *key) {
+    // Run the key expansion once; the IV is set per packet
+#if CUART_AES_BACKEND == CUART_AES_TTABLE
+    aes_tt_setkey(&ctx->tt, key);
+#elif CUART_AES_BACKEND == CUART_AES_AUTO
+    aes_tt_setkey(&ctx->tt, key);
+    for (int i = 0; i < 44; i++) {
+        uint32_t w = ctx->tt.rk[i];
+        ctx->rk[4 * i] = (uint8_t)(w >> 24);
+        ctx->rk[4 * i + 1] = (uint8_t)(w >> 16);
+        ctx->rk[4 * i + 2] = (uint8_t)(w >> 8);
+        ctx->rk[4 * i + 3] = (uint8_t)w;
+    }
+    ctx->accel = aes_accel_kernel(aes_accel_detect());
+#elif CUART_AES_BACKEND == CUART_AES_ESP_HW
+    // The driver keeps the key in the context and loads it into the peripheral per call
+    esp_aes_init(&ctx->hw);
+    esp_aes_setkey(&ctx->hw, key, AES_KEY_SIZE * 8);
+#else
+    AES_init_ctx(&ctx->aes, key);
+#endif
+}
+
+void aes_ctr_crypt(aes_ctr_ctx_t *ctx, const uint8_t *input, uint8_t *output,
+                   size_t length, const uint8_t *nonce) {
+#if CUART_AES_BACKEND == CUART_AES_TTABLE
+    uint8_t counter[AES_BLOCK_SIZE];
+
+    // Out-of-place kernel: no staging copy of the input
+    memcpy(counter, nonce, AES_BLOCK_SIZE);
+    aes_tt_ctr_crypt(&ctx->tt, counter, input, output, length);
+#elif CUART_AES_BACKEND == CUART_AES_AUTO
+    uint8_t counter[AES_BLOCK_SIZE];
+
+    memcpy(counter, nonce, AES_BLOCK_SIZE);
+    if (ctx->accel != NULL) {
+        ctx->accel(ctx->rk, counter, input, output, length);
+    } else {
+        aes_tt_ctr_crypt(&ctx->tt, counter, input, output, length);
+    }
+#elif CUART_AES_BACKEND == CUART_AES_ESP_HW
+    uint8_t counter[AES_BLOCK_SIZE];
+    uint8_t stream_block[AES_BLOCK_SIZE];
+    size_t nc_off = 0;
+
+    // One driver call per packet: the peripheral runs every counter block
+    memcpy(counter, nonce, AES_BLOCK_SIZE);
+    esp_aes_crypt_ctr(&ctx->hw, length, &nc_off, counter, stream_block, input, output);
+#else
+    // Reset the counter block only, keep the expanded round keys
+    AES_ctx_set_iv(&ctx->aes, nonce);
+
+    // Copy input to output buffer
+    if (output != input) {
+        memcpy(output, input, length);
+    }
+
+    // CTR mode is symmetric: the same operation encrypts and decrypts (in place)
+    AES_CTR_xcrypt_buffer(&ctx->aes, output, length);
+#endif
+}
+
+bool aes_ctr_selftest(void) {
+    // NIST SP 800-38A, F.5.1 CTR-AES128.Encrypt
+    static const uint8_t key[AES_KEY_SIZE] = {
+        0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6,
+        0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c
+    };
+    static const uint8_t counter[AES_BLOCK_SIZE] = {
+        0xf0, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7,
+        0xf8, 0xf9, 0xfa, 0xfb, 0xfc, 0xfd, 0xfe, 0xff
+    };
+    static const uint8_t plaintext[64] = {
+        0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96, 0xe9, 0x3d, 0x7e, 0x11, 0x73, 0x93, 0x17, 0x2a,
+        0xae, 0x2d, 0x8a, 0x57, 0x1e, 0x03, 0xac, 0x9c, 0x9e, 0xb7, 0x6f, 0xac, 0x45, 0xaf, 0x8e, 0x51,
+        0x30, 0xc8, 0x1c, 0x46, 0xa3, 0x5c, 0xe4, 0x11, 0xe5, 0xfb, 0xc1, 0x19, 0x1a, 0x0a, 0x52, 0xef,
+        0xf6, 0x9f, 0x24, 0x45, 0xdf, 0x4f, 0x9b, 0x17, 0xad, 0x2b, 0x41, 0x7b, 0xe6, 0x6c, 0x37, 0x10
+    };
+    static const uint8_t ciphertext[64] = {
+        0x87, 0x4d, 0x61, 0x91, 0xb6, 0x20, 0xe3, 0x26, 0x1b, 0xef, 0x68, 0x64, 0x99, 0x0d, 0xb6, 0xce,
+        0x98, 0x06, 0xf6, 0x6b, 0x79, 0x70, 0xfd, 0xff, 0x86, 0x17, 0x18, 0x7b, 0xb9, 0xff, 0xfd, 0xff,
+        0x5a, 0xe4, 0xdf, 0x3e, 0xdb, 0xd5, 0xd3, 0x5e, 0x5b, 0x4f, 0x09, 0x02, 0x0d, 0xb0, 0x3e, 0xab,
+        0x1e, 0x03, 0x1d, 0xda, 0x2f, 0xbe, 0x03, 0xd1, 0x79, 0x21, 0x70, 0xa0, 0xf3, 0x00, 0x9c, 0xee
+    };
+    aes_ctr_ctx_t test_ctx;
+    uint8_t out[64];
+
+    aes_ctr_setkey(&test_ctx, key);
+    aes_ctr_crypt(&test_ctx, plaintext, out, sizeof(out), counter);
+
+    return memcmp(out, ciphertext, sizeof(out)) == 0;
+}
+
+const char *aes_backend_name(void) {
+#if CUART_AES_BACKEND == CUART_AES_TTABLE
+    return "ttable";
+#elif CUART_AES_BACKEND == CUART_AES_AUTO
+    return aes_accel_name(aes_accel_detect());
+#elif CUART_AES_BACKEND == CUART_AES_ESP_HW
+    return "esp-hw";
+#else
+    return "tiny-AES-c";
+#endif
+}
+
+void aes_init(const uint8_t *key) {
+    aes_ctr_setkey(&default_ctx, key);
+}
+
+void aes_encrypt_ctr(const uint8_t *input, uint8_t *output, size_t length, const uint8_t *nonce) {
+    aes_ctr_crypt(&default_ctx, input, output, length, nonce);
+}
+
+void aes_decrypt_ctr(const uint8_t *input, uint8_t *output, size_t length, const uint8_t *nonce) {
+    // CTR mode decryption is the same as encryption
+    aes_ctr_crypt(&default_ctx, input, output, length, nonce);
+}
+
+void aes_generate_nonce(uint8_t *nonce) {
+    // Generate random nonce using the platform RNG (ESP32 hardware RNG on target)
+    cuart_port_random(nonce, AES_BLOCK_SIZE);
+}
+
+// Absorb (K ^ ipad) into inner and (K ^ opad) into outer
+static void hmac_sha256_pads(cuart_sha256_ctx_t *inner, cuart_sha256_ctx_t *outer,
+                             const uint8_t *key, size_t key_len) {
+    uint8_t key_block[HMAC_BLOCK_SIZE];
+    uint8_t pad[HMAC_BLOCK_SIZE];
+
+    // Keys longer than one block are hashed first (RFC 2104)
+    memset(key_block, 0, HMAC_BLOCK_SIZE);
+    if (key_len > HMAC_BLOCK_SIZE) {
+        cuart_port_sha256_init(inner);
+        cuart_port_sha256_update(inner, key, key_len);
+        cuart_port_sha256_final(inner, key_block);
+    } else {
+        memcpy(key_block, key, key_len);
+    }
+
+    for (int i = 0; i < HMAC_BLOCK_SIZE; i++) {
+        pad[i] = key_block[i] ^ 0x36;
+    }
+    cuart_port_sha256_init(inner);
+    cuart_port_sha256_update(inner, pad, HMAC_BLOCK_SIZE);
+
+    for (int i = 0; i < HMAC_BLOCK_SIZE; i++) {
+        pad[i] = key_block[i] ^ 0x5c;
+    }
+    cuart_port_sha256_init(outer);
+    cuart_port_sha256_update(outer, pad, HMAC_BLOCK_SIZE);
+
+    memset(key_block, 0, HMAC_BLOCK_SIZE);
+    memset(pad, 0, HMAC_BLOCK_SIZE);
+}
+
+void hmac_sha256_setkey(hmac_sha256_key_t *key, const uint8_t *k, size_t k_len) {
+    hmac_sha256_ctx_t tmp;
+
+    // Store clones so the saved states never hold a hardware SHA engine
+    hmac_sha256_pads(&tmp.sha, &tmp.outer, k, k_len);
+    cuart_port_sha256_clone(&key->inner, &tmp.sha);
+    cuart_port_sha256_clone(&key->outer, &tmp.outer);
+    cuart_port_sha256_free(&tmp.sha);
+    cuart_port_sha256_free(&tmp.outer);
+}
+
+void hmac_sha256_start(hmac_sha256_ctx_t *ctx, const hmac_sha256_key_t *key) {
+    cuart_port_sha256_clone(&ctx->sha, &key->inner);
+    cuart_port_sha256_clone(&ctx->outer, &key->outer);
+}
+
+void hmac_sha256_init(hmac_sha256_ctx_t *ctx, const uint8_t *key, size_t key_len) {
+    hmac_sha256_pads(&ctx->sha, &ctx->outer, key, key_len);
+}
+
+void hmac_sha256_update(hmac_sha256_ctx_t *ctx, const uint8_t *data, size_t data_len) {
+    cuart_port_sha256_update(&ctx->sha, data, data_len);
+}
+
+void hmac_sha256_final(hmac_sha256_ctx_t *ctx, uint8_t *hmac) {
+    uint8_t inner[HMAC_SIZE];
+
+    // Outer hash: H((K ^ opad) || H((K ^ ipad) || message))
+    cuart_port_sha256_final(&ctx->sha, inner);
+    cuart_port_sha256_update(&ctx->outer, inner, HMAC_SIZE);
+    cuart_port_sha256_final(&ctx->outer, hmac);
+}
+
+bool hmac_sha256_verify_final(hmac_sha256_ctx_t *ctx, const uint8_t *received_hmac) {
+    uint8_t computed_hmac[HMAC_SIZE];
+
+    hmac_sha256_final(ctx, computed_hmac);
+
+    // Constant-time comparison to prevent timing attacks
+    int result = 0;
+    for (int i = 0; i < HMAC_SIZE; i++) {
+        result |= computed_hmac[i] ^ received_hmac[i];
+    }
+
+    return (result == 0);
+}
+
+void compute_hmac_sha256(const uint8_t *data, size_t data_len,
+                         const uint8_t *key, size_t key_len,
+                         uint8_t *hmac) {
+    hmac_sha256_ctx_t ctx;
+
+    hmac_sha256_init(&ctx, key, key_len);
+    hmac_sha256_update(&ctx, data, data_len);
+    hmac_sha256_final(&ctx, hmac);
+}
+
+bool verify_hmac_sha256(const uint8_t *data, size_t data_len,
+                        const uint8_t *key, size_t key_len,
+                        const uint8_t *received_hmac) {
+    hmac_sha256_ctx_t ctx;
+
+    hmac_sha256_init(&ctx, key, key_len);
+    hmac_sha256_update(&ctx, data, data_len);
+    return hmac_sha256_verify_final(&ctx, received_hmac);
+}
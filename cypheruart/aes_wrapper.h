@@ -0,0 +1,234 @@
+#ifndef AES_WRAPPER_H
+#define AES_WRAPPER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "aes.h"
+#include "aes_ttable.h"
+#include "aes_accel.h"
+#include "cuart_port.h"
+
+// AES-128 key size in bytes
+#define AES_KEY_SIZE 16
+
+// AES block size in bytes
+#define AES_BLOCK_SIZE 16
+
+// HMAC-SHA256 output size in bytes
+#define HMAC_SIZE 32
+
+// SHA-256 block size in bytes (HMAC key pad length)
+#define HMAC_BLOCK_SIZE 64
+
+// AES-128 backends, selected at compile time with CUART_AES_BACKEND
+#define CUART_AES_TINYAES 1     // tiny-AES-c (byte-wise, smallest footprint)
+#define CUART_AES_TTABLE  2     // 32-bit T-tables, multi-block CTR kernel
+#define CUART_AES_AUTO    3     // host only: AES-NI/VAES/ARMv8 at runtime, T-table fallback
+#define CUART_AES_ESP_HW  4     // ESP32 AES peripheral (esp_aes driver; host mock in mock/)
+
+#ifndef CUART_AES_BACKEND
+#define CUART_AES_BACKEND CUART_AES_TINYAES
+#endif
+
+#if CUART_AES_BACKEND == CUART_AES_ESP_HW
+#include "aes/esp_aes.h"
+#endif
+
+/**
+ * @brief AES-128 CTR context
+ *
+ * Holds the expanded round keys for one key. The key schedule is computed
+ * once by aes_ctr_setkey(); each packet only resets the counter block.
+ */
+typedef struct {
+#if CUART_AES_BACKEND == CUART_AES_TTABLE
+    aes_tt_key_t tt;
+#elif CUART_AES_BACKEND == CUART_AES_AUTO
+    aes_tt_key_t tt;                        // portable fallback
+    uint8_t rk[AES_ACCEL_RK_SIZE];          // round keys in byte order
+    aes_accel_ctr_fn accel;                 // NULL when no acceleration
+#elif CUART_AES_BACKEND == CUART_AES_ESP_HW
+    esp_aes_context hw;
+#else
+    struct AES_ctx aes;
+#endif
+} aes_ctr_ctx_t;
+
+/**
+ * @brief Expand a 128-bit key into a CTR context
+ *
+ * @param ctx Pointer to context to initialize
+ * @param key Pointer to 16-byte encryption key
+ */
+void aes_ctr_setkey(aes_ctr_ctx_t *ctx, const uint8_t *key);
+
+/**
+ * @brief Encrypt or decrypt data in AES-128 CTR mode with a pre-expanded key
+ *
+ * @param ctx Pointer to context initialized with aes_ctr_setkey()
+ * @param input Pointer to input data
+ * @param output Pointer to output buffer (may be the same as input)
+ * @param length Length of data
+ * @param nonce Pointer to 16-byte nonce/IV (initial counter block)
+ */
+void aes_ctr_crypt(aes_ctr_ctx_t *ctx, const uint8_t *input, uint8_t *output,
+                   size_t length, const uint8_t *nonce);
+
+/**
+ * @brief Known-answer self-test of the configured AES backend
+ *
+ * Runs the NIST SP 800-38A F.5.1 CTR-AES128 vector through aes_ctr_crypt().
+ *
+ * @return true if the backend produces the expected ciphertext
+ */
+bool aes_ctr_selftest(void);
+
+/**
+ * @brief Name of the AES implementation aes_ctr_crypt() uses
+ *
+ * @return "tiny-AES-c", "ttable", "esp-hw", or the runtime-selected kernel
+ *         for CUART_AES_AUTO ("vaes", "aesni", "armv8", "portable")
+ */
+const char *aes_backend_name(void);
+
+/**
+ * @brief Initialize AES encryption with a 128-bit key
+ *
+ * @param key Pointer to 16-byte encryption key
+ */
+void aes_init(const uint8_t *key);
+
+/**
+ * @brief Pre-keyed HMAC-SHA256 key
+ *
+ * SHA-256 states after absorbing (K ^ ipad) and (K ^ opad), computed once per
+ * key by hmac_sha256_setkey(). Starting a message from it costs two state
+ * copies instead of two extra compressions, with no allocation.
+ */
+typedef struct {
+    cuart_sha256_ctx_t inner;
+    cuart_sha256_ctx_t outer;
+} hmac_sha256_key_t;
+
+/**
+ * @brief Streaming HMAC-SHA256 context
+ *
+ * Lets a message be authenticated field by field, directly from where the
+ * fields already live, instead of staging them in one contiguous buffer.
+ */
+typedef struct {
+    cuart_sha256_ctx_t sha;         // inner hash in progress
+    cuart_sha256_ctx_t outer;       // outer hash, (K ^ opad) already absorbed
+} hmac_sha256_ctx_t;
+
+/**
+ * @brief Precompute the inner and outer key pads for an HMAC key
+ *
+ * @param key Pointer to pre-keyed state to fill
+ * @param k Pointer to HMAC key
+ * @param k_len Length of HMAC key
+ */
+void hmac_sha256_setkey(hmac_sha256_key_t *key, const uint8_t *k, size_t k_len);
+
+/**
+ * @brief Start an HMAC-SHA256 computation from a pre-keyed state
+ *
+ * @param ctx Pointer to context to initialize
+ * @param key Pointer to state prepared with hmac_sha256_setkey()
+ */
+void hmac_sha256_start(hmac_sha256_ctx_t *ctx, const hmac_sha256_key_t *key);
+
+/**
+ * @brief Start an HMAC-SHA256 computation from a raw key
+ *
+ * Processes the key pads on every call; prefer hmac_sha256_setkey() +
+ * hmac_sha256_start() when the key is reused.
+ *
+ * @param ctx Pointer to context to initialize
+ * @param key Pointer to HMAC key
+ * @param key_len Length of HMAC key
+ */
+void hmac_sha256_init(hmac_sha256_ctx_t *ctx, const uint8_t *key, size_t key_len);
+
+/**
+ * @brief Feed the next part of the message
+ *
+ * @param ctx Pointer to context started with hmac_sha256_start() or hmac_sha256_init()
+ * @param data Pointer to data
+ * @param data_len Length of data
+ */
+void hmac_sha256_update(hmac_sha256_ctx_t *ctx, const uint8_t *data, size_t data_len);
+
+/**
+ * @brief Finish the computation and output the HMAC
+ *
+ * @param ctx Pointer to context
+ * @param hmac Pointer to 32-byte buffer for HMAC output
+ */
+void hmac_sha256_final(hmac_sha256_ctx_t *ctx, uint8_t *hmac);
+
+/**
+ * @brief Finish the computation and compare against a received HMAC
+ *
+ * @param ctx Pointer to context
+ * @param received_hmac Pointer to 32-byte received HMAC
+ * @return true if HMAC is valid (constant-time comparison), false otherwise
+ */
+bool hmac_sha256_verify_final(hmac_sha256_ctx_t *ctx, const uint8_t *received_hmac);
+
+/**
+ * @brief Compute HMAC-SHA256 for message authentication
+ *
+ * @param data Pointer to data to authenticate
+ * @param data_len Length of data
+ * @param key Pointer to HMAC key
+ * @param key_len Length of HMAC key
+ * @param hmac Pointer to 32-byte buffer for HMAC output
+ */
+void compute_hmac_sha256(const uint8_t *data, size_t data_len,
+                         const uint8_t *key, size_t key_len,
+                         uint8_t *hmac);
+
+/**
+ * @brief Verify HMAC-SHA256 for message authentication
+ *
+ * @param data Pointer to data to verify
+ * @param data_len Length of data
+ * @param key Pointer to HMAC key
+ * @param key_len Length of HMAC key
+ * @param received_hmac Pointer to 32-byte received HMAC
+ * @return true if HMAC is valid, false otherwise
+ */
+bool verify_hmac_sha256(const uint8_t *data, size_t data_len,
+                        const uint8_t *key, size_t key_len,
+                        const uint8_t *received_hmac);
+
+/**
+ * @brief Encrypt data using AES-128 CTR mode
+ *
+ * @param input Pointer to plaintext data
+ * @param output Pointer to buffer for encrypted data (must be same size as input)
+ * @param length Length of data to encrypt
+ * @param nonce Pointer to 16-byte nonce/IV (counter initialization vector)
+ */
+void aes_encrypt_ctr(const uint8_t *input, uint8_t *output, size_t length, const uint8_t *nonce);
+
+/**
+ * @brief Decrypt data using AES-128 CTR mode
+ *
+ * @param input Pointer to encrypted data
+ * @param output Pointer to buffer for decrypted data (must be same size as input)
+ * @param length Length of data to decrypt
+ * @param nonce Pointer to 16-byte nonce/IV (must be same as used for encryption)
+ */
+void aes_decrypt_ctr(const uint8_t *input, uint8_t *output, size_t length, const uint8_t *nonce);
+
+/**
+ * @brief Generate a random nonce for CTR mode
+ *
+ * @param nonce Pointer to 16-byte buffer to store generated nonce
+ */
+void aes_generate_nonce(uint8_t *nonce);
+
+#endif // AES_WRAPPER_H
@@ -0,0 +1,40 @@
+#ifndef CUART_BENCH_H
+#define CUART_BENCH_H
+
+/*
+ * Timing helpers shared by the host micro-benchmarks.
+ * Cycle counts use the TSC on x86 and fall back to nanoseconds elsewhere.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+static inline uint64_t bench_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static inline uint64_t bench_cycles(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return bench_now_ns();
+#endif
+}
+
+static inline double bench_min(double a, double b) {
+    return a < b ? a : b;
+}
+
+// Keeps the compiler from optimizing away a benchmarked result
+static inline void bench_clobber(const void *p) {
+    __asm__ volatile("" : : "r"(p) : "memory");
+}
+
+#endif // CUART_BENCH_H
@@ -0,0 +1,112 @@
+/*
+ * Per-packet cost of the two wire formats: AES-128-CTR + HMAC-SHA256
+ * (pre-keyed) versus AES-128-GCM, with bytes on the wire and airtime at
+ * 115200 baud (8N1, 10 bits per byte).
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "aes_wrapper.h"
+#include "aes_gcm.h"
+#include "bench.h"
+
+#define ITERATIONS 20000
+#define REPEATS 15
+#define BAUD 115200.0
+
+static const uint8_t KEY[AES_KEY_SIZE] = {
+    0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6,
+    0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c
+};
+
+static const uint8_t HMAC_KEY[32] = {
+    0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef,
+    0xfe, 0xdc, 0xba, 0x98, 0x76, 0x54, 0x32, 0x10,
+    0x0f, 0x1e, 0x2d, 0x3c, 0x4b, 0x5a, 0x69, 0x78,
+    0x87, 0x96, 0xa5, 0xb4, 0xc3, 0xd2, 0xe1, 0xf0
+};
+
+// Message sizes the sender actually transmits
+static const size_t SIZES[] = { 20, 24, 32, 48, 64, 256 };
+
+static aes_ctr_ctx_t ctr_ctx;
+static hmac_sha256_key_t hmac_key;
+static aes_gcm_ctx_t gcm_ctx;
+
+// Sender side of the legacy format: encrypt, then MAC nonce || len || ct
+static void seal_ctr_hmac(const uint8_t *nonce, const uint8_t *len_be,
+                          const uint8_t *in, uint8_t *out, size_t len, uint8_t *mac) {
+    hmac_sha256_ctx_t hmac;
+
+    aes_ctr_crypt(&ctr_ctx, in, out, len, nonce);
+    hmac_sha256_start(&hmac, &hmac_key);
+    hmac_sha256_update(&hmac, nonce, AES_BLOCK_SIZE);
+    hmac_sha256_update(&hmac, len_be, 2);
+    hmac_sha256_update(&hmac, out, len);
+    hmac_sha256_final(&hmac, mac);
+}
+
+int main(void) {
+    uint8_t nonce[AES_BLOCK_SIZE];
+    uint8_t input[256];
+    uint8_t out[256];
+    uint8_t mac[HMAC_SIZE];
+    uint8_t len_be[2];
+
+    if (!aes_gcm_selftest()) {
+        fprintf(stderr, "GCM self-test FAILED\n");
+        return 1;
+    }
+
+    aes_ctr_setkey(&ctr_ctx, KEY);
+    hmac_sha256_setkey(&hmac_key, HMAC_KEY, sizeof(HMAC_KEY));
+    aes_gcm_setkey(&gcm_ctx, KEY);
+    for (size_t i = 0; i < sizeof(input); i++) {
+        input[i] = (uint8_t)i;
+    }
+    memset(nonce, 0xa5, sizeof(nonce));
+
+    printf("backend: %s\n", aes_backend_name());
+    printf("%-6s %14s %14s %8s %10s %10s %12s %12s\n",
+           "bytes", "ctr+hmac ns", "gcm ns", "speedup",
+           "hmac wire", "gcm wire", "hmac us@115k", "gcm us@115k");
+
+    for (size_t s = 0; s < sizeof(SIZES) / sizeof(SIZES[0]); s++) {
+        size_t len = SIZES[s];
+        size_t wire_hmac = AES_BLOCK_SIZE + 2 + len + HMAC_SIZE;
+        size_t wire_gcm = AES_GCM_NONCE_SIZE + 2 + len + AES_GCM_TAG_SIZE;
+        uint64_t t0, t1;
+        double old_ns, new_ns;
+
+        len_be[0] = (uint8_t)(len >> 8);
+        len_be[1] = (uint8_t)len;
+
+        // Best of REPEATS runs to filter out scheduler and frequency noise
+        old_ns = new_ns = 1e30;
+        for (int r = 0; r < REPEATS; r++) {
+            t0 = bench_now_ns();
+            for (int i = 0; i < ITERATIONS; i++) {
+                nonce[0] = (uint8_t)i;
+                seal_ctr_hmac(nonce, len_be, input, out, len, mac);
+                bench_clobber(mac);
+            }
+            t1 = bench_now_ns();
+            old_ns = bench_min(old_ns, (double)(t1 - t0) / ITERATIONS);
+
+            t0 = bench_now_ns();
+            for (int i = 0; i < ITERATIONS; i++) {
+                nonce[0] = (uint8_t)i;
+                aes_gcm_encrypt(&gcm_ctx, nonce, len_be, 2, input, out, len, mac);
+                bench_clobber(mac);
+            }
+            t1 = bench_now_ns();
+            new_ns = bench_min(new_ns, (double)(t1 - t0) / ITERATIONS);
+        }
+
+        printf("%-6zu %14.1f %14.1f %7.2fx %10zu %10zu %12.0f %12.0f\n",
+               len, old_ns, new_ns, old_ns / new_ns, wire_hmac, wire_gcm,
+               wire_hmac * 10 * 1e6 / BAUD, wire_gcm * 10 * 1e6 / BAUD);
+    }
+
+    return 0;
+}
@@ -0,0 +1,264 @@
+/*
+ * AES-128 CTR backends: known-answer verification and cycles/byte.
+ *
+ * Checks the T-table kernel against FIPS-197 (Appendix B and C.1) and
+ * NIST SP 800-38A F.5.1, cross-checks every CTR kernel this machine
+ * supports (T-table, AES-NI, VAES, ARMv8) against tiny-AES-c on random
+ * lengths and counter wrap-around, then times all of them.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "aes.h"
+#include "aes_ttable.h"
+#include "aes_accel.h"
+#include "aes_wrapper.h"
+#include "bench.h"
+
+#define REPEATS 9
+#define BYTES_PER_RUN (256 * 1024)
+
+static const size_t SIZES[] = { 16, 24, 64, 256, 1024, 16384 };
+
+static int check(const char *name, const uint8_t *got, const uint8_t *expected, size_t len) {
+    if (memcmp(got, expected, len) != 0) {
+        printf("  FAIL  %s\n", name);
+        return 1;
+    }
+    printf("  ok    %s\n", name);
+    return 0;
+}
+
+static int known_answer_tests(void) {
+    // FIPS-197 Appendix B
+    static const uint8_t b_key[16] = {
+        0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c
+    };
+    static const uint8_t b_pt[16] = {
+        0x32, 0x43, 0xf6, 0xa8, 0x88, 0x5a, 0x30, 0x8d, 0x31, 0x31, 0x98, 0xa2, 0xe0, 0x37, 0x07, 0x34
+    };
+    static const uint8_t b_ct[16] = {
+        0x39, 0x25, 0x84, 0x1d, 0x02, 0xdc, 0x09, 0xfb, 0xdc, 0x11, 0x85, 0x97, 0x19, 0x6a, 0x0b, 0x32
+    };
+    // FIPS-197 Appendix C.1
+    static const uint8_t c1_key[16] = {
+        0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f
+    };
+    static const uint8_t c1_pt[16] = {
+        0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff
+    };
+    static const uint8_t c1_ct[16] = {
+        0x69, 0xc4, 0xe0, 0xd8, 0x6a, 0x7b, 0x04, 0x30, 0xd8, 0xcd, 0xb7, 0x80, 0x70, 0xb4, 0xc5, 0x5a
+    };
+    // NIST SP 800-38A F.5.1 CTR-AES128.Encrypt
+    static const uint8_t ctr_iv[16] = {
+        0xf0, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8, 0xf9, 0xfa, 0xfb, 0xfc, 0xfd, 0xfe, 0xff
+    };
+    static const uint8_t ctr_pt[64] = {
+        0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96, 0xe9, 0x3d, 0x7e, 0x11, 0x73, 0x93, 0x17, 0x2a,
+        0xae, 0x2d, 0x8a, 0x57, 0x1e, 0x03, 0xac, 0x9c, 0x9e, 0xb7, 0x6f, 0xac, 0x45, 0xaf, 0x8e, 0x51,
+        0x30, 0xc8, 0x1c, 0x46, 0xa3, 0x5c, 0xe4, 0x11, 0xe5, 0xfb, 0xc1, 0x19, 0x1a, 0x0a, 0x52, 0xef,
+        0xf6, 0x9f, 0x24, 0x45, 0xdf, 0x4f, 0x9b, 0x17, 0xad, 0x2b, 0x41, 0x7b, 0xe6, 0x6c, 0x37, 0x10
+    };
+    static const uint8_t ctr_ct[64] = {
+        0x87, 0x4d, 0x61, 0x91, 0xb6, 0x20, 0xe3, 0x26, 0x1b, 0xef, 0x68, 0x64, 0x99, 0x0d, 0xb6, 0xce,
+        0x98, 0x06, 0xf6, 0x6b, 0x79, 0x70, 0xfd, 0xff, 0x86, 0x17, 0x18, 0x7b, 0xb9, 0xff, 0xfd, 0xff,
+        0x5a, 0xe4, 0xdf, 0x3e, 0xdb, 0xd5, 0xd3, 0x5e, 0x5b, 0x4f, 0x09, 0x02, 0x0d, 0xb0, 0x3e, 0xab,
+        0x1e, 0x03, 0x1d, 0xda, 0x2f, 0xbe, 0x03, 0xd1, 0x79, 0x21, 0x70, 0xa0, 0xf3, 0x00, 0x9c, 0xee
+    };
+    aes_tt_key_t tt;
+    struct AES_ctx tiny;
+    uint8_t out[64];
+    uint8_t ctr[16];
+    int failures = 0;
+
+    printf("Known-answer tests:\n");
+
+    aes_tt_setkey(&tt, b_key);
+    aes_tt_encrypt_block(&tt, b_pt, out);
+    failures += check("FIPS-197 Appendix B (ttable)", out, b_ct, 16);
+
+    aes_tt_setkey(&tt, c1_key);
+    aes_tt_encrypt_block(&tt, c1_pt, out);
+    failures += check("FIPS-197 Appendix C.1 (ttable)", out, c1_ct, 16);
+
+    aes_tt_setkey(&tt, b_key);
+    memcpy(ctr, ctr_iv, 16);
+    aes_tt_ctr_crypt(&tt, ctr, ctr_pt, out, sizeof(ctr_pt));
+    failures += check("SP 800-38A F.5.1 CTR (ttable)", out, ctr_ct, sizeof(ctr_ct));
+
+    AES_init_ctx_iv(&tiny, b_key, ctr_iv);
+    memcpy(out, ctr_pt, sizeof(ctr_pt));
+    AES_CTR_xcrypt_buffer(&tiny, out, sizeof(ctr_pt));
+    failures += check("SP 800-38A F.5.1 CTR (tiny-AES-c)", out, ctr_ct, sizeof(ctr_ct));
+
+    if (!aes_ctr_selftest()) {
+        printf("  FAIL  aes_ctr_selftest (configured backend)\n");
+        failures++;
+    } else {
+        printf("  ok    aes_ctr_selftest (configured backend)\n");
+    }
+
+    return failures;
+}
+
+/*
+ * Every CTR path behind one signature. Keys are expanded once up front.
+ */
+typedef struct {
+    struct AES_ctx tiny;
+    aes_tt_key_t tt;
+    uint8_t rk[AES_ACCEL_RK_SIZE];
+} bench_keys_t;
+
+typedef struct {
+    const char *name;
+    aes_accel_impl_t accel;     // AES_ACCEL_NONE for the software paths
+    void (*crypt)(bench_keys_t *keys, aes_accel_ctr_fn fn, uint8_t *ctr,
+                  const uint8_t *input, uint8_t *output, size_t length);
+} bench_impl_t;
+
+static void setup_keys(bench_keys_t *keys, const uint8_t *key) {
+    AES_init_ctx(&keys->tiny, key);
+    aes_tt_setkey(&keys->tt, key);
+    for (int i = 0; i < 44; i++) {
+        for (int j = 0; j < 4; j++) {
+            keys->rk[4 * i + j] = (uint8_t)(keys->tt.rk[i] >> (24 - 8 * j));
+        }
+    }
+}
+
+// Reference path: what the sniffer's decrypt_aes_ctr() used to do (minus the key expansion)
+static void crypt_tiny(bench_keys_t *keys, aes_accel_ctr_fn fn, uint8_t *ctr,
+                       const uint8_t *input, uint8_t *output, size_t length) {
+    (void)fn;
+    AES_ctx_set_iv(&keys->tiny, ctr);
+    if (output != input) {
+        memcpy(output, input, length);
+    }
+    AES_CTR_xcrypt_buffer(&keys->tiny, output, length);
+    memcpy(ctr, keys->tiny.Iv, 16);
+}
+
+static void crypt_ttable(bench_keys_t *keys, aes_accel_ctr_fn fn, uint8_t *ctr,
+                         const uint8_t *input, uint8_t *output, size_t length) {
+    (void)fn;
+    aes_tt_ctr_crypt(&keys->tt, ctr, input, output, length);
+}
+
+static void crypt_accel(bench_keys_t *keys, aes_accel_ctr_fn fn, uint8_t *ctr,
+                        const uint8_t *input, uint8_t *output, size_t length) {
+    fn(keys->rk, ctr, input, output, length);
+}
+
+static const bench_impl_t IMPLS[] = {
+    { "tiny-AES-c", AES_ACCEL_NONE,  crypt_tiny },
+    { "ttable",     AES_ACCEL_NONE,  crypt_ttable },
+    { "aesni",      AES_ACCEL_AESNI, crypt_accel },
+    { "vaes",       AES_ACCEL_VAES,  crypt_accel },
+    { "armv8",      AES_ACCEL_ARMV8, crypt_accel },
+};
+#define NUM_IMPLS (sizeof(IMPLS) / sizeof(IMPLS[0]))
+
+static int impl_available(const bench_impl_t *impl) {
+    return impl->accel == AES_ACCEL_NONE || aes_accel_supported(impl->accel);
+}
+
+// Random lengths and counters (including carry across all 16 bytes) against tiny-AES-c
+static int cross_check(const bench_impl_t *impl) {
+    static uint8_t input[4096], ref[4096], out[4096];
+    uint8_t key[16], iv[16], ref_ctr[16], ctr[16];
+    aes_accel_ctr_fn fn = aes_accel_kernel(impl->accel);
+    bench_keys_t keys;
+
+    srand(1);
+    for (int iter = 0; iter < 2000; iter++) {
+        size_t len = (size_t)(rand() % (int)sizeof(input));
+        for (int i = 0; i < 16; i++) {
+            key[i] = (uint8_t)rand();
+            iv[i] = (iter % 4 == 0 && i > 0) ? 0xff : (uint8_t)rand();
+        }
+        for (size_t i = 0; i < len; i++) {
+            input[i] = (uint8_t)rand();
+        }
+        setup_keys(&keys, key);
+
+        memcpy(ref_ctr, iv, 16);
+        crypt_tiny(&keys, NULL, ref_ctr, input, ref, len);
+
+        memcpy(ctr, iv, 16);
+        impl->crypt(&keys, fn, ctr, input, out, len);
+
+        if (memcmp(ref, out, len) != 0 || memcmp(ctr, ref_ctr, 16) != 0) {
+            printf("  FAIL  %s cross-check vs tiny-AES-c (iteration %d, %zu bytes)\n",
+                   impl->name, iter, len);
+            return 1;
+        }
+    }
+    printf("  ok    %s cross-check vs tiny-AES-c (2000 random buffers)\n", impl->name);
+    return 0;
+}
+
+int main(void) {
+    static uint8_t buf[16384];
+    static const uint8_t key[16] = {
+        0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c
+    };
+    const uint8_t nonce[16] = { 0 };
+    bench_keys_t keys;
+    int failures = known_answer_tests();
+
+    for (size_t i = 1; i < NUM_IMPLS; i++) {
+        if (impl_available(&IMPLS[i])) {
+            failures += cross_check(&IMPLS[i]);
+        }
+    }
+    if (failures != 0) {
+        return 1;
+    }
+
+    printf("\nConfigured backend: %s\n", aes_backend_name());
+
+    setup_keys(&keys, key);
+    memset(buf, 0x5a, sizeof(buf));
+
+    printf("\ncycles/byte\n%-7s", "bytes");
+    for (size_t i = 0; i < NUM_IMPLS; i++) {
+        if (impl_available(&IMPLS[i])) {
+            printf(" %12s", IMPLS[i].name);
+        }
+    }
+    printf("\n");
+
+    for (size_t s = 0; s < sizeof(SIZES) / sizeof(SIZES[0]); s++) {
+        size_t len = SIZES[s];
+        size_t runs = BYTES_PER_RUN / len;
+
+        printf("%-7zu", len);
+        for (size_t i = 0; i < NUM_IMPLS; i++) {
+            const bench_impl_t *impl = &IMPLS[i];
+            aes_accel_ctr_fn fn = aes_accel_kernel(impl->accel);
+            double cpb = 1e30;
+
+            if (!impl_available(impl)) {
+                continue;
+            }
+            for (int r = 0; r < REPEATS; r++) {
+                uint64_t c0 = bench_cycles();
+                for (size_t n = 0; n < runs; n++) {
+                    uint8_t ctr[16];
+                    memcpy(ctr, nonce, 16);
+                    impl->crypt(&keys, fn, ctr, buf, buf, len);
+                    bench_clobber(buf);
+                }
+                uint64_t c1 = bench_cycles();
+                cpb = bench_min(cpb, (double)(c1 - c0) / (double)(runs * len));
+            }
+            printf(" %12.2f", cpb);
+        }
+        printf("\n");
+    }
+
+    return 0;
+}
@@ -0,0 +1,411 @@
+/*
+ * Reliable delivery (cuart_arq.h) over a lossy pty pair: sender and receiver
+ * each own one pty as their UART, and a relay in the middle plays the two
+ * wires at 115200 baud, paced by airtime, flipping a bit in a given share
+ * of everything sent either way (packets, ACKs and link frames alike).
+ *
+ * The sender keeps the line busy with 48-byte messages sealed as AES-CTR +
+ * HMAC packets with sync framing, up to a 2 KB UART TX buffer, and reads
+ * the return wire every 10 ms (the firmware TX task's polling interval at
+ * the default 100 Hz tick). The receiver verifies, de-duplicates and
+ * acknowledges every packet through the link (cuart_link.h), which brings
+ * the line up first. Time is virtual, 1 ms per step, so every run is the
+ * same.
+ *
+ * For each loss rate it compares no reliability layer, stop-and-wait
+ * (window 1) and windows of 4, 8 and 16: goodput (new messages delivered
+ * per second, and as a share of what the line can carry), messages lost,
+ * retransmissions and duplicates. Exits 1 if a run with a window loses or
+ * doubles a message.
+ *
+ *   bench_arq [loss_percent...]
+ */
+
+#define _DEFAULT_SOURCE
+#define _XOPEN_SOURCE 600
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "aes_wrapper.h"
+#include "cuart_port.h"
+#include "cuart_frame.h"
+#include "cuart_parser.h"
+#include "cuart_link.h"
+#include "cuart_arq.h"
+#include "bench_pty.h"
+
+#define BAUD 115200
+#define RUN_MS 10000
+#define PAYLOAD_LEN 48
+#define POLL_MS 10
+#define TX_BUFFER 2048
+#define TIMEOUT_MS 300
+#define MAX_TRIES 32
+#define MAX_MESSAGES 4096
+
+// Sync header, nonce, length, reliability header, message, HMAC
+#define PACKET_MAX (CUART_FRAME_SYNC_SIZE + AES_BLOCK_SIZE + 2 + CUART_ARQ_HEADER_SIZE + PAYLOAD_LEN + HMAC_SIZE)
+
+static const uint8_t KEY[AES_KEY_SIZE] = {
+    0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6,
+    0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c
+};
+
+static const uint8_t HMAC_KEY[32] = {
+    0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef,
+    0xfe, 0xdc, 0xba, 0x98, 0x76, 0x54, 0x32, 0x10,
+    0x0f, 0x1e, 0x2d, 0x3c, 0x4b, 0x5a, 0x69, 0x78,
+    0x87, 0x96, 0xa5, 0xb4, 0xc3, 0xd2, 0xe1, 0xf0
+};
+
+// Windows compared; 0 is no reliability layer
+static const uint8_t WINDOWS[] = { 0, 1, 4, 8, 16 };
+#define NUM_WINDOWS (sizeof(WINDOWS) / sizeof(WINDOWS[0]))
+
+static const double DEFAULT_LOSSES[] = { 0, 1, 2, 5, 10, 20 };
+#define NUM_DEFAULT_LOSSES (sizeof(DEFAULT_LOSSES) / sizeof(DEFAULT_LOSSES[0]))
+
+typedef struct {
+    bench_pty_t pty;            // the end's UART and the relay's side of it
+    cuart_link_t link;
+    cuart_parser_t parser;
+} end_t;
+
+// One direction of the line: bytes leave at BAUD
+typedef struct {
+    uint8_t buf[16 * 1024];
+    size_t head;
+    size_t len;
+    uint32_t credit;            // bits * 1000 the line can still carry this step
+    end_t *to;
+} wire_t;
+
+// A sealed packet the sender holds for cuart_arq
+typedef struct {
+    uint8_t data[PACKET_MAX];
+    size_t len;
+} held_t;
+
+static end_t snd, rcv;
+static wire_t fwd, ret;
+static uint32_t now;
+static uint32_t loss_ppm;
+static uint32_t rng = 1;
+
+static aes_ctr_ctx_t ctr_ctx;
+static hmac_sha256_key_t hmac_key;
+static cuart_frame_ctx_t frame_ctx;
+
+static cuart_arq_tx_t arq_tx;
+static cuart_arq_rx_t arq_rx;
+static held_t held[CUART_ARQ_MAX_WINDOW];
+static uint8_t delivered[MAX_MESSAGES];
+static uint32_t messages;       // sealed by the sender
+static uint32_t released;       // taken out of the window as acknowledged
+static uint32_t unique;         // delivered for the first time
+static uint32_t doubled;        // delivered twice
+static uint32_t corrupted;
+
+static uint32_t next_rand(void) {
+    rng = rng * 1103515245u + 12345u;
+    return rng >> 8;
+}
+
+// One end transmits: the relay picks the bytes up and queues them on the line
+static void transmit(end_t *from, const uint8_t *data, size_t len) {
+    wire_t *w = (from == &snd) ? &fwd : &ret;
+    uint8_t bytes[PACKET_MAX];
+
+    bench_pty_transmit(&from->pty, data, len, bytes);
+
+    if (next_rand() % 1000000 < loss_ppm) {
+        bytes[next_rand() % len] ^= (uint8_t)(1u << (next_rand() % 8));
+        corrupted++;
+    }
+    if (len > sizeof(w->buf) - w->len) {
+        fprintf(stderr, "relay overflow\n");
+        exit(1);
+    }
+    for (size_t i = 0; i < len; i++) {
+        w->buf[(w->head + w->len + i) % sizeof(w->buf)] = bytes[i];
+    }
+    w->len += len;
+}
+
+// One millisecond of the line: deliver what it carries in that time
+static void wire_step(wire_t *w) {
+    size_t n;
+
+    if (w->len == 0) {
+        w->credit = 0;          // an idle line saves nothing up
+        return;
+    }
+    w->credit += BAUD;
+    n = w->credit / 10000;      // 10 bits per byte
+    if (n > w->len) {
+        n = w->len;
+    }
+    w->credit -= (uint32_t)n * 10000;
+
+    while (n > 0) {
+        size_t run = sizeof(w->buf) - w->head;
+
+        if (run > n) {
+            run = n;
+        }
+        bench_pty_deliver(&w->to->pty, w->buf + w->head, run);
+        w->head = (w->head + run) % sizeof(w->buf);
+        w->len -= run;
+        n -= run;
+    }
+}
+
+// Take in what reached an end; returns the byte count
+static size_t receive(end_t *end, uint8_t *buf) {
+    size_t n = bench_pty_receive(&end->pty, buf);
+
+    if (n > 0 && cuart_link_input(&end->link, buf, n, now)) {
+        cuart_parser_reset(&end->parser);
+    }
+    return n;
+}
+
+static void link_poll(end_t *end) {
+    uint8_t frame[CUART_LINK_FRAME_SIZE];
+
+    while (cuart_link_poll(&end->link, now, frame) > 0) {
+        transmit(end, frame, sizeof(frame));
+    }
+}
+
+static size_t seal(uint8_t window, uint8_t *out) {
+    uint8_t payload[CUART_ARQ_HEADER_SIZE + PAYLOAD_LEN];
+    uint8_t *message = payload + (window ? CUART_ARQ_HEADER_SIZE : 0);
+    uint8_t *packet = out + CUART_FRAME_SYNC_SIZE;
+    uint8_t iv[AES_BLOCK_SIZE];
+    size_t len;
+
+    memset(message, 0, PAYLOAD_LEN);
+    snprintf((char *)message, PAYLOAD_LEN, "{\"seq\":%u,\"temp\":21.5}", (unsigned)messages);
+    if (window) {
+        cuart_arq_put_header(payload, arq_tx.next, arq_tx.base);
+    }
+    cuart_port_random(iv, sizeof(iv));
+    memcpy(packet, iv, sizeof(iv));
+    len = cuart_frame_seal(&frame_ctx, packet, packet, AES_BLOCK_SIZE, iv, payload,
+                           (size_t)(message - payload) + PAYLOAD_LEN, true);
+    cuart_frame_sync_header(out, packet, AES_BLOCK_SIZE);
+    messages++;
+    return CUART_FRAME_SYNC_SIZE + len;
+}
+
+static void sender_step(uint8_t window) {
+    static uint8_t buf[64 * 1024];
+    held_t *h;
+
+    // The TX task looks at the return wire once per tick
+    if (now % POLL_MS == 0) {
+        receive(&snd, buf);
+        if (window && snd.link.acks_new) {
+            snd.link.acks_new = false;
+            cuart_arq_tx_ack(&arq_tx, snd.link.acks);
+        }
+        link_poll(&snd);
+    }
+    if (!cuart_link_up(&snd.link)) {
+        return;
+    }
+
+    if (window) {
+        while ((h = cuart_arq_tx_resend(&arq_tx, now)) != NULL) {
+            transmit(&snd, h->data, h->len);
+        }
+        while (cuart_arq_tx_release(&arq_tx) != NULL) {
+            released++;
+        }
+    }
+
+    // Keep the TX buffer topped up as far as the window allows
+    while (fwd.len + PACKET_MAX <= TX_BUFFER && messages < MAX_MESSAGES) {
+        if (window == 0) {
+            uint8_t out[PACKET_MAX];
+            size_t len = seal(window, out);
+
+            transmit(&snd, out, len);
+            continue;
+        }
+        if (cuart_arq_tx_full(&arq_tx)) {
+            break;
+        }
+        h = &held[arq_tx.next % CUART_ARQ_MAX_WINDOW];
+        h->len = seal(window, h->data);
+        transmit(&snd, h->data, h->len);
+        cuart_arq_tx_sent(&arq_tx, h, now);
+    }
+}
+
+static void receiver_step(uint8_t window) {
+    static uint8_t buf[64 * 1024];
+    size_t n = receive(&rcv, buf);
+    const uint8_t *data = buf;
+    bool ack_due = false;
+    cuart_parse_result_t result;
+
+    do {
+        size_t used;
+        cuart_frame_view_t frame;
+        uint8_t iv[AES_BLOCK_SIZE];
+        const uint8_t *message;
+        unsigned idx;
+
+        result = cuart_parser_feed(&rcv.parser, data, n, &used);
+        data += used;
+        n -= used;
+        if (result != CUART_PARSE_FRAME) {
+            continue;
+        }
+
+        cuart_parser_view(&rcv.parser, &frame);
+        memcpy(iv, frame.nonce, AES_BLOCK_SIZE);
+        if (!cuart_frame_open(&frame_ctx, &frame, iv, frame.body, true)) {
+            cuart_parser_resync(&rcv.parser);
+            continue;
+        }
+        message = frame.body;
+        if (window) {
+            ack_due = true;
+            if (!cuart_arq_rx_accept(&arq_rx, frame.body, NULL)) {
+                continue;
+            }
+            message += CUART_ARQ_HEADER_SIZE;
+        }
+        if (sscanf((const char *)message, "{\"seq\":%u", &idx) == 1 && idx < sizeof(delivered)) {
+            if (delivered[idx]++) {
+                doubled++;
+            } else {
+                unique++;
+            }
+        }
+    } while (n > 0 || result == CUART_PARSE_FRAME);
+
+    if (ack_due && arq_rx.synced) {
+        uint8_t state[CUART_ARQ_ACK_SIZE];
+        uint8_t frame[CUART_LINK_FRAME_SIZE];
+
+        cuart_arq_rx_ack(&arq_rx, state);
+        cuart_link_build_acks(frame, state);
+        transmit(&rcv, frame, sizeof(frame));
+    }
+    link_poll(&rcv);
+}
+
+static void start_end(end_t *end, cuart_link_role_t role) {
+    cuart_link_init(&end->link, role, cuart_link_rates_upto(BAUD), false, now);
+    cuart_parser_init(&end->parser, AES_BLOCK_SIZE, HMAC_SIZE, true);
+}
+
+static void drain(wire_t *w) {
+    w->head = w->len = 0;
+    w->credit = 0;
+}
+
+static int run(double loss, uint8_t window) {
+    // Packets the line could carry per second with no loss and no layer
+    double line_rate = (double)BAUD / 10 / (PACKET_MAX - CUART_ARQ_HEADER_SIZE);
+    double goodput;
+    uint32_t lost;
+    char mode[16];
+    int ok = 1;
+
+    loss_ppm = (uint32_t)(loss * 10000);
+    rng = 1;
+    messages = released = unique = doubled = corrupted = 0;
+    memset(delivered, 0, sizeof(delivered));
+    drain(&fwd);
+    drain(&ret);
+    // Whatever is still in the ptys from the last run
+    receive(&snd, (uint8_t[64 * 1024]){ 0 });
+    receive(&rcv, (uint8_t[64 * 1024]){ 0 });
+    now = 0;
+    start_end(&snd, CUART_LINK_INITIATOR);
+    start_end(&rcv, CUART_LINK_RESPONDER);
+    cuart_arq_tx_init(&arq_tx, window ? window : 1, TIMEOUT_MS, MAX_TRIES);
+    cuart_arq_rx_init(&arq_rx);
+
+    for (now = 0; now < RUN_MS; now++) {
+        sender_step(window);
+        wire_step(&fwd);
+        wire_step(&ret);
+        receiver_step(window);
+    }
+
+    goodput = unique * 1000.0 / RUN_MS;
+    if (window) {
+        // Every message acknowledged must have arrived, once
+        lost = 0;
+        for (uint32_t i = 0; i < released; i++) {
+            lost += !delivered[i];
+        }
+        ok = lost == 0 && doubled == 0 && arq_tx.stats.abandoned == 0;
+    } else {
+        // Everything sent long enough ago to have arrived
+        uint32_t queued = TX_BUFFER / PACKET_MAX + 1;
+        uint32_t settled = messages > queued ? messages - queued : 0;
+
+        lost = 0;
+        for (uint32_t i = 0; i < settled; i++) {
+            lost += !delivered[i];
+        }
+    }
+
+    if (window == 0) {
+        snprintf(mode, sizeof(mode), "none");
+    } else if (window == 1) {
+        snprintf(mode, sizeof(mode), "stop-and-wait");
+    } else {
+        snprintf(mode, sizeof(mode), "window %u", (unsigned)window);
+    }
+    printf("%5.1f%%  %-13s %8.1f %6.1f%% %7u %6u %6u %6u %5u  %s\n", loss,
+           mode, goodput, 100.0 * goodput / line_rate, (unsigned)lost,
+           window ? (unsigned)arq_tx.stats.fast_retransmits : 0, window ? (unsigned)arq_tx.stats.timeouts : 0,
+           window ? (unsigned)arq_rx.stats.duplicates : 0, (unsigned)corrupted, ok ? "ok" : "FAILED");
+    return ok;
+}
+
+int main(int argc, char *argv[]) {
+    double losses[32];
+    size_t num_losses = 0;
+    int failed = 0;
+
+    for (int i = 1; i < argc && num_losses < 32; i++) {
+        losses[num_losses++] = atof(argv[i]);
+    }
+    if (num_losses == 0) {
+        memcpy(losses, DEFAULT_LOSSES, sizeof(DEFAULT_LOSSES));
+        num_losses = NUM_DEFAULT_LOSSES;
+    }
+
+    if (!bench_pty_open(&snd.pty, "sender") || !bench_pty_open(&rcv.pty, "receiver")) {
+        perror("pty");
+        return 1;
+    }
+    fwd.to = &rcv;
+    ret.to = &snd;
+    aes_ctr_setkey(&ctr_ctx, KEY);
+    hmac_sha256_setkey(&hmac_key, HMAC_KEY, sizeof(HMAC_KEY));
+    frame_ctx.wire = CUART_WIRE_HMAC;
+    frame_ctx.ctr = &ctr_ctx;
+    frame_ctx.hmac_key = &hmac_key;
+
+    printf("%d baud, %d-byte messages in %d-byte packets, %d s of virtual time per run;\n"
+           "loss = share of transmissions (packets, ACKs, link frames) with a bit flipped\n",
+           BAUD, PAYLOAD_LEN, (int)PACKET_MAX, RUN_MS / 1000);
+    printf("%6s  %-13s %8s %7s %7s %6s %6s %6s %5s\n", "loss", "mode", "msg/s", "line",
+           "lost", "fast", "rto", "dups", "hit");
+    for (size_t l = 0; l < num_losses; l++) {
+        for (size_t w = 0; w < NUM_WINDOWS; w++) {
+            failed += !run(losses[l], WINDOWS[w]);
+        }
+    }
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,74 @@
+/*
+ * Common AES backend harness.
+ *
+ * Built once per CUART_AES_BACKEND (bench_backend_<backend>) and driven only
+ * through the aes_ctr_* API, so every backend is measured the same way:
+ * self-test, then per-packet latency (p50/p99) and throughput for the
+ * message sizes the sender transmits plus larger buffers.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "aes_wrapper.h"
+#include "bench.h"
+
+#define PACKETS 20000
+
+static const size_t SIZES[] = { 24, 64, 256, 1024 };
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+int main(void) {
+    static const uint8_t key[AES_KEY_SIZE] = {
+        0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6,
+        0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c
+    };
+    static uint8_t buf[1024];
+    static uint64_t latency[PACKETS];
+    uint8_t nonce[AES_BLOCK_SIZE] = { 0 };
+    aes_ctr_ctx_t ctx;
+
+    if (!aes_ctr_selftest()) {
+        fprintf(stderr, "%s: self-test FAILED\n", aes_backend_name());
+        return 1;
+    }
+
+    aes_ctr_setkey(&ctx, key);
+    memset(buf, 0x5a, sizeof(buf));
+
+    printf("backend: %s (self-test ok)\n", aes_backend_name());
+    printf("%-7s %12s %12s %12s\n", "bytes", "p50 ns", "p99 ns", "MB/s");
+
+    for (size_t s = 0; s < sizeof(SIZES) / sizeof(SIZES[0]); s++) {
+        size_t len = SIZES[s];
+        uint64_t total = 0;
+
+        for (int i = 0; i < PACKETS; i++) {
+            nonce[15] = (uint8_t)i;
+            uint64_t t0 = bench_now_ns();
+            aes_ctr_crypt(&ctx, buf, buf, len, nonce);
+            uint64_t t1 = bench_now_ns();
+            bench_clobber(buf);
+            latency[i] = t1 - t0;
+            total += t1 - t0;
+        }
+        qsort(latency, PACKETS, sizeof(latency[0]), cmp_u64);
+
+        printf("%-7zu %12llu %12llu %12.1f\n", len,
+               (unsigned long long)latency[PACKETS / 2],
+               (unsigned long long)latency[PACKETS * 99 / 100],
+               (double)len * PACKETS / ((double)total / 1e9) / 1e6);
+    }
+
+#ifdef ESP_AES_MOCK
+    printf("esp_aes mock: %lu setkey, %lu crypt calls, %llu block operations\n",
+           esp_aes_mock_stats.setkey_calls, esp_aes_mock_stats.crypt_calls,
+           esp_aes_mock_stats.blocks);
+#endif
+
+    return 0;
+}
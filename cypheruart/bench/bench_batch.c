@@ -0,0 +1,261 @@
+/*
+ * Batched packets (cuart_batch.h): effective messages per second for short
+ * telemetry records sent one per packet versus batched up to 64-1024 payload
+ * bytes, for both wire formats.
+ *
+ * For each batch limit it builds a stream of sealed batches, feeds it
+ * through cuart_parser, verifies and decrypts every packet in place and
+ * splits the records back out, checking each against what was sent. It
+ * reports wire bytes per message, the host CPU cost per message of sealing
+ * plus opening, and the resulting messages/sec at 115200 baud to 3 Mbaud
+ * (8N1, 10 bits per byte): the lower of the line-rate and CPU limits.
+ *
+ *   bench_batch [--sync] [record bytes]    (default 24)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "aes_wrapper.h"
+#include "aes_gcm.h"
+#include "cuart_frame.h"
+#include "cuart_parser.h"
+#include "cuart_batch.h"
+#include "bench.h"
+
+#define MESSAGES 20000
+#define REPEATS 5
+
+static const uint8_t KEY[AES_KEY_SIZE] = {
+    0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6,
+    0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c
+};
+
+static const uint8_t HMAC_KEY[32] = {
+    0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef,
+    0xfe, 0xdc, 0xba, 0x98, 0x76, 0x54, 0x32, 0x10,
+    0x0f, 0x1e, 0x2d, 0x3c, 0x4b, 0x5a, 0x69, 0x78,
+    0x87, 0x96, 0xa5, 0xb4, 0xc3, 0xd2, 0xe1, 0xf0
+};
+
+// Batch payload limits; 0 is one message per packet without a record table
+static const size_t LIMITS[] = { 0, 64, 128, 256, 512, 1024 };
+#define NUM_LIMITS (sizeof(LIMITS) / sizeof(LIMITS[0]))
+
+static const double BAUDS[] = { 115200, 921600, 3000000 };
+#define NUM_BAUDS (sizeof(BAUDS) / sizeof(BAUDS[0]))
+
+static aes_ctr_ctx_t ctr_ctx;
+static hmac_sha256_key_t hmac_key;
+static aes_gcm_ctx_t gcm_ctx;
+
+static int use_sync;
+static size_t record_len = 24;
+
+// Sealed stream, worst case one packet per message
+static uint8_t *stream;
+static size_t stream_cap;
+
+// Record i: its index in the first bytes, then a fill pattern
+static void make_record(uint8_t *out, uint32_t i) {
+    for (size_t k = 0; k < record_len; k++) {
+        out[k] = (uint8_t)(i * 31 + k);
+    }
+    memcpy(out, &i, record_len < sizeof(i) ? record_len : sizeof(i));
+}
+
+static size_t seal_packet(cuart_frame_ctx_t *ctx, uint8_t *out, const uint8_t *payload, size_t len,
+                          uint32_t counter) {
+    size_t nonce_len = (ctx->wire == CUART_WIRE_AEAD) ? AES_GCM_NONCE_SIZE : AES_BLOCK_SIZE;
+    uint8_t *packet = out + (use_sync ? CUART_FRAME_SYNC_SIZE : 0);
+    uint8_t iv[AES_BLOCK_SIZE] = { 0 };
+    size_t packet_len;
+
+    memcpy(iv, &counter, sizeof(counter));
+    memcpy(packet, iv, nonce_len);
+    packet_len = cuart_frame_seal(ctx, packet, packet, nonce_len, iv, payload, len, true);
+    if (use_sync) {
+        cuart_frame_sync_header(out, packet, nonce_len);
+        packet_len += CUART_FRAME_SYNC_SIZE;
+    }
+    return packet_len;
+}
+
+// Sender: MESSAGES records into packets of at most limit payload bytes
+static size_t seal_stream(cuart_frame_ctx_t *ctx, size_t limit, size_t *packets) {
+    uint8_t payload[CUART_FRAME_MAX_PAYLOAD];
+    uint8_t record[CUART_FRAME_MAX_PAYLOAD];
+    cuart_batch_t batch;
+    size_t used = 0;
+
+    *packets = 0;
+    cuart_batch_init(&batch, payload, limit);
+    for (uint32_t i = 0; i < MESSAGES; i++) {
+        make_record(record, i);
+        if (limit == 0) {
+            used += seal_packet(ctx, stream + used, record, record_len, (*packets)++);
+            continue;
+        }
+        if (!cuart_batch_fits(&batch, record_len)) {
+            used += seal_packet(ctx, stream + used, payload, batch.len, (*packets)++);
+            cuart_batch_init(&batch, payload, limit);
+        }
+        cuart_batch_add(&batch, record, record_len);
+    }
+    if (limit > 0 && batch.count > 0) {
+        used += seal_packet(ctx, stream + used, payload, batch.len, (*packets)++);
+    }
+    return used;
+}
+
+// Receiver: parse, verify, decrypt in place and split; returns records that match
+static uint32_t open_stream(cuart_frame_ctx_t *ctx, cuart_parser_t *parser, size_t len, size_t limit) {
+    const uint8_t *p = stream;
+    size_t left = len;
+    uint32_t next = 0;
+    cuart_parse_result_t result;
+
+    do {
+        size_t used;
+
+        result = cuart_parser_feed(parser, p, left, &used);
+        p += used;
+        left -= used;
+        if (result == CUART_PARSE_FRAME) {
+            uint8_t iv[AES_BLOCK_SIZE] = { 0 };
+            uint8_t expected[CUART_FRAME_MAX_PAYLOAD];
+            cuart_frame_view_t frame;
+            const uint8_t *record;
+            size_t offset = 0;
+            size_t n;
+
+            cuart_parser_view(parser, &frame);
+            memcpy(iv, frame.nonce, frame.nonce_len);
+            if (!cuart_frame_open(ctx, &frame, iv, frame.body, true)) {
+                continue;
+            }
+            if (limit == 0) {
+                make_record(expected, next);
+                next += (frame.length == record_len && memcmp(frame.body, expected, record_len) == 0);
+                continue;
+            }
+            if (cuart_batch_count(frame.body, frame.length) < 0) {
+                continue;
+            }
+            while (cuart_batch_next(frame.body, frame.length, &offset, &record, &n)) {
+                make_record(expected, next);
+                next += (n == record_len && memcmp(record, expected, record_len) == 0);
+            }
+        }
+    } while (left > 0 || result == CUART_PARSE_FRAME);
+    return next;
+}
+
+// Malformed tables must be rejected whole
+static int check_tables(void) {
+    static const uint8_t good[] = { 0, 2, 'h', 'i', 0, 1, '!' };
+    static const uint8_t short_header[] = { 0, 2, 'h', 'i', 0 };
+    static const uint8_t overrun[] = { 0, 2, 'h', 'i', 0, 9, '!' };
+    static const uint8_t empty_record[] = { 0, 0, 0, 1, '!' };
+    uint8_t buf[10];
+    cuart_batch_t batch;
+
+    cuart_batch_init(&batch, buf, sizeof(buf));
+    return cuart_batch_count(good, sizeof(good)) == 2 &&
+           cuart_batch_count(short_header, sizeof(short_header)) < 0 &&
+           cuart_batch_count(overrun, sizeof(overrun)) < 0 &&
+           cuart_batch_count(empty_record, sizeof(empty_record)) < 0 &&
+           cuart_batch_count(good, 0) < 0 &&
+           cuart_batch_add(&batch, good, 5) && !cuart_batch_add(&batch, good, 2) &&
+           cuart_batch_add(&batch, good, 1) && batch.len == sizeof(buf) && batch.count == 2 &&
+           !cuart_batch_add(&batch, good, 0);
+}
+
+static int run(cuart_wire_t wire) {
+    static cuart_parser_t parser;
+    cuart_frame_ctx_t ctx = { .wire = wire, .ctr = &ctr_ctx, .hmac_key = &hmac_key, .gcm = &gcm_ctx };
+    size_t nonce_len = (wire == CUART_WIRE_AEAD) ? AES_GCM_NONCE_SIZE : AES_BLOCK_SIZE;
+
+    printf("\n%s, %zu-byte records%s\n", wire == CUART_WIRE_AEAD ? "AES-128-GCM" : "AES-128-CTR + HMAC-SHA256",
+           record_len, use_sync ? ", sync framing" : "");
+    printf("%-9s %8s %10s %10s %12s", "batch", "msg/pkt", "bytes/msg", "overhead", "cpu ns/msg");
+    for (size_t b = 0; b < NUM_BAUDS; b++) {
+        printf(" %9.0fbd", BAUDS[b]);
+    }
+    printf("\n");
+
+    for (size_t l = 0; l < NUM_LIMITS; l++) {
+        size_t limit = LIMITS[l];
+        size_t packets = 0, len = 0;
+        double best = 1e30;
+
+        if (limit > 0 && CUART_BATCH_RECORD_HEADER + record_len > limit) {
+            continue;
+        }
+        for (int r = 0; r < REPEATS; r++) {
+            uint64_t t0 = bench_now_ns();
+
+            len = seal_stream(&ctx, limit, &packets);
+            cuart_parser_init(&parser, nonce_len, cuart_frame_mac_size(wire), use_sync);
+            if (open_stream(&ctx, &parser, len, limit) != MESSAGES) {
+                fprintf(stderr, "batch %zu: records lost or corrupted in the round trip\n", limit);
+                return 0;
+            }
+            best = bench_min(best, (double)(bench_now_ns() - t0));
+        }
+
+        double bytes_per_msg = (double)len / MESSAGES;
+        double ns_per_msg = best / MESSAGES;
+
+        if (limit == 0) {
+            printf("%-9s", "none");
+        } else {
+            printf("%-9zu", limit);
+        }
+        printf(" %8.1f %10.1f %9.0f%% %12.0f", (double)MESSAGES / packets, bytes_per_msg,
+               100.0 * (bytes_per_msg - record_len) / record_len, ns_per_msg);
+        for (size_t b = 0; b < NUM_BAUDS; b++) {
+            double wire_rate = BAUDS[b] / 10.0 / bytes_per_msg;
+            double cpu_rate = 1e9 / ns_per_msg;
+
+            printf(" %11.0f", wire_rate < cpu_rate ? wire_rate : cpu_rate);
+        }
+        printf("\n");
+    }
+    return 1;
+}
+
+int main(int argc, char *argv[]) {
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--sync") == 0) {
+            use_sync = 1;
+        } else if (argv[i][0] != '-' && atoi(argv[i]) > 0 && atoi(argv[i]) <= 512) {
+            record_len = (size_t)atoi(argv[i]);
+        } else {
+            fprintf(stderr, "Usage: %s [--sync] [record bytes, 1-512]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (!check_tables()) {
+        fprintf(stderr, "record table checks FAILED\n");
+        return 1;
+    }
+    printf("record table checks: ok\n");
+
+    aes_ctr_setkey(&ctr_ctx, KEY);
+    hmac_sha256_setkey(&hmac_key, HMAC_KEY, sizeof(HMAC_KEY));
+    aes_gcm_setkey(&gcm_ctx, KEY);
+    stream_cap = (size_t)MESSAGES * (CUART_FRAME_SYNC_SIZE + CUART_FRAME_MAX_NONCE + 2 + record_len + HMAC_SIZE);
+    stream = malloc(stream_cap);
+    if (stream == NULL) {
+        return 1;
+    }
+
+    printf("backend: %s; msg/s = min(line rate, host CPU for seal + open)\n", aes_backend_name());
+    if (!run(CUART_WIRE_HMAC) || !run(CUART_WIRE_AEAD)) {
+        return 1;
+    }
+    free(stream);
+    return 0;
+}
@@ -0,0 +1,355 @@
+/*
+ * Capture files (cuart_capture.h): cost of writing one as the sniffer does,
+ * and offline replay (uart_capture_replay) throughput with one worker and
+ * with one per CPU.
+ *
+ * Four ports each send back-to-back packets of 20-100 byte messages; their
+ * bytes arrive in reads of 1 byte to 4 KB, interleaved between the ports,
+ * so packets often span reads. Every read is appended to the capture and
+ * parsed as the sniffer does, indexing each packet as it completes. Two
+ * formats are captured: AES-CTR + HMAC with random nonces, and AES-128-GCM
+ * with session nonces (a salt announcement every 32 packets, a new salt
+ * every 4096) and sync framing.
+ *
+ * The replay tool then verifies the whole capture, and the first tenth of
+ * it by time. Reports MB of capture and packets per second (wall time of
+ * the tool, page cache warm), and exits 1 unless every message comes back
+ * authentic.
+ *
+ *   bench_capture [MB per format] [path/to/uart_capture_replay]
+ */
+
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "aes_wrapper.h"
+#include "aes_gcm.h"
+#include "cuart_port.h"
+#include "cuart_frame.h"
+#include "cuart_parser.h"
+#include "cuart_session.h"
+#include "cuart_capture.h"
+
+#define NUM_PORTS 4
+#define MAX_READ 4096
+#define ANNOUNCE_INTERVAL 32
+#define SALT_PACKETS 4096
+
+// The replay tool's keys (uart_capture_replay.c)
+static const uint8_t KEY[AES_KEY_SIZE] = {
+    0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6,
+    0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c
+};
+
+static const uint8_t HMAC_KEY[32] = {
+    0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef,
+    0xfe, 0xdc, 0xba, 0x98, 0x76, 0x54, 0x32, 0x10,
+    0x0f, 0x1e, 0x2d, 0x3c, 0x4b, 0x5a, 0x69, 0x78,
+    0x87, 0x96, 0xa5, 0xb4, 0xc3, 0xd2, 0xe1, 0xf0
+};
+
+typedef struct {
+    const char *name;
+    uint32_t options;
+} format_t;
+
+static const format_t FORMATS[] = {
+    { "CTR+HMAC", 0 },
+    { "GCM, session, sync", CUART_CAPTURE_AEAD | CUART_CAPTURE_SESSION | CUART_CAPTURE_SYNC },
+};
+#define NUM_FORMATS (sizeof(FORMATS) / sizeof(FORMATS[0]))
+
+// One sending port: a stream of sealed packets being read in pieces
+typedef struct {
+    cuart_session_tx_t session;
+    uint32_t since_announce;
+    uint32_t next_salt;             // messages sent when the next salt is drawn
+    uint32_t sent;                  // messages
+    uint8_t pending[CUART_CAPTURE_PACKET_MAX];
+    size_t pending_len;
+    size_t pending_pos;
+    int pending_message;            // pending is a message, not an announcement
+    cuart_parser_t parser;
+} port_t;
+
+static cuart_frame_ctx_t frame_ctx;
+static aes_ctr_ctx_t ctr;
+static hmac_sha256_key_t hmac_key;
+static aes_gcm_ctx_t gcm;
+static port_t ports[NUM_PORTS];
+static cuart_capture_writer_t writer;
+
+static double now_s(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Seal the port's next packet into pending; returns whether it is a message
+static int next_packet(port_t *port, uint32_t options) {
+    uint8_t *packet = port->pending + ((options & CUART_CAPTURE_SYNC) ? CUART_FRAME_SYNC_SIZE : 0);
+    uint8_t message[100];
+    uint8_t iv[AES_BLOCK_SIZE];
+    size_t nonce_len, len;
+    int is_message = 1;
+
+    size_t message_len = 20 + (size_t)(rand() % 81);
+    size_t n = (size_t)snprintf((char *)message, sizeof(message), "{\"seq\":%u,\"temp\":21.5}", port->sent);
+
+    if (message_len < n) {
+        message_len = n;
+    }
+    memset(message + n, ' ', message_len - n);
+
+    if (options & CUART_CAPTURE_SESSION) {
+        bool renewed = false;
+
+        nonce_len = CUART_SESSION_SEQ_SIZE;
+        if (port->sent == port->next_salt) {
+            cuart_session_tx_init(&port->session);
+            port->next_salt += SALT_PACKETS;
+            renewed = true;
+        }
+        if (renewed || port->since_announce == ANNOUNCE_INTERVAL) {
+            uint8_t announce[CUART_SESSION_ANNOUNCE_SIZE];
+
+            cuart_session_put_announce(&port->session, announce);
+            cuart_session_put_seq(CUART_SESSION_ANNOUNCE_SEQ, packet);
+            cuart_session_iv(port->session.salt, CUART_SESSION_ANNOUNCE_SEQ, iv);
+            len = cuart_frame_seal(&frame_ctx, packet, packet, nonce_len, iv, announce, sizeof(announce), false);
+            port->since_announce = 0;
+            is_message = 0;
+        } else {
+            uint32_t seq = cuart_session_next_seq(&port->session, NULL);
+
+            cuart_session_put_seq(seq, packet);
+            cuart_session_iv(port->session.salt, seq, iv);
+            len = cuart_frame_seal(&frame_ctx, packet, packet, nonce_len, iv, message, message_len, true);
+            port->since_announce++;
+        }
+    } else {
+        nonce_len = (options & CUART_CAPTURE_AEAD) ? AES_GCM_NONCE_SIZE : AES_BLOCK_SIZE;
+        memset(iv, 0, sizeof(iv));
+        cuart_port_random(iv, nonce_len);
+        memcpy(packet, iv, nonce_len);
+        len = cuart_frame_seal(&frame_ctx, packet, packet, nonce_len, iv, message, message_len, true);
+    }
+    if (options & CUART_CAPTURE_SYNC) {
+        cuart_frame_sync_header(port->pending, packet, nonce_len);
+        len += CUART_FRAME_SYNC_SIZE;
+    }
+    port->pending_len = len;
+    port->pending_pos = 0;
+    port->sent += (uint32_t)is_message;
+    port->pending_message = is_message;
+    return is_message;
+}
+
+// Capture about target bytes of traffic; returns messages sent and sets the
+// time spent in the capture writer and parser
+static uint64_t write_capture(const char *path, uint32_t options, size_t target, double *write_s) {
+    static uint8_t chunk[MAX_READ];
+    uint64_t messages = 0;
+    size_t total = 0;
+    double spent = 0;
+
+    frame_ctx.wire = (options & CUART_CAPTURE_AEAD) ? CUART_WIRE_AEAD : CUART_WIRE_HMAC;
+    if (cuart_capture_create(&writer, path, options) < 0) {
+        perror(path);
+        exit(1);
+    }
+    for (int i = 0; i < NUM_PORTS; i++) {
+        char name[32];
+
+        memset(&ports[i], 0, sizeof(ports[i]));
+        cuart_parser_init(&ports[i].parser,
+                          (options & CUART_CAPTURE_SESSION) ? CUART_SESSION_SEQ_SIZE
+                              : ((options & CUART_CAPTURE_AEAD) ? AES_GCM_NONCE_SIZE : AES_BLOCK_SIZE),
+                          cuart_frame_mac_size(frame_ctx.wire), (options & CUART_CAPTURE_SYNC) != 0);
+        snprintf(name, sizeof(name), "/dev/ttyUSB%d", i);
+        cuart_capture_add_port(&writer, name);
+    }
+
+    while (total < target) {
+        int id = rand() % NUM_PORTS;
+        port_t *port = &ports[id];
+        size_t want = 1 + (size_t)(rand() % MAX_READ);
+        size_t len = 0;
+
+        // The read: whatever the port has sent, up to want bytes
+        while (len < want) {
+            size_t take;
+
+            if (port->pending_pos == port->pending_len) {
+                messages += (uint64_t)next_packet(port, options);
+            }
+            take = port->pending_len - port->pending_pos;
+            if (take > want - len) {
+                take = want - len;
+            }
+            memcpy(chunk + len, port->pending + port->pending_pos, take);
+            port->pending_pos += take;
+            len += take;
+        }
+        total += len;
+
+        // What the sniffer does with it
+        double t0 = now_s();
+        cuart_parse_result_t result;
+        const uint8_t *p = chunk;
+        size_t left = len;
+
+        cuart_capture_chunk(&writer, id, chunk, len);
+        do {
+            size_t used;
+
+            result = cuart_parser_feed(&port->parser, p, left, &used);
+            p += used;
+            left -= used;
+            if (result == CUART_PARSE_FRAME) {
+                cuart_frame_view_t frame;
+                uint8_t flags = 0;
+
+                cuart_parser_view(&port->parser, &frame);
+                if ((options & CUART_CAPTURE_SESSION) &&
+                    cuart_session_get_seq(frame.nonce) == CUART_SESSION_ANNOUNCE_SEQ) {
+                    flags = CUART_CAPTURE_SALT;
+                }
+                cuart_capture_packet(&writer, id, (int32_t)(p - chunk) - (int32_t)cuart_parser_trailing(&port->parser),
+                                     port->parser.frame_len, flags);
+            }
+        } while (left > 0 || result == CUART_PARSE_FRAME);
+        spent += now_s() - t0;
+    }
+
+    // Packets still on their way are not in the capture
+    for (int i = 0; i < NUM_PORTS; i++) {
+        if (ports[i].pending_pos < ports[i].pending_len) {
+            messages -= (uint64_t)ports[i].pending_message;
+        }
+    }
+    double t0 = now_s();
+    if (cuart_capture_close(&writer) < 0) {
+        perror(path);
+        exit(1);
+    }
+    *write_s = spent + now_s() - t0;
+    return messages;
+}
+
+// Run the replay tool; returns the authentic messages it reports, -1 on failure
+static long long replay(const char *tool, const char *path, int workers, const char *to, double *wall) {
+    char command[1024];
+    char line[512];
+    long long messages = -1;
+    FILE *out;
+    double t0 = now_s();
+
+    snprintf(command, sizeof(command), "%s --workers %d%s%s %s", tool, workers, to ? " --to " : "", to ? to : "",
+             path);
+    out = popen(command, "r");
+    if (!out) {
+        return -1;
+    }
+    while (fgets(line, sizeof(line), out)) {
+        unsigned long long n;
+
+        if (sscanf(line, " %llu messages", &n) == 1 && strstr(line, "messages")) {
+            messages = (long long)n;
+        }
+        if (strstr(line, "INVALID") && !strstr(line, " 0 ✗ INVALID, 0 unreadable")) {
+            fprintf(stderr, "%s", line);
+            messages = -1;
+            break;
+        }
+    }
+    if (pclose(out) != 0) {
+        messages = -1;
+    }
+    *wall = now_s() - t0;
+    return messages;
+}
+
+int main(int argc, char *argv[]) {
+    size_t mb = (argc > 1) ? (size_t)atoi(argv[1]) : 64;
+    const char *tool = (argc > 2) ? argv[2] : "./uart_capture_replay";
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    char path[] = "/tmp/bench_capture_XXXXXX";
+    int failed = 0;
+    int fd;
+
+    if (mb == 0 || access(tool, X_OK) != 0) {
+        fprintf(stderr, "usage: %s [MB per format] [path/to/uart_capture_replay] (build it with `make`)\n", argv[0]);
+        return 1;
+    }
+    if (cpus < 1) {
+        cpus = 1;
+    }
+    fd = mkstemp(path);
+    if (fd < 0) {
+        perror("mkstemp");
+        return 1;
+    }
+    close(fd);
+    srand(1);
+    aes_ctr_setkey(&ctr, KEY);
+    hmac_sha256_setkey(&hmac_key, HMAC_KEY, sizeof(HMAC_KEY));
+    aes_gcm_setkey(&gcm, KEY);
+    frame_ctx.ctr = &ctr;
+    frame_ctx.hmac_key = &hmac_key;
+    frame_ctx.gcm = &gcm;
+
+    printf("%zu MB of traffic per format from %d ports in 1-4096 byte reads, %ld CPUs\n", mb, NUM_PORTS, cpus);
+    printf("%-20s %-13s %7s %9s %10s %11s %5s\n", "format", "run", "workers", "seconds", "MB/s", "packets/s", "");
+    for (size_t f = 0; f < NUM_FORMATS; f++) {
+        double write_s;
+        uint64_t messages = write_capture(path, FORMATS[f].options, mb << 20, &write_s);
+        cuart_capture_reader_t reader;
+        double size_mb;
+        uint64_t packets;
+
+        if (cuart_capture_open(&reader, path) < 0) {
+            perror(path);
+            return 1;
+        }
+        size_mb = reader.size / 1e6;
+        packets = reader.packets;
+        cuart_capture_release(&reader);
+        printf("%-20s %-13s %7s %9.3f %10.1f %11.0f\n", FORMATS[f].name, "write", "-", write_s,
+               size_mb / write_s, packets / write_s);
+
+        int worker_counts[2] = { 1, (int)cpus };
+        for (int w = 0; w < (cpus > 1 ? 2 : 1); w++) {
+            double wall;
+            long long got = replay(tool, path, worker_counts[w], NULL, &wall);
+            int ok = got == (long long)messages;
+
+            printf("%-20s %-13s %7d %9.3f %10.1f %11.0f %5s\n", "", "replay all", worker_counts[w], wall,
+                   size_mb / wall, packets / wall, ok ? "ok" : "FAIL");
+            if (!ok) {
+                fprintf(stderr, "expected %llu messages, replay reported %lld\n",
+                        (unsigned long long)messages, got);
+                failed++;
+            }
+        }
+
+        // A time slice: found by binary search, only its packets read
+        double wall;
+        char to[32];
+        cuart_capture_open(&reader, path);
+        uint64_t span = cuart_capture_entry(&reader, reader.packets - 1)->timestamp_ns - reader.header->created_ns;
+        cuart_capture_release(&reader);
+        snprintf(to, sizeof(to), "%.6f", span / 1e9 / 10);
+        long long got = replay(tool, path, (int)cpus, to, &wall);
+        printf("%-20s %-13s %7ld %9.3f %10s %11s %5s\n", "", "replay 1/10", cpus, wall, "", "",
+               got > 0 && got < (long long)messages ? "ok" : "FAIL");
+        failed += !(got > 0 && got < (long long)messages);
+    }
+    unlink(path);
+    return failed ? 1 : 0;
+}
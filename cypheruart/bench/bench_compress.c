@@ -0,0 +1,384 @@
+/*
+ * Payload compression (cuart_compress.h) over recorded traffic: compression
+ * ratio, compress/decompress cost, and end-to-end latency per message with
+ * and without compression, for both wire formats.
+ *
+ * Traffic is read one message per line from a file (for example the
+ * plaintext lines logged by the receiver), or synthesized: the sender's demo
+ * messages, JSON telemetry and log lines with changing values. Every
+ * message is compressed, sealed, parsed, verified, decrypted and
+ * decompressed, and checked against what was sent. As on the sender, a
+ * message is only sent compressed if that makes it smaller.
+ *
+ * Latency per message is the host CPU time for the whole round trip plus the
+ * time its packet spends on the wire at 115200 baud to 3 Mbaud (8N1).
+ *
+ *   bench_compress [traffic.txt]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "aes_wrapper.h"
+#include "aes_gcm.h"
+#include "cuart_frame.h"
+#include "cuart_parser.h"
+#include "cuart_compress.h"
+#include "bench.h"
+
+#define MAX_MESSAGES 20000
+#define SYNTHETIC_MESSAGES 4000
+#define REPEATS 5
+
+static const uint8_t KEY[AES_KEY_SIZE] = {
+    0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6,
+    0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c
+};
+
+static const uint8_t HMAC_KEY[32] = {
+    0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef,
+    0xfe, 0xdc, 0xba, 0x98, 0x76, 0x54, 0x32, 0x10,
+    0x0f, 0x1e, 0x2d, 0x3c, 0x4b, 0x5a, 0x69, 0x78,
+    0x87, 0x96, 0xa5, 0xb4, 0xc3, 0xd2, 0xe1, 0xf0
+};
+
+static const double BAUDS[] = { 115200, 921600, 3000000 };
+#define NUM_BAUDS (sizeof(BAUDS) / sizeof(BAUDS[0]))
+
+static aes_ctr_ctx_t ctr_ctx;
+static hmac_sha256_key_t hmac_key;
+static aes_gcm_ctx_t gcm_ctx;
+static cuart_compress_t compressor;
+
+// Traffic: message i is text + offsets[i], lengths[i] bytes
+static char *text;
+static size_t *offsets;
+static size_t *lengths;
+static size_t messages;
+static size_t plain_bytes;
+
+// Sealed stream, worst case one uncompressed packet per message
+static uint8_t *stream;
+
+static int add_message(const char *msg, size_t len, size_t *used, size_t cap) {
+    if (len == 0) {
+        return 1;
+    }
+    if (len > CUART_FRAME_MAX_PAYLOAD || messages == MAX_MESSAGES || *used + len > cap) {
+        return 0;
+    }
+    memcpy(text + *used, msg, len);
+    offsets[messages] = *used;
+    lengths[messages++] = len;
+    *used += len;
+    plain_bytes += len;
+    return 1;
+}
+
+static int load_file(const char *path, size_t cap) {
+    static char line[4096];
+    FILE *f = fopen(path, "r");
+    size_t used = 0;
+
+    if (f == NULL) {
+        perror(path);
+        return 0;
+    }
+    while (fgets(line, sizeof(line), f) != NULL) {
+        size_t len = strcspn(line, "\r\n");
+
+        if (len > CUART_FRAME_MAX_PAYLOAD) {
+            len = CUART_FRAME_MAX_PAYLOAD;
+        }
+        if (!add_message(line, len, &used, cap)) {
+            break;
+        }
+    }
+    fclose(f);
+    return messages > 0;
+}
+
+static void synthesize(size_t cap) {
+    static const char *demo[] = {
+        "Hello from ESP32 Sender!",
+        "This is encrypted data",
+        "AES-128 CTR mode active",
+        "Secure communication test"
+    };
+    static const char *levels[] = { "INFO", "INFO", "INFO", "WARNING", "ERROR" };
+    static const char *events[] = { "sensor read ok", "retry after timeout", "buffer overflow", "reset" };
+    char msg[256];
+    size_t used = 0;
+    uint32_t x = 1;
+
+    for (uint32_t i = 0; i < SYNTHETIC_MESSAGES; i++) {
+        int len;
+
+        x = x * 1103515245u + 12345u;
+        switch (i % 4) {
+        case 0:
+            len = snprintf(msg, sizeof(msg), "%s", demo[(i / 4) % 4]);
+            break;
+        case 1:
+            len = snprintf(msg, sizeof(msg),
+                           "{\"node\":%u,\"seq\":%u,\"temp\":%d.%u,\"humidity\":%u,\"pressure\":%u,"
+                           "\"battery\":%u,\"status\":\"ok\"}",
+                           (x >> 8) % 8, i, 18 + (int)((x >> 12) % 10), (x >> 16) % 10,
+                           40 + (x >> 20) % 30, 990 + (x >> 4) % 40, 3300 + (x >> 24) % 900);
+            break;
+        case 2:
+            len = snprintf(msg, sizeof(msg), "{\"id\":%u,\"uptime\":%u,\"rssi\":-%u,\"state\":\"%s\"}",
+                           (x >> 8) % 8, i * 5, 40 + (x >> 16) % 50, (x & 0x100) ? "on" : "off");
+            break;
+        default:
+            len = snprintf(msg, sizeof(msg), "%s node %u: %s, voltage %u.%02u level %u",
+                           levels[(x >> 8) % 5], (x >> 12) % 8, events[(x >> 16) % 4],
+                           3 + (x >> 20) % 2, (x >> 4) % 100, (x >> 24) % 100);
+            break;
+        }
+        add_message(msg, (size_t)len, &used, cap);
+    }
+}
+
+static size_t seal_packet(cuart_frame_ctx_t *ctx, uint8_t *out, const uint8_t *payload, size_t len,
+                          uint16_t flags, uint32_t counter) {
+    size_t nonce_len = (ctx->wire == CUART_WIRE_AEAD) ? AES_GCM_NONCE_SIZE : AES_BLOCK_SIZE;
+    uint8_t iv[AES_BLOCK_SIZE] = { 0 };
+
+    memcpy(iv, &counter, sizeof(counter));
+    memcpy(out, iv, nonce_len);
+    return cuart_frame_seal_flags(ctx, out, out, nonce_len, iv, payload, len, true, flags);
+}
+
+// Sender: every message, compressed when that saves a byte
+static size_t seal_stream(cuart_frame_ctx_t *ctx, int compress, size_t *compressed) {
+    uint8_t packed[CUART_FRAME_MAX_PAYLOAD];
+    size_t used = 0;
+
+    *compressed = 0;
+    for (size_t i = 0; i < messages; i++) {
+        const uint8_t *payload = (const uint8_t *)text + offsets[i];
+        size_t len = lengths[i];
+        uint16_t flags = 0;
+
+        if (compress) {
+            size_t packed_len = cuart_compress(&compressor, payload, len, packed, len - 1);
+
+            if (packed_len > 0) {
+                payload = packed;
+                len = packed_len;
+                flags = CUART_FRAME_FLAG_COMPRESSED;
+                (*compressed)++;
+            }
+        }
+        used += seal_packet(ctx, stream + used, payload, len, flags, (uint32_t)i);
+    }
+    return used;
+}
+
+// Receiver: parse, verify, decrypt in place and decompress; returns messages that match
+static size_t open_stream(cuart_frame_ctx_t *ctx, cuart_parser_t *parser, size_t len) {
+    const uint8_t *p = stream;
+    size_t left = len;
+    size_t next = 0;
+    cuart_parse_result_t result;
+
+    do {
+        size_t used;
+
+        result = cuart_parser_feed(parser, p, left, &used);
+        p += used;
+        left -= used;
+        if (result == CUART_PARSE_FRAME) {
+            uint8_t iv[AES_BLOCK_SIZE] = { 0 };
+            uint8_t inflated[CUART_FRAME_MAX_PAYLOAD];
+            cuart_frame_view_t frame;
+            const uint8_t *plaintext;
+            size_t plaintext_len;
+
+            cuart_parser_view(parser, &frame);
+            memcpy(iv, frame.nonce, frame.nonce_len);
+            if (!cuart_frame_open(ctx, &frame, iv, frame.body, true) || next == messages) {
+                continue;
+            }
+            plaintext = frame.body;
+            plaintext_len = frame.length;
+            if (frame.flags & CUART_FRAME_FLAG_COMPRESSED) {
+                plaintext_len = cuart_decompress(frame.body, frame.length, inflated, sizeof(inflated));
+                plaintext = inflated;
+            }
+            next += (plaintext_len == lengths[next] &&
+                     memcmp(plaintext, text + offsets[next], plaintext_len) == 0);
+        }
+    } while (left > 0 || result == CUART_PARSE_FRAME);
+    return next;
+}
+
+// Malformed streams must be rejected without reading or writing out of bounds
+static int check_streams(void) {
+    static const uint8_t good[] = { 0x01, 'h', 'i', 0x80, 0x01 };      // "hi", copy 3 from 2 back
+    static const uint8_t short_literals[] = { 0x05, 'h', 'i' };
+    static const uint8_t short_copy[] = { 0x01, 'h', 'i', 0x80 };
+    static const uint8_t far_copy[] = { 0x01, 'h', 'i', 0x83, 0xff };   // 1024 back, before the dictionary
+    uint8_t out[8];
+
+    return cuart_decompress(good, sizeof(good), out, sizeof(out)) == 5 && memcmp(out, "hihih", 5) == 0 &&
+           cuart_decompress(good, sizeof(good), out, 4) == 0 &&
+           cuart_decompress(short_literals, sizeof(short_literals), out, sizeof(out)) == 0 &&
+           cuart_decompress(short_copy, sizeof(short_copy), out, sizeof(out)) == 0 &&
+           cuart_decompress(far_copy, sizeof(far_copy), out, sizeof(out)) == 0;
+}
+
+// Compression alone: ratio and per-message cost of each direction
+static int measure_codec(void) {
+    uint8_t packed[2 * CUART_FRAME_MAX_PAYLOAD];        // room for incompressible messages
+    uint8_t inflated[CUART_FRAME_MAX_PAYLOAD];
+    size_t packed_bytes = 0, sent_bytes = 0, compressed = 0;
+    double best_c = 1e30, best_d = 1e30;
+
+    for (size_t i = 0; i < messages; i++) {
+        const uint8_t *msg = (const uint8_t *)text + offsets[i];
+        size_t n = cuart_compress(&compressor, msg, lengths[i], packed, sizeof(packed));
+
+        if (n == 0 || cuart_decompress(packed, n, inflated, sizeof(inflated)) != lengths[i] ||
+            memcmp(inflated, msg, lengths[i]) != 0) {
+            fprintf(stderr, "message %zu does not survive compression\n", i);
+            return 0;
+        }
+        packed_bytes += n;
+        if (n < lengths[i]) {
+            sent_bytes += n;
+            compressed++;
+        } else {
+            sent_bytes += lengths[i];
+        }
+    }
+
+    for (int r = 0; r < REPEATS; r++) {
+        uint64_t t0 = bench_now_ns();
+        size_t n = 0;
+
+        for (size_t i = 0; i < messages; i++) {
+            n += cuart_compress(&compressor, (const uint8_t *)text + offsets[i], lengths[i], packed, sizeof(packed));
+            bench_clobber(packed);
+        }
+        best_c = bench_min(best_c, (double)(bench_now_ns() - t0));
+        bench_clobber(&n);
+    }
+    for (int r = 0; r < REPEATS; r++) {
+        uint64_t total = 0;
+
+        for (size_t i = 0; i < messages; i++) {
+            size_t n = cuart_compress(&compressor, (const uint8_t *)text + offsets[i], lengths[i],
+                                      packed, sizeof(packed));
+            uint64_t t0 = bench_now_ns();
+
+            cuart_decompress(packed, n, inflated, sizeof(inflated));
+            bench_clobber(inflated);
+            total += bench_now_ns() - t0;
+        }
+        best_d = bench_min(best_d, (double)total);
+    }
+
+    printf("%zu messages, %.1f bytes average\n", messages, (double)plain_bytes / messages);
+    printf("compressed stream:  %5.1f%% of plaintext (ratio %.2f)\n",
+           100.0 * packed_bytes / plain_bytes, (double)plain_bytes / packed_bytes);
+    printf("sent payload:       %5.1f%% of plaintext, %zu of %zu messages compressed\n",
+           100.0 * sent_bytes / plain_bytes, compressed, messages);
+    printf("compress:   %8.0f ns/msg %8.1f MB/s\n", best_c / messages, plain_bytes * 1e3 / best_c);
+    printf("decompress: %8.0f ns/msg %8.1f MB/s (includes clock reads)\n",
+           best_d / messages, plain_bytes * 1e3 / best_d);
+    return 1;
+}
+
+static int run(cuart_wire_t wire) {
+    static cuart_parser_t parser;
+    cuart_frame_ctx_t ctx = { .wire = wire, .ctr = &ctr_ctx, .hmac_key = &hmac_key, .gcm = &gcm_ctx };
+    size_t nonce_len = (wire == CUART_WIRE_AEAD) ? AES_GCM_NONCE_SIZE : AES_BLOCK_SIZE;
+
+    printf("\n%s\n", wire == CUART_WIRE_AEAD ? "AES-128-GCM" : "AES-128-CTR + HMAC-SHA256");
+    printf("%-12s %10s %12s", "payload", "bytes/pkt", "cpu ns/msg");
+    for (size_t b = 0; b < NUM_BAUDS; b++) {
+        printf(" %9.0fbd", BAUDS[b]);
+    }
+    printf("   (latency, us/msg)\n");
+
+    for (int compress = 0; compress <= 1; compress++) {
+        size_t len = 0, compressed = 0;
+        double best = 1e30;
+
+        for (int r = 0; r < REPEATS; r++) {
+            uint64_t t0 = bench_now_ns();
+
+            len = seal_stream(&ctx, compress, &compressed);
+            cuart_parser_init(&parser, nonce_len, cuart_frame_mac_size(wire), false);
+            if (open_stream(&ctx, &parser, len) != messages) {
+                fprintf(stderr, "%s: messages lost or corrupted in the round trip\n",
+                        compress ? "compressed" : "plain");
+                return 0;
+            }
+            best = bench_min(best, (double)(bench_now_ns() - t0));
+        }
+
+        double bytes_per_pkt = (double)len / messages;
+        double ns_per_msg = best / messages;
+
+        printf("%-12s %10.1f %12.0f", compress ? "compressed" : "plain", bytes_per_pkt, ns_per_msg);
+        for (size_t b = 0; b < NUM_BAUDS; b++) {
+            printf(" %11.1f", ns_per_msg / 1e3 + bytes_per_pkt * 10.0 / BAUDS[b] * 1e6);
+        }
+        printf("\n");
+    }
+    return 1;
+}
+
+int main(int argc, char *argv[]) {
+    size_t cap = (size_t)MAX_MESSAGES * 256;
+
+    if (argc > 2 || (argc == 2 && argv[1][0] == '-')) {
+        fprintf(stderr, "Usage: %s [traffic.txt, one message per line]\n", argv[0]);
+        return 1;
+    }
+
+    text = malloc(cap);
+    offsets = malloc(MAX_MESSAGES * sizeof(*offsets));
+    lengths = malloc(MAX_MESSAGES * sizeof(*lengths));
+    if (text == NULL || offsets == NULL || lengths == NULL) {
+        return 1;
+    }
+    cuart_compress_init(&compressor);
+    if (argc == 2) {
+        if (!load_file(argv[1], cap)) {
+            fprintf(stderr, "%s: no messages\n", argv[1]);
+            return 1;
+        }
+        printf("traffic: %s\n", argv[1]);
+    } else {
+        synthesize(cap);
+        printf("traffic: synthesized (demo messages, JSON telemetry, log lines)\n");
+    }
+
+    stream = malloc(messages * (CUART_FRAME_MAX_NONCE + 2 + HMAC_SIZE) + plain_bytes);
+    if (stream == NULL) {
+        return 1;
+    }
+
+    aes_ctr_setkey(&ctr_ctx, KEY);
+    hmac_sha256_setkey(&hmac_key, HMAC_KEY, sizeof(HMAC_KEY));
+    aes_gcm_setkey(&gcm_ctx, KEY);
+
+    if (!check_streams()) {
+        fprintf(stderr, "malformed stream checks FAILED\n");
+        return 1;
+    }
+    printf("malformed stream checks: ok\n");
+    printf("backend: %s\n\n", aes_backend_name());
+    if (!measure_codec() || !run(CUART_WIRE_HMAC) || !run(CUART_WIRE_AEAD)) {
+        return 1;
+    }
+    free(stream);
+    free(text);
+    free(offsets);
+    free(lengths);
+    return 0;
+}
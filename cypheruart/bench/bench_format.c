@@ -0,0 +1,270 @@
+/*
+ * Sniffer output (cuart_format.h): cost of rendering packets, per packet and
+ * per MB of traffic, against the printf() path the sniffer used before.
+ *
+ * Packets of two sizes are rendered: 24-byte telemetry messages like the
+ * sender's, and 1000-byte messages. The printf() path is the sniffer's old
+ * one, kept here: a printf() per hex byte and per ASCII character, the time
+ * broken down with localtime_r() and strftime() every packet, and stdout
+ * flushed after each. The buffered modes flush every 64 KB, as the sniffer
+ * does once per read. Output goes to /dev/null, so only the formatting and
+ * the system calls are measured, not a terminal.
+ *
+ * Pretty output must be byte for byte what the printf() path prints;
+ * exits 1 if it is not.
+ *
+ *   bench_format [packets]
+ */
+
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "cuart_frame.h"
+#include "cuart_format.h"
+
+#define FLUSH_AT 65536
+#define NONCE_SIZE 16
+#define MAC_SIZE 32
+
+typedef struct {
+    const char *name;
+    size_t message_len;
+} size_case_t;
+
+static const size_case_t SIZES[] = {
+    { "24 B", 24 },
+    { "1000 B", 1000 },
+};
+#define NUM_SIZES (sizeof(SIZES) / sizeof(SIZES[0]))
+
+// One packet as the sniffer has it after decryption
+typedef struct {
+    uint8_t wire[NONCE_SIZE + 2 + CUART_FRAME_MAX_PAYLOAD + MAC_SIZE];
+    cuart_frame_view_t frame;
+    uint8_t decrypted[CUART_FRAME_MAX_PAYLOAD];
+    uint64_t time_ns;
+} sample_t;
+
+static double now_s(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Random nonce, ciphertext and MAC around a readable message, 250 packets a second
+static void make_samples(sample_t *samples, size_t count, size_t message_len) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    for (size_t i = 0; i < count; i++) {
+        sample_t *s = &samples[i];
+        cuart_frame_view_t *frame = &s->frame;
+        size_t n = (size_t)snprintf((char *)s->decrypted, message_len + 1, "{\"seq\":%zu,\"temp\":21.5}", i);
+
+        if (n < message_len) {
+            memset(s->decrypted + n, 'x', message_len - n);
+        }
+        for (size_t j = 0; j < sizeof(s->wire); j++) {
+            s->wire[j] = (uint8_t)rand();
+        }
+        frame->nonce = s->wire;
+        frame->nonce_len = NONCE_SIZE;
+        frame->length_bytes = s->wire + NONCE_SIZE;
+        frame->body = s->wire + NONCE_SIZE + 2;
+        frame->length = message_len;
+        frame->flags = 0;
+        frame->mac = frame->body + message_len;
+        frame->mac_len = MAC_SIZE;
+        s->time_ns = (uint64_t)ts.tv_sec * 1000000000u + i * 4000000u;
+    }
+}
+
+/* The sniffer's printf() path, as it was */
+
+static void print_hex(FILE *f, const char *label, const uint8_t *data, size_t len) {
+    fprintf(f, "%s\n", label);
+    for (size_t i = 0; i < len; i++) {
+        fprintf(f, "%02x ", data[i]);
+        if ((i + 1) % 16 == 0) {
+            fprintf(f, " |");
+            for (size_t j = i - 15; j <= i; j++) {
+                fprintf(f, "%c", (data[j] >= 32 && data[j] < 127) ? data[j] : '.');
+            }
+            fprintf(f, "|\n");
+        }
+    }
+    if (len % 16 != 0) {
+        size_t remaining = len % 16;
+        for (size_t i = 0; i < (16 - remaining) * 3; i++) {
+            fprintf(f, " ");
+        }
+        fprintf(f, " |");
+        for (size_t i = len - remaining; i < len; i++) {
+            fprintf(f, "%c", (data[i] >= 32 && data[i] < 127) ? data[i] : '.');
+        }
+        fprintf(f, "|\n");
+    }
+}
+
+static void print_plaintext(FILE *f, const char *label, const uint8_t *data, size_t len) {
+    fprintf(f, "%s \"", label);
+    for (size_t i = 0; i < len; i++) {
+        if (data[i] >= 32 && data[i] < 127) {
+            fprintf(f, "%c", data[i]);
+        } else if (data[i] == 0) {
+            break;
+        } else {
+            fprintf(f, ".");
+        }
+    }
+    fprintf(f, "\"\n");
+}
+
+static void print_packet(FILE *f, const sample_t *s, int number) {
+    const cuart_frame_view_t *frame = &s->frame;
+    time_t sec = (time_t)(s->time_ns / 1000000000u);
+    struct tm tm_info;
+    char time_str[64];
+
+    fprintf(f, "════════════════════════════════════════════════════════════════════════════════\n");
+    fprintf(f, "📦 Packet #%d %s", number, "");
+    localtime_r(&sec, &tm_info);
+    strftime(time_str, sizeof(time_str), "%H:%M:%S", &tm_info);
+    fprintf(f, "@ %s", time_str);
+    fprintf(f, "\n");
+    fprintf(f, "════════════════════════════════════════════════════════════════════════════════\n");
+    fprintf(f, "\n🔑 Nonce (%d bytes):\n", (int)frame->nonce_len);
+    print_hex(f, "", frame->nonce, frame->nonce_len);
+    fprintf(f, "\n🔒 ENCRYPTED Data (%d bytes%s):\n", (int)frame->length, "");
+    print_hex(f, "", frame->body, frame->length);
+    fprintf(f, "\n🏷️  %s (%d bytes): %s\n", "HMAC", (int)frame->mac_len, "✓ authentic");
+    print_hex(f, "", frame->mac, frame->mac_len);
+    fprintf(f, "\n🔓 DECRYPTED Plaintext (%d bytes):\n", (int)frame->length);
+    print_hex(f, "", s->decrypted, frame->length);
+    fprintf(f, "\n📝 ");
+    print_plaintext(f, "Message:", s->decrypted, frame->length);
+    fprintf(f, "\n📊 Total packet size: %d bytes\n\n", (int)(frame->nonce_len + 2 + frame->length + frame->mac_len));
+    fflush(f);
+}
+
+static void format_sample(cuart_out_t *out, const sample_t *s, int number) {
+    cuart_packet_info_t packet = {
+        .port = "/dev/ttyUSB0",
+        .number = number,
+        .time_ns = s->time_ns,
+        .wire = CUART_WIRE_HMAC,
+        .frame = &s->frame,
+        .authentic = true,
+        .decrypted = s->decrypted,
+        .message = s->decrypted,
+        .message_len = s->frame.length,
+        .wire_len = s->frame.nonce_len + 2 + s->frame.length + s->frame.mac_len,
+    };
+
+    cuart_format_packet(out, &packet);
+}
+
+// Pretty output against the printf() path, byte for byte
+static int check_pretty(const sample_t *samples, size_t count) {
+    char *expected = NULL;
+    size_t expected_len = 0;
+    FILE *f = open_memstream(&expected, &expected_len);
+    cuart_out_t out;
+    int same;
+
+    cuart_out_init(&out, CUART_FORMAT_PRETTY, FLUSH_AT);
+    for (size_t i = 0; i < count; i++) {
+        print_packet(f, &samples[i], (int)i + 1);
+        format_sample(&out, &samples[i], (int)i + 1);
+    }
+    fclose(f);
+    same = out.len == expected_len && memcmp(out.buf, expected, expected_len) == 0;
+    free(expected);
+    cuart_out_free(&out);
+    return same;
+}
+
+int main(int argc, char *argv[]) {
+    static const struct {
+        const char *name;
+        int mode;                   // cuart_format_mode_t, or -1 for printf()
+    } PATHS[] = {
+        { "printf (old)", -1 },
+        { "pretty", CUART_FORMAT_PRETTY },
+        { "quiet", CUART_FORMAT_QUIET },
+        { "json", CUART_FORMAT_JSON },
+        { "summary", CUART_FORMAT_SUMMARY },
+    };
+    size_t count = (argc > 1) ? strtoul(argv[1], NULL, 10) : 20000;
+    sample_t *samples = malloc(count * sizeof(*samples));
+    int devnull = open("/dev/null", O_WRONLY);
+    FILE *sink = fdopen(dup(devnull), "w");
+    int failed = 0;
+
+    if (count == 0 || !samples || devnull < 0 || !sink) {
+        fprintf(stderr, "usage: %s [packets]\n", argv[0]);
+        return 1;
+    }
+    srand(1);
+
+    printf("%zu packets per size, output to /dev/null\n", count);
+    printf("%-8s %-14s %10s %10s %12s %10s %5s\n", "message", "path", "ns/packet", "ms/MB", "out B/packet",
+           "vs printf", "");
+    for (size_t z = 0; z < NUM_SIZES; z++) {
+        double printf_s = 0;
+        size_t wire_len = NONCE_SIZE + 2 + SIZES[z].message_len + MAC_SIZE;
+        double wire_mb = (double)count * wire_len / 1e6;
+
+        make_samples(samples, count, SIZES[z].message_len);
+        int same = check_pretty(samples, count < 100 ? count : 100);
+        failed += !same;
+
+        for (size_t p = 0; p < sizeof(PATHS) / sizeof(PATHS[0]); p++) {
+            unsigned long long out_bytes = 0;
+            char out_column[16];
+            double t0 = now_s();
+            double s;
+
+            if (PATHS[p].mode < 0) {
+                for (size_t i = 0; i < count; i++) {
+                    print_packet(sink, &samples[i], (int)i + 1);
+                }
+            } else {
+                cuart_out_t out;
+
+                cuart_out_init(&out, (cuart_format_mode_t)PATHS[p].mode, FLUSH_AT + 16384);
+                for (size_t i = 0; i < count; i++) {
+                    format_sample(&out, &samples[i], (int)i + 1);
+                    if (out.len >= FLUSH_AT) {
+                        out_bytes += out.len;
+                        cuart_out_write(&out, devnull);
+                    }
+                }
+                out_bytes += out.len;
+                cuart_out_write(&out, devnull);
+                cuart_out_free(&out);
+            }
+            s = now_s() - t0;
+            if (PATHS[p].mode < 0) {
+                // Same bytes as pretty (checked above)
+                printf_s = s;
+                snprintf(out_column, sizeof(out_column), "-");
+            } else {
+                snprintf(out_column, sizeof(out_column), "%.0f", (double)out_bytes / count);
+            }
+
+            printf("%-8s %-14s %10.0f %10.2f %12s %9.1fx %5s\n", p == 0 ? SIZES[z].name : "", PATHS[p].name,
+                   s / count * 1e9, s * 1e3 / wire_mb, out_column, printf_s / s,
+                   PATHS[p].mode == CUART_FORMAT_PRETTY ? (same ? "same" : "DIFF") : "");
+        }
+    }
+    fclose(sink);
+    close(devnull);
+    free(samples);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,332 @@
+/*
+ * Link negotiation (cuart_link.h) over pseudo-terminals: an initiator
+ * (sender), a responder (receiver) and a monitor (sniffer) each own one pty
+ * as their UART, and a relay in the middle plays the wires. It knows the
+ * rate each end has applied and garbles bytes between ends at different
+ * rates (and has the responder count them as UART framing errors, as the
+ * receiver does), corrupts bytes above the rate the line can carry, and can
+ * cut the return wire. Either end can be restarted mid-run.
+ *
+ * Once the link is up the initiator sends a sealed packet (AES-CTR +
+ * HMAC) every 20 ms; responder and monitor parse and verify them and report
+ * each one to their link state, as the firmware and sniffer do. Time is
+ * virtual, 1 ms per step, so every run is the same.
+ *
+ * Each scenario checks the rate, RTS/CTS and state all three ends settle on
+ * and that every packet of the last second arrived, and prints when the link
+ * came up and what it took to get there.
+ *
+ *   bench_link
+ */
+
+#define _DEFAULT_SOURCE
+#define _XOPEN_SOURCE 600
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "aes_wrapper.h"
+#include "cuart_port.h"
+#include "cuart_frame.h"
+#include "cuart_parser.h"
+#include "cuart_link.h"
+#include "bench_pty.h"
+
+#define RUN_MS 6000
+#define DATA_MS 20
+#define PAYLOAD_LEN 48
+
+static const uint8_t KEY[AES_KEY_SIZE] = {
+    0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6,
+    0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c
+};
+
+static const uint8_t HMAC_KEY[32] = {
+    0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef,
+    0xfe, 0xdc, 0xba, 0x98, 0x76, 0x54, 0x32, 0x10,
+    0x0f, 0x1e, 0x2d, 0x3c, 0x4b, 0x5a, 0x69, 0x78,
+    0x87, 0x96, 0xa5, 0xb4, 0xc3, 0xd2, 0xe1, 0xf0
+};
+
+typedef struct {
+    const char *name;
+    uint32_t ini_max;           // fastest rate of each end, and RTS/CTS wired
+    bool ini_flow;
+    uint32_t rsp_max;
+    bool rsp_flow;
+    uint32_t line_max;          // fastest rate the wiring carries cleanly, 0 = any
+    uint32_t degrade_ms;        // from then on the line only carries degrade_to
+    uint32_t degrade_to;
+    uint32_t restart_ms;        // responder restarts then
+    uint32_t restart_tx_ms;     // initiator restarts then
+    bool no_return;             // return wire not connected
+    uint32_t expect_baud;
+    bool expect_flow;
+} scenario_t;
+
+static const scenario_t SCENARIOS[] = {
+    { "3 Mbaud + RTS/CTS both ends", 3000000, true, 3000000, true, 0, 0, 0, 0, 0, false, 3000000, true },
+    { "receiver limited to 921600", 5000000, true, 921600, false, 0, 0, 0, 0, 0, false, 921600, false },
+    { "wiring good to 1 Mbaud", 5000000, true, 5000000, true, 1000000, 0, 0, 0, 0, false, 1000000, true },
+    { "line degrades at 2 s", 2000000, false, 2000000, false, 0, 2000, 460800, 0, 0, false, 460800, false },
+    { "receiver restarts at 2 s", 2000000, false, 2000000, false, 0, 0, 0, 2000, 0, false, 2000000, false },
+    { "sender restarts at 2 s", 2000000, false, 2000000, false, 0, 0, 0, 0, 2000, false, 2000000, false },
+    { "no return wire", 2000000, false, 2000000, false, 0, 0, 0, 0, 0, true, 115200, false },
+};
+#define NUM_SCENARIOS (sizeof(SCENARIOS) / sizeof(SCENARIOS[0]))
+
+typedef struct {
+    bench_pty_t pty;            // the end's UART and the relay's side of it
+    cuart_link_t link;
+    uint32_t baud;              // settings the UART has applied
+    bool flow;
+    uint32_t up_ms;             // first time the link was up at the final rate
+    uint32_t frame_errors;      // wrong-rate deliveries, as UART_FRAME_ERR events
+    cuart_parser_t parser;
+    uint32_t good, bad;         // packets verified and failed
+    uint32_t good_late;         // packets verified in the last second
+} end_t;
+
+static end_t ini, rsp, mon;
+static const scenario_t *sc;
+static uint32_t line_max;
+static uint32_t rng = 1;
+static uint32_t now;
+static uint32_t sent_late;
+
+static aes_ctr_ctx_t ctr_ctx;
+static hmac_sha256_key_t hmac_key;
+static cuart_frame_ctx_t frame_ctx;
+
+static uint32_t next_rand(void) {
+    rng = rng * 1103515245u + 12345u;
+    return rng >> 8;
+}
+
+// The wire from one end's TX to another's RX
+static void deliver(end_t *to, uint32_t tx_baud, const uint8_t *data, size_t len) {
+    uint8_t out[2 * 4096];
+    size_t n = len;
+
+    if (to->baud == tx_baud) {
+        memcpy(out, data, len);
+    } else {
+        // Wrong rate: a slower receiver sees fewer bytes, a faster one
+        // splits each into about two, and all of them are garbage
+        n = (tx_baud > to->baud) ? len * to->baud / tx_baud : 2 * len;
+        if (n == 0) {
+            n = 1;
+        }
+        for (size_t i = 0; i < n; i++) {
+            out[i] = (uint8_t)next_rand();
+        }
+        to->frame_errors++;
+    }
+    bench_pty_deliver(&to->pty, out, n);
+}
+
+// One end transmits: the relay picks the bytes up and plays the wire
+static void transmit(end_t *from, const uint8_t *data, size_t len) {
+    uint8_t wire[4096];
+
+    bench_pty_transmit(&from->pty, data, len, wire);
+
+    // Above what the wiring carries, about one byte in 20 takes a bit error
+    if (line_max != 0 && from->baud > line_max) {
+        for (size_t i = 0; i < len; i++) {
+            if (next_rand() % 20 == 0) {
+                wire[i] ^= (uint8_t)(1u << (next_rand() % 8));
+            }
+        }
+    }
+
+    if (from == &ini) {
+        deliver(&rsp, ini.baud, wire, len);
+        deliver(&mon, ini.baud, wire, len);
+    } else if (!sc->no_return) {
+        deliver(&ini, rsp.baud, wire, len);
+    }
+}
+
+// Apply the link's settings once everything sent before is out
+static void apply(end_t *end) {
+    if (cuart_link_baud(&end->link) == end->baud && end->link.flow == end->flow) {
+        return;
+    }
+    end->baud = cuart_link_baud(&end->link);
+    end->flow = end->link.flow;
+    cuart_parser_reset(&end->parser);
+}
+
+static void check_packets(end_t *end, const uint8_t *data, size_t len) {
+    cuart_parse_result_t result;
+
+    do {
+        size_t used;
+
+        result = cuart_parser_feed(&end->parser, data, len, &used);
+        data += used;
+        len -= used;
+        if (result == CUART_PARSE_BAD_LENGTH) {
+            end->bad++;
+            cuart_link_report(&end->link, false, now);
+        } else if (result == CUART_PARSE_FRAME) {
+            cuart_frame_view_t frame;
+            uint8_t iv[AES_BLOCK_SIZE];
+            bool good;
+
+            cuart_parser_view(&end->parser, &frame);
+            memcpy(iv, frame.nonce, AES_BLOCK_SIZE);
+            good = cuart_frame_open(&frame_ctx, &frame, iv, frame.body, true) && frame.length == PAYLOAD_LEN;
+            cuart_link_report(&end->link, good, now);
+            if (good) {
+                end->good++;
+                end->good_late += (now >= RUN_MS - 1000);
+            } else {
+                end->bad++;
+                cuart_parser_resync(&end->parser);
+            }
+        }
+    } while (len > 0 || result == CUART_PARSE_FRAME);
+}
+
+// One millisecond at one end: receive, run the link, send, apply
+static void service(end_t *end) {
+    static uint8_t buf[64 * 1024];
+    uint8_t frame[CUART_LINK_FRAME_SIZE];
+    size_t n;
+
+    // The receiver counts UART framing errors against the rate; the sniffer
+    // gets none from a tty, and the sender's return wire carries no packets
+    if (end == &rsp) {
+        for (; end->frame_errors > 0; end->frame_errors--) {
+            cuart_link_report(&end->link, false, now);
+        }
+    }
+    end->frame_errors = 0;
+
+    if ((n = bench_pty_receive(&end->pty, buf)) > 0) {
+        size_t link_end = cuart_link_input(&end->link, buf, n, now);
+
+        if (link_end > 0) {
+            // A link frame: a partial packet before it is garbage, the bytes
+            // after it start the next one
+            cuart_parser_reset(&end->parser);
+        }
+        if (end != &ini) {
+            check_packets(end, buf + link_end, n - link_end);
+        }
+    }
+
+    while ((n = cuart_link_poll(&end->link, now, frame)) > 0) {
+        transmit(end, frame, n);
+        apply(end);
+    }
+    apply(end);
+
+    if (!cuart_link_up(&end->link) || end->baud != sc->expect_baud) {
+        end->up_ms = 0;
+    } else if (end->up_ms == 0) {
+        end->up_ms = now;
+    }
+}
+
+static void send_packet(uint32_t seq) {
+    uint8_t packet[CUART_FRAME_MAX_NONCE + 2 + PAYLOAD_LEN + HMAC_SIZE];
+    uint8_t payload[PAYLOAD_LEN];
+    uint8_t iv[AES_BLOCK_SIZE];
+    size_t len;
+
+    memset(payload, 0, sizeof(payload));
+    snprintf((char *)payload, sizeof(payload), "{\"seq\":%u,\"temp\":21.5}", (unsigned)seq);
+    cuart_port_random(iv, sizeof(iv));
+    memcpy(packet, iv, sizeof(iv));
+    len = cuart_frame_seal(&frame_ctx, packet, packet, AES_BLOCK_SIZE, iv, payload, sizeof(payload), true);
+    transmit(&ini, packet, len);
+    sent_late += (now >= RUN_MS - 1000);
+}
+
+static void start_end(end_t *end, cuart_link_role_t role, uint32_t max_baud, bool flow) {
+    cuart_link_init(&end->link, role, cuart_link_rates_upto(max_baud), flow, now);
+    end->baud = CUART_LINK_SAFE_BAUD;
+    end->flow = false;
+    cuart_parser_init(&end->parser, AES_BLOCK_SIZE, HMAC_SIZE, false);
+}
+
+static int run(const scenario_t *s) {
+    uint32_t packets = 0;
+
+    sc = s;
+    line_max = s->line_max;
+    now = 0;
+    sent_late = 0;
+    ini.good = ini.bad = rsp.good = rsp.bad = mon.good = mon.bad = 0;
+    ini.good_late = rsp.good_late = mon.good_late = 0;
+    ini.up_ms = rsp.up_ms = mon.up_ms = 0;
+    start_end(&ini, CUART_LINK_INITIATOR, s->ini_max, s->ini_flow);
+    start_end(&rsp, CUART_LINK_RESPONDER, s->rsp_max, s->rsp_flow);
+    start_end(&mon, CUART_LINK_MONITOR, 5000000, false);
+
+    for (now = 0; now < RUN_MS; now++) {
+        if (s->degrade_ms != 0 && now == s->degrade_ms) {
+            line_max = s->degrade_to;
+        }
+        if (s->restart_ms != 0 && now == s->restart_ms) {
+            start_end(&rsp, CUART_LINK_RESPONDER, s->rsp_max, s->rsp_flow);
+        }
+        if (s->restart_tx_ms != 0 && now == s->restart_tx_ms) {
+            start_end(&ini, CUART_LINK_INITIATOR, s->ini_max, s->ini_flow);
+        }
+        service(&ini);
+        service(&rsp);
+        service(&mon);
+        if (cuart_link_up(&ini.link) && now % DATA_MS == 0) {
+            send_packet(packets++);
+        }
+    }
+
+    bool rsp_up = s->no_return ? true : cuart_link_up(&rsp.link);
+    int ok = ini.baud == s->expect_baud && rsp.baud == s->expect_baud && mon.baud == s->expect_baud &&
+             ini.flow == s->expect_flow && rsp.flow == s->expect_flow &&
+             cuart_link_up(&ini.link) && rsp_up &&
+             sent_late > 0 && rsp.good_late == sent_late && mon.good_late == sent_late;
+
+    printf("%-30s %9u %-3s %7u %7u %7u %6u %5u %5u %7u %5u  %s\n", s->name,
+           (unsigned)ini.baud, ini.flow ? "yes" : "no", (unsigned)ini.up_ms, (unsigned)rsp.up_ms,
+           (unsigned)mon.up_ms, (unsigned)(ini.link.stats.switches + rsp.link.stats.switches),
+           (unsigned)(ini.link.stats.check_failures + rsp.link.stats.check_failures),
+           (unsigned)(ini.link.stats.fallbacks + rsp.link.stats.fallbacks + mon.link.stats.fallbacks),
+           (unsigned)rsp.good, (unsigned)rsp.bad, ok ? "ok" : "FAILED");
+    if (!ok) {
+        fprintf(stderr, "  expected %u baud, flow %s; responder %u/%s %s, monitor %u %s, "
+                "last second %u sent, %u/%u verified\n",
+                (unsigned)s->expect_baud, s->expect_flow ? "yes" : "no", (unsigned)rsp.baud,
+                rsp.flow ? "yes" : "no", cuart_link_up(&rsp.link) ? "up" : "down", (unsigned)mon.baud,
+                cuart_link_up(&mon.link) ? "up" : "following", (unsigned)sent_late,
+                (unsigned)rsp.good_late, (unsigned)mon.good_late);
+    }
+    return ok;
+}
+
+int main(void) {
+    int failed = 0;
+
+    if (!bench_pty_open(&ini.pty, "initiator") || !bench_pty_open(&rsp.pty, "responder") ||
+        !bench_pty_open(&mon.pty, "monitor")) {
+        perror("pty");
+        return 1;
+    }
+    aes_ctr_setkey(&ctr_ctx, KEY);
+    hmac_sha256_setkey(&hmac_key, HMAC_KEY, sizeof(HMAC_KEY));
+    frame_ctx.wire = CUART_WIRE_HMAC;
+    frame_ctx.ctr = &ctr_ctx;
+    frame_ctx.hmac_key = &hmac_key;
+
+    printf("virtual time, %d ms per run; up = ms until sender / receiver / sniffer were up at the final rate\n",
+           RUN_MS);
+    printf("%-30s %9s %-3s %7s %7s %7s %6s %5s %5s %7s %5s\n", "scenario", "baud", "fc", "up tx",
+           "up rx", "up mon", "switch", "chkf", "fallb", "rx ok", "rx bad");
+    for (size_t i = 0; i < NUM_SCENARIOS; i++) {
+        failed += !run(&SCENARIOS[i]);
+    }
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,208 @@
+/*
+ * Frame pool (cuart_pool.h): exhaustion and fallback checks, then cost of an
+ * alloc/free pair from one thread, with THREADS threads hammering the pool at
+ * once, and with frames handed from a producer to a consumer thread by
+ * pointer (the consumer frees what the producer allocated). Every frame is
+ * filled with an owner tag and checked before it is freed, so a frame handed
+ * out twice is caught. Prints the pool counters after each run.
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include "cuart_pool.h"
+#include "bench.h"
+
+#define ITERATIONS 200000
+#define THREADS 4
+#define HANDOFF_DEPTH 4
+
+// Payload sizes: mostly small telemetry, some full-size packets
+static const size_t SIZES[] = { 8, 24, 64, 20, 48, 256, 32, 1024 };
+#define NUM_SIZES (sizeof(SIZES) / sizeof(SIZES[0]))
+
+static _Atomic unsigned long corrupted;
+
+// Fill a frame with a tag and check it is still there after other threads ran
+static void fill(cuart_pool_frame_t *frame, uint8_t tag) {
+    memset(frame->data, tag, frame->capacity);
+}
+
+static void check(const cuart_pool_frame_t *frame, uint8_t tag) {
+    for (size_t i = 0; i < frame->capacity; i++) {
+        if (frame->data[i] != tag) {
+            atomic_fetch_add(&corrupted, 1);
+            return;
+        }
+    }
+}
+
+static void print_stats(const char *label) {
+    cuart_pool_stats_t stats;
+
+    cuart_pool_stats(&stats);
+    printf("  %s\n", label);
+    for (int c = 0; c < CUART_POOL_CLASSES; c++) {
+        const cuart_pool_class_stats_t *cls = &stats.classes[c];
+
+        printf("    %-5s %2u x %4u B: in use %u, high-water %u, %u allocs, %u exhausted\n",
+               c == CUART_POOL_SMALL ? "small" : "large", (unsigned)cls->frames,
+               (unsigned)cls->block_size, (unsigned)cls->in_use, (unsigned)cls->high_water,
+               (unsigned)cls->allocs, (unsigned)cls->exhausted);
+    }
+    printf("    failed %u, too large %u\n", (unsigned)stats.failures, (unsigned)stats.too_large);
+}
+
+// Take every frame, check sizes, fallback and exhaustion counting
+static int check_exhaustion(void) {
+    cuart_pool_frame_t *frames[CUART_POOL_SMALL_FRAMES + CUART_POOL_LARGE_FRAMES];
+    cuart_pool_stats_t stats;
+    size_t n = 0;
+    int ok = 1;
+
+    cuart_pool_init();
+    while (n < sizeof(frames) / sizeof(frames[0]) && (frames[n] = cuart_pool_alloc(24)) != NULL) {
+        if (frames[n]->capacity < CUART_POOL_BLOCK_FOR(24)) {
+            ok = 0;
+        }
+        n++;
+    }
+    ok &= (n == sizeof(frames) / sizeof(frames[0]));
+    ok &= (cuart_pool_alloc(24) == NULL);
+    ok &= (cuart_pool_alloc(CUART_FRAME_MAX_PAYLOAD + 1) == NULL);
+    cuart_pool_stats(&stats);
+    ok &= (stats.classes[CUART_POOL_SMALL].exhausted == CUART_POOL_LARGE_FRAMES + 1);
+    ok &= (stats.classes[CUART_POOL_LARGE].allocs == CUART_POOL_LARGE_FRAMES);
+    ok &= (stats.failures == 1 && stats.too_large == 1);
+
+    for (size_t i = 0; i < n; i++) {
+        cuart_pool_free(frames[i]);
+    }
+    cuart_pool_stats(&stats);
+    ok &= (stats.classes[CUART_POOL_SMALL].in_use == 0 && stats.classes[CUART_POOL_LARGE].in_use == 0);
+    return ok;
+}
+
+static void *churn_task(void *arg) {
+    uint8_t tag = (uint8_t)(uintptr_t)arg;
+
+    for (int i = 0; i < ITERATIONS; i++) {
+        cuart_pool_frame_t *frame = cuart_pool_alloc(SIZES[(size_t)(i + tag) % NUM_SIZES]);
+
+        if (frame == NULL) {
+            sched_yield();
+            continue;
+        }
+        fill(frame, tag);
+        if (i % 64 == 0) {
+            sched_yield();
+        }
+        check(frame, tag);
+        cuart_pool_free(frame);
+    }
+    return NULL;
+}
+
+// Producer -> consumer by pointer through a small ring
+static cuart_pool_frame_t *_Atomic handoff[HANDOFF_DEPTH];
+
+static void *producer_task(void *arg) {
+    (void)arg;
+    for (int i = 0; i < ITERATIONS; i++) {
+        cuart_pool_frame_t *frame;
+        cuart_pool_frame_t *empty = NULL;
+
+        while ((frame = cuart_pool_alloc(SIZES[(size_t)i % NUM_SIZES])) == NULL) {
+            sched_yield();
+        }
+        fill(frame, (uint8_t)i);
+        frame->len = (uint16_t)i;
+        while (!atomic_compare_exchange_weak(&handoff[i % HANDOFF_DEPTH], &empty, frame)) {
+            empty = NULL;
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+static void *consumer_task(void *arg) {
+    (void)arg;
+    for (int i = 0; i < ITERATIONS; i++) {
+        cuart_pool_frame_t *frame;
+
+        while ((frame = atomic_exchange(&handoff[i % HANDOFF_DEPTH], NULL)) == NULL) {
+            sched_yield();
+        }
+        check(frame, (uint8_t)frame->len);
+        cuart_pool_free(frame);
+    }
+    return NULL;
+}
+
+static double run_threads(void *(*fn)(void *), int count) {
+    pthread_t threads[THREADS];
+    uint64_t t0 = bench_now_ns();
+
+    for (int t = 0; t < count; t++) {
+        pthread_create(&threads[t], NULL, fn, (void *)(uintptr_t)(t + 1));
+    }
+    for (int t = 0; t < count; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    return (double)(bench_now_ns() - t0);
+}
+
+int main(void) {
+    pthread_t producer, consumer;
+    uint64_t t0;
+    double ns;
+
+    printf("pool: %d small x %u B (payload <= %d), %d large x %u B, %u bytes total\n",
+           CUART_POOL_SMALL_FRAMES, (unsigned)CUART_POOL_SMALL_BLOCK, CUART_POOL_SMALL_PAYLOAD,
+           CUART_POOL_LARGE_FRAMES, (unsigned)CUART_POOL_LARGE_BLOCK,
+           (unsigned)(CUART_POOL_SMALL_FRAMES * CUART_POOL_SMALL_BLOCK +
+                      CUART_POOL_LARGE_FRAMES * CUART_POOL_LARGE_BLOCK));
+
+    if (!check_exhaustion()) {
+        fprintf(stderr, "exhaustion / fallback check FAILED\n");
+        return 1;
+    }
+    printf("exhaustion and fallback: ok\n");
+
+    // Uncontended alloc/free pair, no fill
+    cuart_pool_init();
+    t0 = bench_now_ns();
+    for (int i = 0; i < ITERATIONS; i++) {
+        cuart_pool_frame_t *frame = cuart_pool_alloc(SIZES[(size_t)i % NUM_SIZES]);
+
+        bench_clobber(frame);
+        cuart_pool_free(frame);
+    }
+    ns = (double)(bench_now_ns() - t0);
+    printf("1 thread:   %.1f ns per alloc+free\n", ns / ITERATIONS);
+    print_stats("counters");
+
+    cuart_pool_init();
+    ns = run_threads(churn_task, THREADS);
+    printf("%d threads:  %.1f ns per alloc+fill+check+free (wall, all threads)\n",
+           THREADS, ns / (ITERATIONS * THREADS));
+    print_stats("counters");
+
+    cuart_pool_init();
+    t0 = bench_now_ns();
+    pthread_create(&producer, NULL, producer_task, NULL);
+    pthread_create(&consumer, NULL, consumer_task, NULL);
+    pthread_join(producer, NULL);
+    pthread_join(consumer, NULL);
+    ns = (double)(bench_now_ns() - t0);
+    printf("handoff:    %.1f ns per frame, producer allocates, consumer frees\n", ns / ITERATIONS);
+    print_stats("counters");
+
+    if (atomic_load(&corrupted) > 0) {
+        fprintf(stderr, "%lu frames were handed out twice\n", atomic_load(&corrupted));
+        return 1;
+    }
+    printf("no frame handed out twice\n");
+    return 0;
+}
@@ -0,0 +1,99 @@
+#ifndef CUART_BENCH_PTY_H
+#define CUART_BENCH_PTY_H
+
+/*
+ * Pseudo-terminal fixture for the benchmarks that run the firmware's ends
+ * over a relay (bench_link, bench_arq). Each end owns a pty slave as its
+ * UART; the relay in the middle holds the master and plays the wire. Both
+ * sides are raw and nonblocking, and the relay counts the bytes it has put
+ * on their way to each end, so an end reads exactly those and never waits
+ * on timing. Define _XOPEN_SOURCE 600 before any include.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+typedef struct {
+    const char *name;
+    int fd;                     // the end's UART: pty slave
+    int master;                 // the relay's side
+    size_t expect;              // bytes relayed to this end and not read yet
+} bench_pty_t;
+
+static inline int bench_pty_open(bench_pty_t *pty, const char *name) {
+    struct termios tio;
+
+    pty->name = name;
+    pty->expect = 0;
+    pty->master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (pty->master < 0 || grantpt(pty->master) != 0 || unlockpt(pty->master) != 0) {
+        return 0;
+    }
+    pty->fd = open(ptsname(pty->master), O_RDWR | O_NOCTTY | O_NONBLOCK);
+    if (pty->fd < 0) {
+        return 0;
+    }
+    // Raw both ways: no echo, no line discipline rewriting bytes
+    tcgetattr(pty->fd, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(pty->fd, TCSANOW, &tio);
+    tcgetattr(pty->master, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(pty->master, TCSANOW, &tio);
+    fcntl(pty->master, F_SETFL, O_NONBLOCK);
+    return 1;
+}
+
+// Read exactly n bytes that are on their way
+static inline void bench_pty_read_exact(int fd, uint8_t *buf, size_t n) {
+    while (n > 0) {
+        struct pollfd p = { .fd = fd, .events = POLLIN };
+        ssize_t got;
+
+        if (poll(&p, 1, 1000) <= 0) {
+            fprintf(stderr, "pty stalled\n");
+            exit(1);
+        }
+        got = read(fd, buf, n);
+        if (got > 0) {
+            buf += got;
+            n -= (size_t)got;
+        }
+    }
+}
+
+// An end writes to its UART; the relay picks the len bytes up into wire
+static inline void bench_pty_transmit(bench_pty_t *from, const uint8_t *data, size_t len, uint8_t *wire) {
+    if (write(from->fd, data, len) != (ssize_t)len) {
+        fprintf(stderr, "%s: write failed\n", from->name);
+        exit(1);
+    }
+    bench_pty_read_exact(from->master, wire, len);
+}
+
+// The relay puts bytes on their way to an end
+static inline void bench_pty_deliver(bench_pty_t *to, const uint8_t *data, size_t len) {
+    if (write(to->master, data, len) != (ssize_t)len) {
+        fprintf(stderr, "relay write failed\n");
+        exit(1);
+    }
+    to->expect += len;
+}
+
+// An end reads everything that has reached it; returns the byte count
+static inline size_t bench_pty_receive(bench_pty_t *pty, uint8_t *buf) {
+    size_t n = pty->expect;
+
+    if (n > 0) {
+        bench_pty_read_exact(pty->fd, buf, n);
+        pty->expect = 0;
+    }
+    return n;
+}
+
+#endif // CUART_BENCH_PTY_H
@@ -0,0 +1,340 @@
+/*
+ * Framing under line errors: a stream of back-to-back packets goes through a
+ * channel that flips bits and drops bytes at configurable rates, and the
+ * receive path (cuart_parser + cuart_frame_open) recovers what it can.
+ * Compares the unframed format, the unframed format with the line going idle
+ * after every packet (so the receiver's idle timeout resets the parser), and
+ * sync framing.
+ *
+ *   bench_resync [--aead] [--ber RATE] [--drop RATE] [--frames N] [--seed N]
+ *
+ * Without --ber/--drop a fixed set of rates is swept. Reported per mode:
+ *   delivered    authentic packets received / sent
+ *   undamaged    packets the channel left intact / sent (the best possible)
+ *   collateral   intact packets lost anyway (misalignment after an error)
+ *   goodput      payload bytes delivered / bytes on the wire
+ *   recovery     wire bytes after a damaged packet until the next delivered
+ *                one starts (mean / max; 0 means the very next packet made it)
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "aes_wrapper.h"
+#include "aes_gcm.h"
+#include "cuart_frame.h"
+#include "cuart_parser.h"
+#include "bench.h"
+
+#define DEFAULT_FRAMES 20000
+#define MAX_CHUNK 128
+
+static const uint8_t KEY[AES_KEY_SIZE] = {
+    0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6,
+    0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c
+};
+
+static const uint8_t HMAC_KEY[32] = {
+    0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef,
+    0xfe, 0xdc, 0xba, 0x98, 0x76, 0x54, 0x32, 0x10,
+    0x0f, 0x1e, 0x2d, 0x3c, 0x4b, 0x5a, 0x69, 0x78,
+    0x87, 0x96, 0xa5, 0xb4, 0xc3, 0xd2, 0xe1, 0xf0
+};
+
+// Message sizes the sender actually transmits
+static const size_t SIZES[] = { 20, 24, 32, 48, 64, 256 };
+
+// Bit error and byte drop rates swept by default
+static const double SWEEP[][2] = {
+    { 0, 0 }, { 1e-5, 0 }, { 0, 1e-5 }, { 1e-4, 1e-4 }, { 1e-3, 1e-3 }
+};
+
+typedef enum { MODE_UNFRAMED, MODE_IDLE, MODE_SYNC } rx_mode_t;
+
+static const char *MODE_NAMES[] = { "unframed", "unframed+idle", "sync" };
+
+static aes_ctr_ctx_t ctr_ctx;
+static hmac_sha256_key_t hmac_key;
+static aes_gcm_ctx_t gcm_ctx;
+static cuart_frame_ctx_t frame_ctx;
+static cuart_parser_t parser;
+static uint64_t rng_state;
+
+// Sender stream and what the channel did to it
+static uint8_t *tx_stream;
+static size_t *tx_start;        // offset of packet i in tx_stream (plus one past the last)
+static uint8_t *rx_stream;
+static size_t *rx_end;          // offset in rx_stream where packet i's bytes end
+static bool *damaged;
+static bool *delivered;
+static size_t *payload_len;
+
+static uint64_t rng_next(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+// Uniform in [0, 1)
+static double rng_uniform(void) {
+    return (double)(rng_next() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static size_t nonce_size(void) {
+    return frame_ctx.wire == CUART_WIRE_AEAD ? AES_GCM_NONCE_SIZE : AES_BLOCK_SIZE;
+}
+
+// Packets carry their index in the first 4 bytes of the payload
+static size_t synthesize(int frames, bool sync) {
+    uint8_t message[256];
+    size_t hdr = sync ? CUART_FRAME_SYNC_SIZE : 0;
+    size_t len = 0;
+
+    for (size_t i = 0; i < sizeof(message); i++) {
+        message[i] = (uint8_t)('a' + i % 26);
+    }
+
+    for (int i = 0; i < frames; i++) {
+        uint8_t iv[AES_BLOCK_SIZE];
+        size_t size = SIZES[i % (sizeof(SIZES) / sizeof(SIZES[0]))];
+
+        memset(iv, 0, sizeof(iv));
+        for (size_t b = 0; b < nonce_size(); b++) {
+            iv[b] = (uint8_t)rng_next();
+        }
+        message[0] = (uint8_t)(i >> 24);
+        message[1] = (uint8_t)(i >> 16);
+        message[2] = (uint8_t)(i >> 8);
+        message[3] = (uint8_t)i;
+
+        tx_start[i] = len;
+        payload_len[i] = size;
+        len += hdr + cuart_frame_seal(&frame_ctx, tx_stream + len + hdr, iv, nonce_size(), iv,
+                                      message, size, true);
+        if (sync) {
+            cuart_frame_sync_header(tx_stream + tx_start[i], tx_stream + tx_start[i] + hdr, nonce_size());
+        }
+    }
+    tx_start[frames] = len;
+    return len;
+}
+
+// Flip bits and drop bytes; returns the received length
+static size_t channel(int frames, double ber, double drop) {
+    double p_clean = 1.0;
+    double p_flip;
+    size_t out = 0;
+
+    // Probability that at least one of a byte's 8 bits flips
+    for (int bit = 0; bit < 8; bit++) {
+        p_clean *= 1.0 - ber;
+    }
+    p_flip = 1.0 - p_clean;
+
+    for (int i = 0; i < frames; i++) {
+        damaged[i] = false;
+        for (size_t pos = tx_start[i]; pos < tx_start[i + 1]; pos++) {
+            uint8_t b = tx_stream[pos];
+
+            if (drop > 0 && rng_uniform() < drop) {
+                damaged[i] = true;
+                continue;
+            }
+            if (ber > 0 && rng_uniform() < p_flip) {
+                b ^= (uint8_t)(1u << (rng_next() % 8));
+                damaged[i] = true;
+            }
+            rx_stream[out++] = b;
+        }
+        rx_end[i] = out;
+    }
+    return out;
+}
+
+static void handle_frame(int frames) {
+    cuart_frame_view_t frame;
+    uint8_t plaintext[CUART_FRAME_MAX_PAYLOAD];
+    uint8_t iv[AES_BLOCK_SIZE];
+
+    cuart_parser_view(&parser, &frame);
+    memset(iv, 0, sizeof(iv));
+    memcpy(iv, frame.nonce, frame.nonce_len);
+    if (!cuart_frame_open(&frame_ctx, &frame, iv, plaintext, true)) {
+        cuart_parser_resync(&parser);
+        return;
+    }
+
+    uint32_t index = ((uint32_t)plaintext[0] << 24) | ((uint32_t)plaintext[1] << 16) |
+                     ((uint32_t)plaintext[2] << 8) | plaintext[3];
+    if (index < (uint32_t)frames) {
+        delivered[index] = true;
+    }
+}
+
+// Feed rx_stream in 1..MAX_CHUNK byte pieces; returns ns spent
+static double receive(int frames, size_t rx_len, rx_mode_t mode) {
+    uint64_t chunk_state = 0x9e3779b97f4a7c15ull;
+    int next_frame = 0;
+    size_t pos = 0;
+    uint64_t t0;
+
+    memset(delivered, 0, (size_t)frames * sizeof(bool));
+    cuart_parser_init(&parser, nonce_size(), cuart_frame_mac_size(frame_ctx.wire), mode == MODE_SYNC);
+
+    t0 = bench_now_ns();
+    while (pos < rx_len) {
+        size_t n;
+
+        chunk_state = chunk_state * 6364136223846793005ull + 1442695040888963407ull;
+        n = 1 + (size_t)(chunk_state >> 33) % MAX_CHUNK;
+        if (n > rx_len - pos) {
+            n = rx_len - pos;
+        }
+
+        // With idle gaps, a piece never spans two packets and the timeout
+        // resets the parser at every packet boundary
+        if (mode == MODE_IDLE) {
+            while (next_frame < frames && rx_end[next_frame] <= pos) {
+                next_frame++;
+            }
+            if (next_frame < frames && pos + n > rx_end[next_frame]) {
+                n = rx_end[next_frame] - pos;
+            }
+        }
+
+        cuart_parse_result_t r;
+        do {
+            size_t used;
+
+            r = cuart_parser_feed(&parser, rx_stream + pos, n, &used);
+            if (r == CUART_PARSE_FRAME) {
+                handle_frame(frames);
+            }
+            pos += used;
+            n -= used;
+        } while (n > 0 || r == CUART_PARSE_FRAME);
+
+        if (mode == MODE_IDLE && next_frame < frames && pos == rx_end[next_frame]) {
+            cuart_parser_reset(&parser);
+        }
+    }
+    return (double)(bench_now_ns() - t0);
+}
+
+static void report(int frames, size_t tx_len, size_t rx_len, double ber, double drop,
+                   rx_mode_t mode, double ns) {
+    int sent_ok = 0, got = 0, collateral = 0, events = 0;
+    size_t payload = 0, recovery_sum = 0, recovery_max = 0;
+
+    for (int i = 0; i < frames; i++) {
+        sent_ok += !damaged[i];
+        got += delivered[i];
+        collateral += !damaged[i] && !delivered[i];
+        if (delivered[i]) {
+            payload += payload_len[i];
+        }
+
+        // Recovery after a damaged packet: wire bytes until the next delivered one
+        if (damaged[i] && i + 1 < frames) {
+            int j = i + 1;
+            size_t bytes;
+
+            while (j < frames && !delivered[j]) {
+                j++;
+            }
+            bytes = tx_start[j] - tx_start[i + 1];
+            recovery_sum += bytes;
+            if (bytes > recovery_max) {
+                recovery_max = bytes;
+            }
+            events++;
+        }
+    }
+
+    printf("%-8.0e %-8.0e %-14s %9.2f%% %9.2f%% %10d %8.1f%% %10.0f %10zu %8.1f\n",
+           ber, drop, MODE_NAMES[mode], 100.0 * got / frames, 100.0 * sent_ok / frames,
+           collateral, 100.0 * payload / tx_len,
+           events ? (double)recovery_sum / events : 0.0, recovery_max, rx_len * 1e3 / ns);
+}
+
+static void run(int frames, double ber, double drop, uint64_t seed) {
+    for (rx_mode_t mode = MODE_UNFRAMED; mode <= MODE_SYNC; mode++) {
+        size_t tx_len, rx_len;
+
+        // Same packets and same channel for every mode
+        rng_state = seed;
+        tx_len = synthesize(frames, mode == MODE_SYNC);
+        rx_len = channel(frames, ber, drop);
+        report(frames, tx_len, rx_len, ber, drop, mode, receive(frames, rx_len, mode));
+    }
+}
+
+int main(int argc, char **argv) {
+    int frames = DEFAULT_FRAMES;
+    double ber = -1, drop = -1;
+    uint64_t seed = 0x2545f4914f6cdd1dull;
+
+    frame_ctx.wire = CUART_WIRE_HMAC;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--aead") == 0) {
+            frame_ctx.wire = CUART_WIRE_AEAD;
+        } else if (strcmp(argv[i], "--ber") == 0 && i + 1 < argc) {
+            ber = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--drop") == 0 && i + 1 < argc) {
+            drop = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+            frames = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = strtoull(argv[++i], NULL, 0) | 1;
+        } else {
+            fprintf(stderr, "Usage: %s [--aead] [--ber RATE] [--drop RATE] [--frames N] [--seed N]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (frames < 1) {
+        frames = 1;
+    }
+
+    aes_ctr_setkey(&ctr_ctx, KEY);
+    hmac_sha256_setkey(&hmac_key, HMAC_KEY, sizeof(HMAC_KEY));
+    aes_gcm_setkey(&gcm_ctx, KEY);
+    frame_ctx.ctr = &ctr_ctx;
+    frame_ctx.hmac_key = &hmac_key;
+    frame_ctx.gcm = &gcm_ctx;
+
+    tx_stream = malloc((size_t)frames * (CUART_FRAME_SYNC_SIZE + CUART_FRAME_MAX));
+    rx_stream = malloc((size_t)frames * (CUART_FRAME_SYNC_SIZE + CUART_FRAME_MAX));
+    tx_start = malloc(((size_t)frames + 1) * sizeof(size_t));
+    rx_end = malloc((size_t)frames * sizeof(size_t));
+    payload_len = malloc((size_t)frames * sizeof(size_t));
+    damaged = malloc((size_t)frames * sizeof(bool));
+    delivered = malloc((size_t)frames * sizeof(bool));
+    if (!tx_stream || !rx_stream || !tx_start || !rx_end || !payload_len || !damaged || !delivered) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    printf("backend: %s, wire: %s, %d packets\n", aes_backend_name(),
+           frame_ctx.wire == CUART_WIRE_AEAD ? "aead" : "hmac", frames);
+    printf("%-8s %-8s %-14s %10s %10s %10s %9s %10s %10s %8s\n",
+           "ber", "drop", "mode", "delivered", "undamaged", "collateral", "goodput",
+           "recov avg", "recov max", "MB/s");
+
+    if (ber < 0 && drop < 0) {
+        for (size_t i = 0; i < sizeof(SWEEP) / sizeof(SWEEP[0]); i++) {
+            run(frames, SWEEP[i][0], SWEEP[i][1], seed);
+        }
+    } else {
+        run(frames, ber < 0 ? 0 : ber, drop < 0 ? 0 : drop, seed);
+    }
+
+    free(tx_stream);
+    free(rx_stream);
+    free(tx_start);
+    free(rx_end);
+    free(payload_len);
+    free(damaged);
+    free(delivered);
+    return 0;
+}
@@ -0,0 +1,238 @@
+/*
+ * Receiver memory per packet: the original receive path (a packet_t with
+ * separate 1 KB ciphertext and plaintext arrays on the task stack, cleared
+ * with memset every loop, fields read into it one by one and staged again for
+ * the HMAC) versus the current one (bytes read straight into the static
+ * parser buffer and verified and decrypted in place). Both use the same
+ * pre-keyed AES-CTR and HMAC contexts, so only buffer handling differs.
+ *
+ * Each path runs as its own "task" on a painted pthread stack; the stack
+ * high-water mark is measured the way uxTaskGetStackHighWaterMark() does,
+ * less what an empty task already uses. Host stack frames are not Xtensa
+ * frames, but the buffers dominate either way. The two tasks take turns
+ * running short batches so clock drift hits both alike.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "aes_wrapper.h"
+#include "cuart_frame.h"
+#include "cuart_parser.h"
+#include "bench.h"
+
+#define ITERATIONS 500
+#define REPEATS 200
+#define TASK_STACK_SIZE (64 * 1024)
+#define STACK_PAINT 0xa5
+
+static const uint8_t KEY[AES_KEY_SIZE] = {
+    0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6,
+    0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c
+};
+
+static const uint8_t HMAC_KEY[32] = {
+    0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef,
+    0xfe, 0xdc, 0xba, 0x98, 0x76, 0x54, 0x32, 0x10,
+    0x0f, 0x1e, 0x2d, 0x3c, 0x4b, 0x5a, 0x69, 0x78,
+    0x87, 0x96, 0xa5, 0xb4, 0xc3, 0xd2, 0xe1, 0xf0
+};
+
+// Message sizes the sender transmits, plus the largest payload
+static const size_t SIZES[] = { 24, 64, 256, CUART_FRAME_MAX_PAYLOAD };
+#define NUM_SIZES (sizeof(SIZES) / sizeof(SIZES[0]))
+
+// Packet structure of the original receiver
+typedef struct {
+    uint8_t nonce[AES_BLOCK_SIZE];
+    uint16_t data_len;
+    uint8_t encrypted_data[CUART_FRAME_MAX_PAYLOAD];
+    uint8_t decrypted_data[CUART_FRAME_MAX_PAYLOAD];
+    uint8_t received_hmac[HMAC_SIZE];
+} packet_t;
+
+static aes_ctr_ctx_t ctr_ctx;
+static hmac_sha256_key_t hmac_key;
+static cuart_frame_ctx_t frame_ctx;
+static cuart_parser_t parser;
+
+// One sealed packet per size, standing in for the UART driver's RX buffer
+static uint8_t wire[NUM_SIZES][CUART_FRAME_MAX];
+
+// Best cycles per packet for each size over all batches, and frames that failed to verify
+typedef struct {
+    double cycles[NUM_SIZES];
+    unsigned long failures;
+} task_result_t;
+
+typedef void *(*task_fn_t)(void *arg);
+
+// Original path: four field reads into the packet, a staging copy for the
+// HMAC, then decryption into a second array
+static bool receive_packet(packet_t *packet, const uint8_t *rx) {
+    uint8_t hmac_input[AES_BLOCK_SIZE + 2 + CUART_FRAME_MAX_PAYLOAD];
+    uint8_t length_bytes[2];
+    hmac_sha256_ctx_t hmac;
+
+    memcpy(packet->nonce, rx, AES_BLOCK_SIZE);
+    memcpy(length_bytes, rx + AES_BLOCK_SIZE, 2);
+    packet->data_len = ((uint16_t)length_bytes[0] << 8) | length_bytes[1];
+    memcpy(packet->encrypted_data, rx + AES_BLOCK_SIZE + 2, packet->data_len);
+    memcpy(packet->received_hmac, rx + AES_BLOCK_SIZE + 2 + packet->data_len, HMAC_SIZE);
+
+    memcpy(hmac_input, packet->nonce, AES_BLOCK_SIZE);
+    memcpy(hmac_input + AES_BLOCK_SIZE, length_bytes, 2);
+    memcpy(hmac_input + AES_BLOCK_SIZE + 2, packet->encrypted_data, packet->data_len);
+    bench_clobber(hmac_input);
+
+    hmac_sha256_start(&hmac, &hmac_key);
+    hmac_sha256_update(&hmac, hmac_input, AES_BLOCK_SIZE + 2 + packet->data_len);
+    if (!hmac_sha256_verify_final(&hmac, packet->received_hmac)) {
+        return false;
+    }
+    aes_ctr_crypt(&ctr_ctx, packet->encrypted_data, packet->decrypted_data, packet->data_len, packet->nonce);
+    return true;
+}
+
+static void *packet_task(void *arg) {
+    task_result_t *result = arg;
+    packet_t packet;
+
+    for (size_t s = 0; s < NUM_SIZES; s++) {
+        uint64_t t0 = bench_cycles();
+
+        for (int i = 0; i < ITERATIONS; i++) {
+            memset(&packet, 0, sizeof(packet));
+            bench_clobber(&packet);
+            if (!receive_packet(&packet, wire[s])) {
+                result->failures++;
+                continue;
+            }
+            packet.decrypted_data[packet.data_len < sizeof(packet.decrypted_data) ?
+                                  packet.data_len : sizeof(packet.decrypted_data) - 1] = '\0';
+            bench_clobber(packet.decrypted_data);
+        }
+        result->cycles[s] = bench_min(result->cycles[s], (double)(bench_cycles() - t0) / ITERATIONS);
+    }
+    return NULL;
+}
+
+// Current path: reads land in the parser buffer, verify and decrypt in place
+static void *in_place_task(void *arg) {
+    task_result_t *result = arg;
+    cuart_frame_view_t frame;
+
+    for (size_t s = 0; s < NUM_SIZES; s++) {
+        uint64_t t0 = bench_cycles();
+
+        for (int i = 0; i < ITERATIONS; i++) {
+            const uint8_t *rx = wire[s];
+            uint8_t iv[AES_BLOCK_SIZE];
+            uint8_t *dst;
+            size_t want;
+
+            while (cuart_parser_poll(&parser, &dst, &want) == CUART_PARSE_MORE) {
+                memcpy(dst, rx, want);
+                cuart_parser_commit(&parser, want);
+                rx += want;
+            }
+            cuart_parser_view(&parser, &frame);
+            memcpy(iv, frame.nonce, AES_BLOCK_SIZE);
+            if (!cuart_frame_open(&frame_ctx, &frame, iv, frame.body, true)) {
+                result->failures++;
+            }
+            bench_clobber(frame.body);
+        }
+        result->cycles[s] = bench_min(result->cycles[s], (double)(bench_cycles() - t0) / ITERATIONS);
+    }
+    return NULL;
+}
+
+static void *empty_task(void *arg) {
+    bench_clobber(arg);
+    return NULL;
+}
+
+// Run a task on a painted stack; returns the bytes of stack it touched
+static size_t run_task(task_fn_t fn, task_result_t *result) {
+    pthread_attr_t attr;
+    pthread_t thread;
+    uint8_t *stack;
+    size_t untouched = 0;
+
+    if (posix_memalign((void **)&stack, 4096, TASK_STACK_SIZE) != 0) {
+        return 0;
+    }
+    memset(stack, STACK_PAINT, TASK_STACK_SIZE);
+    pthread_attr_init(&attr);
+    pthread_attr_setstack(&attr, stack, TASK_STACK_SIZE);
+    if (pthread_create(&thread, &attr, fn, result) != 0) {
+        perror("pthread_create");
+        exit(1);
+    }
+    pthread_join(thread, NULL);
+    pthread_attr_destroy(&attr);
+
+    // The stack grows down: count still-painted bytes from the bottom
+    while (untouched < TASK_STACK_SIZE && stack[untouched] == STACK_PAINT) {
+        untouched++;
+    }
+    free(stack);
+    return TASK_STACK_SIZE - untouched;
+}
+
+int main(void) {
+    task_result_t packet_result, in_place_result, empty_result;
+    size_t base, packet_stack = 0, in_place_stack = 0;
+    uint8_t message[CUART_FRAME_MAX_PAYLOAD];
+
+    aes_ctr_setkey(&ctr_ctx, KEY);
+    hmac_sha256_setkey(&hmac_key, HMAC_KEY, sizeof(HMAC_KEY));
+    frame_ctx.wire = CUART_WIRE_HMAC;
+    frame_ctx.ctr = &ctr_ctx;
+    frame_ctx.hmac_key = &hmac_key;
+    cuart_parser_init(&parser, AES_BLOCK_SIZE, HMAC_SIZE, false);
+
+    for (size_t i = 0; i < sizeof(message); i++) {
+        message[i] = (uint8_t)('A' + i % 26);
+    }
+    for (size_t s = 0; s < NUM_SIZES; s++) {
+        uint8_t nonce[AES_BLOCK_SIZE];
+
+        memset(nonce, (int)(0x10 + s), sizeof(nonce));
+        cuart_frame_seal(&frame_ctx, wire[s], nonce, AES_BLOCK_SIZE, nonce, message, SIZES[s], true);
+    }
+
+    memset(&packet_result, 0, sizeof(packet_result));
+    memset(&in_place_result, 0, sizeof(in_place_result));
+    for (size_t s = 0; s < NUM_SIZES; s++) {
+        packet_result.cycles[s] = 1e30;
+        in_place_result.cycles[s] = 1e30;
+    }
+
+    base = run_task(empty_task, &empty_result);
+    for (int r = 0; r < REPEATS; r++) {
+        size_t used = run_task(packet_task, &packet_result) - base;
+
+        packet_stack = used > packet_stack ? used : packet_stack;
+        used = run_task(in_place_task, &in_place_result) - base;
+        in_place_stack = used > in_place_stack ? used : in_place_stack;
+    }
+
+    printf("backend: %s, wire: hmac\n", aes_backend_name());
+    printf("receiver task stack used: packet_t %zu bytes, in place %zu bytes (sizeof(packet_t) %zu)\n",
+           packet_stack, in_place_stack, sizeof(packet_t));
+    printf("%-6s %16s %16s %8s\n", "bytes", "packet_t cyc", "in place cyc", "speedup");
+    for (size_t s = 0; s < NUM_SIZES; s++) {
+        printf("%-6zu %16.0f %16.0f %7.2fx\n", SIZES[s], packet_result.cycles[s],
+               in_place_result.cycles[s], packet_result.cycles[s] / in_place_result.cycles[s]);
+    }
+
+    if (packet_result.failures > 0 || in_place_result.failures > 0) {
+        fprintf(stderr, "verification failed (packet_t %lu, in place %lu)\n",
+                packet_result.failures, in_place_result.failures);
+        return 1;
+    }
+    return 0;
+}
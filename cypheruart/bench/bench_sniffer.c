@@ -0,0 +1,358 @@
+/*
+ * Host sniffer (uart_decrypt_sniffer) throughput as the number of ports
+ * grows: the sniffer is started on the slave sides of N pty pairs and every
+ * master is written as fast as the ptys take it, 4000 sealed AES-CTR + HMAC
+ * packets each, with the sniffer's output drained from a pipe.
+ *
+ * Each port count runs with one worker thread and with one per CPU. For
+ * each run it reports packets decrypted per second across all ports, the
+ * bytes per second they make up, and the CPU the sniffer used (user +
+ * system time over wall time, so above 100% with several workers busy).
+ * The time runs from the first byte written to the sniffer's exit, which
+ * follows the ports closing once it has read everything. Exits 1 if the
+ * sniffer's per-port summary is short of a packet on any port.
+ *
+ * A last run on one port has the sniffer follow link negotiation (--link,
+ * no sync framing) with an ACKS link frame in front of every third packet,
+ * as the sender puts a CHECK in front of data after a rate switch: every
+ * packet must still decode.
+ *
+ *   bench_sniffer [path/to/uart_decrypt_sniffer]
+ */
+
+#define _DEFAULT_SOURCE
+#define _XOPEN_SOURCE 600
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include "aes_wrapper.h"
+#include "cuart_port.h"
+#include "cuart_frame.h"
+#include "cuart_link.h"
+
+#define PACKETS_PER_PORT 4000
+#define PAYLOAD_LEN 48
+#define MAX_PORTS 16
+#define PACKET_LEN (AES_BLOCK_SIZE + 2 + PAYLOAD_LEN + HMAC_SIZE)
+#define LINK_EVERY 3
+
+// The sniffer's keys (uart_decrypt_sniffer.c)
+static const uint8_t KEY[AES_KEY_SIZE] = {
+    0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6,
+    0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c
+};
+
+static const uint8_t HMAC_KEY[32] = {
+    0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef,
+    0xfe, 0xdc, 0xba, 0x98, 0x76, 0x54, 0x32, 0x10,
+    0x0f, 0x1e, 0x2d, 0x3c, 0x4b, 0x5a, 0x69, 0x78,
+    0x87, 0x96, 0xa5, 0xb4, 0xc3, 0xd2, 0xe1, 0xf0
+};
+
+static const int PORT_COUNTS[] = { 1, 2, 4, 8, 16 };
+#define NUM_PORT_COUNTS (sizeof(PORT_COUNTS) / sizeof(PORT_COUNTS[0]))
+
+// Every port sends the same packets; link_stream has a link frame in front
+// of every LINK_EVERY-th
+static uint8_t stream[PACKETS_PER_PORT * PACKET_LEN];
+static uint8_t link_stream[sizeof(stream) + (PACKETS_PER_PORT / LINK_EVERY + 1) * CUART_LINK_FRAME_SIZE];
+static size_t link_stream_len;
+
+typedef struct {
+    int master;
+    int slave;                      // held open to watch the sniffer's input queue
+    char name[64];
+    size_t sent;
+} pty_t;
+
+static double now_s(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void build_stream(void) {
+    aes_ctr_ctx_t ctr;
+    hmac_sha256_key_t hmac_key;
+    cuart_frame_ctx_t frame_ctx = { .wire = CUART_WIRE_HMAC, .ctr = &ctr, .hmac_key = &hmac_key };
+    uint8_t message[PAYLOAD_LEN];
+
+    aes_ctr_setkey(&ctr, KEY);
+    hmac_sha256_setkey(&hmac_key, HMAC_KEY, sizeof(HMAC_KEY));
+    for (int i = 0; i < PACKETS_PER_PORT; i++) {
+        uint8_t *packet = stream + (size_t)i * PACKET_LEN;
+        uint8_t iv[AES_BLOCK_SIZE];
+
+        memset(message, 0, sizeof(message));
+        snprintf((char *)message, sizeof(message), "{\"seq\":%d,\"temp\":21.5}", i);
+        cuart_port_random(iv, sizeof(iv));
+        memcpy(packet, iv, sizeof(iv));
+        cuart_frame_seal(&frame_ctx, packet, packet, AES_BLOCK_SIZE, iv, message, sizeof(message), true);
+    }
+
+    for (int i = 0; i < PACKETS_PER_PORT; i++) {
+        if (i % LINK_EVERY == 0) {
+            uint8_t state[4] = { (uint8_t)(i >> 8), (uint8_t)i, 0, 0 };
+
+            cuart_link_build_acks(link_stream + link_stream_len, state);
+            link_stream_len += CUART_LINK_FRAME_SIZE;
+        }
+        memcpy(link_stream + link_stream_len, stream + (size_t)i * PACKET_LEN, PACKET_LEN);
+        link_stream_len += PACKET_LEN;
+    }
+}
+
+static int open_pty(pty_t *pty) {
+    struct termios tio;
+
+    pty->master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (pty->master < 0 || grantpt(pty->master) != 0 || unlockpt(pty->master) != 0) {
+        return 0;
+    }
+    snprintf(pty->name, sizeof(pty->name), "%s", ptsname(pty->master));
+    pty->slave = open(pty->name, O_RDONLY | O_NOCTTY | O_CLOEXEC);
+    if (pty->slave < 0) {
+        return 0;
+    }
+    // Raw before the sniffer opens it, so no byte is cooked
+    tcgetattr(pty->slave, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(pty->slave, TCSANOW, &tio);
+    fcntl(pty->master, F_SETFL, O_NONBLOCK);
+    fcntl(pty->master, F_SETFD, FD_CLOEXEC);
+    pty->sent = 0;
+    return 1;
+}
+
+// Discard the sniffer's output as fast as it comes
+static void *drain(void *arg) {
+    static char buf[65536];
+    int fd = *(int *)arg;
+
+    while (read(fd, buf, sizeof(buf)) > 0) {
+    }
+    return NULL;
+}
+
+// Start the sniffer on the ports; returns its pid, with its stdout and
+// stderr pipes, once it is listening
+static pid_t start_sniffer(const char *sniffer, pty_t *ptys, int nports, int workers, int link,
+                           int *out_fd, int *err_fd) {
+    int out[2], err[2];
+    char workers_arg[16];
+    char *args[MAX_PORTS + 5];
+    int n = 0;
+
+    if (pipe(out) != 0 || pipe(err) != 0) {
+        return -1;
+    }
+    snprintf(workers_arg, sizeof(workers_arg), "%d", workers);
+    args[n++] = (char *)sniffer;
+    args[n++] = "--workers";
+    args[n++] = workers_arg;
+    if (link) {
+        args[n++] = "--link";
+    }
+    for (int i = 0; i < nports; i++) {
+        args[n++] = ptys[i].name;
+    }
+    args[n] = NULL;
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        dup2(out[1], STDOUT_FILENO);
+        dup2(err[1], STDERR_FILENO);
+        close(out[0]);
+        close(out[1]);
+        close(err[0]);
+        close(err[1]);
+        execv(sniffer, args);
+        _exit(127);
+    }
+    close(out[1]);
+    close(err[1]);
+    if (pid < 0) {
+        return -1;
+    }
+
+    // The banner ends with "Listening" once every port is open and watched
+    char banner[8192];
+    size_t len = 0;
+    while (len < sizeof(banner) - 1) {
+        ssize_t got = read(out[0], banner + len, sizeof(banner) - 1 - len);
+        if (got <= 0) {
+            break;
+        }
+        len += (size_t)got;
+        banner[len] = '\0';
+        if (strstr(banner, "Listening")) {
+            *out_fd = out[0];
+            *err_fd = err[0];
+            return pid;
+        }
+    }
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+    return -1;
+}
+
+// Feed every port everything, then wait until the sniffer has read it all
+static void feed(pty_t *ptys, int nports, const uint8_t *data, size_t len) {
+    struct pollfd fds[MAX_PORTS];
+    int pending = nports;
+
+    while (pending > 0) {
+        int n = 0;
+
+        for (int i = 0; i < nports; i++) {
+            if (ptys[i].sent < len) {
+                fds[n].fd = ptys[i].master;
+                fds[n].events = POLLOUT;
+                n++;
+            }
+        }
+        poll(fds, (nfds_t)n, 100);
+        pending = 0;
+        for (int i = 0; i < nports; i++) {
+            pty_t *pty = &ptys[i];
+
+            if (pty->sent < len) {
+                ssize_t put = write(pty->master, data + pty->sent, len - pty->sent);
+                if (put > 0) {
+                    pty->sent += (size_t)put;
+                }
+                pending += pty->sent < len;
+            }
+        }
+    }
+
+    for (int i = 0; i < nports; i++) {
+        int queued;
+
+        while (ioctl(ptys[i].slave, FIONREAD, &queued) == 0 && queued > 0) {
+            usleep(1000);
+        }
+    }
+}
+
+// Per-port lines of the sniffer's summary: "<port>: <n> packets, <m> invalid, ..."
+static int check_summary(int err_fd, pty_t *ptys, int nports) {
+    static char text[65536];
+    size_t len = 0;
+    ssize_t got;
+    int ok = 1;
+
+    while (len < sizeof(text) - 1 && (got = read(err_fd, text + len, sizeof(text) - 1 - len)) > 0) {
+        len += (size_t)got;
+    }
+    text[len] = '\0';
+
+    for (int i = 0; i < nports; i++) {
+        char key[80];
+        const char *line;
+        int packets = -1, invalid = -1;
+
+        snprintf(key, sizeof(key), "%s: ", ptys[i].name);
+        line = strstr(text, key);
+        if (line) {
+            sscanf(line + strlen(key), "%d packets, %d invalid", &packets, &invalid);
+        }
+        if (packets != PACKETS_PER_PORT || invalid != 0) {
+            fprintf(stderr, "%s: %d packets, %d invalid, expected %d\n", ptys[i].name, packets, invalid,
+                    PACKETS_PER_PORT);
+            ok = 0;
+        }
+    }
+    return ok;
+}
+
+static int run(const char *sniffer, int nports, int workers, int link) {
+    const uint8_t *data = link ? link_stream : stream;
+    size_t len = link ? link_stream_len : sizeof(stream);
+    pty_t ptys[MAX_PORTS];
+    pthread_t drainer;
+    struct rusage usage;
+    int out_fd, err_fd, status;
+    int ok;
+
+    for (int i = 0; i < nports; i++) {
+        if (!open_pty(&ptys[i])) {
+            perror("pty");
+            return 0;
+        }
+    }
+    pid_t pid = start_sniffer(sniffer, ptys, nports, workers, link, &out_fd, &err_fd);
+    if (pid < 0) {
+        fprintf(stderr, "could not start %s\n", sniffer);
+        return 0;
+    }
+    pthread_create(&drainer, NULL, drain, &out_fd);
+
+    double start = now_s();
+    feed(ptys, nports, data, len);
+
+    // Hanging up the masters ends the sniffer
+    for (int i = 0; i < nports; i++) {
+        close(ptys[i].master);
+    }
+    wait4(pid, &status, 0, &usage);
+    double wall = now_s() - start;
+
+    pthread_join(drainer, NULL);
+    ok = WIFEXITED(status) && WEXITSTATUS(status) == 0 && check_summary(err_fd, ptys, nports);
+    close(out_fd);
+    close(err_fd);
+    for (int i = 0; i < nports; i++) {
+        close(ptys[i].slave);
+    }
+
+    double cpu = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 +
+                 usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+    double packets = (double)nports * PACKETS_PER_PORT;
+    printf("%5d %7d %10.0f %9.2f %8.0f%% %9.0f %5s\n", nports, workers, packets / wall,
+           (double)nports * len / wall / 1e6, 100.0 * cpu / wall, 1e6 * cpu / packets, ok ? "ok" : "FAIL");
+    fflush(stdout);
+    return ok;
+}
+
+int main(int argc, char *argv[]) {
+    const char *sniffer = (argc > 1) ? argv[1] : "./uart_decrypt_sniffer";
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int failed = 0;
+
+    if (access(sniffer, X_OK) != 0) {
+        fprintf(stderr, "%s: not found (build it with `make`, or pass its path)\n", sniffer);
+        return 1;
+    }
+    if (cpus < 1) {
+        cpus = 1;
+    }
+    build_stream();
+
+    printf("%d %d-byte packets (AES-CTR + HMAC) per port, %ld CPUs\n", PACKETS_PER_PORT, PACKET_LEN, cpus);
+    printf("%5s %7s %10s %9s %9s %9s %5s\n", "ports", "workers", "packets/s", "MB/s", "CPU", "us/packet", "");
+    for (size_t i = 0; i < NUM_PORT_COUNTS; i++) {
+        int nports = PORT_COUNTS[i];
+        int per_cpu = (cpus < nports) ? (int)cpus : nports;
+
+        failed += !run(sniffer, nports, 1, 0);
+        if (per_cpu > 1) {
+            failed += !run(sniffer, nports, per_cpu, 0);
+        }
+    }
+
+    printf("--link, an ACKS link frame in front of 1 in %d packets:\n", LINK_EVERY);
+    failed += !run(sniffer, 1, 1, 1);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,309 @@
+/*
+ * Packet tracing (cuart_trace.h): per-frame receive latency with the dumps
+ * off, printed at once, and deferred to the trace ring.
+ *
+ * The receiver's loop is modelled on the host: frames of the sender's
+ * 24-byte messages arrive back to back as they would at 115200 baud (the
+ * sender streaming), each is read into the parser, verified and decrypted,
+ * and dumped the way reciever/main/main.c dumps it. The console is a 4 KB
+ * pipe drained by a thread at 11520 bytes a second, the 115200 8N1 console
+ * UART; a dump printed at once blocks once the pipe is full, as
+ * ESP_LOG_BUFFER_HEX does on the UART. In the deferred modes a thread under
+ * SCHED_IDLE calls cuart_trace_drain(), standing in for the drain task.
+ *
+ * Per mode: time to handle a frame (parse, verify, decrypt, trace), and
+ * from its arrival to done, which grows without bound once the receiver
+ * falls behind the wire (it includes the host's wake-up jitter, up to a few
+ * ms on a busy machine). The host CPU is far faster than an ESP32, so the
+ * "off" numbers are small; the console, modelled at its real speed,
+ * dominates every other mode.
+ *
+ *   bench_trace [frames]
+ */
+
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "aes_wrapper.h"
+#include "cuart_frame.h"
+#include "cuart_parser.h"
+#include "cuart_trace.h"
+#include "bench.h"
+
+#define MESSAGE_LEN 24
+#define CONSOLE_BYTES_PER_S 11520
+#define CONSOLE_PIPE_SIZE 4096
+#define DRAIN_SLEEP_NS 20000000     // as CUART_TRACE_DRAIN_MS
+#define WIRE_BITS_PER_BYTE 10
+
+static const char *TAG = "UART_RECEIVER";
+
+static const uint8_t KEY[AES_KEY_SIZE] = {
+    0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6,
+    0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c
+};
+
+static const uint8_t HMAC_KEY[32] = {
+    0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef,
+    0xfe, 0xdc, 0xba, 0x98, 0x76, 0x54, 0x32, 0x10,
+    0x0f, 0x1e, 0x2d, 0x3c, 0x4b, 0x5a, 0x69, 0x78,
+    0x87, 0x96, 0xa5, 0xb4, 0xc3, 0xd2, 0xe1, 0xf0
+};
+
+typedef enum {
+    TRACE_OFF,
+    TRACE_IMMEDIATE,
+    TRACE_DEFERRED,
+} trace_mode_t;
+
+typedef struct {
+    const char *name;
+    trace_mode_t mode;
+    int level;                      // CUART_TRACE_LEVEL_*
+} mode_case_t;
+
+static const mode_case_t MODES[] = {
+    { "off", TRACE_OFF, CUART_TRACE_LEVEL_NONE },
+    { "immediate, fields", TRACE_IMMEDIATE, CUART_TRACE_LEVEL_FIELDS },
+    { "immediate, payload", TRACE_IMMEDIATE, CUART_TRACE_LEVEL_PAYLOAD },
+    { "deferred, fields", TRACE_DEFERRED, CUART_TRACE_LEVEL_FIELDS },
+    { "deferred, payload", TRACE_DEFERRED, CUART_TRACE_LEVEL_PAYLOAD },
+};
+#define NUM_MODES (sizeof(MODES) / sizeof(MODES[0]))
+
+static aes_ctr_ctx_t ctr_ctx;
+static hmac_sha256_key_t hmac_key;
+static cuart_frame_ctx_t frame_ctx;
+static cuart_parser_t parser;
+
+static int console_fd[2];           // the console pipe
+static _Atomic unsigned long long console_written;
+static _Atomic unsigned long long console_bytes;    // sent by the console UART
+static _Atomic uint32_t drain_wanted;               // drain pass asked for
+static _Atomic uint32_t drain_empty;                // last such pass that found the ring empty
+static _Atomic bool stopping;
+
+static void sleep_ns(uint64_t ns) {
+    struct timespec ts = { (time_t)(ns / 1000000000u), (long)(ns % 1000000000u) };
+
+    nanosleep(&ts, NULL);
+}
+
+// Trace output: into the console pipe, blocking while it is full
+static ssize_t console_write(void *cookie, const char *buf, size_t len) {
+    size_t done = 0;
+
+    (void)cookie;
+    while (done < len) {
+        ssize_t n = write(console_fd[1], buf + done, len - done);
+
+        if (n <= 0) {
+            return done > 0 ? (ssize_t)done : -1;
+        }
+        done += (size_t)n;
+    }
+    atomic_fetch_add(&console_written, (unsigned long long)len);
+    return (ssize_t)len;
+}
+
+// The console UART: takes the pipe's bytes at the baud rate
+static void *console_thread(void *arg) {
+    uint8_t buf[64];
+    ssize_t n;
+
+    (void)arg;
+    while ((n = read(console_fd[0], buf, sizeof(buf))) > 0) {
+        sleep_ns((uint64_t)n * 1000000000u / CONSOLE_BYTES_PER_S);
+        atomic_fetch_add(&console_bytes, (unsigned long long)n);
+    }
+    return NULL;
+}
+
+// The drain task: prints deferred dumps whenever nothing else wants the CPU
+static void *drain_thread(void *arg) {
+    struct sched_param param = { 0 };
+
+    (void)arg;
+    if (pthread_setschedparam(pthread_self(), SCHED_IDLE, &param) != 0) {
+        fprintf(stderr, "SCHED_IDLE not available, drain thread at normal priority\n");
+    }
+    while (!atomic_load(&stopping)) {
+        uint32_t wanted = atomic_load(&drain_wanted);
+
+        if (cuart_trace_drain(SIZE_MAX) == 0) {
+            atomic_store(&drain_empty, wanted);
+            sleep_ns(DRAIN_SLEEP_NS);
+        }
+    }
+    return NULL;
+}
+
+// As CUART_TRACE_FIELD() / CUART_TRACE_DATA() at the mode's level
+static void trace(const mode_case_t *mode, int level, const char *label, const void *data, size_t len) {
+    if (mode->level < level) {
+        return;
+    }
+    if (mode->mode == TRACE_DEFERRED) {
+        cuart_trace_defer(TAG, label, data, len);
+    } else {
+        cuart_trace_hex(TAG, label, data, len);
+    }
+}
+
+// The receiver's per-frame work: read, trace, verify and decrypt, trace
+static bool handle_frame(const mode_case_t *mode, const uint8_t *rx) {
+    cuart_frame_view_t frame;
+    uint8_t iv[AES_BLOCK_SIZE];
+    uint8_t *dst;
+    size_t want;
+    bool ok;
+
+    while (cuart_parser_poll(&parser, &dst, &want) == CUART_PARSE_MORE) {
+        memcpy(dst, rx, want);
+        cuart_parser_commit(&parser, want);
+        rx += want;
+    }
+    cuart_parser_view(&parser, &frame);
+    trace(mode, CUART_TRACE_LEVEL_FIELDS, "Received nonce", frame.nonce, frame.nonce_len);
+    trace(mode, CUART_TRACE_LEVEL_PAYLOAD, "Received encrypted data", frame.body, frame.length);
+    trace(mode, CUART_TRACE_LEVEL_FIELDS, "Received HMAC", frame.mac, frame.mac_len);
+    memcpy(iv, frame.nonce, AES_BLOCK_SIZE);
+    ok = cuart_frame_open(&frame_ctx, &frame, iv, frame.body, true);
+    if (ok) {
+        trace(mode, CUART_TRACE_LEVEL_PAYLOAD, "Decrypted data", frame.body, frame.length);
+    }
+    bench_clobber(frame.body);
+    return ok;
+}
+
+// Until the ring and then the console have printed everything traced so far
+static void wait_idle(FILE *console) {
+    uint32_t pass = atomic_fetch_add(&drain_wanted, 1) + 1;
+
+    while (atomic_load(&drain_empty) != pass) {
+        sleep_ns(DRAIN_SLEEP_NS);
+    }
+    fflush(console);
+    while (atomic_load(&console_bytes) != atomic_load(&console_written)) {
+        sleep_ns(DRAIN_SLEEP_NS);
+    }
+}
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+static double percentile_us(const uint64_t *sorted, size_t count, double p) {
+    size_t i = (size_t)(p * (double)(count - 1) + 0.5);
+
+    return (double)sorted[i] / 1e3;
+}
+
+int main(int argc, char *argv[]) {
+    size_t frames = (argc > 1) ? strtoul(argv[1], NULL, 10) : 150;
+    uint64_t *handle_ns = malloc(frames * sizeof(*handle_ns));
+    uint64_t *done_ns = malloc(frames * sizeof(*done_ns));
+    uint8_t wire[CUART_FRAME_MAX];
+    uint8_t message[MESSAGE_LEN];
+    uint8_t nonce[AES_BLOCK_SIZE];
+    pthread_t console, drain;
+    size_t wire_len;
+    uint64_t airtime_ns;
+    FILE *out;
+    unsigned long failures = 0;
+
+    if (frames == 0 || !handle_ns || !done_ns) {
+        fprintf(stderr, "usage: %s [frames]\n", argv[0]);
+        return 1;
+    }
+
+    aes_ctr_setkey(&ctr_ctx, KEY);
+    hmac_sha256_setkey(&hmac_key, HMAC_KEY, sizeof(HMAC_KEY));
+    frame_ctx.wire = CUART_WIRE_HMAC;
+    frame_ctx.ctr = &ctr_ctx;
+    frame_ctx.hmac_key = &hmac_key;
+    cuart_parser_init(&parser, AES_BLOCK_SIZE, HMAC_SIZE, false);
+
+    memcpy(message, "Hello from ESP32 Sender!", MESSAGE_LEN);
+    memset(nonce, 0x5a, sizeof(nonce));
+    wire_len = cuart_frame_seal(&frame_ctx, wire, nonce, AES_BLOCK_SIZE, nonce, message, MESSAGE_LEN, true);
+    airtime_ns = (uint64_t)wire_len * WIRE_BITS_PER_BYTE * 1000000000u / 115200;
+
+    if (pipe(console_fd) != 0) {
+        perror("pipe");
+        return 1;
+    }
+    fcntl(console_fd[1], F_SETPIPE_SZ, CONSOLE_PIPE_SIZE);
+    out = fopencookie(NULL, "w", (cookie_io_functions_t){ .write = console_write });
+    cuart_trace_set_output(out);
+    if (pthread_create(&console, NULL, console_thread, NULL) != 0 ||
+        pthread_create(&drain, NULL, drain_thread, NULL) != 0) {
+        perror("pthread_create");
+        return 1;
+    }
+
+    printf("backend: %s, wire: hmac, %zu frames of %zu bytes (%d-byte messages), one every %.2f ms at 115200\n",
+           aes_backend_name(), frames, wire_len, MESSAGE_LEN, airtime_ns / 1e6);
+    printf("console: %d bytes/s, trace ring %d slots of %d bytes\n", CONSOLE_BYTES_PER_S, CUART_TRACE_RING_SLOTS,
+           CUART_TRACE_SLOT_BYTES);
+    printf("%-20s %10s %10s %10s %14s %8s %11s %10s\n", "tracing", "p50 us", "p99 us", "max us", "arrival p99 ms",
+           "behind", "dumps lost", "console B");
+
+    for (size_t m = 0; m < NUM_MODES; m++) {
+        const mode_case_t *mode = &MODES[m];
+        unsigned long long bytes_before;
+        uint32_t dropped_before = cuart_trace_dropped();
+        uint64_t start;
+        size_t behind = 0;
+
+        bytes_before = atomic_load(&console_bytes);
+        start = bench_now_ns();
+        for (size_t i = 0; i < frames; i++) {
+            uint64_t arrival = start + (i + 1) * airtime_ns;
+            uint64_t now = bench_now_ns();
+            uint64_t t0, t1;
+
+            if (now < arrival) {
+                sleep_ns(arrival - now);
+            }
+            t0 = bench_now_ns();
+            failures += !handle_frame(mode, wire);
+            t1 = bench_now_ns();
+            handle_ns[i] = t1 - t0;
+            done_ns[i] = t1 > arrival ? t1 - arrival : 0;
+            // Still busy when the next frame has fully arrived
+            behind += done_ns[i] > airtime_ns;
+        }
+        wait_idle(out);
+
+        qsort(handle_ns, frames, sizeof(*handle_ns), compare_u64);
+        qsort(done_ns, frames, sizeof(*done_ns), compare_u64);
+        printf("%-20s %10.1f %10.1f %10.1f %14.2f %8zu %11u %10llu\n", mode->name,
+               percentile_us(handle_ns, frames, 0.50), percentile_us(handle_ns, frames, 0.99),
+               percentile_us(handle_ns, frames, 1.0), percentile_us(done_ns, frames, 0.99) / 1e3, behind,
+               (unsigned)(cuart_trace_dropped() - dropped_before), atomic_load(&console_bytes) - bytes_before);
+        fflush(stdout);
+    }
+
+    atomic_store(&stopping, true);
+    pthread_join(drain, NULL);
+    fclose(out);
+    close(console_fd[1]);
+    pthread_join(console, NULL);
+    free(handle_ns);
+    free(done_ns);
+
+    if (failures > 0) {
+        fprintf(stderr, "verification failed (%lu frames)\n", failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,281 @@
+/*
+ * Send pipeline model (sender/main/cuart_send.c) on the host: the sequential
+ * path (one task seals, then writes) versus the pipelined one (the caller
+ * copies the message into a pool frame and queues it, a crypto thread seals
+ * it in place, a TX thread writes it and frees the frame).
+ *
+ * The UART is modelled as the ESP-IDF driver sees it: a TX ring buffer of
+ * TX_RING bytes drained at the baud rate (10 bits per byte); a write blocks
+ * only while the ring is full. For each baud rate it reports sustained
+ * throughput when streaming, and the time the caller is held up handing over
+ * a burst of BURST messages from idle. Baud 0 is an unpaced wire and shows
+ * what is left of the work when the UART is not the bottleneck.
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "aes_wrapper.h"
+#include "cuart_frame.h"
+#include "cuart_pool.h"
+#include "bench.h"
+
+#define TX_RING 2048
+#define BURST 8
+#define QUEUE_LEN (CUART_POOL_SMALL_FRAMES + CUART_POOL_LARGE_FRAMES)
+#define UNPACED_MESSAGES 100000
+
+static const uint8_t KEY[AES_KEY_SIZE] = {
+    0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6,
+    0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c
+};
+
+static const uint8_t HMAC_KEY[32] = {
+    0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef,
+    0xfe, 0xdc, 0xba, 0x98, 0x76, 0x54, 0x32, 0x10,
+    0x0f, 0x1e, 0x2d, 0x3c, 0x4b, 0x5a, 0x69, 0x78,
+    0x87, 0x96, 0xa5, 0xb4, 0xc3, 0xd2, 0xe1, 0xf0
+};
+
+static const uint32_t BAUDS[] = { 115200, 921600, 3000000, 0 };
+#define NUM_BAUDS (sizeof(BAUDS) / sizeof(BAUDS[0]))
+
+static const char MESSAGE[] = "Hello from ESP32 Sender!";
+#define MESSAGE_LEN (sizeof(MESSAGE) - 1)
+
+static aes_ctr_ctx_t ctr_ctx;
+static hmac_sha256_key_t hmac_key;
+static cuart_frame_ctx_t frame_ctx;
+
+// ---- Paced UART: ring drained at the baud rate -----------------------------
+
+static uint32_t baud;
+static uint64_t wire_free_at;   // when the last queued byte leaves the wire
+static uint64_t wire_bytes;
+
+static uint64_t wire_ns(size_t bytes) {
+    return baud ? (uint64_t)bytes * 10u * 1000000000ull / baud : 0;
+}
+
+static void sleep_until(uint64_t t) {
+    struct timespec ts = { (time_t)(t / 1000000000ull), (long)(t % 1000000000ull) };
+
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) != 0) {
+    }
+}
+
+// uart_write_bytes(): copy into the ring, blocking while it is full
+static void uart_write(const uint8_t *data, size_t len) {
+    static uint8_t ring[TX_RING];
+    uint64_t now = bench_now_ns();
+
+    if (wire_free_at < now) {
+        wire_free_at = now;
+    }
+    // Room for len more bytes once the backlog is down to TX_RING - len
+    if (baud && wire_free_at - now > wire_ns(TX_RING - len)) {
+        sleep_until(wire_free_at - wire_ns(TX_RING - len));
+    }
+    memcpy(ring, data, len);
+    bench_clobber(ring);
+    wire_free_at += wire_ns(len);
+    wire_bytes += len;
+}
+
+static void uart_reset(void) {
+    wire_free_at = 0;
+    wire_bytes = 0;
+}
+
+static size_t seal(uint8_t *packet, const uint8_t *body, size_t len) {
+    uint8_t iv[AES_BLOCK_SIZE];
+
+    cuart_port_random(packet, AES_BLOCK_SIZE);
+    memcpy(iv, packet, AES_BLOCK_SIZE);
+    return cuart_frame_seal(&frame_ctx, packet, packet, AES_BLOCK_SIZE, iv, body, len, true);
+}
+
+// ---- Sequential: seal and write in the caller ------------------------------
+
+static void send_sequential(const uint8_t *buf, size_t len) {
+    uint8_t packet[CUART_FRAME_MAX];
+
+    uart_write(packet, seal(packet, buf, len));
+}
+
+// ---- Pipelined: caller -> crypto thread -> TX thread -----------------------
+
+typedef struct {
+    cuart_pool_frame_t *items[QUEUE_LEN];
+    int head, count;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} queue_t;
+
+static queue_t plain_queue = { .lock = PTHREAD_MUTEX_INITIALIZER, .cond = PTHREAD_COND_INITIALIZER };
+static queue_t tx_queue = { .lock = PTHREAD_MUTEX_INITIALIZER, .cond = PTHREAD_COND_INITIALIZER };
+
+// Stands in for the frame_freed semaphore
+static pthread_mutex_t freed_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t freed_cond = PTHREAD_COND_INITIALIZER;
+static unsigned freed;
+
+// Every frame fits in a queue, so a send never waits for room
+static void queue_send(queue_t *q, cuart_pool_frame_t *frame) {
+    pthread_mutex_lock(&q->lock);
+    q->items[(q->head + q->count++) % QUEUE_LEN] = frame;
+    pthread_cond_signal(&q->cond);
+    pthread_mutex_unlock(&q->lock);
+}
+
+static cuart_pool_frame_t *queue_receive(queue_t *q) {
+    cuart_pool_frame_t *frame;
+
+    pthread_mutex_lock(&q->lock);
+    while (q->count == 0) {
+        pthread_cond_wait(&q->cond, &q->lock);
+    }
+    frame = q->items[q->head];
+    q->head = (q->head + 1) % QUEUE_LEN;
+    q->count--;
+    pthread_mutex_unlock(&q->lock);
+    return frame;
+}
+
+// Frames written and freed by the TX thread, for the caller to wait on
+static _Atomic unsigned long frames_sent;
+
+static void *crypto_thread(void *arg) {
+    (void)arg;
+    while (1) {
+        cuart_pool_frame_t *frame = queue_receive(&plain_queue);
+        uint8_t *packet = cuart_pool_packet(frame);
+
+        frame->len = (uint16_t)seal(packet, packet + AES_BLOCK_SIZE + 2, frame->len);
+        queue_send(&tx_queue, frame);
+    }
+    return NULL;
+}
+
+static void *tx_thread(void *arg) {
+    (void)arg;
+    while (1) {
+        cuart_pool_frame_t *frame = queue_receive(&tx_queue);
+
+        uart_write(cuart_pool_packet(frame), frame->len);
+        cuart_pool_free(frame);
+        pthread_mutex_lock(&freed_lock);
+        freed++;
+        pthread_cond_broadcast(&freed_cond);
+        pthread_mutex_unlock(&freed_lock);
+        atomic_fetch_add(&frames_sent, 1);
+    }
+    return NULL;
+}
+
+// cuart_send(): copy into a pool frame and queue it
+static void send_pipelined(const uint8_t *buf, size_t len) {
+    cuart_pool_frame_t *frame;
+
+    pthread_mutex_lock(&freed_lock);
+    while ((frame = cuart_pool_alloc(len)) == NULL) {
+        unsigned seen = freed;
+
+        while (freed == seen) {
+            pthread_cond_wait(&freed_cond, &freed_lock);
+        }
+    }
+    pthread_mutex_unlock(&freed_lock);
+
+    memcpy(cuart_pool_packet(frame) + AES_BLOCK_SIZE + 2, buf, len);
+    frame->len = (uint16_t)len;
+    queue_send(&plain_queue, frame);
+}
+
+// ---- Measurement ------------------------------------------------------------
+
+typedef void (*send_fn_t)(const uint8_t *buf, size_t len);
+
+// Wait until the wire is idle again (every queued byte shifted out)
+static void drain(int pipelined, unsigned long expected) {
+    while (pipelined && atomic_load(&frames_sent) < expected) {
+        sched_yield();
+    }
+    if (baud) {
+        sleep_until(wire_free_at);
+    }
+}
+
+// Messages per second from the first call until the last byte is on the wire
+static double stream(send_fn_t send, int pipelined, int count) {
+    unsigned long start = atomic_load(&frames_sent);
+    uint64_t t0;
+
+    uart_reset();
+    t0 = bench_now_ns();
+    for (int i = 0; i < count; i++) {
+        send((const uint8_t *)MESSAGE, MESSAGE_LEN);
+    }
+    drain(pipelined, start + (unsigned long)count);
+    return count / ((double)(bench_now_ns() - t0) / 1e9);
+}
+
+// Time the caller spends handing over BURST messages from idle (best of 20)
+static double burst(send_fn_t send, int pipelined) {
+    double best = 1e30;
+
+    for (int r = 0; r < 20; r++) {
+        unsigned long start = atomic_load(&frames_sent);
+        uint64_t t0;
+
+        uart_reset();
+        t0 = bench_now_ns();
+        for (int i = 0; i < BURST; i++) {
+            send((const uint8_t *)MESSAGE, MESSAGE_LEN);
+        }
+        best = bench_min(best, (double)(bench_now_ns() - t0));
+        drain(pipelined, start + BURST);
+    }
+    return best;
+}
+
+int main(void) {
+    pthread_t crypto, tx;
+    size_t frame_len = AES_BLOCK_SIZE + 2 + MESSAGE_LEN + HMAC_SIZE;
+
+    aes_ctr_setkey(&ctr_ctx, KEY);
+    hmac_sha256_setkey(&hmac_key, HMAC_KEY, sizeof(HMAC_KEY));
+    frame_ctx.wire = CUART_WIRE_HMAC;
+    frame_ctx.ctr = &ctr_ctx;
+    frame_ctx.hmac_key = &hmac_key;
+
+    cuart_pool_init();
+    pthread_create(&crypto, NULL, crypto_thread, NULL);
+    pthread_create(&tx, NULL, tx_thread, NULL);
+
+    // With one CPU the three pipeline threads share it, as on a single-core chip
+    printf("%zu byte message, %zu byte packet, %d byte TX ring, %d pool frames, %ld CPUs online\n",
+           MESSAGE_LEN, frame_len, TX_RING, QUEUE_LEN, sysconf(_SC_NPROCESSORS_ONLN));
+    printf("%8s  %16s  %16s  %16s\n", "baud", "line rate msg/s", "sequential msg/s",
+           "pipelined msg/s");
+    for (size_t b = 0; b < NUM_BAUDS; b++) {
+        // About half a second of wire time per run
+        int count = BAUDS[b] ? (int)(BAUDS[b] / 10 / frame_len / 2) : UNPACED_MESSAGES;
+        double line = BAUDS[b] ? BAUDS[b] / 10.0 / frame_len : 0;
+
+        baud = BAUDS[b];
+        printf("%8u  %16.0f  %16.0f  %16.0f\n", (unsigned)baud, line,
+               stream(send_sequential, 0, count), stream(send_pipelined, 1, count));
+    }
+
+    printf("\ncaller time to hand over a burst of %d messages from idle\n", BURST);
+    printf("%8s  %16s  %16s\n", "baud", "sequential us", "pipelined us");
+    for (size_t b = 0; b < NUM_BAUDS; b++) {
+        baud = BAUDS[b];
+        printf("%8u  %16.1f  %16.1f\n", (unsigned)baud, burst(send_sequential, 0) / 1e3,
+               burst(send_pipelined, 1) / 1e3);
+    }
+    return 0;
+}
@@ -0,0 +1,185 @@
+/*
+ * UART driver traffic per packet: the field-by-field send path (packet struct,
+ * one uart_write_bytes() per field) versus cuart_frame_seal() into one buffer
+ * and a single write, for both wire formats. Runs against the host UART mock
+ * (mock/driver/uart.h), which counts driver calls (each one a TX-lock
+ * acquisition) and bytes copied into the TX ring buffer, and checks that both paths put the
+ * same bytes on the wire.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "aes_wrapper.h"
+#include "aes_gcm.h"
+#include "cuart_frame.h"
+#include "driver/uart.h"
+#include "bench.h"
+
+#define ITERATIONS 20000
+#define REPEATS 15
+#define UART_NUM 1
+
+static const uint8_t KEY[AES_KEY_SIZE] = {
+    0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6,
+    0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c
+};
+
+static const uint8_t HMAC_KEY[32] = {
+    0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef,
+    0xfe, 0xdc, 0xba, 0x98, 0x76, 0x54, 0x32, 0x10,
+    0x0f, 0x1e, 0x2d, 0x3c, 0x4b, 0x5a, 0x69, 0x78,
+    0x87, 0x96, 0xa5, 0xb4, 0xc3, 0xd2, 0xe1, 0xf0
+};
+
+// Message sizes the sender actually transmits
+static const size_t SIZES[] = { 20, 24, 32, 48, 64, 256 };
+
+// Packet layout of the field-by-field path
+typedef struct {
+    uint8_t nonce[AES_BLOCK_SIZE];
+    uint16_t data_len;
+    uint8_t data[CUART_FRAME_MAX_PAYLOAD];
+    uint8_t mac[HMAC_SIZE];
+} field_packet_t;
+
+static aes_ctr_ctx_t ctr_ctx;
+static hmac_sha256_key_t hmac_key;
+static aes_gcm_ctx_t gcm_ctx;
+static cuart_frame_ctx_t frame_ctx;
+static uint8_t tx_frame[CUART_FRAME_MAX];
+
+// Field-by-field path: seal into a packet struct, then four driver writes
+static void send_fields(const uint8_t *nonce, const uint8_t *plaintext, size_t length) {
+    field_packet_t packet;
+    uint8_t length_bytes[2];
+    size_t nonce_len;
+    size_t mac_len;
+
+    packet.data_len = (uint16_t)length;
+    length_bytes[0] = (packet.data_len >> 8) & 0xFF;
+    length_bytes[1] = packet.data_len & 0xFF;
+
+    if (frame_ctx.wire == CUART_WIRE_AEAD) {
+        nonce_len = AES_GCM_NONCE_SIZE;
+        mac_len = AES_GCM_TAG_SIZE;
+        memcpy(packet.nonce, nonce, nonce_len);
+        aes_gcm_encrypt(&gcm_ctx, nonce, length_bytes, 2, plaintext, packet.data, length, packet.mac);
+    } else {
+        hmac_sha256_ctx_t hmac;
+
+        nonce_len = AES_BLOCK_SIZE;
+        mac_len = HMAC_SIZE;
+        memcpy(packet.nonce, nonce, nonce_len);
+        aes_ctr_crypt(&ctr_ctx, plaintext, packet.data, length, nonce);
+        hmac_sha256_start(&hmac, &hmac_key);
+        hmac_sha256_update(&hmac, nonce, AES_BLOCK_SIZE);
+        hmac_sha256_update(&hmac, length_bytes, 2);
+        hmac_sha256_update(&hmac, packet.data, length);
+        hmac_sha256_final(&hmac, packet.mac);
+    }
+
+    uart_write_bytes(UART_NUM, packet.nonce, nonce_len);
+    uart_write_bytes(UART_NUM, length_bytes, 2);
+    uart_write_bytes(UART_NUM, packet.data, length);
+    uart_write_bytes(UART_NUM, packet.mac, mac_len);
+}
+
+// Coalesced path: build the packet in tx_frame, then one driver write
+static void send_frame(const uint8_t *nonce, const uint8_t *plaintext, size_t length) {
+    size_t nonce_len = (frame_ctx.wire == CUART_WIRE_AEAD) ? AES_GCM_NONCE_SIZE : AES_BLOCK_SIZE;
+    size_t frame_len = cuart_frame_seal(&frame_ctx, tx_frame, nonce, nonce_len, nonce,
+                                        plaintext, length, true);
+
+    uart_write_bytes(UART_NUM, tx_frame, frame_len);
+}
+
+typedef void (*send_fn_t)(const uint8_t *nonce, const uint8_t *plaintext, size_t length);
+
+// Best-of-REPEATS ns per packet; driver stats of the last run are left in uart_mock_stats
+static double time_path(send_fn_t send, uint8_t *nonce, const uint8_t *input, size_t len) {
+    double best = 1e30;
+
+    for (int r = 0; r < REPEATS; r++) {
+        uint64_t t0, t1;
+
+        uart_mock_reset();
+        t0 = bench_now_ns();
+        for (int i = 0; i < ITERATIONS; i++) {
+            nonce[0] = (uint8_t)i;
+            send(nonce, input, len);
+        }
+        t1 = bench_now_ns();
+        bench_clobber(uart_mock_capture);
+        best = bench_min(best, (double)(t1 - t0) / ITERATIONS);
+    }
+    return best;
+}
+
+// Both paths must produce the same bytes for the same nonce
+static int same_wire_bytes(uint8_t *nonce, const uint8_t *input, size_t len) {
+    uint8_t expected[CUART_FRAME_MAX];
+    size_t expected_len;
+
+    nonce[0] = 0x5a;
+    uart_mock_reset();
+    send_fields(nonce, input, len);
+    expected_len = uart_mock_capture_len;
+    memcpy(expected, uart_mock_capture, expected_len);
+
+    uart_mock_reset();
+    send_frame(nonce, input, len);
+    return uart_mock_capture_len == expected_len &&
+           memcmp(uart_mock_capture, expected, expected_len) == 0;
+}
+
+int main(void) {
+    static const cuart_wire_t WIRES[] = { CUART_WIRE_HMAC, CUART_WIRE_AEAD };
+    uint8_t nonce[AES_BLOCK_SIZE];
+    uint8_t input[256];
+
+    aes_ctr_setkey(&ctr_ctx, KEY);
+    hmac_sha256_setkey(&hmac_key, HMAC_KEY, sizeof(HMAC_KEY));
+    aes_gcm_setkey(&gcm_ctx, KEY);
+    frame_ctx.ctr = &ctr_ctx;
+    frame_ctx.hmac_key = &hmac_key;
+    frame_ctx.gcm = &gcm_ctx;
+    for (size_t i = 0; i < sizeof(input); i++) {
+        input[i] = (uint8_t)i;
+    }
+    memset(nonce, 0xa5, sizeof(nonce));
+
+    printf("backend: %s\n", aes_backend_name());
+    printf("%-5s %-6s %12s %12s %12s %12s %12s %12s\n",
+           "wire", "bytes", "field calls", "frame calls",
+           "field copied", "frame copied", "field ns", "frame ns");
+
+    for (size_t w = 0; w < sizeof(WIRES) / sizeof(WIRES[0]); w++) {
+        frame_ctx.wire = WIRES[w];
+
+        for (size_t s = 0; s < sizeof(SIZES) / sizeof(SIZES[0]); s++) {
+            size_t len = SIZES[s];
+            uart_mock_stats_t field_stats;
+            double field_ns, frame_ns;
+
+            if (!same_wire_bytes(nonce, input, len)) {
+                fprintf(stderr, "wire bytes differ (%s, %zu bytes)\n",
+                        frame_ctx.wire == CUART_WIRE_AEAD ? "aead" : "hmac", len);
+                return 1;
+            }
+
+            field_ns = time_path(send_fields, nonce, input, len);
+            field_stats = uart_mock_stats;
+            frame_ns = time_path(send_frame, nonce, input, len);
+
+            printf("%-5s %-6zu %12.1f %12.1f %12.1f %12.1f %12.1f %12.1f\n",
+                   frame_ctx.wire == CUART_WIRE_AEAD ? "aead" : "hmac", len,
+                   (double)field_stats.write_calls / ITERATIONS,
+                   (double)uart_mock_stats.write_calls / ITERATIONS,
+                   (double)field_stats.bytes_copied / ITERATIONS,
+                   (double)uart_mock_stats.bytes_copied / ITERATIONS,
+                   field_ns, frame_ns);
+        }
+    }
+
+    return 0;
+}
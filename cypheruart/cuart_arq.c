@@ -0,0 +1,197 @@
+#include <string.h>
+#include "cuart_arq.h"
+
+// Distance from a to b in sequence space, negative if b is behind a
+static int seq_diff(uint16_t a, uint16_t b) {
+    int d = (int)((b - a) & CUART_ARQ_SEQ_MASK);
+
+    return (d > CUART_ARQ_SEQ_MASK / 2) ? d - (CUART_ARQ_SEQ_MASK + 1) : d;
+}
+
+static cuart_arq_slot_t *slot(cuart_arq_tx_t *tx, uint16_t seq) {
+    return &tx->slots[seq % CUART_ARQ_MAX_WINDOW];
+}
+
+void cuart_arq_put_header(uint8_t *out, uint16_t seq, uint16_t base) {
+    uint16_t v = (uint16_t)(((seq & CUART_ARQ_SEQ_MASK) << 4) | ((seq - base) & 0x0f));
+
+    out[0] = (uint8_t)(v >> 8);
+    out[1] = (uint8_t)v;
+}
+
+void cuart_arq_tx_init(cuart_arq_tx_t *tx, uint8_t window, uint32_t timeout_ms, uint8_t max_tries) {
+    memset(tx, 0, sizeof(*tx));
+    if (window < 1) {
+        window = 1;
+    } else if (window > CUART_ARQ_MAX_WINDOW) {
+        window = CUART_ARQ_MAX_WINDOW;
+    }
+    tx->window = window;
+    tx->timeout_ms = timeout_ms;
+    tx->max_tries = max_tries ? max_tries : 1;
+}
+
+static void transmitted(cuart_arq_tx_t *tx, cuart_arq_slot_t *s, uint32_t now_ms) {
+    s->sent_ms = now_ms;
+    s->order = ++tx->order;
+    s->tries++;
+    s->lost = false;
+}
+
+uint16_t cuart_arq_tx_sent(cuart_arq_tx_t *tx, void *frame, uint32_t now_ms) {
+    uint16_t seq = tx->next;
+    cuart_arq_slot_t *s = slot(tx, seq);
+
+    memset(s, 0, sizeof(*s));
+    s->frame = frame;
+    transmitted(tx, s, now_ms);
+    tx->next = (seq + 1) & CUART_ARQ_SEQ_MASK;
+    tx->stats.sent++;
+    return seq;
+}
+
+void cuart_arq_tx_ack(cuart_arq_tx_t *tx, const uint8_t *ack) {
+    uint16_t cum = (uint16_t)(((ack[0] << 8) | ack[1]) & CUART_ARQ_SEQ_MASK);
+    uint16_t sack = (uint16_t)((ack[2] << 8) | ack[3]);
+    uint32_t newest = 0;
+
+    // Mark what arrived, and find the last transmission known to have arrived
+    for (uint16_t seq = tx->base; seq != tx->next; seq = (seq + 1) & CUART_ARQ_SEQ_MASK) {
+        cuart_arq_slot_t *s = slot(tx, seq);
+        int bit = seq_diff(cum, seq) - 2;
+
+        if (!s->acked && !s->abandoned &&
+            (seq_diff(cum, seq) <= 0 || (bit >= 0 && bit < 16 && (sack & (1u << bit))))) {
+            s->acked = true;
+            tx->stats.acked++;
+        }
+        if (s->acked && s->order > newest) {
+            newest = s->order;
+        }
+    }
+
+    // Anything sent before it and still missing was lost on the way
+    for (uint16_t seq = tx->base; seq != tx->next; seq = (seq + 1) & CUART_ARQ_SEQ_MASK) {
+        cuart_arq_slot_t *s = slot(tx, seq);
+
+        if (!s->acked && !s->abandoned && s->order < newest) {
+            s->lost = true;
+        }
+    }
+}
+
+void *cuart_arq_tx_resend(cuart_arq_tx_t *tx, uint32_t now_ms) {
+    cuart_arq_slot_t *due = NULL;
+
+    for (uint16_t seq = tx->base; seq != tx->next; seq = (seq + 1) & CUART_ARQ_SEQ_MASK) {
+        cuart_arq_slot_t *s = slot(tx, seq);
+
+        if (s->acked || s->abandoned) {
+            continue;
+        }
+        if (s->lost) {
+            due = s;
+            break;
+        }
+        if (due == NULL && now_ms - s->sent_ms >= tx->timeout_ms) {
+            due = s;
+        }
+    }
+    if (due == NULL) {
+        return NULL;
+    }
+
+    if (due->tries >= tx->max_tries) {
+        due->abandoned = true;
+        tx->stats.abandoned++;
+        return cuart_arq_tx_resend(tx, now_ms);
+    }
+    if (due->lost) {
+        tx->stats.fast_retransmits++;
+    } else {
+        tx->stats.timeouts++;
+    }
+    transmitted(tx, due, now_ms);
+    return due->frame;
+}
+
+void *cuart_arq_tx_release(cuart_arq_tx_t *tx) {
+    cuart_arq_slot_t *s;
+
+    if (tx->base == tx->next) {
+        return NULL;
+    }
+    s = slot(tx, tx->base);
+    if (!s->acked && !s->abandoned) {
+        return NULL;
+    }
+    tx->base = (tx->base + 1) & CUART_ARQ_SEQ_MASK;
+    return s->frame;
+}
+
+void cuart_arq_rx_init(cuart_arq_rx_t *rx) {
+    memset(rx, 0, sizeof(*rx));
+}
+
+// After CUM has moved on by one, SACK bit i stands for CUM + 1 + i: move it
+// on past everything else that has arrived in a row, and back to CUM + 2 + i
+static void rx_advance(cuart_arq_rx_t *rx) {
+    while (rx->sack & 1) {
+        rx->sack >>= 1;
+        rx->cum = (rx->cum + 1) & CUART_ARQ_SEQ_MASK;
+    }
+    rx->sack >>= 1;
+}
+
+bool cuart_arq_rx_accept(cuart_arq_rx_t *rx, const uint8_t *header, uint16_t *seq_out) {
+    uint16_t v = (uint16_t)((header[0] << 8) | header[1]);
+    uint16_t seq = v >> 4;
+    uint16_t base = (seq - (v & 0x0f)) & CUART_ARQ_SEQ_MASK;
+    int d;
+    int bit;
+
+    if (seq_out != NULL) {
+        *seq_out = seq;
+    }
+
+    // BASE is at most CUM + 1, and at most two windows behind it (a packet
+    // sent again carries the BASE it was sealed with). Slightly ahead: the
+    // sender gave up on packets, skip them. Anything else: a sender (or this
+    // receiver) restarted.
+    d = rx->synced ? seq_diff((rx->cum + 1) & CUART_ARQ_SEQ_MASK, base) : INT16_MAX;
+    if (d > 0 && d <= 2 * CUART_ARQ_MAX_WINDOW) {
+        while (seq_diff((rx->cum + 1) & CUART_ARQ_SEQ_MASK, base) > 0) {
+            rx->cum = (rx->cum + 1) & CUART_ARQ_SEQ_MASK;
+            rx_advance(rx);
+        }
+        rx->stats.resyncs++;
+    } else if (d > 0 || d < -2 * CUART_ARQ_MAX_WINDOW) {
+        if (rx->synced) {
+            rx->stats.resyncs++;
+        }
+        rx->synced = true;
+        rx->cum = (base - 1) & CUART_ARQ_SEQ_MASK;
+        rx->sack = 0;
+    }
+
+    bit = seq_diff(rx->cum, seq) - 1;   // 0: the next one in order
+    if (bit < 0 || (bit < 17 && bit > 0 && (rx->sack & (1u << (bit - 1))))) {
+        rx->stats.duplicates++;
+        return false;
+    }
+    if (bit == 0) {
+        rx->cum = seq;
+        rx_advance(rx);
+    } else if (bit <= 16) {
+        rx->sack |= (uint16_t)(1u << (bit - 1));
+    }
+    rx->stats.delivered++;
+    return true;
+}
+
+void cuart_arq_rx_ack(const cuart_arq_rx_t *rx, uint8_t *out) {
+    out[0] = (uint8_t)(rx->cum >> 8);
+    out[1] = (uint8_t)rx->cum;
+    out[2] = (uint8_t)(rx->sack >> 8);
+    out[3] = (uint8_t)rx->sack;
+}
@@ -0,0 +1,205 @@
+#ifndef CUART_ARQ_H
+#define CUART_ARQ_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/*
+ * Reliable delivery: a sliding window with selective retransmit. Every data
+ * packet's plaintext starts with a 2-byte header, encrypted and
+ * authenticated with the rest:
+ *
+ *   [SEQ 12 bits | BACK 4 bits]    big-endian; SEQ - BACK is the sender's
+ *                                  oldest unacknowledged packet (BASE)
+ *
+ * The header is never compressed: CUART_FRAME_FLAG_COMPRESSED covers what
+ * follows it. Salt announcements carry no header and are not acknowledged.
+ *
+ * The receiver answers on the return wire with its state, carried in a link
+ * frame (cuart_link.h, CUART_LINK_ACKS):
+ *
+ *   [CUM 2][SACK 2]    CUM: every SEQ up to it has arrived
+ *                      SACK bit i: CUM + 2 + i has arrived too
+ *
+ * The sender keeps up to a window of sealed packets after sending them and
+ * sends one again when a packet sent after it is acknowledged (the UART does
+ * not reorder, so it was lost), or when it has gone a timeout without an
+ * answer (the ACK was lost). Retransmissions are the same bytes, so in
+ * session mode a copy of a packet that did arrive is dropped as a replay;
+ * the receiver acknowledges it all the same. A sender that gives up on a
+ * packet moves BASE past it, and the receiver follows.
+ *
+ * Packets are delivered as they arrive, once each; a lost packet that is
+ * sent again arrives after the ones sent behind it. The receiver keeps no
+ * copies, only CUM and SACK.
+ *
+ * The state here does no I/O: the sender's TX task and the receiver task do
+ * the UART writes, the link does the ACK framing.
+ */
+
+// Bytes in front of every data packet's plaintext
+#define CUART_ARQ_HEADER_SIZE 2
+
+// Sequence numbers are 12 bits
+#define CUART_ARQ_SEQ_MASK 0x0fff
+
+// Largest window: BACK has 4 bits, SACK covers 16 packets past CUM + 1
+#define CUART_ARQ_MAX_WINDOW 16
+
+// Bytes of ACK state in a CUART_LINK_ACKS frame
+#define CUART_ARQ_ACK_SIZE 4
+
+/**
+ * @brief A packet the sender is holding until it is acknowledged
+ */
+typedef struct {
+    void *frame;                // caller's handle for the sealed packet
+    uint32_t sent_ms;           // last transmission
+    uint32_t order;             // transmission count when last sent
+    uint8_t tries;              // transmissions so far
+    bool acked;
+    bool lost;                  // a packet sent after it was acknowledged
+    bool abandoned;             // given up after max_tries
+} cuart_arq_slot_t;
+
+/**
+ * @brief Sender counters
+ */
+typedef struct {
+    uint32_t sent;              // first transmissions
+    uint32_t acked;             // packets acknowledged
+    uint32_t fast_retransmits;  // sent again after a later packet was acknowledged
+    uint32_t timeouts;          // sent again after the timeout
+    uint32_t abandoned;         // given up after max_tries
+} cuart_arq_tx_stats_t;
+
+/**
+ * @brief Sender window
+ */
+typedef struct {
+    uint8_t window;             // packets in flight at most
+    uint32_t timeout_ms;
+    uint8_t max_tries;
+    uint16_t base;              // oldest packet not yet released
+    uint16_t next;              // sequence number of the next packet sent
+    uint32_t order;             // transmissions so far
+    cuart_arq_slot_t slots[CUART_ARQ_MAX_WINDOW];   // indexed by seq % CUART_ARQ_MAX_WINDOW
+    cuart_arq_tx_stats_t stats;
+} cuart_arq_tx_t;
+
+/**
+ * @brief Receiver counters
+ */
+typedef struct {
+    uint32_t delivered;         // packets accepted for the first time
+    uint32_t duplicates;        // copies of packets already accepted
+    uint32_t resyncs;           // jumps to the sender's BASE (restart, or packets given up)
+} cuart_arq_rx_stats_t;
+
+/**
+ * @brief Receiver state: what has arrived
+ */
+typedef struct {
+    bool synced;                // a packet has arrived: cum and sack are valid
+    uint16_t cum;
+    uint16_t sack;
+    cuart_arq_rx_stats_t stats;
+} cuart_arq_rx_t;
+
+/**
+ * @brief Write a data packet's header
+ *
+ * @param out Pointer to CUART_ARQ_HEADER_SIZE bytes
+ * @param seq Packet's sequence number
+ * @param base Sender's oldest unacknowledged packet (seq - base < CUART_ARQ_MAX_WINDOW)
+ */
+void cuart_arq_put_header(uint8_t *out, uint16_t seq, uint16_t base);
+
+/**
+ * @brief Start a sender window
+ *
+ * @param tx Pointer to sender state
+ * @param window Packets in flight at most (1 to CUART_ARQ_MAX_WINDOW; 1 is stop-and-wait)
+ * @param timeout_ms Time without an answer before a packet is sent again
+ * @param max_tries Transmissions before a packet is given up
+ */
+void cuart_arq_tx_init(cuart_arq_tx_t *tx, uint8_t window, uint32_t timeout_ms, uint8_t max_tries);
+
+/**
+ * @brief Check whether the window has room for another packet
+ */
+static inline bool cuart_arq_tx_full(const cuart_arq_tx_t *tx) {
+    return ((tx->next - tx->base) & CUART_ARQ_SEQ_MASK) >= tx->window;
+}
+
+/**
+ * @brief Take a packet into the window after its first transmission
+ *
+ * Packets must be sealed with consecutive sequence numbers starting at 0,
+ * and sent in that order; the window must not be full.
+ *
+ * @param tx Pointer to sender state
+ * @param frame Caller's handle, returned by cuart_arq_tx_resend() and cuart_arq_tx_release()
+ * @param now_ms Current time in milliseconds
+ * @return The packet's sequence number
+ */
+uint16_t cuart_arq_tx_sent(cuart_arq_tx_t *tx, void *frame, uint32_t now_ms);
+
+/**
+ * @brief Take in the receiver's state from an ACK
+ *
+ * @param tx Pointer to sender state
+ * @param ack Pointer to CUART_ARQ_ACK_SIZE bytes
+ */
+void cuart_arq_tx_ack(cuart_arq_tx_t *tx, const uint8_t *ack);
+
+/**
+ * @brief Get the next packet to send again, if any
+ *
+ * Lost packets first, then timed-out ones, oldest first. The caller sends
+ * the packet's bytes again as they were.
+ *
+ * @param tx Pointer to sender state
+ * @param now_ms Current time in milliseconds
+ * @return Caller's handle, or NULL
+ */
+void *cuart_arq_tx_resend(cuart_arq_tx_t *tx, uint32_t now_ms);
+
+/**
+ * @brief Take the oldest packet out of the window once it is done with
+ *
+ * Call until it returns NULL after cuart_arq_tx_ack() and cuart_arq_tx_resend();
+ * each call that returns a handle opens the window by one.
+ *
+ * @param tx Pointer to sender state
+ * @return Caller's handle of an acknowledged or abandoned packet, or NULL
+ */
+void *cuart_arq_tx_release(cuart_arq_tx_t *tx);
+
+/**
+ * @brief Start a receiver with nothing received
+ */
+void cuart_arq_rx_init(cuart_arq_rx_t *rx);
+
+/**
+ * @brief Record an authentic data packet's arrival
+ *
+ * @param rx Pointer to receiver state
+ * @param header Pointer to the packet's CUART_ARQ_HEADER_SIZE header
+ * @param seq Set to its sequence number (may be NULL)
+ * @return true the first time, false for a copy of a packet already accepted
+ */
+bool cuart_arq_rx_accept(cuart_arq_rx_t *rx, const uint8_t *header, uint16_t *seq);
+
+/**
+ * @brief Write the receiver's state for an ACK
+ *
+ * Only meaningful once rx->synced is set.
+ *
+ * @param rx Pointer to receiver state
+ * @param out Pointer to CUART_ARQ_ACK_SIZE bytes
+ */
+void cuart_arq_rx_ack(const cuart_arq_rx_t *rx, uint8_t *out);
+
+#endif // CUART_ARQ_H
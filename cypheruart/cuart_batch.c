@@ -0,0 +1,61 @@
+#include <string.h>
+#include "cuart_batch.h"
+
+static size_t record_len_at(const uint8_t *p) {
+    return ((size_t)p[0] << 8) | p[1];
+}
+
+void cuart_batch_init(cuart_batch_t *batch, uint8_t *buf, size_t capacity) {
+    batch->buf = buf;
+    batch->capacity = capacity;
+    batch->len = 0;
+    batch->count = 0;
+}
+
+bool cuart_batch_add(cuart_batch_t *batch, const uint8_t *record, size_t len) {
+    uint8_t *out;
+
+    if (!cuart_batch_fits(batch, len) || batch->count == UINT16_MAX) {
+        return false;
+    }
+
+    out = batch->buf + batch->len;
+    out[0] = (uint8_t)(len >> 8);
+    out[1] = (uint8_t)len;
+    memcpy(out + CUART_BATCH_RECORD_HEADER, record, len);
+    batch->len += CUART_BATCH_RECORD_HEADER + len;
+    batch->count++;
+    return true;
+}
+
+int cuart_batch_count(const uint8_t *payload, size_t len) {
+    size_t offset = 0;
+    int count = 0;
+
+    while (offset < len) {
+        size_t record_len;
+
+        if (len - offset < CUART_BATCH_RECORD_HEADER) {
+            return -1;
+        }
+        record_len = record_len_at(payload + offset);
+        offset += CUART_BATCH_RECORD_HEADER;
+        if (record_len == 0 || record_len > len - offset) {
+            return -1;
+        }
+        offset += record_len;
+        count++;
+    }
+    return count > 0 ? count : -1;
+}
+
+bool cuart_batch_next(const uint8_t *payload, size_t len, size_t *offset,
+                      const uint8_t **record, size_t *record_len) {
+    if (*offset + CUART_BATCH_RECORD_HEADER > len) {
+        return false;
+    }
+    *record_len = record_len_at(payload + *offset);
+    *record = payload + *offset + CUART_BATCH_RECORD_HEADER;
+    *offset += CUART_BATCH_RECORD_HEADER + *record_len;
+    return true;
+}
@@ -0,0 +1,371 @@
+/*
+ * Capture files (host only): writer and mapped reader, see cuart_capture.h
+ */
+
+#define _DEFAULT_SOURCE
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include "cuart_capture.h"
+
+#define PAD(len) ((8 - ((len) & 7)) & 7)
+
+static const uint8_t zeros[8];
+
+// Write everything or fail
+static int append(cuart_capture_writer_t *writer, struct iovec *iov, int count) {
+    while (count > 0) {
+        ssize_t n = writev(writer->fd, iov, count);
+
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        writer->offset += (uint64_t)n;
+        while (count > 0 && (size_t)n >= iov->iov_len) {
+            n -= (ssize_t)iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = (uint8_t *)iov->iov_base + n;
+            iov->iov_len -= (size_t)n;
+        }
+    }
+    return 0;
+}
+
+static int append_record(cuart_capture_writer_t *writer, const cuart_capture_record_t *record,
+                         const void *data) {
+    struct iovec iov[3] = {
+        { (void *)record, sizeof(*record) },
+        { (void *)data, record->length },
+        { (void *)zeros, PAD(record->length) }
+    };
+
+    return append(writer, iov, 3);
+}
+
+// Wall-clock time, held back to never run backwards through the file
+static uint64_t stamp(cuart_capture_writer_t *writer) {
+    struct timespec ts;
+    uint64_t ns;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ns = (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+    if (ns < writer->last_ns) {
+        ns = writer->last_ns;
+    }
+    writer->last_ns = ns;
+    return ns;
+}
+
+int cuart_capture_create(cuart_capture_writer_t *writer, const char *path, uint32_t options) {
+    cuart_capture_header_t header;
+    struct iovec iov = { &header, sizeof(header) };
+
+    memset(writer, 0, offsetof(cuart_capture_writer_t, index));
+    writer->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (writer->fd < 0) {
+        return -1;
+    }
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CUART_CAPTURE_MAGIC, sizeof(header.magic));
+    header.version = CUART_CAPTURE_VERSION;
+    header.options = options;
+    header.created_ns = stamp(writer);
+    if (append(writer, &iov, 1) < 0) {
+        int err = errno;
+
+        close(writer->fd);
+        errno = err;
+        return -1;
+    }
+    return 0;
+}
+
+int cuart_capture_add_port(cuart_capture_writer_t *writer, const char *name) {
+    cuart_capture_record_t record = { .type = CUART_CAPTURE_PORT, .port = writer->num_ports };
+
+    if (writer->num_ports == CUART_CAPTURE_MAX_PORTS) {
+        errno = ENOSPC;
+        return -1;
+    }
+    record.length = (uint32_t)strlen(name);
+    if (append_record(writer, &record, name) < 0) {
+        return -1;
+    }
+    return writer->num_ports++;
+}
+
+int cuart_capture_chunk(cuart_capture_writer_t *writer, int port, const uint8_t *data, size_t len) {
+    cuart_capture_record_t record = { .type = CUART_CAPTURE_CHUNK };
+    uint64_t offset = writer->offset;
+
+    if (port < 0 || port >= writer->num_ports || len > INT32_MAX) {
+        errno = EINVAL;
+        return -1;
+    }
+    record.port = (uint16_t)port;
+    record.length = (uint32_t)len;
+    record.timestamp_ns = stamp(writer);
+    record.prev = writer->chunk[port];
+    if (append_record(writer, &record, data) < 0) {
+        return -1;
+    }
+    writer->chunk[port] = offset;
+    writer->chunk_ns[port] = record.timestamp_ns;
+    return 0;
+}
+
+int cuart_capture_packet(cuart_capture_writer_t *writer, int port, int32_t end, size_t length, uint8_t flags) {
+    cuart_capture_entry_t *entry;
+
+    if (port < 0 || port >= writer->num_ports || writer->chunk[port] == 0 ||
+        length == 0 || length > CUART_CAPTURE_PACKET_MAX) {
+        errno = EINVAL;
+        return -1;
+    }
+    entry = &writer->index[writer->pending++];
+    entry->timestamp_ns = writer->chunk_ns[port];
+    entry->chunk = writer->chunk[port];
+    entry->end = end;
+    entry->length = (uint16_t)length;
+    entry->port = (uint8_t)port;
+    entry->flags = flags;
+    writer->packets++;
+
+    return (writer->pending == CUART_CAPTURE_INDEX_BLOCK) ? cuart_capture_flush(writer) : 0;
+}
+
+int cuart_capture_flush(cuart_capture_writer_t *writer) {
+    cuart_capture_record_t record = {
+        .type = CUART_CAPTURE_INDEX,
+        .length = (uint32_t)(writer->pending * sizeof(cuart_capture_entry_t))
+    };
+
+    if (writer->pending == 0) {
+        return 0;
+    }
+    writer->pending = 0;
+    return append_record(writer, &record, writer->index);
+}
+
+int cuart_capture_close(cuart_capture_writer_t *writer) {
+    int result = cuart_capture_flush(writer);
+
+    if (close(writer->fd) < 0) {
+        result = -1;
+    }
+    writer->fd = -1;
+    return result;
+}
+
+// Record at a file offset, if it is whole and of the given type
+static const cuart_capture_record_t *record_at(const cuart_capture_reader_t *reader, uint64_t offset,
+                                               uint16_t type) {
+    const cuart_capture_record_t *record;
+
+    if (offset < sizeof(cuart_capture_header_t) || (offset & 7) ||
+        offset > reader->size - sizeof(*record)) {
+        return NULL;
+    }
+    record = (const cuart_capture_record_t *)(reader->map + offset);
+    if (record->type != type || record->length > reader->size - offset - sizeof(*record)) {
+        return NULL;
+    }
+    return record;
+}
+
+static int invalid(cuart_capture_reader_t *reader) {
+    cuart_capture_release(reader);
+    errno = EINVAL;
+    return -1;
+}
+
+int cuart_capture_open(cuart_capture_reader_t *reader, const char *path) {
+    struct stat st;
+    size_t capacity = 0;
+    uint64_t offset = sizeof(cuart_capture_header_t);
+    int fd;
+
+    memset(reader, 0, sizeof(*reader));
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return -1;
+    }
+    if ((size_t)st.st_size < sizeof(cuart_capture_header_t)) {
+        close(fd);
+        errno = EINVAL;
+        return -1;
+    }
+    reader->size = (size_t)st.st_size;
+    reader->map = mmap(NULL, reader->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (reader->map == MAP_FAILED) {
+        reader->map = NULL;
+        return -1;
+    }
+    reader->header = (const cuart_capture_header_t *)reader->map;
+    if (memcmp(reader->header->magic, CUART_CAPTURE_MAGIC, sizeof(reader->header->magic)) != 0 ||
+        reader->header->version != CUART_CAPTURE_VERSION) {
+        return invalid(reader);
+    }
+
+    // Walk the records: names, chunk counts and where the index blocks are
+    while (offset < reader->size) {
+        const cuart_capture_record_t *record = (const cuart_capture_record_t *)(reader->map + offset);
+        const uint8_t *data = reader->map + offset + sizeof(*record);
+
+        if (reader->size - offset < sizeof(*record) ||
+            record->length > reader->size - offset - sizeof(*record)) {
+            reader->truncated = true;
+            break;
+        }
+        switch (record->type) {
+        case CUART_CAPTURE_PORT:
+            if (record->port != reader->num_ports || reader->num_ports == CUART_CAPTURE_MAX_PORTS) {
+                return invalid(reader);
+            }
+            reader->port_names[reader->num_ports] = strndup((const char *)data, record->length);
+            if (!reader->port_names[reader->num_ports++]) {
+                cuart_capture_release(reader);
+                return -1;
+            }
+            break;
+        case CUART_CAPTURE_CHUNK:
+            reader->chunks++;
+            reader->bytes += record->length;
+            break;
+        case CUART_CAPTURE_INDEX:
+            if (record->length % sizeof(cuart_capture_entry_t) != 0) {
+                return invalid(reader);
+            }
+            if (reader->num_blocks == capacity) {
+                size_t grown = capacity ? 2 * capacity : 64;
+                cuart_capture_block_t *blocks = realloc(reader->blocks, grown * sizeof(*blocks));
+
+                if (!blocks) {
+                    cuart_capture_release(reader);
+                    return -1;
+                }
+                reader->blocks = blocks;
+                capacity = grown;
+            }
+            reader->blocks[reader->num_blocks].entries = (const cuart_capture_entry_t *)data;
+            reader->blocks[reader->num_blocks].count = record->length / sizeof(cuart_capture_entry_t);
+            reader->blocks[reader->num_blocks].first = reader->packets;
+            reader->packets += reader->blocks[reader->num_blocks].count;
+            reader->num_blocks++;
+            break;
+        default:
+            return invalid(reader);
+        }
+        offset += sizeof(*record) + record->length + PAD(record->length);
+    }
+    return 0;
+}
+
+void cuart_capture_release(cuart_capture_reader_t *reader) {
+    for (int i = 0; i < reader->num_ports; i++) {
+        free(reader->port_names[i]);
+    }
+    free(reader->blocks);
+    if (reader->map) {
+        munmap((void *)reader->map, reader->size);
+    }
+    memset(reader, 0, sizeof(*reader));
+}
+
+// Block holding entry n
+static const cuart_capture_block_t *block_of(const cuart_capture_reader_t *reader, uint64_t n) {
+    size_t lo = 0, hi = reader->num_blocks;
+
+    while (hi - lo > 1) {
+        size_t mid = lo + (hi - lo) / 2;
+
+        if (reader->blocks[mid].first <= n) {
+            lo = mid;
+        } else {
+            hi = mid;
+        }
+    }
+    return &reader->blocks[lo];
+}
+
+const cuart_capture_entry_t *cuart_capture_entry(const cuart_capture_reader_t *reader, uint64_t n) {
+    const cuart_capture_block_t *block = block_of(reader, n);
+
+    return &block->entries[n - block->first];
+}
+
+uint64_t cuart_capture_find(const cuart_capture_reader_t *reader, uint64_t timestamp_ns) {
+    uint64_t lo = 0, hi = reader->packets;
+
+    while (lo < hi) {
+        uint64_t mid = lo + (hi - lo) / 2;
+
+        if (cuart_capture_entry(reader, mid)->timestamp_ns < timestamp_ns) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+size_t cuart_capture_bytes(const cuart_capture_reader_t *reader, const cuart_capture_entry_t *entry,
+                           uint8_t *scratch, const uint8_t **packet) {
+    const cuart_capture_record_t *chunk = record_at(reader, entry->chunk, CUART_CAPTURE_CHUNK);
+    uint64_t at = entry->chunk;
+    int64_t end = entry->end;
+    size_t need = entry->length;
+
+    if (!chunk || chunk->port != entry->port || end > (int64_t)chunk->length ||
+        need == 0 || need > CUART_CAPTURE_PACKET_MAX) {
+        return 0;
+    }
+
+    // Usually the whole packet arrived in one read
+    if (end >= (int64_t)need) {
+        *packet = (const uint8_t *)(chunk + 1) + end - need;
+        return need;
+    }
+
+    // Otherwise gather it from the back, one chunk of the port at a time
+    while (1) {
+        if (end > 0) {
+            size_t take = ((size_t)end < need) ? (size_t)end : need;
+
+            need -= take;
+            memcpy(scratch + need, (const uint8_t *)(chunk + 1) + end - take, take);
+            if (need == 0) {
+                break;
+            }
+        }
+        // Earlier in the file, or the capture is damaged
+        if (chunk->prev == 0 || chunk->prev >= at) {
+            return 0;
+        }
+        at = chunk->prev;
+        chunk = record_at(reader, at, CUART_CAPTURE_CHUNK);
+        if (!chunk || chunk->port != entry->port) {
+            return 0;
+        }
+        end = ((end > 0) ? 0 : end) + (int64_t)chunk->length;
+    }
+    *packet = scratch;
+    return entry->length;
+}
@@ -0,0 +1,259 @@
+#ifndef CUART_CAPTURE_H
+#define CUART_CAPTURE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "cuart_frame.h"
+
+/*
+ * Capture files (host only): port traffic kept as it was read, with an index
+ * of the packets in it, for offline decryption and verification
+ *
+ * A capture is append-only: a 32-byte file header, then records, each a
+ * 24-byte record header followed by its data, padded to 8 bytes:
+ *
+ *   PORT   a port's name; ports get IDs 0, 1, ... in the order they appear
+ *   CHUNK  the bytes one read() returned from a port, with the time of the
+ *          read and the file offset of the port's previous chunk
+ *   INDEX  up to CUART_CAPTURE_INDEX_BLOCK entries, one per packet that
+ *          ended in chunks already written: time, port, the chunk holding
+ *          its last byte, where it ends in it and the packet's length
+ *
+ * Chunks keep everything the port delivered (link frames, noise, packets
+ * that failed verification), so a capture can always be parsed again from
+ * the start. The index lets a reader skip the parsing: go straight to each
+ * packet, split the packets across threads, and find a time range by
+ * binary search. A packet that spans reads is stitched together by
+ * following its port's chunk links backwards.
+ *
+ * Timestamps never decrease through the file, so the index is in time
+ * order. Integers are little-endian; the reader maps the file and uses the
+ * index entries in place, so it runs on little-endian hosts only. A capture
+ * cut short (the writer was killed) reads up to its last whole record.
+ *
+ * The writer is not thread-safe: callers writing from several threads hold
+ * a lock around each call.
+ */
+
+#define CUART_CAPTURE_MAGIC "CUARTCAP"
+#define CUART_CAPTURE_VERSION 1
+
+// Port IDs fit in an index entry's byte
+#define CUART_CAPTURE_MAX_PORTS 255
+
+// Index entries buffered before they are written as one INDEX record
+#define CUART_CAPTURE_INDEX_BLOCK 1024
+
+// Largest packet an index entry can point at (sync header included)
+#define CUART_CAPTURE_PACKET_MAX (CUART_FRAME_SYNC_SIZE + CUART_FRAME_MAX)
+
+// Wire options the traffic was sent with (header options)
+#define CUART_CAPTURE_AEAD      0x01
+#define CUART_CAPTURE_SESSION   0x02
+#define CUART_CAPTURE_SYNC      0x04
+#define CUART_CAPTURE_BATCH     0x08
+#define CUART_CAPTURE_LINK      0x10
+#define CUART_CAPTURE_RELIABLE  0x20
+
+// Index entry flags
+#define CUART_CAPTURE_SALT      0x01    // session salt announcement (sequence number 0)
+
+// Record types
+typedef enum {
+    CUART_CAPTURE_PORT = 1,
+    CUART_CAPTURE_CHUNK = 2,
+    CUART_CAPTURE_INDEX = 3
+} cuart_capture_type_t;
+
+/**
+ * @brief File header
+ */
+typedef struct {
+    char magic[8];              // CUART_CAPTURE_MAGIC, not NUL-terminated
+    uint16_t version;           // CUART_CAPTURE_VERSION
+    uint16_t reserved;
+    uint32_t options;           // CUART_CAPTURE_AEAD, ...
+    uint64_t created_ns;        // wall-clock time the capture started
+    uint64_t reserved2;
+} cuart_capture_header_t;
+
+/**
+ * @brief Record header
+ */
+typedef struct {
+    uint16_t type;              // cuart_capture_type_t
+    uint16_t port;              // PORT, CHUNK: port ID
+    uint32_t length;            // data bytes after this header, before padding
+    uint64_t timestamp_ns;      // CHUNK: wall-clock time of the read
+    uint64_t prev;              // CHUNK: file offset of the port's previous chunk, 0 for its first
+} cuart_capture_record_t;
+
+/**
+ * @brief Index entry: where one packet is
+ */
+typedef struct {
+    uint64_t timestamp_ns;      // time of the read that completed the packet
+    uint64_t chunk;             // file offset of that read's CHUNK record
+    int32_t end;                // end of the packet relative to the chunk's first data byte
+                                // (can be past earlier chunks, never past this one)
+    uint16_t length;            // packet bytes, sync header included
+    uint8_t port;
+    uint8_t flags;              // CUART_CAPTURE_SALT
+} cuart_capture_entry_t;
+
+_Static_assert(sizeof(cuart_capture_header_t) == 32, "capture header layout");
+_Static_assert(sizeof(cuart_capture_record_t) == 24, "capture record layout");
+_Static_assert(sizeof(cuart_capture_entry_t) == 24, "capture index layout");
+
+/**
+ * @brief Capture being written
+ */
+typedef struct {
+    int fd;
+    uint64_t offset;                                // bytes written
+    uint64_t last_ns;                               // latest timestamp written
+    uint16_t num_ports;
+    uint64_t chunk[CUART_CAPTURE_MAX_PORTS];        // offset of each port's latest chunk
+    uint64_t chunk_ns[CUART_CAPTURE_MAX_PORTS];     // and its timestamp
+    size_t pending;                                 // entries in index not yet written
+    cuart_capture_entry_t index[CUART_CAPTURE_INDEX_BLOCK];
+    uint64_t packets;                               // entries added
+} cuart_capture_writer_t;
+
+/**
+ * @brief Create (or truncate) a capture file
+ *
+ * @param writer Pointer to writer (about 28 KB: keep it static or on the heap)
+ * @param path File to write
+ * @param options Wire options of the traffic (CUART_CAPTURE_AEAD, ...)
+ * @return 0, or -1 with errno set
+ */
+int cuart_capture_create(cuart_capture_writer_t *writer, const char *path, uint32_t options);
+
+/**
+ * @brief Name the next port
+ *
+ * @param writer Pointer to writer
+ * @param name Port name (device path)
+ * @return Port ID, or -1 (errno set; ENOSPC past CUART_CAPTURE_MAX_PORTS)
+ */
+int cuart_capture_add_port(cuart_capture_writer_t *writer, const char *name);
+
+/**
+ * @brief Append the bytes of one read from a port, stamped with the time now
+ *
+ * @param writer Pointer to writer
+ * @param port Port ID
+ * @param data Pointer to bytes read
+ * @param len Number of bytes (at most INT32_MAX)
+ * @return 0, or -1 with errno set
+ */
+int cuart_capture_chunk(cuart_capture_writer_t *writer, int port, const uint8_t *data, size_t len);
+
+/**
+ * @brief Index a packet that ended in the port's bytes written so far
+ *
+ * Entries are buffered and written CUART_CAPTURE_INDEX_BLOCK at a time.
+ *
+ * @param writer Pointer to writer
+ * @param port Port ID
+ * @param end End of the packet relative to the start of the port's latest chunk
+ * @param length Packet bytes, sync header included
+ * @param flags CUART_CAPTURE_SALT or 0
+ * @return 0, or -1 with errno set
+ */
+int cuart_capture_packet(cuart_capture_writer_t *writer, int port, int32_t end, size_t length, uint8_t flags);
+
+/**
+ * @brief Write the buffered index entries
+ *
+ * @param writer Pointer to writer
+ * @return 0, or -1 with errno set
+ */
+int cuart_capture_flush(cuart_capture_writer_t *writer);
+
+/**
+ * @brief Write the buffered index entries and close the file
+ *
+ * @param writer Pointer to writer
+ * @return 0, or -1 with errno set
+ */
+int cuart_capture_close(cuart_capture_writer_t *writer);
+
+/**
+ * @brief Run of index entries, in place in the mapped file
+ */
+typedef struct {
+    const cuart_capture_entry_t *entries;
+    uint32_t count;
+    uint64_t first;             // number of the first entry in the whole index
+} cuart_capture_block_t;
+
+/**
+ * @brief Capture mapped for reading
+ */
+typedef struct {
+    const uint8_t *map;
+    size_t size;
+    const cuart_capture_header_t *header;
+    uint16_t num_ports;
+    char *port_names[CUART_CAPTURE_MAX_PORTS];
+    uint64_t chunks;            // CHUNK records
+    uint64_t bytes;             // bytes in them
+    cuart_capture_block_t *blocks;
+    size_t num_blocks;
+    uint64_t packets;           // index entries
+    bool truncated;             // file ends in a partial record
+} cuart_capture_reader_t;
+
+/**
+ * @brief Map a capture and collect its ports and index
+ *
+ * @param reader Pointer to reader
+ * @param path Capture file
+ * @return 0, or -1 with errno set (EINVAL: not a capture, or a damaged one)
+ */
+int cuart_capture_open(cuart_capture_reader_t *reader, const char *path);
+
+/**
+ * @brief Unmap a capture
+ *
+ * @param reader Pointer to reader
+ */
+void cuart_capture_release(cuart_capture_reader_t *reader);
+
+/**
+ * @brief Index entry by number
+ *
+ * @param reader Pointer to reader
+ * @param n Entry number, below reader->packets
+ * @return Pointer to the entry in the mapped file
+ */
+const cuart_capture_entry_t *cuart_capture_entry(const cuart_capture_reader_t *reader, uint64_t n);
+
+/**
+ * @brief First packet at or after a time
+ *
+ * @param reader Pointer to reader
+ * @param timestamp_ns Wall-clock time
+ * @return Entry number, reader->packets if every packet is earlier
+ */
+uint64_t cuart_capture_find(const cuart_capture_reader_t *reader, uint64_t timestamp_ns);
+
+/**
+ * @brief Bytes of an indexed packet
+ *
+ * A packet within one chunk is returned in place; one that spans chunks is
+ * copied into scratch.
+ *
+ * @param reader Pointer to reader
+ * @param entry Pointer to index entry
+ * @param scratch Pointer to CUART_CAPTURE_PACKET_MAX bytes
+ * @param packet Set to the packet's first byte
+ * @return Packet length, 0 if the entry does not point at whole chunks of its port
+ */
+size_t cuart_capture_bytes(const cuart_capture_reader_t *reader, const cuart_capture_entry_t *entry,
+                           uint8_t *scratch, const uint8_t **packet);
+
+#endif // CUART_CAPTURE_H
@@ -0,0 +1,155 @@
+#include <string.h>
+#include "cuart_compress.h"
+
+// Preset dictionary: fragments common in the sender's text and telemetry
+// messages. Copies reach back into it from the start of every payload, and
+// the most common fragments sit at the end, where they stay in reach longest.
+// Changing it changes the wire format.
+static const uint8_t DICT[] =
+    "ERROR WARNING INFO DEBUG failed timeout overflow reset restart boot "
+    "voltage current power energy level count total average minimum maximum "
+    "latitude longitude altitude speed heading accel gyro magnet "
+    "\"status\":\"ok\",\"status\":\"error\",\"state\":\"on\",\"state\":\"off\","
+    "\"uptime\":\"rssi\":-\"battery\":\"pressure\":\"humidity\":\"temperature\":"
+    "\"value\":\"sensor\":\"node\":\"seq\":\"ts\":\"id\":{\"temp\":"
+    "Secure communication test AES-128 CTR mode active This is encrypted data "
+    "Hello from ESP32 Sender! the and of to in is for with from sensor data message ";
+
+#define DICT_LEN (sizeof(DICT) - 1)
+
+_Static_assert(DICT_LEN <= CUART_COMPRESS_WINDOW, "dictionary out of copy reach");
+
+// Literal runs and copy token layout
+#define MAX_LITERALS 128
+#define TOKEN_COPY 0x80
+
+static uint32_t hash3(const uint8_t *p) {
+    uint32_t v = ((uint32_t)p[0] << 16) | ((uint32_t)p[1] << 8) | p[2];
+
+    return (v * 2654435761u) >> (32 - CUART_COMPRESS_HASH_BITS);
+}
+
+// Byte at a position of dictionary || payload
+static uint8_t at(const uint8_t *in, size_t pos) {
+    return (pos < DICT_LEN) ? DICT[pos] : in[pos - DICT_LEN];
+}
+
+void cuart_compress_init(cuart_compress_t *c) {
+    memset(c->dict_head, 0, sizeof(c->dict_head));
+    for (size_t pos = 0; pos + CUART_COMPRESS_MIN_MATCH <= DICT_LEN; pos++) {
+        c->dict_head[hash3(DICT + pos)] = (uint16_t)(pos + 1);
+    }
+}
+
+// Emit in[start, end) as literal runs; false if out_cap is reached
+static int put_literals(const uint8_t *in, size_t start, size_t end,
+                        uint8_t *out, size_t *o, size_t out_cap) {
+    while (start < end) {
+        size_t run = end - start;
+
+        if (run > MAX_LITERALS) {
+            run = MAX_LITERALS;
+        }
+        if (1 + run > out_cap - *o) {
+            return 0;
+        }
+        out[(*o)++] = (uint8_t)(run - 1);
+        memcpy(out + *o, in + start, run);
+        *o += run;
+        start += run;
+    }
+    return 1;
+}
+
+size_t cuart_compress(cuart_compress_t *c, const uint8_t *in, size_t len,
+                      uint8_t *out, size_t out_cap) {
+    size_t literals = 0;        // start of the pending literal run
+    size_t o = 0;
+    size_t i = 0;
+
+    // Positions are stored + 1 in dictionary || payload space, 0 meaning none
+    memcpy(c->head, c->dict_head, sizeof(c->head));
+
+    while (i + CUART_COMPRESS_MIN_MATCH <= len) {
+        size_t pos = DICT_LEN + i;
+        uint32_t h = hash3(in + i);
+        size_t cand = c->head[h];
+        size_t match = 0;
+
+        c->head[h] = (uint16_t)(pos + 1);
+        if (cand != 0 && pos - (cand - 1) <= CUART_COMPRESS_WINDOW) {
+            size_t limit = len - i;
+
+            cand--;
+            if (limit > CUART_COMPRESS_MAX_MATCH) {
+                limit = CUART_COMPRESS_MAX_MATCH;
+            }
+            while (match < limit && at(in, cand + match) == in[i + match]) {
+                match++;
+            }
+        }
+
+        if (match < CUART_COMPRESS_MIN_MATCH) {
+            i++;
+            continue;
+        }
+
+        size_t offset = pos - cand;
+
+        if (!put_literals(in, literals, i, out, &o, out_cap) || 2 > out_cap - o) {
+            return 0;
+        }
+        out[o++] = (uint8_t)(TOKEN_COPY | ((match - CUART_COMPRESS_MIN_MATCH) << 2) | ((offset - 1) >> 8));
+        out[o++] = (uint8_t)(offset - 1);
+
+        // Index the copied bytes too, so later copies can start inside them
+        for (size_t k = 1; k < match && i + k + CUART_COMPRESS_MIN_MATCH <= len; k++) {
+            c->head[hash3(in + i + k)] = (uint16_t)(pos + k + 1);
+        }
+        i += match;
+        literals = i;
+    }
+
+    if (!put_literals(in, literals, len, out, &o, out_cap)) {
+        return 0;
+    }
+    return o;
+}
+
+size_t cuart_decompress(const uint8_t *in, size_t len, uint8_t *out, size_t out_cap) {
+    size_t i = 0;
+    size_t o = 0;
+
+    while (i < len) {
+        uint8_t token = in[i++];
+
+        if (!(token & TOKEN_COPY)) {
+            size_t run = (size_t)token + 1;
+
+            if (run > len - i || run > out_cap - o) {
+                return 0;
+            }
+            memcpy(out + o, in + i, run);
+            i += run;
+            o += run;
+            continue;
+        }
+
+        if (i == len) {
+            return 0;
+        }
+        size_t match = ((token >> 2) & 0x1f) + CUART_COMPRESS_MIN_MATCH;
+        size_t offset = ((((size_t)token & 0x03) << 8) | in[i++]) + 1;
+
+        if (offset > DICT_LEN + o || match > out_cap - o) {
+            return 0;
+        }
+        // Byte by byte: a copy may overlap what it produces
+        for (size_t k = 0; k < match; k++, o++) {
+            size_t src = DICT_LEN + o - offset;
+
+            out[o] = (src < DICT_LEN) ? DICT[src] : out[src - DICT_LEN];
+        }
+    }
+    return o;
+}
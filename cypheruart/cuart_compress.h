@@ -0,0 +1,82 @@
+#ifndef CUART_COMPRESS_H
+#define CUART_COMPRESS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Payload compression: a byte-oriented LZ77 with a preset dictionary shared
+ * by both ends, sized for short, repetitive text and telemetry messages.
+ * Compression runs on the plaintext before sealing; decompression runs after
+ * the MAC verified and the payload was decrypted. A packet whose payload is
+ * compressed has CUART_FRAME_FLAG_COMPRESSED set in its LEN field (see
+ * cuart_frame.h), so compressed and plain packets can be mixed: the sender
+ * compresses only when it makes the payload smaller.
+ *
+ * Compressed stream, a sequence of tokens:
+ *
+ *   0LLLLLLL                      L+1 literal bytes follow (1..128)
+ *   1LLLLLOO OOOOOOOO             copy L+3 bytes (3..34) from O+1 bytes back (1..1024)
+ *
+ * Copies reach back into the output produced so far and, before its start,
+ * into the end of the preset dictionary, so even the first message of a
+ * session compresses. They may overlap the bytes they produce (runs).
+ *
+ * The dictionary is part of the wire format: sender, receiver and sniffer
+ * must be built from the same cuart_compress.c.
+ */
+
+// Shortest and longest copy, and how far back a copy can reach
+#define CUART_COMPRESS_MIN_MATCH 3
+#define CUART_COMPRESS_MAX_MATCH 34
+#define CUART_COMPRESS_WINDOW 1024
+
+// Hash table size (entries) used to find copies
+#define CUART_COMPRESS_HASH_BITS 9
+#define CUART_COMPRESS_HASH_SIZE (1u << CUART_COMPRESS_HASH_BITS)
+
+/**
+ * @brief Compressor state (2 KB: keep it static, one per task)
+ */
+typedef struct {
+    uint16_t dict_head[CUART_COMPRESS_HASH_SIZE];   // dictionary positions, built once
+    uint16_t head[CUART_COMPRESS_HASH_SIZE];        // working copy for one message
+} cuart_compress_t;
+
+/**
+ * @brief Index the preset dictionary
+ *
+ * @param c Pointer to compressor state
+ */
+void cuart_compress_init(cuart_compress_t *c);
+
+/**
+ * @brief Compress a payload
+ *
+ * @param c Pointer to compressor state (from cuart_compress_init())
+ * @param in Pointer to payload
+ * @param len Payload length
+ * @param out Pointer to output
+ * @param out_cap Largest output worth producing (usually len - 1)
+ * @return Compressed length, or 0 if the payload does not fit in out_cap
+ *         compressed (send it uncompressed)
+ */
+size_t cuart_compress(cuart_compress_t *c, const uint8_t *in, size_t len,
+                      uint8_t *out, size_t out_cap);
+
+/**
+ * @brief Decompress a payload
+ *
+ * Every token is bounds-checked, so a stream that is not valid (a peer built
+ * with another dictionary, or a damaged capture) is rejected without reading
+ * or writing outside the buffers.
+ *
+ * @param in Pointer to compressed payload
+ * @param len Compressed length
+ * @param out Pointer to output (must not overlap in)
+ * @param out_cap Output size
+ * @return Decompressed length, or 0 if the stream is malformed or does not fit
+ */
+size_t cuart_decompress(const uint8_t *in, size_t len, uint8_t *out, size_t out_cap);
+
+#endif // CUART_COMPRESS_H
@@ -0,0 +1,550 @@
+/*
+ * Sniffer output (host only): buffered packet rendering, see cuart_format.h
+ */
+
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include "cuart_format.h"
+#include "cuart_batch.h"
+
+static const char HEX_DIGITS[] = "0123456789abcdef";
+
+static const char RULE[] =
+    "════════════════════════════════════════════════════════════════════════════════\n";
+
+// Byte as shown in the ASCII column and in messages
+#define PRINTABLE(c) (((c) >= 32 && (c) < 127) ? (char)(c) : '.')
+
+int cuart_out_init(cuart_out_t *out, cuart_format_mode_t mode, size_t cap) {
+    memset(out, 0, sizeof(*out));
+    out->mode = mode;
+    out->clock_sec = (time_t)-1;
+    out->buf = malloc(cap);
+    if (!out->buf) {
+        return -1;
+    }
+    out->cap = cap;
+    return 0;
+}
+
+void cuart_out_free(cuart_out_t *out) {
+    free(out->buf);
+    out->buf = NULL;
+    out->len = out->cap = 0;
+}
+
+// Room for n more bytes; false (nothing appended) if the buffer cannot grow
+static bool reserve(cuart_out_t *out, size_t n) {
+    if (out->len + n <= out->cap) {
+        return true;
+    }
+
+    size_t cap = out->cap ? out->cap * 2 : 4096;
+    while (cap < out->len + n) {
+        cap *= 2;
+    }
+    char *buf = realloc(out->buf, cap);
+    if (!buf) {
+        return false;
+    }
+    out->buf = buf;
+    out->cap = cap;
+    return true;
+}
+
+int cuart_out_write(cuart_out_t *out, int fd) {
+    size_t done = 0;
+
+    while (done < out->len) {
+        ssize_t n = write(fd, out->buf + done, out->len - done);
+
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            out->len = 0;
+            return -1;
+        }
+        done += (size_t)n;
+    }
+    out->len = 0;
+    return 0;
+}
+
+static void put(cuart_out_t *out, const void *data, size_t len) {
+    if (reserve(out, len)) {
+        memcpy(out->buf + out->len, data, len);
+        out->len += len;
+    }
+}
+
+void cuart_out_printf(cuart_out_t *out, const char *fmt, ...) {
+    va_list ap;
+    int n;
+
+    va_start(ap, fmt);
+    n = vsnprintf(out->buf + out->len, out->cap - out->len, fmt, ap);
+    va_end(ap);
+    if (n < 0) {
+        return;
+    }
+    if ((size_t)n >= out->cap - out->len) {
+        if (!reserve(out, (size_t)n + 1)) {
+            return;
+        }
+        va_start(ap, fmt);
+        vsnprintf(out->buf + out->len, out->cap - out->len, fmt, ap);
+        va_end(ap);
+    }
+    out->len += (size_t)n;
+}
+
+void cuart_out_str(cuart_out_t *out, const char *s) {
+    put(out, s, strlen(s));
+}
+
+void cuart_out_uint(cuart_out_t *out, uint64_t value) {
+    char digits[20];
+    size_t n = sizeof(digits);
+
+    do {
+        digits[--n] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value > 0);
+    put(out, digits + n, sizeof(digits) - n);
+}
+
+void cuart_out_hex(cuart_out_t *out, const uint8_t *data, size_t len) {
+    if (!reserve(out, len * 2)) {
+        return;
+    }
+
+    char *p = out->buf + out->len;
+    for (size_t i = 0; i < len; i++) {
+        *p++ = HEX_DIGITS[data[i] >> 4];
+        *p++ = HEX_DIGITS[data[i] & 0x0f];
+    }
+    out->len += len * 2;
+}
+
+void cuart_out_hexdump(cuart_out_t *out, const uint8_t *data, size_t len) {
+    // Each line: 16 "xx " cells, " |", 16 characters, "|\n"
+    if (!reserve(out, (len + 15) / 16 * 68)) {
+        return;
+    }
+
+    char *p = out->buf + out->len;
+    for (size_t line = 0; line < len; line += 16) {
+        size_t n = (len - line < 16) ? len - line : 16;
+
+        for (size_t i = 0; i < n; i++) {
+            *p++ = HEX_DIGITS[data[line + i] >> 4];
+            *p++ = HEX_DIGITS[data[line + i] & 0x0f];
+            *p++ = ' ';
+        }
+        memset(p, ' ', (16 - n) * 3);
+        p += (16 - n) * 3;
+        *p++ = ' ';
+        *p++ = '|';
+        for (size_t i = 0; i < n; i++) {
+            *p++ = PRINTABLE(data[line + i]);
+        }
+        *p++ = '|';
+        *p++ = '\n';
+    }
+    out->len = (size_t)(p - out->buf);
+}
+
+void cuart_out_text(cuart_out_t *out, const uint8_t *data, size_t len) {
+    const uint8_t *nul = memchr(data, 0, len);
+
+    if (nul) {
+        len = (size_t)(nul - data);
+    }
+    if (!reserve(out, len)) {
+        return;
+    }
+
+    char *p = out->buf + out->len;
+    for (size_t i = 0; i < len; i++) {
+        p[i] = PRINTABLE(data[i]);
+    }
+    out->len += len;
+}
+
+void cuart_out_json_string(cuart_out_t *out, const uint8_t *data, size_t len) {
+    const uint8_t *nul = memchr(data, 0, len);
+
+    if (nul) {
+        len = (size_t)(nul - data);
+    }
+    // Worst case every byte becomes \u00XX
+    if (!reserve(out, len * 6 + 2)) {
+        return;
+    }
+
+    char *p = out->buf + out->len;
+    *p++ = '"';
+    for (size_t i = 0; i < len; i++) {
+        uint8_t c = data[i];
+
+        if (c == '"' || c == '\\') {
+            *p++ = '\\';
+            *p++ = (char)c;
+        } else if (c >= 32 && c < 127) {
+            *p++ = (char)c;
+        } else {
+            memcpy(p, "\\u00", 4);
+            p[4] = HEX_DIGITS[c >> 4];
+            p[5] = HEX_DIGITS[c & 0x0f];
+            p += 6;
+        }
+    }
+    *p++ = '"';
+    out->len = (size_t)(p - out->buf);
+}
+
+// "HH:MM:SS" local time; localtime_r() once a second, not once a packet
+static void put_clock(cuart_out_t *out, uint64_t time_ns) {
+    time_t sec = (time_t)(time_ns / 1000000000u);
+
+    if (sec != out->clock_sec) {
+        struct tm tm_info;
+
+        localtime_r(&sec, &tm_info);
+        out->clock[0] = (char)('0' + tm_info.tm_hour / 10);
+        out->clock[1] = (char)('0' + tm_info.tm_hour % 10);
+        out->clock[2] = ':';
+        out->clock[3] = (char)('0' + tm_info.tm_min / 10);
+        out->clock[4] = (char)('0' + tm_info.tm_min % 10);
+        out->clock[5] = ':';
+        out->clock[6] = (char)('0' + tm_info.tm_sec / 10);
+        out->clock[7] = (char)('0' + tm_info.tm_sec % 10);
+        out->clock_sec = sec;
+    }
+    put(out, out->clock, sizeof(out->clock));
+}
+
+// Zero-padded decimal of a fixed width
+static void put_fixed(cuart_out_t *out, uint64_t value, int width) {
+    char digits[20];
+
+    for (int i = width - 1; i >= 0; i--) {
+        digits[i] = (char)('0' + value % 10);
+        value /= 10;
+    }
+    put(out, digits, (size_t)width);
+}
+
+// "HH:MM:SS.mmm " and the port, for quiet lines
+static void put_line_start(cuart_out_t *out, const char *port, bool tag, uint64_t time_ns) {
+    put_clock(out, time_ns);
+    put(out, ".", 1);
+    put_fixed(out, time_ns / 1000000u % 1000u, 3);
+    put(out, " ", 1);
+    if (tag) {
+        put(out, "[", 1);
+        cuart_out_str(out, port);
+        put(out, "] ", 2);
+    }
+}
+
+// {"time":<seconds since the epoch>,"port":"<name>"
+static void put_json_start(cuart_out_t *out, const char *port, uint64_t time_ns) {
+    cuart_out_str(out, "{\"time\":");
+    cuart_out_uint(out, time_ns / 1000000000u);
+    put(out, ".", 1);
+    put_fixed(out, time_ns / 1000u % 1000000u, 6);
+    cuart_out_str(out, ",\"port\":");
+    cuart_out_json_string(out, (const uint8_t *)port, strlen(port));
+}
+
+// Pretty: a message or a record table, as the sniffer has always shown it
+static void pretty_message(cuart_out_t *out, const cuart_packet_info_t *packet) {
+    const uint8_t *record;
+    size_t record_len;
+    size_t offset = 0;
+
+    if (!packet->batch) {
+        cuart_out_str(out, "\n📝 Message: \"");
+        cuart_out_text(out, packet->message, packet->message_len);
+        cuart_out_str(out, "\"\n");
+        return;
+    }
+
+    int count = cuart_batch_count(packet->message, packet->message_len);
+    if (count < 0) {
+        cuart_out_str(out, "\n⚠️  Malformed record table\n");
+        return;
+    }
+    cuart_out_printf(out, "\n📝 %d record%s:\n", count, count == 1 ? "" : "s");
+    for (int i = 1; cuart_batch_next(packet->message, packet->message_len, &offset, &record, &record_len); i++) {
+        cuart_out_printf(out, "   [%d] %zu bytes \"", i, record_len);
+        cuart_out_text(out, record, record_len);
+        cuart_out_str(out, "\"\n");
+    }
+}
+
+static void format_pretty(cuart_out_t *out, const cuart_packet_info_t *packet) {
+    const cuart_frame_view_t *frame = packet->frame;
+    const char *mac_name = (packet->wire == CUART_WIRE_AEAD) ? "Tag" : "HMAC";
+
+    cuart_out_str(out, RULE);
+    cuart_out_str(out, "📦 Packet #");
+    cuart_out_uint(out, (uint64_t)packet->number);
+    put(out, " ", 1);
+    if (packet->tag) {
+        put(out, "[", 1);
+        cuart_out_str(out, packet->port);
+        put(out, "] ", 2);
+    }
+    cuart_out_str(out, "@ ");
+    put_clock(out, packet->time_ns);
+    put(out, "\n", 1);
+    cuart_out_str(out, RULE);
+
+    if (packet->session) {
+        cuart_out_str(out, "\n🔑 Sequence number: ");
+        cuart_out_uint(out, packet->seq);
+        cuart_out_str(out, "\n");
+    } else {
+        cuart_out_str(out, "\n🔑 Nonce (");
+        cuart_out_uint(out, frame->nonce_len);
+        cuart_out_str(out, " bytes):\n\n");
+        cuart_out_hexdump(out, frame->nonce, frame->nonce_len);
+    }
+
+    cuart_out_str(out, "\n🔒 ENCRYPTED Data (");
+    cuart_out_uint(out, frame->length);
+    cuart_out_str(out, (frame->flags & CUART_FRAME_FLAG_COMPRESSED) ? " bytes, compressed):\n\n" : " bytes):\n\n");
+    cuart_out_hexdump(out, frame->body, frame->length);
+
+    cuart_out_str(out, "\n🏷️  ");
+    cuart_out_str(out, mac_name);
+    cuart_out_str(out, " (");
+    cuart_out_uint(out, frame->mac_len);
+    cuart_out_str(out, packet->authentic ? " bytes): ✓ authentic\n\n" : " bytes): ✗ INVALID\n\n");
+    cuart_out_hexdump(out, frame->mac, frame->mac_len);
+
+    if (packet->authentic) {
+        cuart_out_str(out, "\n🔓 DECRYPTED Plaintext (");
+        cuart_out_uint(out, frame->length);
+        cuart_out_str(out, " bytes):\n\n");
+        cuart_out_hexdump(out, packet->decrypted, frame->length);
+
+        switch (packet->delivery) {
+        case CUART_DELIVERY_MISSING:
+            cuart_out_str(out, "\n⚠️  No delivery sequence number (sender without reliable delivery?)\n\n");
+            return;
+        case CUART_DELIVERY_AGAIN:
+            cuart_out_str(out, "\n🔁 Delivery seq ");
+            cuart_out_uint(out, packet->delivery_seq);
+            cuart_out_str(out, " sent again, shown before\n\n");
+            return;
+        case CUART_DELIVERY_NEW:
+            cuart_out_str(out, "\n🔁 Delivery seq ");
+            cuart_out_uint(out, packet->delivery_seq);
+            cuart_out_str(out, "\n");
+            break;
+        case CUART_DELIVERY_NONE:
+            break;
+        }
+
+        if (packet->inflate_failed) {
+            cuart_out_str(out, "\n⚠️  Compressed payload does not decompress\n");
+        } else if (packet->packed_len > 0) {
+            cuart_out_printf(out, "\n🗜️  Compressed: %zu → %zu bytes (%.0f%%)\n", packet->packed_len,
+                             packet->message_len, 100.0 * packet->packed_len / packet->message_len);
+        }
+
+        // A message that does not decompress is not shown
+        if (packet->message_len > 0 && !packet->inflate_failed) {
+            pretty_message(out, packet);
+        }
+    }
+
+    cuart_out_str(out, "\n📊 Total packet size: ");
+    cuart_out_uint(out, packet->wire_len);
+    cuart_out_str(out, " bytes\n\n");
+}
+
+// Quiet: "12:00:01.250 [port] #7 ✓ 48 B seq 12 "message""
+static void format_quiet(cuart_out_t *out, const cuart_packet_info_t *packet) {
+    const uint8_t *record;
+    size_t record_len;
+    size_t offset = 0;
+
+    put_line_start(out, packet->port, packet->tag, packet->time_ns);
+    put(out, "#", 1);
+    cuart_out_uint(out, (uint64_t)packet->number);
+    cuart_out_str(out, packet->authentic ? " ✓ " : " ✗ ");
+    cuart_out_uint(out, packet->wire_len);
+    cuart_out_str(out, " B");
+    if (packet->session) {
+        cuart_out_str(out, " seq ");
+        cuart_out_uint(out, packet->seq);
+    }
+    if (!packet->authentic) {
+        cuart_out_str(out, packet->wire == CUART_WIRE_AEAD ? " INVALID Tag\n" : " INVALID HMAC\n");
+        return;
+    }
+
+    switch (packet->delivery) {
+    case CUART_DELIVERY_MISSING:
+        cuart_out_str(out, " no delivery seq\n");
+        return;
+    case CUART_DELIVERY_AGAIN:
+        cuart_out_str(out, " delivery ");
+        cuart_out_uint(out, packet->delivery_seq);
+        cuart_out_str(out, " again\n");
+        return;
+    case CUART_DELIVERY_NEW:
+        cuart_out_str(out, " delivery ");
+        cuart_out_uint(out, packet->delivery_seq);
+        break;
+    case CUART_DELIVERY_NONE:
+        break;
+    }
+
+    if (packet->inflate_failed) {
+        cuart_out_str(out, " does not decompress\n");
+        return;
+    }
+    if (!packet->batch) {
+        cuart_out_str(out, " \"");
+        cuart_out_text(out, packet->message, packet->message_len);
+        cuart_out_str(out, "\"\n");
+        return;
+    }
+
+    int count = cuart_batch_count(packet->message, packet->message_len);
+    if (count < 0) {
+        cuart_out_str(out, " malformed record table\n");
+        return;
+    }
+    cuart_out_str(out, " ");
+    cuart_out_uint(out, (uint64_t)count);
+    cuart_out_str(out, count == 1 ? " record" : " records");
+    while (cuart_batch_next(packet->message, packet->message_len, &offset, &record, &record_len)) {
+        cuart_out_str(out, " \"");
+        cuart_out_text(out, record, record_len);
+        put(out, "\"", 1);
+    }
+    put(out, "\n", 1);
+}
+
+// JSON: {"time":...,"port":"...","packet":7,"seq":12,"length":48,"authentic":true,"message":"...","wire":98}
+static void format_json(cuart_out_t *out, const cuart_packet_info_t *packet) {
+    const cuart_frame_view_t *frame = packet->frame;
+    const uint8_t *record;
+    size_t record_len;
+    size_t offset = 0;
+
+    put_json_start(out, packet->port, packet->time_ns);
+    cuart_out_str(out, ",\"packet\":");
+    cuart_out_uint(out, (uint64_t)packet->number);
+    if (packet->session) {
+        cuart_out_str(out, ",\"seq\":");
+        cuart_out_uint(out, packet->seq);
+    } else {
+        cuart_out_str(out, ",\"nonce\":\"");
+        cuart_out_hex(out, frame->nonce, frame->nonce_len);
+        put(out, "\"", 1);
+    }
+    cuart_out_str(out, ",\"length\":");
+    cuart_out_uint(out, frame->length);
+    if (frame->flags & CUART_FRAME_FLAG_COMPRESSED) {
+        cuart_out_str(out, ",\"compressed\":true");
+    }
+    cuart_out_str(out, packet->authentic ? ",\"authentic\":true" : ",\"authentic\":false");
+
+    if (packet->authentic) {
+        if (packet->delivery == CUART_DELIVERY_MISSING) {
+            cuart_out_str(out, ",\"error\":\"no delivery sequence number\"");
+        } else if (packet->delivery != CUART_DELIVERY_NONE) {
+            cuart_out_str(out, ",\"delivery_seq\":");
+            cuart_out_uint(out, packet->delivery_seq);
+            if (packet->delivery == CUART_DELIVERY_AGAIN) {
+                cuart_out_str(out, ",\"again\":true");
+            }
+        }
+        if (packet->delivery == CUART_DELIVERY_MISSING || packet->delivery == CUART_DELIVERY_AGAIN) {
+            // Nothing new to show
+        } else if (packet->inflate_failed) {
+            cuart_out_str(out, ",\"error\":\"does not decompress\"");
+        } else if (!packet->batch) {
+            cuart_out_str(out, ",\"message\":");
+            cuart_out_json_string(out, packet->message, packet->message_len);
+        } else if (cuart_batch_count(packet->message, packet->message_len) < 0) {
+            cuart_out_str(out, ",\"error\":\"malformed record table\"");
+        } else {
+            cuart_out_str(out, ",\"records\":[");
+            for (int i = 0; cuart_batch_next(packet->message, packet->message_len, &offset, &record, &record_len); i++) {
+                if (i > 0) {
+                    put(out, ",", 1);
+                }
+                cuart_out_json_string(out, record, record_len);
+            }
+            put(out, "]", 1);
+        }
+    }
+
+    cuart_out_str(out, ",\"wire\":");
+    cuart_out_uint(out, packet->wire_len);
+    cuart_out_str(out, "}\n");
+}
+
+void cuart_format_packet(cuart_out_t *out, const cuart_packet_info_t *packet) {
+    switch (out->mode) {
+    case CUART_FORMAT_PRETTY:
+        format_pretty(out, packet);
+        break;
+    case CUART_FORMAT_QUIET:
+        format_quiet(out, packet);
+        break;
+    case CUART_FORMAT_JSON:
+        format_json(out, packet);
+        break;
+    case CUART_FORMAT_SUMMARY:
+        break;
+    }
+}
+
+void cuart_format_event(cuart_out_t *out, const char *port, bool tag, uint64_t time_ns,
+                        const char *icon, const char *event, const char *text) {
+    switch (out->mode) {
+    case CUART_FORMAT_PRETTY:
+        cuart_out_str(out, icon);
+        put(out, " ", 1);
+        if (tag) {
+            put(out, "[", 1);
+            cuart_out_str(out, port);
+            put(out, "] ", 2);
+        }
+        cuart_out_str(out, text);
+        cuart_out_str(out, "\n\n");
+        break;
+    case CUART_FORMAT_QUIET:
+        put_line_start(out, port, tag, time_ns);
+        cuart_out_str(out, icon);
+        put(out, " ", 1);
+        cuart_out_str(out, text);
+        put(out, "\n", 1);
+        break;
+    case CUART_FORMAT_JSON:
+        put_json_start(out, port, time_ns);
+        cuart_out_str(out, ",\"event\":");
+        cuart_out_json_string(out, (const uint8_t *)event, strlen(event));
+        cuart_out_str(out, ",\"detail\":");
+        cuart_out_json_string(out, (const uint8_t *)text, strlen(text));
+        cuart_out_str(out, "}\n");
+        break;
+    case CUART_FORMAT_SUMMARY:
+        break;
+    }
+}
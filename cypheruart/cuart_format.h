@@ -0,0 +1,172 @@
+#ifndef CUART_FORMAT_H
+#define CUART_FORMAT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <time.h>
+#include "cuart_frame.h"
+
+/*
+ * Sniffer output (host only): packets rendered into a reusable buffer and
+ * written out with one write() per batch, instead of a printf() per byte
+ *
+ * Hex and ASCII dumps come from lookup tables, numbers are converted by
+ * hand, and the wall-clock time is broken down once a second, so rendering
+ * a packet costs about as much as copying its text. Each thread renders into
+ * its own buffer; whole packets reach the file descriptor in one write, so
+ * output from several threads never interleaves within a packet.
+ *
+ * Modes:
+ *
+ *   PRETTY   every field in hex and ASCII, boxed (the sniffer's default)
+ *   QUIET    one line per packet: time, port, number, verdict, message
+ *   JSON     one JSON object per packet or event (JSON Lines)
+ *   SUMMARY  nothing per packet; the caller prints totals at the end
+ */
+
+typedef enum {
+    CUART_FORMAT_PRETTY,
+    CUART_FORMAT_QUIET,
+    CUART_FORMAT_JSON,
+    CUART_FORMAT_SUMMARY
+} cuart_format_mode_t;
+
+/**
+ * @brief Output buffer for one thread
+ */
+typedef struct {
+    cuart_format_mode_t mode;
+    char *buf;
+    size_t len;
+    size_t cap;
+    time_t clock_sec;           // second the cached clock text is for
+    char clock[8];              // "HH:MM:SS" for clock_sec, local time
+} cuart_out_t;
+
+// What the delivery sequence number (reliable delivery) said
+typedef enum {
+    CUART_DELIVERY_NONE,        // not in use
+    CUART_DELIVERY_NEW,         // first copy, shown
+    CUART_DELIVERY_AGAIN,       // a copy sent again, shown before
+    CUART_DELIVERY_MISSING      // payload too short to carry one
+} cuart_delivery_t;
+
+/**
+ * @brief A received packet as it is shown
+ */
+typedef struct {
+    const char *port;           // port name
+    bool tag;                   // name the port in pretty and quiet output (several ports)
+    int number;                 // packet number on its port
+    uint64_t time_ns;           // wall-clock time it was read
+    cuart_wire_t wire;          // HMAC or tag
+    const cuart_frame_view_t *frame;    // body still encrypted
+    bool session;               // NONCE field is a sequence number
+    uint32_t seq;               // session sequence number
+    bool authentic;
+    const uint8_t *decrypted;   // whole decrypted payload (authentic only)
+    cuart_delivery_t delivery;
+    uint16_t delivery_seq;
+    const uint8_t *message;     // payload after the delivery header and decompression
+    size_t message_len;
+    size_t packed_len;          // compressed payload bytes, 0 if not compressed
+    bool inflate_failed;        // compressed payload did not decompress (message is the packed bytes)
+    bool batch;                 // message is a record table (cuart_batch.h)
+    size_t wire_len;            // packet bytes on the wire
+} cuart_packet_info_t;
+
+/**
+ * @brief Set up an output buffer
+ *
+ * @param out Pointer to output buffer
+ * @param mode Output mode
+ * @param cap Initial capacity (grows as needed)
+ * @return 0, or -1 if out of memory
+ */
+int cuart_out_init(cuart_out_t *out, cuart_format_mode_t mode, size_t cap);
+
+/**
+ * @brief Free an output buffer
+ *
+ * @param out Pointer to output buffer
+ */
+void cuart_out_free(cuart_out_t *out);
+
+/**
+ * @brief Write out and empty the buffer
+ *
+ * @param out Pointer to output buffer
+ * @param fd File descriptor
+ * @return 0, or -1 with errno set (the buffer is emptied either way)
+ */
+int cuart_out_write(cuart_out_t *out, int fd);
+
+/**
+ * @brief Append text formatted by vsnprintf()
+ *
+ * For the occasional line; dumps and per-packet fields have their own calls.
+ *
+ * @param out Pointer to output buffer
+ * @param fmt printf() format
+ */
+void cuart_out_printf(cuart_out_t *out, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+/**
+ * @brief Append a string
+ */
+void cuart_out_str(cuart_out_t *out, const char *s);
+
+/**
+ * @brief Append an unsigned decimal number
+ */
+void cuart_out_uint(cuart_out_t *out, uint64_t value);
+
+/**
+ * @brief Append bytes as lowercase hex, no separators
+ */
+void cuart_out_hex(cuart_out_t *out, const uint8_t *data, size_t len);
+
+/**
+ * @brief Append a hex dump: 16 bytes a line, then the printable ones between bars
+ *
+ *   "2b 7e 15 16 28 ae d2 a6 ab f7 15 88 09 cf 4f 3c  |+~..(.......O<|"
+ */
+void cuart_out_hexdump(cuart_out_t *out, const uint8_t *data, size_t len);
+
+/**
+ * @brief Append text up to the first NUL, non-printable bytes as '.'
+ */
+void cuart_out_text(cuart_out_t *out, const uint8_t *data, size_t len);
+
+/**
+ * @brief Append text up to the first NUL as a quoted JSON string
+ *
+ * Quotes, backslashes and control characters are escaped; bytes above 0x7e
+ * become \u00XX (read as Latin-1).
+ */
+void cuart_out_json_string(cuart_out_t *out, const uint8_t *data, size_t len);
+
+/**
+ * @brief Append a packet in the buffer's mode
+ *
+ * @param out Pointer to output buffer
+ * @param packet Pointer to packet
+ */
+void cuart_format_packet(cuart_out_t *out, const cuart_packet_info_t *packet);
+
+/**
+ * @brief Append an event that is not a packet (warning, new session, rate change)
+ *
+ * @param out Pointer to output buffer
+ * @param port Port name
+ * @param tag Name the port in pretty and quiet output
+ * @param time_ns Wall-clock time
+ * @param icon Emoji in front of the text (pretty and quiet)
+ * @param event Short name for JSON ("replayed", "link", ...)
+ * @param text Description
+ */
+void cuart_format_event(cuart_out_t *out, const char *port, bool tag, uint64_t time_ns,
+                        const char *icon, const char *event, const char *text);
+
+#endif // CUART_FORMAT_H
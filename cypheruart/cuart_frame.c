@@ -0,0 +1,96 @@
+#include <string.h>
+#include "cuart_frame.h"
+
+size_t cuart_frame_mac_size(cuart_wire_t wire) {
+    return (wire == CUART_WIRE_AEAD) ? AES_GCM_TAG_SIZE : HMAC_SIZE;
+}
+
+size_t cuart_frame_seal(cuart_frame_ctx_t *ctx, uint8_t *frame,
+                        const uint8_t *nonce, size_t nonce_len, const uint8_t *iv,
+                        const uint8_t *payload, size_t length, bool encrypt) {
+    return cuart_frame_seal_flags(ctx, frame, nonce, nonce_len, iv, payload, length, encrypt, 0);
+}
+
+size_t cuart_frame_seal_flags(cuart_frame_ctx_t *ctx, uint8_t *frame,
+                              const uint8_t *nonce, size_t nonce_len, const uint8_t *iv,
+                              const uint8_t *payload, size_t length, bool encrypt, uint16_t flags) {
+    uint8_t *length_bytes = frame + nonce_len;
+    uint8_t *body = length_bytes + 2;
+    uint8_t *mac = body + length;
+
+    if (nonce != frame) {
+        memmove(frame, nonce, nonce_len);
+    }
+    length_bytes[0] = (uint8_t)((length | flags) >> 8);
+    length_bytes[1] = (uint8_t)length;
+
+    if (ctx->wire == CUART_WIRE_AEAD) {
+        if (encrypt) {
+            aes_gcm_encrypt(ctx->gcm, iv, length_bytes, 2, payload, body, length, mac);
+        } else {
+            // Nothing to encrypt: LEN || payload is additional data
+            memmove(body, payload, length);
+            aes_gcm_encrypt(ctx->gcm, iv, length_bytes, 2 + length, NULL, NULL, 0, mac);
+        }
+    } else {
+        hmac_sha256_ctx_t hmac;
+
+        if (encrypt) {
+            aes_ctr_crypt(ctx->ctr, payload, body, length, iv);
+        } else {
+            memmove(body, payload, length);
+        }
+
+        // Encrypt-then-MAC over IV || LEN || body
+        hmac_sha256_start(&hmac, ctx->hmac_key);
+        hmac_sha256_update(&hmac, iv, AES_BLOCK_SIZE);
+        hmac_sha256_update(&hmac, length_bytes, 2 + length);
+        hmac_sha256_final(&hmac, mac);
+    }
+
+    return nonce_len + 2 + length + cuart_frame_mac_size(ctx->wire);
+}
+
+bool cuart_frame_open(cuart_frame_ctx_t *ctx, const cuart_frame_view_t *frame,
+                      const uint8_t *iv, uint8_t *output, bool decrypt) {
+    if (ctx->wire == CUART_WIRE_AEAD) {
+        if (!decrypt) {
+            return aes_gcm_decrypt(ctx->gcm, iv, frame->length_bytes, 2 + frame->length,
+                                   NULL, NULL, 0, frame->mac);
+        }
+        return aes_gcm_decrypt(ctx->gcm, iv, frame->length_bytes, 2,
+                               frame->body, output, frame->length, frame->mac);
+    } else {
+        hmac_sha256_ctx_t hmac;
+
+        // Authenticate then decrypt: HMAC over IV || LEN || body
+        hmac_sha256_start(&hmac, ctx->hmac_key);
+        hmac_sha256_update(&hmac, iv, AES_BLOCK_SIZE);
+        hmac_sha256_update(&hmac, frame->length_bytes, 2 + frame->length);
+        if (!hmac_sha256_verify_final(&hmac, frame->mac)) {
+            return false;
+        }
+        if (decrypt) {
+            aes_ctr_crypt(ctx->ctr, frame->body, output, frame->length, iv);
+        }
+        return true;
+    }
+}
+
+uint8_t cuart_frame_header_crc(const uint8_t *header, size_t len) {
+    uint8_t crc = 0;
+
+    for (size_t i = 0; i < len; i++) {
+        crc ^= header[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+void cuart_frame_sync_header(uint8_t *out, const uint8_t *frame, size_t nonce_len) {
+    out[0] = CUART_FRAME_SYNC0;
+    out[1] = CUART_FRAME_SYNC1;
+    out[2] = cuart_frame_header_crc(frame, nonce_len + 2);
+}
@@ -0,0 +1,162 @@
+#ifndef CUART_FRAME_H
+#define CUART_FRAME_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "aes_wrapper.h"
+#include "aes_gcm.h"
+
+/*
+ * Packet assembly for both wire formats:
+ *
+ *   CUART_WIRE_HMAC  [NONCE][LEN 2][CIPHERTEXT][HMAC 32]   HMAC over IV || LEN || CIPHERTEXT
+ *   CUART_WIRE_AEAD  [NONCE][LEN 2][CIPHERTEXT][TAG 16]    AES-128-GCM, LEN as AAD
+ *
+ * LEN is the payload length in its low 15 bits; the top bit
+ * (CUART_FRAME_FLAG_COMPRESSED) marks a payload that was compressed before
+ * sealing (see cuart_compress.h). Both are authenticated with the packet.
+ *
+ * The NONCE field is a random nonce (16 or 12 bytes, equal to the IV) or a
+ * 4-byte session sequence number (see cuart_session.h). A packet is built in
+ * one contiguous buffer, encrypting straight into place, so the sender can
+ * hand it to the UART driver in a single write.
+ *
+ * With sync framing (CONFIG_CUART_SYNC_FRAMING, sniffer --sync) every packet
+ * is preceded by
+ *
+ *   [SYNC 0xA5 0xC3][HCRC 1]   HCRC = CRC-8 (poly 0x07) over NONCE || LEN
+ *
+ * so a receiver that lost or corrupted bytes finds the next packet by
+ * scanning for the sync word and checking the header CRC, instead of reading
+ * garbage lengths until the line goes idle. The MAC is unchanged and does not
+ * cover the sync header.
+ */
+
+// Largest payload carried by one packet
+#define CUART_FRAME_MAX_PAYLOAD 1024
+
+// LEN field: payload length bits and flags
+#define CUART_FRAME_LEN_MASK 0x7fff
+#define CUART_FRAME_FLAG_COMPRESSED 0x8000
+
+// Largest NONCE field
+#define CUART_FRAME_MAX_NONCE AES_BLOCK_SIZE
+
+// Largest packet: 16-byte nonce, length, payload, HMAC
+#define CUART_FRAME_MAX (CUART_FRAME_MAX_NONCE + 2 + CUART_FRAME_MAX_PAYLOAD + HMAC_SIZE)
+
+// Sync word and header CRC in front of a packet (sync framing)
+#define CUART_FRAME_SYNC0 0xA5
+#define CUART_FRAME_SYNC1 0xC3
+#define CUART_FRAME_SYNC_SIZE 3
+
+// Packet wire formats
+typedef enum {
+    CUART_WIRE_HMAC,    // AES-128-CTR + HMAC-SHA256
+    CUART_WIRE_AEAD     // AES-128-GCM
+} cuart_wire_t;
+
+/**
+ * @brief Keys and wire format used to build packets
+ */
+typedef struct {
+    cuart_wire_t wire;
+    aes_ctr_ctx_t *ctr;                 // CUART_WIRE_HMAC
+    const hmac_sha256_key_t *hmac_key;  // CUART_WIRE_HMAC
+    aes_gcm_ctx_t *gcm;                 // CUART_WIRE_AEAD
+} cuart_frame_ctx_t;
+
+/**
+ * @brief Fields of a received packet, pointing into one contiguous buffer
+ */
+typedef struct {
+    const uint8_t *nonce;
+    size_t nonce_len;
+    const uint8_t *length_bytes;        // LEN field, immediately followed by body
+    uint8_t *body;
+    size_t length;
+    uint16_t flags;                     // LEN field flags (CUART_FRAME_FLAG_*)
+    const uint8_t *mac;
+    size_t mac_len;
+} cuart_frame_view_t;
+
+/**
+ * @brief Length of the authenticator (HMAC or tag) for a wire format
+ *
+ * @param wire Wire format
+ * @return 32 for CUART_WIRE_HMAC, 16 for CUART_WIRE_AEAD
+ */
+size_t cuart_frame_mac_size(cuart_wire_t wire);
+
+/**
+ * @brief Build a packet in place
+ *
+ * Writes [NONCE][LEN][payload][MAC] to frame. The payload is encrypted
+ * straight into the frame; with encrypt set to false it is sent in clear but
+ * still authenticated (used for session salt announcements; for AEAD the
+ * clear payload is additional data).
+ *
+ * @param ctx Pointer to keys and wire format
+ * @param frame Pointer to output buffer (at least nonce_len + 2 + length + MAC bytes)
+ * @param nonce Pointer to NONCE field (may already be at the start of frame)
+ * @param nonce_len Length of NONCE field
+ * @param iv Pointer to 16-byte IV the NONCE field stands for (GCM uses 12 bytes)
+ * @param payload Pointer to plaintext
+ * @param length Length of plaintext (at most CUART_FRAME_MAX_PAYLOAD)
+ * @param encrypt false to authenticate the payload without encrypting it
+ * @return Total packet length
+ */
+size_t cuart_frame_seal(cuart_frame_ctx_t *ctx, uint8_t *frame,
+                        const uint8_t *nonce, size_t nonce_len, const uint8_t *iv,
+                        const uint8_t *payload, size_t length, bool encrypt);
+
+/**
+ * @brief Build a packet in place with flags in its LEN field
+ *
+ * As cuart_frame_seal(), with flags (CUART_FRAME_FLAG_*) ORed into LEN, where
+ * the MAC covers them.
+ *
+ * @param flags LEN field flags
+ * @return Total packet length
+ */
+size_t cuart_frame_seal_flags(cuart_frame_ctx_t *ctx, uint8_t *frame,
+                              const uint8_t *nonce, size_t nonce_len, const uint8_t *iv,
+                              const uint8_t *payload, size_t length, bool encrypt, uint16_t flags);
+
+/**
+ * @brief Verify a received packet and decrypt its payload
+ *
+ * The MAC is checked first (in constant time); nothing is decrypted unless it
+ * verifies. With decrypt set to false the body is only authenticated, as
+ * cuart_frame_seal() does for clear payloads.
+ *
+ * @param ctx Pointer to keys and wire format
+ * @param frame Pointer to received packet
+ * @param iv Pointer to 16-byte IV the NONCE field stands for
+ * @param output Pointer to plaintext buffer of frame->length bytes (may be frame->body)
+ * @param decrypt false to authenticate a clear payload without decrypting it
+ * @return true if the packet is authentic
+ */
+bool cuart_frame_open(cuart_frame_ctx_t *ctx, const cuart_frame_view_t *frame,
+                      const uint8_t *iv, uint8_t *output, bool decrypt);
+
+/**
+ * @brief CRC-8 (polynomial 0x07, init 0) of a packet header
+ *
+ * @param header Pointer to NONCE || LEN
+ * @param len Length of NONCE || LEN
+ * @return Header CRC
+ */
+uint8_t cuart_frame_header_crc(const uint8_t *header, size_t len);
+
+/**
+ * @brief Write the sync header for a sealed packet
+ *
+ * @param out Pointer to CUART_FRAME_SYNC_SIZE bytes (usually just before frame)
+ * @param frame Pointer to packet built by cuart_frame_seal()
+ * @param nonce_len Length of its NONCE field
+ */
+void cuart_frame_sync_header(uint8_t *out, const uint8_t *frame, size_t nonce_len);
+
+#endif // CUART_FRAME_H
@@ -0,0 +1,405 @@
+#include <string.h>
+#include "cuart_port.h"
+#include "cuart_link.h"
+
+const uint32_t CUART_LINK_RATES[CUART_LINK_NUM_RATES] = {
+    115200, 230400, 460800, 921600, 1000000, 1500000, 2000000, 2500000, 3000000, 4000000, 5000000
+};
+
+#define MAGIC0 0x96
+#define MAGIC1 0x69
+
+enum {
+    LINK_CAPS = 1,
+    LINK_SWITCH,
+    LINK_ACK,
+    LINK_CHECK,
+    LINK_FALLBACK,
+    LINK_ACKS
+};
+
+// CRC-16/CCITT-FALSE (poly 0x1021, init 0xffff); frames are 8 bytes
+static uint16_t crc16(const uint8_t *p, size_t len) {
+    uint16_t crc = 0xffff;
+
+    while (len--) {
+        crc ^= (uint16_t)(*p++ << 8);
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+static void build(uint8_t *out, uint8_t type, uint8_t seq, uint8_t a0, uint8_t a1, uint8_t a2, uint8_t a3) {
+    uint16_t crc;
+
+    out[0] = MAGIC0;
+    out[1] = MAGIC1;
+    out[2] = type;
+    out[3] = seq;
+    out[4] = a0;
+    out[5] = a1;
+    out[6] = a2;
+    out[7] = a3;
+    crc = crc16(out, CUART_LINK_FRAME_SIZE - 2);
+    out[8] = (uint8_t)(crc >> 8);
+    out[9] = (uint8_t)crc;
+}
+
+static void build_caps(const cuart_link_t *link, uint8_t *out) {
+    uint16_t rates = (link->local_rates & ~link->failed_rates) | 1;
+
+    build(out, LINK_CAPS, link->seq, (uint8_t)(rates >> 8), (uint8_t)rates,
+          link->local_flow ? CUART_LINK_CAP_FLOW : 0, link->boot);
+}
+
+// Reply sent by the next cuart_link_poll()
+static void queue(cuart_link_t *link, uint8_t type, uint8_t a0, uint8_t a1) {
+    if (type == LINK_CAPS) {
+        build_caps(link, link->out);
+    } else {
+        build(link->out, type, link->seq, a0, a1, 0, 0);
+    }
+    link->out_pending = true;
+}
+
+static void reset_errors(cuart_link_t *link) {
+    link->verified = false;
+    link->window = 0;
+    link->errors = 0;
+    link->junk = 0;
+}
+
+// Back to the safe rate and CAPS exchange; failed marks the rate left behind
+static void go_safe(cuart_link_t *link, uint32_t now_ms, bool failed) {
+    if (failed && link->rate != 0) {
+        link->failed_rates |= (uint16_t)(1u << link->rate);
+    }
+    link->rate = 0;
+    link->flow = false;
+    link->state = CUART_LINK_HELLO;
+    link->have_peer = false;
+    link->tries = 0;
+    link->next_ms = now_ms;
+    reset_errors(link);
+}
+
+// Errors or junk on the current rate: tell the peer (it may still hear it) and drop back
+static void fall_back(cuart_link_t *link, uint32_t now_ms) {
+    if (link->role != CUART_LINK_MONITOR) {
+        queue(link, LINK_FALLBACK, link->rate, 0);
+    }
+    link->stats.fallbacks++;
+    go_safe(link, now_ms, true);
+}
+
+static void move_to(cuart_link_t *link, uint8_t rate, bool flow) {
+    if (rate != link->rate || flow != link->flow) {
+        link->stats.switches++;
+    }
+    link->rate = rate;
+    link->flow = flow;
+    link->state = CUART_LINK_CHECKING;
+    link->tries = 0;
+    reset_errors(link);
+}
+
+static bool rate_ok(const cuart_link_t *link, uint8_t rate, uint8_t flow) {
+    return rate < CUART_LINK_NUM_RATES && (link->local_rates & (1u << rate)) && (!flow || link->local_flow);
+}
+
+static void handle(cuart_link_t *link, const uint8_t *f, uint32_t now_ms) {
+    uint8_t type = f[2];
+    uint8_t seq = f[3];
+    const uint8_t *arg = f + 4;
+
+    link->stats.frames++;
+    link->junk = 0;
+
+    switch (type) {
+    case LINK_CAPS:
+        // CAPS only come from a peer at the safe rate exchanging capabilities:
+        // if we thought the link was up, the peer restarted or fell back
+        if (link->state == CUART_LINK_UP ||
+            (link->role == CUART_LINK_RESPONDER && link->state != CUART_LINK_HELLO)) {
+            go_safe(link, now_ms, false);
+        }
+        if (link->known_peer && arg[3] != link->peer_boot) {
+            link->failed_rates = 0;
+        }
+        if (link->role == CUART_LINK_INITIATOR && (!link->known_peer || arg[3] != link->peer_boot)) {
+            // A peer that may not know our BOOT ID yet, and may still hold
+            // rates failed by our restart: introduce ourselves and use the
+            // CAPS it answers with
+            link->known_peer = true;
+            link->peer_boot = arg[3];
+            queue(link, LINK_CAPS, 0, 0);
+            break;
+        }
+        link->known_peer = true;
+        link->peer_boot = arg[3];
+        link->peer_rates = (uint16_t)((arg[0] << 8) | arg[1]);
+        link->peer_flow = (arg[2] & CUART_LINK_CAP_FLOW) != 0;
+        link->have_peer = true;
+        if (link->role == CUART_LINK_RESPONDER) {
+            queue(link, LINK_CAPS, 0, 0);
+        } else if (link->role == CUART_LINK_INITIATOR && link->state == CUART_LINK_HELLO) {
+            link->next_ms = now_ms;
+        }
+        break;
+
+    case LINK_SWITCH:
+        if (link->role == CUART_LINK_INITIATOR) {
+            break;
+        }
+        if (link->role == CUART_LINK_RESPONDER && !rate_ok(link, arg[0], arg[1])) {
+            // The initiator has stale capabilities: tell it again
+            queue(link, LINK_CAPS, 0, 0);
+            break;
+        }
+        if (arg[0] >= CUART_LINK_NUM_RATES) {
+            break;
+        }
+        link->seq = seq;
+        link->target = arg[0];
+        link->target_flow = arg[1] != 0;
+        if (link->role == CUART_LINK_RESPONDER) {
+            // Sent at the old rate; the caller switches once it is out
+            queue(link, LINK_ACK, arg[0], arg[1]);
+        }
+        move_to(link, link->target, link->target_flow);
+        link->next_ms = now_ms + CUART_LINK_SETTLE_MS + (CUART_LINK_TRIES + 1) * CUART_LINK_RETRY_MS;
+        break;
+
+    case LINK_ACK:
+        if (link->role == CUART_LINK_INITIATOR && link->state == CUART_LINK_SWITCHING &&
+            seq == link->seq && arg[0] == link->target) {
+            move_to(link, link->target, link->target_flow);
+            link->next_ms = now_ms + CUART_LINK_SETTLE_MS;
+        }
+        break;
+
+    case LINK_CHECK:
+        if (seq != link->seq || arg[0] != link->rate || link->state == CUART_LINK_HELLO) {
+            break;
+        }
+        if (link->role == CUART_LINK_RESPONDER) {
+            // Echo every CHECK, in case the previous echo was lost
+            queue(link, LINK_CHECK, link->rate, link->flow);
+        }
+        if (link->state != CUART_LINK_UP) {
+            link->state = CUART_LINK_UP;
+            reset_errors(link);
+        }
+        link->verified = true;
+        break;
+
+    case LINK_FALLBACK:
+        // Only for the rate we are on: one left behind earlier, or before we
+        // restarted, says nothing about the line now
+        if (arg[0] == 0 || arg[0] != link->rate) {
+            break;
+        }
+        link->stats.fallbacks++;
+        go_safe(link, now_ms, true);
+        break;
+
+    case LINK_ACKS:
+        // The state as of this frame; newer ones replace it
+        memcpy(link->acks, arg, sizeof(link->acks));
+        link->acks_new = true;
+        break;
+
+    default:
+        break;
+    }
+}
+
+void cuart_link_build_acks(uint8_t *out, const uint8_t *state) {
+    build(out, LINK_ACKS, 0, state[0], state[1], state[2], state[3]);
+}
+
+uint16_t cuart_link_rates_upto(uint32_t max_baud) {
+    uint16_t rates = 1;
+
+    for (int i = 1; i < CUART_LINK_NUM_RATES; i++) {
+        if (CUART_LINK_RATES[i] <= max_baud) {
+            rates |= (uint16_t)(1u << i);
+        }
+    }
+    return rates;
+}
+
+void cuart_link_init(cuart_link_t *link, cuart_link_role_t role, uint16_t rates, bool flow, uint32_t now_ms) {
+    memset(link, 0, sizeof(*link));
+    link->role = role;
+    link->local_rates = rates | 1;
+    link->local_flow = flow;
+    cuart_port_random(&link->boot, 1);
+    go_safe(link, now_ms, false);
+}
+
+bool cuart_link_scan(cuart_link_t *link, const uint8_t *data, size_t len, uint32_t now_ms, size_t *consumed) {
+    const uint8_t *begin = data;
+    const uint8_t *end = data + len;
+    bool found = false;
+
+    while (data < end && !found) {
+        // Between frames: skip to the next possible start
+        if (link->rx_len == 0) {
+            const uint8_t *start = memchr(data, MAGIC0, (size_t)(end - data));
+
+            if (start == NULL) {
+                link->junk += (uint32_t)(end - data);
+                data = end;
+                break;
+            }
+            link->junk += (uint32_t)(start - data);
+            data = start;
+        }
+
+        link->rx[link->rx_len++] = *data++;
+        if (link->rx_len == 2 && link->rx[1] != MAGIC1) {
+            link->rx_len = 0;
+            link->junk++;
+            data--;             // may itself start a frame
+            continue;
+        }
+        if (link->rx_len < CUART_LINK_FRAME_SIZE) {
+            continue;
+        }
+
+        link->rx_len = 0;
+        if (crc16(link->rx, CUART_LINK_FRAME_SIZE - 2) == (uint16_t)((link->rx[8] << 8) | link->rx[9])) {
+            handle(link, link->rx, now_ms);
+            found = true;
+            continue;
+        }
+
+        // Not a frame: rescan from the byte after its first (too few bytes
+        // to hold a whole one, they only start the next candidate)
+        uint8_t rest[CUART_LINK_FRAME_SIZE - 1];
+        size_t rescanned;
+
+        memcpy(rest, link->rx + 1, sizeof(rest));
+        link->junk++;
+        cuart_link_scan(link, rest, sizeof(rest), now_ms, &rescanned);
+    }
+
+    if (link->rate != 0 &&
+        link->junk > ((!link->verified || link->role == CUART_LINK_INITIATOR) ? CUART_LINK_JUNK_NEW
+                                                                                : CUART_LINK_JUNK_LIMIT)) {
+        fall_back(link, now_ms);
+    }
+    *consumed = (size_t)(data - begin);
+    return found;
+}
+
+size_t cuart_link_input(cuart_link_t *link, const uint8_t *data, size_t len, uint32_t now_ms) {
+    size_t scanned = 0;
+    size_t last_end = 0;
+
+    while (scanned < len) {
+        size_t used;
+
+        if (cuart_link_scan(link, data + scanned, len - scanned, now_ms, &used)) {
+            last_end = scanned + used;
+        }
+        scanned += used;
+    }
+    return last_end;
+}
+
+size_t cuart_link_poll(cuart_link_t *link, uint32_t now_ms, uint8_t *out) {
+    if (link->out_pending) {
+        memcpy(out, link->out, CUART_LINK_FRAME_SIZE);
+        link->out_pending = false;
+        return CUART_LINK_FRAME_SIZE;
+    }
+    if (link->role == CUART_LINK_MONITOR || (int32_t)(now_ms - link->next_ms) < 0) {
+        return 0;
+    }
+
+    switch (link->state) {
+    case CUART_LINK_HELLO:
+        if (link->role == CUART_LINK_INITIATOR && link->have_peer) {
+            uint16_t common = (link->local_rates & link->peer_rates & ~link->failed_rates) | 1;
+
+            link->target = 0;
+            while (common >>= 1) {
+                link->target++;
+            }
+            link->target_flow = link->local_flow && link->peer_flow;
+            link->seq++;
+            link->state = CUART_LINK_SWITCHING;
+            link->tries = 1;
+            link->next_ms = now_ms + CUART_LINK_RETRY_MS;
+            build(out, LINK_SWITCH, link->seq, link->target, link->target_flow, 0, 0);
+            return CUART_LINK_FRAME_SIZE;
+        }
+        if (link->role == CUART_LINK_INITIATOR && link->tries >= CUART_LINK_HELLO_TRIES) {
+            // Nobody answers (no return wire, or no receiver yet): send at
+            // the safe rate, and negotiate if CAPS turn up later
+            link->state = CUART_LINK_UP;
+            return 0;
+        }
+        if (link->tries < UINT8_MAX) {
+            link->tries++;
+        }
+        link->next_ms = now_ms + CUART_LINK_HELLO_MS;
+        build_caps(link, out);
+        return CUART_LINK_FRAME_SIZE;
+
+    case CUART_LINK_SWITCHING:
+        if (link->tries >= CUART_LINK_TRIES) {
+            go_safe(link, now_ms, false);
+            return 0;
+        }
+        link->tries++;
+        link->next_ms = now_ms + CUART_LINK_RETRY_MS;
+        build(out, LINK_SWITCH, link->seq, link->target, link->target_flow, 0, 0);
+        return CUART_LINK_FRAME_SIZE;
+
+    case CUART_LINK_CHECKING:
+        // The responder's deadline, or the initiator's last CHECK, went unanswered
+        if (link->role == CUART_LINK_RESPONDER || link->tries >= CUART_LINK_TRIES) {
+            link->stats.check_failures++;
+            go_safe(link, now_ms, true);
+            return 0;
+        }
+        link->tries++;
+        link->next_ms = now_ms + CUART_LINK_RETRY_MS;
+        build(out, LINK_CHECK, link->seq, link->rate, link->flow, 0, 0);
+        return CUART_LINK_FRAME_SIZE;
+
+    case CUART_LINK_UP:
+        break;
+    }
+    return 0;
+}
+
+void cuart_link_report(cuart_link_t *link, bool good, uint32_t now_ms) {
+    if (good) {
+        link->verified = true;
+        link->junk = 0;
+        // A monitor that missed the CHECK learns from the traffic
+        if (link->role == CUART_LINK_MONITOR && link->state == CUART_LINK_CHECKING) {
+            link->state = CUART_LINK_UP;
+        }
+    }
+    if (link->rate == 0) {
+        return;
+    }
+
+    link->window++;
+    if (!good) {
+        link->errors++;
+    }
+    if (link->errors >= CUART_LINK_ERROR_LIMIT) {
+        fall_back(link, now_ms);
+    } else if (link->window >= CUART_LINK_ERROR_WINDOW) {
+        link->window = 0;
+        link->errors = 0;
+    }
+}
@@ -0,0 +1,246 @@
+#ifndef CUART_LINK_H
+#define CUART_LINK_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/*
+ * Link bring-up: both ends start at CUART_LINK_SAFE_BAUD without flow
+ * control, exchange the line rates and RTS/CTS support they have, and move
+ * to the fastest rate both support (and RTS/CTS if both have it wired). The
+ * sender is the initiator; the receiver answers on the return wire; the
+ * sniffer, which only sees the sender's line, follows as a monitor.
+ *
+ * Link frames, 10 bytes, outside the packet format:
+ *
+ *   [96 69][TYPE][SEQ][ARG 4][CRC-16/CCITT 2]
+ *
+ *   CAPS      ARG = [RATES 2][FLAGS][BOOT]  rates not known to fail (bit i =
+ *                                           CUART_LINK_RATES[i]), CUART_LINK_CAP_FLOW,
+ *                                           random ID drawn at cuart_link_init()
+ *   SWITCH    ARG = [RATE][FLOW][0][0]      initiator: move to this rate
+ *   ACK       ARG = as SWITCH               responder: switching now
+ *   CHECK     ARG = as SWITCH               sent at the new rate, echoed back
+ *   FALLBACK  ARG = [RATE][0][0][0]         this rate failed, back to the safe rate
+ *   ACKS      ARG = [CUM 2][SACK 2]         receiver: reliable delivery state
+ *                                           (cuart_arq.h), passed up in link->acks
+ *
+ *   initiator                               responder
+ *   CAPS every 100 ms  ------------------>
+ *                      <------------------  CAPS
+ *   SWITCH             ------------------>
+ *                      <------------------  ACK, then switch
+ *   switch, CHECK      ------------------>  (new rate)
+ *                      <------------------  CHECK: link up
+ *
+ * A rate whose CHECK is not echoed, or on which the error rate climbs
+ * (cuart_link_report()), is marked failed and the link falls back to the
+ * safe rate and negotiates again, skipping it. CAPS from a peer with a new
+ * BOOT ID clear the failed rates: the errors may have been its restart. The
+ * initiator answers CAPS from a responder it has not heard from, so the
+ * responder learns of its restart, and switches on the reply. An
+ * initiator that hears no CAPS within CUART_LINK_HELLO_TRIES sends at the
+ * safe rate, so a receiver without the return wire still gets data; it
+ * renegotiates if CAPS arrive later.
+ *
+ * The state machine does no I/O and takes the time as an argument. The
+ * caller feeds it received bytes (cuart_link_input()), sends what
+ * cuart_link_poll() returns at the current UART rate, waits for it to
+ * leave, and then applies cuart_link_baud() and link->flow if they changed.
+ * Link frames are scanned for in the same byte stream as packets; the CRC
+ * keeps packet bytes from passing for one. The sender writes them between
+ * packets only, so the bytes after a link frame start a packet: a caller
+ * that also parses packets hands its parser the bytes around link frames
+ * (cuart_link_scan() stops after each one) and drops a partial packet at one.
+ */
+
+// Rate both ends start at and fall back to
+#define CUART_LINK_SAFE_BAUD 115200
+
+// Bytes in a link frame
+#define CUART_LINK_FRAME_SIZE 10
+
+// CAPS flags
+#define CUART_LINK_CAP_FLOW 0x01
+
+// CAPS interval, and CAPS sent by the initiator before it gives up on a peer
+#define CUART_LINK_HELLO_MS 100
+#define CUART_LINK_HELLO_TRIES 20
+
+// SWITCH and CHECK retry interval and attempts, and the pause after a rate
+// change before the first CHECK (the peer may still be switching)
+#define CUART_LINK_RETRY_MS 50
+#define CUART_LINK_TRIES 4
+#define CUART_LINK_SETTLE_MS 10
+
+// Fall back when this many of CUART_LINK_ERROR_WINDOW packets fail
+#define CUART_LINK_ERROR_WINDOW 16
+#define CUART_LINK_ERROR_LIMIT 4
+
+// Fall back after this many bytes without a good packet or link frame: few
+// on a new rate or on the initiator's line (it only carries link frames),
+// about two packets once a rate has carried traffic
+#define CUART_LINK_JUNK_NEW 64
+#define CUART_LINK_JUNK_LIMIT 2400
+
+/**
+ * @brief Line rates, indexed by the bits of a rate mask
+ */
+extern const uint32_t CUART_LINK_RATES[];
+#define CUART_LINK_NUM_RATES 11
+
+typedef enum {
+    CUART_LINK_INITIATOR,       // sender: proposes the rate
+    CUART_LINK_RESPONDER,       // receiver: answers on the return wire
+    CUART_LINK_MONITOR          // sniffer: follows, never sends
+} cuart_link_role_t;
+
+typedef enum {
+    CUART_LINK_HELLO,           // at the safe rate, exchanging CAPS
+    CUART_LINK_SWITCHING,       // initiator: SWITCH sent, waiting for ACK
+    CUART_LINK_CHECKING,        // at the new rate, waiting for CHECK
+    CUART_LINK_UP               // data may flow
+} cuart_link_state_t;
+
+/**
+ * @brief Link counters
+ */
+typedef struct {
+    uint32_t frames;            // link frames received
+    uint32_t switches;          // rate changes made
+    uint32_t check_failures;    // rates abandoned because CHECK got no answer
+    uint32_t fallbacks;         // fallbacks on errors, junk or a peer's FALLBACK
+} cuart_link_stats_t;
+
+/**
+ * @brief Negotiation state for one end of a link
+ */
+typedef struct {
+    cuart_link_role_t role;
+    cuart_link_state_t state;
+    uint16_t local_rates;               // rates this end supports
+    bool local_flow;                    // this end has RTS/CTS wired
+    uint16_t peer_rates;
+    bool peer_flow;
+    bool have_peer;                     // CAPS received since the last fallback
+    bool known_peer;                    // peer_boot is valid
+    uint8_t boot;                       // our BOOT ID, and the peer's
+    uint8_t peer_boot;
+    uint16_t failed_rates;              // rates that failed, skipped until the peer restarts
+    uint8_t rate;                       // CUART_LINK_RATES index the UART should use
+    bool flow;                          // RTS/CTS the UART should use
+    uint8_t target;                     // rate being switched to
+    bool target_flow;
+    uint8_t seq;                        // current SWITCH attempt
+    uint8_t tries;
+    uint32_t next_ms;                   // next transmission or timeout
+    bool verified;                      // current rate carried a good frame
+    uint8_t window;                     // packets and failures in the error window
+    uint8_t errors;
+    uint32_t junk;                      // bytes since the last good frame
+    uint8_t out[CUART_LINK_FRAME_SIZE]; // reply waiting for cuart_link_poll()
+    bool out_pending;
+    uint8_t rx[CUART_LINK_FRAME_SIZE];  // link frame being scanned
+    size_t rx_len;
+    uint8_t acks[4];                    // latest ACKS received, for cuart_arq_tx_ack()
+    bool acks_new;                      // set when acks changes; the caller clears it
+    cuart_link_stats_t stats;
+} cuart_link_t;
+
+/**
+ * @brief Rate mask for every rate up to max_baud
+ *
+ * @param max_baud Fastest rate the UART and wiring can run
+ * @return Rate mask (always includes the safe rate)
+ */
+uint16_t cuart_link_rates_upto(uint32_t max_baud);
+
+/**
+ * @brief Start negotiating at the safe rate
+ *
+ * @param link Pointer to link state
+ * @param role Which end this is
+ * @param rates Rates this end supports (cuart_link_rates_upto())
+ * @param flow RTS/CTS is wired on this end
+ * @param now_ms Current time in milliseconds
+ */
+void cuart_link_init(cuart_link_t *link, cuart_link_role_t role, uint16_t rates, bool flow, uint32_t now_ms);
+
+/**
+ * @brief Scan received bytes up to the end of the next link frame and act on it
+ *
+ * A frame may have begun in earlier input: the link->rx_len bytes left over
+ * from the previous call, the last ones it was given. Those are all that
+ * may still turn out to be link frame bytes, so a caller can hand the rest
+ * of the input to its packet parser straight away.
+ *
+ * @param link Pointer to link state
+ * @param data Pointer to received bytes (packets included)
+ * @param len Number of bytes
+ * @param now_ms Current time in milliseconds
+ * @param consumed Set to the bytes scanned: through the frame's last byte if
+ *                 one was found, else len
+ * @return true if a link frame ended at data + *consumed
+ */
+bool cuart_link_scan(cuart_link_t *link, const uint8_t *data, size_t len, uint32_t now_ms, size_t *consumed);
+
+/**
+ * @brief Scan received bytes for link frames and act on them
+ *
+ * @param link Pointer to link state
+ * @param data Pointer to received bytes (packets included)
+ * @param len Number of bytes
+ * @param now_ms Current time in milliseconds
+ * @return Bytes of data through the end of the last link frame, 0 if none
+ *         ended in it: the bytes after it start a packet
+ */
+size_t cuart_link_input(cuart_link_t *link, const uint8_t *data, size_t len, uint32_t now_ms);
+
+/**
+ * @brief Run timers and get the next link frame to send
+ *
+ * Call every few milliseconds and after cuart_link_input(). Send the frame
+ * at the current UART settings, then apply cuart_link_baud() and link->flow.
+ *
+ * @param link Pointer to link state
+ * @param now_ms Current time in milliseconds
+ * @param out Pointer to CUART_LINK_FRAME_SIZE bytes
+ * @return CUART_LINK_FRAME_SIZE if a frame is to be sent, else 0
+ */
+size_t cuart_link_poll(cuart_link_t *link, uint32_t now_ms, uint8_t *out);
+
+/**
+ * @brief Build an ACKS frame carrying the receiver's reliable delivery state
+ *
+ * Sent by the caller as it is, at the current UART settings.
+ *
+ * @param out Pointer to CUART_LINK_FRAME_SIZE bytes
+ * @param state Pointer to CUART_ARQ_ACK_SIZE bytes (cuart_arq_rx_ack())
+ */
+void cuart_link_build_acks(uint8_t *out, const uint8_t *state);
+
+/**
+ * @brief Count a received packet towards the error rate
+ *
+ * @param link Pointer to link state
+ * @param good true if it verified, false for a MAC failure or bad length
+ * @param now_ms Current time in milliseconds
+ */
+void cuart_link_report(cuart_link_t *link, bool good, uint32_t now_ms);
+
+/**
+ * @brief Line rate the UART should run at now
+ */
+static inline uint32_t cuart_link_baud(const cuart_link_t *link) {
+    return CUART_LINK_RATES[link->rate];
+}
+
+/**
+ * @brief Check whether data may be sent
+ */
+static inline bool cuart_link_up(const cuart_link_t *link) {
+    return link->state == CUART_LINK_UP;
+}
+
+#endif // CUART_LINK_H
@@ -0,0 +1,191 @@
+#include <string.h>
+#include "cuart_parser.h"
+
+// Bytes before the body: sync header (if any), NONCE and LEN
+static size_t header_size(const cuart_parser_t *parser) {
+    return (parser->sync ? CUART_FRAME_SYNC_SIZE : 0) + parser->nonce_len + 2;
+}
+
+// Move the candidate frame to the start of the buffer
+static void compact(cuart_parser_t *parser) {
+    if (parser->start > 0) {
+        memmove(parser->buf, parser->buf + parser->start, parser->fill - parser->start);
+        parser->fill -= parser->start;
+        parser->start = 0;
+    }
+}
+
+// Discard buffered bytes up to the next sync word (or a trailing SYNC0)
+static void hunt(cuart_parser_t *parser) {
+    size_t i = 0;
+
+    while (i < parser->fill) {
+        const uint8_t *p = memchr(parser->buf + i, CUART_FRAME_SYNC0, parser->fill - i);
+
+        if (p == NULL) {
+            i = parser->fill;
+            break;
+        }
+        i = (size_t)(p - parser->buf);
+        if (i + 1 == parser->fill || parser->buf[i + 1] == CUART_FRAME_SYNC1) {
+            break;
+        }
+        i++;
+    }
+
+    parser->skipped += (uint32_t)i;
+    parser->start = i;
+    compact(parser);
+}
+
+void cuart_parser_init(cuart_parser_t *parser, size_t nonce_len, size_t mac_len, bool sync) {
+    memset(parser, 0, offsetof(cuart_parser_t, buf));
+    parser->nonce_len = nonce_len;
+    parser->mac_len = mac_len;
+    parser->sync = sync;
+}
+
+// Run the state machine over the buffered bytes; on CUART_PARSE_MORE, *need
+// is the number of bytes to append before anything can change
+static cuart_parse_result_t advance(cuart_parser_t *parser, size_t *need) {
+    size_t hdr = header_size(parser);
+
+    if (parser->done) {
+        parser->start += parser->frame_len;
+        parser->frame_len = 0;
+        parser->done = false;
+    }
+
+    while (1) {
+        compact(parser);
+
+        if (parser->frame_len == 0) {
+            if (parser->sync) {
+                hunt(parser);
+            }
+
+            // Header incomplete: ask only for what is missing
+            if (parser->fill < hdr) {
+                *need = hdr - parser->fill;
+                return CUART_PARSE_MORE;
+            }
+
+            const uint8_t *header = parser->buf + hdr - parser->nonce_len - 2;
+            size_t length = (((size_t)header[parser->nonce_len] << 8) | header[parser->nonce_len + 1]) &
+                            CUART_FRAME_LEN_MASK;
+            bool length_ok = length > 0 && length <= CUART_FRAME_MAX_PAYLOAD;
+
+            if (parser->sync) {
+                // False sync or damaged header: resume the hunt one byte later
+                if (!length_ok || cuart_frame_header_crc(header, parser->nonce_len + 2) != parser->buf[2]) {
+                    parser->bad_headers++;
+                    parser->skipped++;
+                    parser->start = 1;
+                    continue;
+                }
+            } else if (!length_ok) {
+                parser->bad_lengths++;
+                parser->start = hdr;
+                return CUART_PARSE_BAD_LENGTH;
+            }
+            parser->frame_len = hdr + length + parser->mac_len;
+        }
+
+        if (parser->fill < parser->frame_len) {
+            *need = parser->frame_len - parser->fill;
+            return CUART_PARSE_MORE;
+        }
+
+        parser->done = true;
+        parser->frames++;
+        return CUART_PARSE_FRAME;
+    }
+}
+
+cuart_parse_result_t cuart_parser_feed(cuart_parser_t *parser, const uint8_t *data,
+                                       size_t len, size_t *consumed) {
+    size_t used = 0;
+
+    while (1) {
+        size_t need;
+        cuart_parse_result_t result = advance(parser, &need);
+
+        if (result != CUART_PARSE_MORE || used == len) {
+            *consumed = used;
+            return result;
+        }
+
+        // Never take bytes beyond the end of the current frame
+        if (need > len - used) {
+            need = len - used;
+        }
+        memcpy(parser->buf + parser->fill, data + used, need);
+        parser->fill += need;
+        used += need;
+    }
+}
+
+cuart_parse_result_t cuart_parser_poll(cuart_parser_t *parser, uint8_t **dst, size_t *want) {
+    cuart_parse_result_t result = advance(parser, want);
+
+    if (result == CUART_PARSE_MORE) {
+        *dst = parser->buf + parser->fill;
+    }
+    return result;
+}
+
+void cuart_parser_commit(cuart_parser_t *parser, size_t n) {
+    parser->fill += n;
+}
+
+void cuart_parser_view(cuart_parser_t *parser, cuart_frame_view_t *view) {
+    uint8_t *frame = parser->buf + parser->start + (parser->sync ? CUART_FRAME_SYNC_SIZE : 0);
+
+    view->nonce = frame;
+    view->nonce_len = parser->nonce_len;
+    view->length_bytes = frame + parser->nonce_len;
+    view->body = frame + parser->nonce_len + 2;
+    view->length = parser->frame_len - header_size(parser) - parser->mac_len;
+    view->flags = (uint16_t)(((view->length_bytes[0] << 8) | view->length_bytes[1]) & ~CUART_FRAME_LEN_MASK);
+    view->mac = view->body + view->length;
+    view->mac_len = parser->mac_len;
+}
+
+size_t cuart_parser_trailing(const cuart_parser_t *parser) {
+    return parser->fill - parser->start - parser->frame_len;
+}
+
+void cuart_parser_resync(cuart_parser_t *parser) {
+    if (!parser->sync || !parser->done) {
+        return;
+    }
+
+    // Keep everything after the sync word's first byte for the next hunt
+    parser->resyncs++;
+    parser->skipped++;
+    parser->start += 1;
+    parser->frame_len = 0;
+    parser->done = false;
+}
+
+bool cuart_parser_busy(const cuart_parser_t *parser) {
+    return parser->fill > parser->start + (parser->done ? parser->frame_len : 0);
+}
+
+void cuart_parser_reset(cuart_parser_t *parser) {
+    if (cuart_parser_busy(parser)) {
+        parser->timeouts++;
+    }
+    parser->start = 0;
+    parser->fill = 0;
+    parser->frame_len = 0;
+    parser->done = false;
+}
+
+void cuart_parser_restart(cuart_parser_t *parser, size_t keep) {
+    size_t from = parser->fill - keep;
+
+    cuart_parser_reset(parser);
+    memmove(parser->buf, parser->buf + from, keep);
+    parser->fill = keep;
+}
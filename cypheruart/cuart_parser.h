@@ -0,0 +1,180 @@
+#ifndef CUART_PARSER_H
+#define CUART_PARSER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "cuart_frame.h"
+
+/*
+ * Incremental packet parser: [NONCE][LEN 2][BODY LEN][MAC], optionally
+ * preceded by the sync header (see cuart_frame.h)
+ *
+ * Bytes are fed in whatever pieces the transport delivers (a UART event, a
+ * read() from a tty or a file) and assembled into one contiguous frame. The
+ * parser never waits or sleeps; it reports a complete frame as soon as its
+ * last MAC byte arrives, and the caller decides what to do about silence in
+ * the middle of a frame (see cuart_parser_busy()).
+ *
+ * With sync framing the parser hunts for the sync word and checks the header
+ * CRC before trusting LEN. A bad header drops only the sync word it started
+ * at and the scan resumes one byte later, in the bytes already buffered. A
+ * frame whose MAC fails can be rescanned the same way with
+ * cuart_parser_resync(), so a packet that lost a byte costs that packet and
+ * not the ones after it.
+ *
+ * Feeding loop:
+ *
+ *     do {
+ *         result = cuart_parser_feed(&parser, data, len, &used);
+ *         data += used;
+ *         len -= used;
+ *         if (result == CUART_PARSE_FRAME) { ... }
+ *     } while (len > 0 || result == CUART_PARSE_FRAME);
+ *
+ * (keep feeding after a frame even with no input left: a rescan may have
+ * another frame buffered).
+ *
+ * A transport that can write into caller memory (the ESP32 UART driver's
+ * uart_read_bytes()) skips the intermediate copy: cuart_parser_poll() points
+ * at where the next bytes belong in the frame buffer and how many the current
+ * field still needs, the transport reads straight there and
+ * cuart_parser_commit() accounts for them. Payload bytes then land once, in
+ * place, where cuart_frame_open() verifies and decrypts them.
+ */
+
+// Result of feeding bytes
+typedef enum {
+    CUART_PARSE_MORE,           // all bytes consumed, frame not complete
+    CUART_PARSE_FRAME,          // frame complete, see cuart_parser_view()
+    CUART_PARSE_BAD_LENGTH      // LEN was 0 or too large; frame dropped (no sync framing)
+} cuart_parse_result_t;
+
+/**
+ * @brief Parser state and frame buffer (about 1.1 KB: keep it static)
+ */
+typedef struct {
+    size_t nonce_len;
+    size_t mac_len;
+    bool sync;                  // frames carry the sync header
+    size_t start;               // offset of the candidate frame in buf
+    size_t fill;                // bytes in buf
+    size_t frame_len;           // length of the candidate frame once its header checked out, else 0
+    bool done;                  // frame at start was reported; dropped on the next feed
+    uint32_t frames;            // complete frames
+    uint32_t bad_lengths;       // frames dropped for an invalid LEN (no sync framing)
+    uint32_t bad_headers;       // sync words rejected by the header CRC or LEN
+    uint32_t resyncs;           // frames rescanned after failing verification
+    uint32_t timeouts;          // partial frames dropped by cuart_parser_reset()
+    uint32_t skipped;           // bytes discarded while hunting for a sync word
+    uint8_t buf[CUART_FRAME_SYNC_SIZE + CUART_FRAME_MAX];
+} cuart_parser_t;
+
+/**
+ * @brief Initialize a parser for one packet layout
+ *
+ * @param parser Pointer to parser
+ * @param nonce_len Length of the NONCE field (16, 12 or 4)
+ * @param mac_len Length of the MAC field (see cuart_frame_mac_size())
+ * @param sync true if packets carry the sync header
+ */
+void cuart_parser_init(cuart_parser_t *parser, size_t nonce_len, size_t mac_len, bool sync);
+
+/**
+ * @brief Feed received bytes
+ *
+ * Takes bytes up to the end of the current frame only. Call again with the
+ * remaining bytes until everything is consumed, and once more after every
+ * CUART_PARSE_FRAME.
+ *
+ * @param parser Pointer to parser
+ * @param data Pointer to received bytes
+ * @param len Number of bytes (may be 0)
+ * @param consumed Set to the number of bytes used
+ * @return CUART_PARSE_FRAME when a frame completed
+ */
+cuart_parse_result_t cuart_parser_feed(cuart_parser_t *parser, const uint8_t *data,
+                                       size_t len, size_t *consumed);
+
+/**
+ * @brief Ask where the next received bytes go
+ *
+ * Processes what is buffered first, so it may report a frame (or a bad
+ * length) without new input; otherwise returns CUART_PARSE_MORE with *dst
+ * and *want set. Read at most *want bytes to *dst, then call
+ * cuart_parser_commit().
+ *
+ * @param parser Pointer to parser
+ * @param dst Set to the write position in the frame buffer
+ * @param want Set to the number of bytes the current field still needs
+ * @return CUART_PARSE_FRAME when a frame completed
+ */
+cuart_parse_result_t cuart_parser_poll(cuart_parser_t *parser, uint8_t **dst, size_t *want);
+
+/**
+ * @brief Account for bytes written to the position given by cuart_parser_poll()
+ *
+ * @param parser Pointer to parser
+ * @param n Number of bytes written (at most *want)
+ */
+void cuart_parser_commit(cuart_parser_t *parser, size_t n);
+
+/**
+ * @brief Fields of the frame just completed
+ *
+ * Valid until the next cuart_parser_feed(). The body may be decrypted in place.
+ *
+ * @param parser Pointer to parser that returned CUART_PARSE_FRAME
+ * @param view Pointer to view to fill
+ */
+void cuart_parser_view(cuart_parser_t *parser, cuart_frame_view_t *view);
+
+/**
+ * @brief Bytes fed after the last byte of the frame just completed
+ *
+ * 0 unless the frame was found by a rescan (cuart_parser_resync()) in bytes
+ * buffered further on. With the bytes consumed so far, this places the
+ * frame in the input stream (the capture index records where each ended).
+ *
+ * @param parser Pointer to parser that returned CUART_PARSE_FRAME
+ * @return Bytes buffered beyond the frame
+ */
+size_t cuart_parser_trailing(const cuart_parser_t *parser);
+
+/**
+ * @brief Rescan the frame just reported, which failed verification
+ *
+ * With sync framing, the bytes after its sync word are searched for the next
+ * one (a dropped byte makes a frame swallow the start of the next). Without
+ * sync framing the frame is simply dropped.
+ *
+ * @param parser Pointer to parser that returned CUART_PARSE_FRAME
+ */
+void cuart_parser_resync(cuart_parser_t *parser);
+
+/**
+ * @brief Whether part of a frame has been received
+ *
+ * @param parser Pointer to parser
+ * @return true between the first byte of a frame and its last
+ */
+bool cuart_parser_busy(const cuart_parser_t *parser);
+
+/**
+ * @brief Drop a partial frame (line went idle mid-frame, input overflowed)
+ *
+ * @param parser Pointer to parser
+ */
+void cuart_parser_reset(cuart_parser_t *parser);
+
+/**
+ * @brief Drop everything buffered but the last bytes received, which start
+ *        a new frame (a link frame ended before them, see cuart_link_input())
+ *
+ * @param parser Pointer to parser
+ * @param keep Number of bytes to keep (at most those committed by the last
+ *             cuart_parser_commit())
+ */
+void cuart_parser_restart(cuart_parser_t *parser, size_t keep);
+
+#endif // CUART_PARSER_H
@@ -0,0 +1,163 @@
+#include "cuart_pool.h"
+
+// Free-list heads pack a 16-bit ABA tag above a 16-bit frame index
+#define POOL_NIL 0xffffu
+#define POOL_INDEX(head) ((uint16_t)((head) & 0xffffu))
+#define POOL_HEAD(head, index) ((((head) + 0x10000u) & 0xffff0000u) | (index))
+
+_Static_assert(CUART_POOL_SMALL_FRAMES > 0 && CUART_POOL_SMALL_FRAMES < POOL_NIL, "small frame count out of range");
+_Static_assert(CUART_POOL_LARGE_FRAMES > 0 && CUART_POOL_LARGE_FRAMES < POOL_NIL, "large frame count out of range");
+_Static_assert(CUART_POOL_SMALL_PAYLOAD <= CUART_FRAME_MAX_PAYLOAD, "small class larger than the large one");
+
+// One size class: its frames, free list and counters
+typedef struct {
+    cuart_pool_frame_t *frames;
+    uint8_t *blocks;
+    uint16_t count;
+    uint16_t block_size;
+    _Atomic uint32_t head;
+    _Atomic uint32_t in_use;
+    _Atomic uint32_t high_water;
+    _Atomic uint32_t allocs;
+    _Atomic uint32_t exhausted;
+} pool_class_t;
+
+static uint8_t small_blocks[CUART_POOL_SMALL_FRAMES * CUART_POOL_SMALL_BLOCK];
+static uint8_t large_blocks[CUART_POOL_LARGE_FRAMES * CUART_POOL_LARGE_BLOCK];
+static cuart_pool_frame_t small_frames[CUART_POOL_SMALL_FRAMES];
+static cuart_pool_frame_t large_frames[CUART_POOL_LARGE_FRAMES];
+
+static pool_class_t classes[CUART_POOL_CLASSES] = {
+    { .frames = small_frames, .blocks = small_blocks,
+      .count = CUART_POOL_SMALL_FRAMES, .block_size = CUART_POOL_SMALL_BLOCK },
+    { .frames = large_frames, .blocks = large_blocks,
+      .count = CUART_POOL_LARGE_FRAMES, .block_size = CUART_POOL_LARGE_BLOCK },
+};
+
+static _Atomic uint32_t failures;
+static _Atomic uint32_t too_large;
+
+static cuart_pool_frame_t *pop(pool_class_t *cls) {
+    uint32_t head = atomic_load_explicit(&cls->head, memory_order_acquire);
+
+    while (POOL_INDEX(head) != POOL_NIL) {
+        cuart_pool_frame_t *frame = &cls->frames[POOL_INDEX(head)];
+        uint32_t next = POOL_HEAD(head, atomic_load_explicit(&frame->next, memory_order_relaxed));
+
+        // A stale next is harmless: the tag makes the swap fail if head moved
+        if (atomic_compare_exchange_weak_explicit(&cls->head, &head, next,
+                                                  memory_order_acquire, memory_order_acquire)) {
+            return frame;
+        }
+    }
+    return NULL;
+}
+
+static void push(pool_class_t *cls, cuart_pool_frame_t *frame) {
+    uint32_t head = atomic_load_explicit(&cls->head, memory_order_relaxed);
+    uint32_t next;
+
+    do {
+        atomic_store_explicit(&frame->next, POOL_INDEX(head), memory_order_relaxed);
+        next = POOL_HEAD(head, frame->index);
+    } while (!atomic_compare_exchange_weak_explicit(&cls->head, &head, next,
+                                                    memory_order_release, memory_order_relaxed));
+}
+
+static void note_in_use(pool_class_t *cls, uint32_t in_use) {
+    uint32_t high = atomic_load_explicit(&cls->high_water, memory_order_relaxed);
+
+    while (in_use > high &&
+           !atomic_compare_exchange_weak_explicit(&cls->high_water, &high, in_use,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+
+void cuart_pool_init(void) {
+    for (int c = 0; c < CUART_POOL_CLASSES; c++) {
+        pool_class_t *cls = &classes[c];
+
+        for (uint16_t i = 0; i < cls->count; i++) {
+            cuart_pool_frame_t *frame = &cls->frames[i];
+            uint16_t next = (i + 1 < cls->count) ? (uint16_t)(i + 1) : (uint16_t)POOL_NIL;
+
+            frame->data = cls->blocks + (size_t)i * cls->block_size;
+            frame->capacity = cls->block_size;
+            frame->len = 0;
+            frame->size_class = (uint8_t)c;
+            frame->index = i;
+            atomic_init(&frame->next, next);
+        }
+        atomic_init(&cls->head, 0);
+        atomic_init(&cls->in_use, 0);
+        atomic_init(&cls->high_water, 0);
+        atomic_init(&cls->allocs, 0);
+        atomic_init(&cls->exhausted, 0);
+    }
+    atomic_init(&failures, 0);
+    atomic_init(&too_large, 0);
+}
+
+cuart_pool_frame_t *cuart_pool_alloc(size_t length) {
+    size_t need = CUART_POOL_BLOCK_FOR(length);
+
+    if (length > CUART_FRAME_MAX_PAYLOAD) {
+        atomic_fetch_add_explicit(&too_large, 1, memory_order_relaxed);
+        return NULL;
+    }
+
+    for (int c = 0; c < CUART_POOL_CLASSES; c++) {
+        pool_class_t *cls = &classes[c];
+        cuart_pool_frame_t *frame;
+        uint32_t in_use;
+
+        if (cls->block_size < need) {
+            continue;
+        }
+
+        // Count the frame before taking it: another task may free it as soon
+        // as it is handed over, and in_use must not wrap below zero
+        in_use = atomic_fetch_add_explicit(&cls->in_use, 1, memory_order_relaxed) + 1;
+        frame = pop(cls);
+        if (frame == NULL) {
+            atomic_fetch_sub_explicit(&cls->in_use, 1, memory_order_relaxed);
+            atomic_fetch_add_explicit(&cls->exhausted, 1, memory_order_relaxed);
+            continue;
+        }
+        // Racing allocations that came up empty may have inflated the count
+        note_in_use(cls, in_use < cls->count ? in_use : cls->count);
+        atomic_fetch_add_explicit(&cls->allocs, 1, memory_order_relaxed);
+        frame->len = 0;
+        return frame;
+    }
+
+    atomic_fetch_add_explicit(&failures, 1, memory_order_relaxed);
+    return NULL;
+}
+
+void cuart_pool_free(cuart_pool_frame_t *frame) {
+    pool_class_t *cls;
+
+    if (frame == NULL) {
+        return;
+    }
+    cls = &classes[frame->size_class];
+    push(cls, frame);
+    atomic_fetch_sub_explicit(&cls->in_use, 1, memory_order_relaxed);
+}
+
+void cuart_pool_stats(cuart_pool_stats_t *stats) {
+    for (int c = 0; c < CUART_POOL_CLASSES; c++) {
+        pool_class_t *cls = &classes[c];
+        cuart_pool_class_stats_t *out = &stats->classes[c];
+
+        out->frames = cls->count;
+        out->block_size = cls->block_size;
+        out->in_use = atomic_load_explicit(&cls->in_use, memory_order_relaxed);
+        out->high_water = atomic_load_explicit(&cls->high_water, memory_order_relaxed);
+        out->allocs = atomic_load_explicit(&cls->allocs, memory_order_relaxed);
+        out->exhausted = atomic_load_explicit(&cls->exhausted, memory_order_relaxed);
+    }
+    stats->failures = atomic_load_explicit(&failures, memory_order_relaxed);
+    stats->too_large = atomic_load_explicit(&too_large, memory_order_relaxed);
+}
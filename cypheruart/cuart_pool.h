@@ -0,0 +1,134 @@
+#ifndef CUART_POOL_H
+#define CUART_POOL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include "cuart_frame.h"
+
+/*
+ * Fixed-block frame pool: statically allocated frame buffers in two size
+ * classes, so tasks can hand packets to each other by pointer with a
+ * bounded memory budget and no heap.
+ *
+ *   small  room for a packet of up to CUART_POOL_SMALL_PAYLOAD bytes
+ *   large  room for the largest packet (CUART_FRAME_MAX)
+ *
+ * Each block has room for the sync header in front of the packet, so a frame
+ * is written to the UART in one call whether or not sync framing is on:
+ *
+ *   data: [SYNC HEADER 3][NONCE][LEN 2][BODY][MAC]
+ *                        ^ cuart_pool_packet()
+ *
+ * Block counts are fixed at build time (CONFIG_CUART_POOL_SMALL_FRAMES and
+ * CONFIG_CUART_POOL_LARGE_FRAMES under ESP-IDF; override the defaults below
+ * with -D on the host). Allocation takes the smallest class that fits and
+ * falls back to a larger one when it is empty.
+ *
+ * Alloc and free are lock-free (a tagged free-list head per class, updated
+ * with compare-and-swap), so any task, on either core, can allocate and any
+ * other can free. They never block; an empty pool returns NULL and is
+ * counted, and the caller decides whether to wait, drop or retry.
+ */
+
+#ifndef CUART_POOL_SMALL_PAYLOAD
+#define CUART_POOL_SMALL_PAYLOAD 64
+#endif
+
+#ifndef CUART_POOL_SMALL_FRAMES
+#define CUART_POOL_SMALL_FRAMES 8
+#endif
+
+#ifndef CUART_POOL_LARGE_FRAMES
+#define CUART_POOL_LARGE_FRAMES 2
+#endif
+
+// Bytes needed for a packet carrying length payload bytes (worst-case nonce and MAC, sync header)
+#define CUART_POOL_BLOCK_FOR(length) (CUART_FRAME_SYNC_SIZE + CUART_FRAME_MAX_NONCE + 2 + (length) + HMAC_SIZE)
+
+// Block sizes, rounded up to whole words
+#define CUART_POOL_SMALL_BLOCK ((CUART_POOL_BLOCK_FOR(CUART_POOL_SMALL_PAYLOAD) + 3u) & ~3u)
+#define CUART_POOL_LARGE_BLOCK ((CUART_POOL_BLOCK_FOR(CUART_FRAME_MAX_PAYLOAD) + 3u) & ~3u)
+
+// Size classes, smallest first
+typedef enum {
+    CUART_POOL_SMALL,
+    CUART_POOL_LARGE,
+    CUART_POOL_CLASSES
+} cuart_pool_class_t;
+
+/**
+ * @brief A frame buffer from the pool
+ */
+typedef struct {
+    uint8_t *data;              // CUART_FRAME_SYNC_SIZE bytes of headroom, then the packet
+    uint16_t capacity;          // bytes at data
+    uint16_t len;               // packet length, set by the user
+    uint8_t size_class;         // cuart_pool_class_t
+    uint16_t index;             // slot within its class
+    _Atomic uint16_t next;      // free-list link
+} cuart_pool_frame_t;
+
+/**
+ * @brief Counters for one size class
+ */
+typedef struct {
+    uint32_t frames;            // blocks in the class
+    uint32_t block_size;        // bytes per block
+    uint32_t in_use;            // blocks allocated now (may briefly count an allocation in progress)
+    uint32_t high_water;        // most blocks ever allocated at once
+    uint32_t allocs;            // successful allocations from this class
+    uint32_t exhausted;         // allocations that found this class empty
+} cuart_pool_class_stats_t;
+
+/**
+ * @brief Pool counters
+ */
+typedef struct {
+    cuart_pool_class_stats_t classes[CUART_POOL_CLASSES];
+    uint32_t failures;          // allocations that found every fitting class empty
+    uint32_t too_large;         // requests above CUART_FRAME_MAX_PAYLOAD
+} cuart_pool_stats_t;
+
+/**
+ * @brief Put every block on its free list and clear the counters
+ *
+ * Call once before any task uses the pool; not thread-safe.
+ */
+void cuart_pool_init(void);
+
+/**
+ * @brief Take a frame with room for a packet carrying length payload bytes
+ *
+ * @param length Payload length (at most CUART_FRAME_MAX_PAYLOAD)
+ * @return Frame, or NULL if every class that fits is empty
+ */
+cuart_pool_frame_t *cuart_pool_alloc(size_t length);
+
+/**
+ * @brief Return a frame to its class
+ *
+ * @param frame Frame from cuart_pool_alloc() (NULL is ignored)
+ */
+void cuart_pool_free(cuart_pool_frame_t *frame);
+
+/**
+ * @brief Start of the packet within a frame (after the sync header headroom)
+ *
+ * @param frame Pointer to frame
+ * @return Pointer to where cuart_frame_seal() builds the packet
+ */
+static inline uint8_t *cuart_pool_packet(cuart_pool_frame_t *frame) {
+    return frame->data + CUART_FRAME_SYNC_SIZE;
+}
+
+/**
+ * @brief Snapshot the counters
+ *
+ * Each counter is read atomically; the snapshot as a whole is not.
+ *
+ * @param stats Pointer to output
+ */
+void cuart_pool_stats(cuart_pool_stats_t *stats);
+
+#endif // CUART_POOL_H
@@ -0,0 +1,86 @@
+#ifndef CUART_PORT_H
+#define CUART_PORT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Platform port for libcypheruart.
+ *
+ * aes_wrapper.c never touches ESP-IDF or libc entropy APIs directly; it calls
+ * the functions below instead. Exactly one port is linked into a build:
+ *   - port_esp.c  : ESP-IDF (hardware RNG + NVS epoch + mbedtls SHA-256, SHA peripheral)
+ *   - port_host.c : Linux/POSIX host (getrandom + clock epoch + portable SHA-256)
+ * A new target provides the RNG, the session epoch counter and the
+ * streaming SHA-256 below; HMAC is built on top of it in aes_wrapper.c.
+ */
+
+#if defined(ESP_PLATFORM)
+#include "mbedtls/sha256.h"
+typedef mbedtls_sha256_context cuart_sha256_ctx_t;
+#else
+#include "sha256.h"
+typedef sha256_ctx cuart_sha256_ctx_t;
+#endif
+
+/**
+ * @brief Fill a buffer with cryptographically secure random bytes
+ *
+ * @param buf Pointer to output buffer
+ * @param len Number of bytes to generate
+ */
+void cuart_port_random(uint8_t *buf, size_t len);
+
+/**
+ * @brief Advance and return the session epoch counter
+ *
+ * Larger on every call, and across restarts: the receiver refuses a session
+ * whose epoch is not newer than the last (see cuart_session.h). The ESP-IDF
+ * port keeps it in NVS; the host port counts up from the clock.
+ *
+ * @return Next epoch (never 0)
+ */
+uint32_t cuart_port_next_epoch(void);
+
+/**
+ * @brief Start a SHA-256 computation
+ *
+ * @param ctx Pointer to context to initialize
+ */
+void cuart_port_sha256_init(cuart_sha256_ctx_t *ctx);
+
+/**
+ * @brief Feed data into a SHA-256 computation
+ *
+ * @param ctx Pointer to context started with cuart_port_sha256_init()
+ * @param data Pointer to data
+ * @param len Length of data
+ */
+void cuart_port_sha256_update(cuart_sha256_ctx_t *ctx, const uint8_t *data, size_t len);
+
+/**
+ * @brief Copy the state of a running SHA-256 computation
+ *
+ * Used to resume from precomputed HMAC key pads without rehashing them.
+ *
+ * @param dst Pointer to destination context (need not be initialized)
+ * @param src Pointer to source context
+ */
+void cuart_port_sha256_clone(cuart_sha256_ctx_t *dst, const cuart_sha256_ctx_t *src);
+
+/**
+ * @brief Release a SHA-256 context without finishing it
+ *
+ * @param ctx Pointer to context
+ */
+void cuart_port_sha256_free(cuart_sha256_ctx_t *ctx);
+
+/**
+ * @brief Finish a SHA-256 computation and release the context
+ *
+ * @param ctx Pointer to context
+ * @param digest Pointer to 32-byte buffer for digest output
+ */
+void cuart_port_sha256_final(cuart_sha256_ctx_t *ctx, uint8_t *digest);
+
+#endif // CUART_PORT_H
@@ -0,0 +1,107 @@
+#include <string.h>
+#include "cuart_session.h"
+#include "cuart_port.h"
+
+void cuart_session_tx_init(cuart_session_tx_t *tx) {
+    cuart_port_random(tx->salt, CUART_SESSION_SALT_SIZE);
+    tx->epoch = cuart_port_next_epoch();
+    tx->seq = CUART_SESSION_ANNOUNCE_SEQ;
+}
+
+uint32_t cuart_session_next_seq(cuart_session_tx_t *tx, bool *renewed) {
+    bool wrapped = (tx->seq == UINT32_MAX);
+
+    // Never reuse salt || seq: start a new session instead of wrapping
+    if (wrapped) {
+        cuart_session_tx_init(tx);
+    }
+    if (renewed != NULL) {
+        *renewed = wrapped;
+    }
+    return ++tx->seq;
+}
+
+void cuart_session_put_seq(uint32_t seq, uint8_t *out) {
+    out[0] = (uint8_t)(seq >> 24);
+    out[1] = (uint8_t)(seq >> 16);
+    out[2] = (uint8_t)(seq >> 8);
+    out[3] = (uint8_t)seq;
+}
+
+uint32_t cuart_session_get_seq(const uint8_t *in) {
+    return ((uint32_t)in[0] << 24) | ((uint32_t)in[1] << 16) |
+           ((uint32_t)in[2] << 8) | (uint32_t)in[3];
+}
+
+void cuart_session_put_announce(const cuart_session_tx_t *tx, uint8_t *out) {
+    memcpy(out, tx->salt, CUART_SESSION_SALT_SIZE);
+    cuart_session_put_seq(tx->epoch, out + CUART_SESSION_SALT_SIZE);
+}
+
+void cuart_session_iv(const uint8_t *salt, uint32_t seq, uint8_t *iv) {
+    memcpy(iv, salt, CUART_SESSION_SALT_SIZE);
+    cuart_session_put_seq(seq, iv + CUART_SESSION_SALT_SIZE);
+    memset(iv + CUART_SESSION_SALT_SIZE + CUART_SESSION_SEQ_SIZE, 0, 4);
+}
+
+void cuart_session_rx_init(cuart_session_rx_t *rx) {
+    memset(rx, 0, sizeof(*rx));
+}
+
+void cuart_session_rx_resume(cuart_session_rx_t *rx, uint32_t epoch) {
+    cuart_session_rx_init(rx);
+    rx->epoch = epoch;
+}
+
+cuart_session_announce_t cuart_session_rx_announce(cuart_session_rx_t *rx, const uint8_t *announce) {
+    uint32_t epoch = cuart_session_get_seq(announce + CUART_SESSION_SALT_SIZE);
+
+    if (rx->have_salt) {
+        if (epoch == rx->epoch && memcmp(rx->salt, announce, CUART_SESSION_SALT_SIZE) == 0) {
+            return CUART_SESSION_REPEAT;
+        }
+        // Sessions only move forward: an older one is never reinstated, and
+        // the current one keeps its window
+        if (epoch <= rx->epoch) {
+            return CUART_SESSION_STALE;
+        }
+    } else if (epoch < rx->epoch) {
+        return CUART_SESSION_STALE;
+    }
+
+    memcpy(rx->salt, announce, CUART_SESSION_SALT_SIZE);
+    rx->have_salt = true;
+    rx->epoch = epoch;
+    rx->top = CUART_SESSION_ANNOUNCE_SEQ;
+    rx->window = 0;
+    return CUART_SESSION_NEW;
+}
+
+bool cuart_session_rx_check(const cuart_session_rx_t *rx, uint32_t seq) {
+    uint32_t age;
+
+    if (!rx->have_salt || seq == CUART_SESSION_ANNOUNCE_SEQ) {
+        return false;
+    }
+    if (seq > rx->top) {
+        return true;
+    }
+
+    age = rx->top - seq;
+    if (age >= CUART_REPLAY_WINDOW) {
+        return false;
+    }
+    return (rx->window & ((uint64_t)1 << age)) == 0;
+}
+
+void cuart_session_rx_accept(cuart_session_rx_t *rx, uint32_t seq) {
+    if (seq > rx->top) {
+        uint32_t shift = seq - rx->top;
+
+        rx->window = (shift >= CUART_REPLAY_WINDOW) ? 0 : rx->window << shift;
+        rx->window |= 1;
+        rx->top = seq;
+    } else {
+        rx->window |= (uint64_t)1 << (rx->top - seq);
+    }
+}
@@ -0,0 +1,195 @@
+#ifndef CUART_SESSION_H
+#define CUART_SESSION_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+/*
+ * Session nonces: instead of a fresh random nonce per packet, the sender
+ * draws one random salt per session and numbers its packets. Only the 4-byte
+ * sequence number goes on the wire; both ends derive the IV as
+ *
+ *     salt (8) || seq (4, big-endian) || 0x00000000
+ *
+ * The first 12 bytes are the AES-GCM nonce; the full 16 bytes are the initial
+ * AES-CTR counter block (the low word counts blocks and cannot wrap for
+ * UART-sized packets). A packet is authenticated over the IV, so a packet
+ * from another session fails verification.
+ *
+ * Sequence number 0 is reserved for the salt announcement: a packet whose
+ * payload is the plaintext salt and the session's epoch,
+ *
+ *     salt (8) || epoch (4, big-endian)
+ *
+ * authenticated under IV = salt || 0 || 0. The epoch comes from a counter
+ * that only goes up, across restarts (cuart_port_next_epoch(): NVS on the
+ * ESP32), so every session has a larger one than the last. The sender
+ * announces at startup and periodically, so a receiver that restarts picks
+ * the session up again (the link is one-way, there is no request channel).
+ *
+ * The receiver keeps a sliding window of the last CUART_REPLAY_WINDOW
+ * sequence numbers and drops duplicates and packets older than the window.
+ * It takes a salt only from a newer epoch than the session it has: a
+ * replayed announcement of an earlier session is refused, so that session's
+ * packets keep failing verification under the current salt, and the current
+ * session's window is never reset. Only the sender can start a session the
+ * receiver will switch to.
+ *
+ * A receiver that restarts should resume from the newest epoch it accepted
+ * (cuart_session_rx_resume(), the firmware keeps it in NVS) so that it does
+ * not take an older session either. It then accepts the current session's
+ * announcement again with an empty window: packets of that session sent
+ * before the restart can be replayed until the first one after it arrives.
+ */
+
+// Salt size in bytes
+#define CUART_SESSION_SALT_SIZE 8
+
+// Sequence number size on the wire in bytes
+#define CUART_SESSION_SEQ_SIZE 4
+
+// Epoch size in an announcement in bytes
+#define CUART_SESSION_EPOCH_SIZE 4
+
+// Salt announcement payload: salt || epoch
+#define CUART_SESSION_ANNOUNCE_SIZE (CUART_SESSION_SALT_SIZE + CUART_SESSION_EPOCH_SIZE)
+
+// Sequence number of salt announcements
+#define CUART_SESSION_ANNOUNCE_SEQ 0
+
+// Number of recent sequence numbers tracked for replay detection
+#define CUART_REPLAY_WINDOW 64
+
+/**
+ * @brief Sender side of a session
+ */
+typedef struct {
+    uint8_t salt[CUART_SESSION_SALT_SIZE];
+    uint32_t epoch;                         // this session's epoch
+    uint32_t seq;                           // last sequence number used
+} cuart_session_tx_t;
+
+/**
+ * @brief Receiver side of a session
+ */
+typedef struct {
+    uint8_t salt[CUART_SESSION_SALT_SIZE];
+    bool have_salt;                         // false until an announcement verified
+    uint32_t epoch;                         // current session's epoch, or the floor before one
+    uint32_t top;                           // highest accepted sequence number
+    uint64_t window;                        // bit i set: seq (top - i) accepted
+} cuart_session_rx_t;
+
+/**
+ * @brief What a salt announcement did to a receiver session
+ */
+typedef enum {
+    CUART_SESSION_NEW,                      // a newer session: salt installed, window cleared
+    CUART_SESSION_REPEAT,                   // the current session announced again
+    CUART_SESSION_STALE,                    // an older epoch, or the current one with another salt: refused
+} cuart_session_announce_t;
+
+/**
+ * @brief Start a new session with a random salt and the next epoch
+ *
+ * This is the only call that draws from the RNG or advances the epoch
+ * counter.
+ *
+ * @param tx Pointer to sender session
+ */
+void cuart_session_tx_init(cuart_session_tx_t *tx);
+
+/**
+ * @brief Take the next sequence number
+ *
+ * When the 32-bit space is exhausted a new session is started (new salt,
+ * next epoch) and numbering restarts; the caller must then announce it.
+ *
+ * @param tx Pointer to sender session
+ * @param renewed Set to true if a new salt was drawn (may be NULL)
+ * @return Sequence number for the next packet (never 0)
+ */
+uint32_t cuart_session_next_seq(cuart_session_tx_t *tx, bool *renewed);
+
+/**
+ * @brief Write a session's announcement payload
+ *
+ * @param tx Pointer to sender session
+ * @param out Pointer to CUART_SESSION_ANNOUNCE_SIZE bytes
+ */
+void cuart_session_put_announce(const cuart_session_tx_t *tx, uint8_t *out);
+
+/**
+ * @brief Derive the 16-byte IV for a packet
+ *
+ * @param salt Pointer to 8-byte session salt
+ * @param seq Packet sequence number
+ * @param iv Pointer to 16-byte output (first 12 bytes are the GCM nonce)
+ */
+void cuart_session_iv(const uint8_t *salt, uint32_t seq, uint8_t *iv);
+
+/**
+ * @brief Encode a sequence number for the wire (big-endian)
+ *
+ * @param seq Sequence number
+ * @param out Pointer to 4-byte output
+ */
+void cuart_session_put_seq(uint32_t seq, uint8_t *out);
+
+/**
+ * @brief Decode a sequence number from the wire
+ *
+ * @param in Pointer to 4 bytes
+ * @return Sequence number
+ */
+uint32_t cuart_session_get_seq(const uint8_t *in);
+
+/**
+ * @brief Reset a receiver session (no salt known)
+ *
+ * @param rx Pointer to receiver session
+ */
+void cuart_session_rx_init(cuart_session_rx_t *rx);
+
+/**
+ * @brief Reset a receiver session that refuses epochs older than one seen
+ *        before a restart
+ *
+ * @param rx Pointer to receiver session
+ * @param epoch Newest epoch accepted before (as returned in rx->epoch)
+ */
+void cuart_session_rx_resume(cuart_session_rx_t *rx, uint32_t epoch);
+
+/**
+ * @brief Act on an authenticated salt announcement
+ *
+ * Only a newer epoch than the current session's replaces it (and clears the
+ * replay window). Before any session, an epoch equal to the resume floor is
+ * taken too.
+ *
+ * @param rx Pointer to receiver session
+ * @param announce Pointer to CUART_SESSION_ANNOUNCE_SIZE bytes (salt || epoch)
+ * @return CUART_SESSION_NEW, CUART_SESSION_REPEAT or CUART_SESSION_STALE
+ */
+cuart_session_announce_t cuart_session_rx_announce(cuart_session_rx_t *rx, const uint8_t *announce);
+
+/**
+ * @brief Cheap pre-authentication check of a data packet's sequence number
+ *
+ * @param rx Pointer to receiver session
+ * @param seq Received sequence number
+ * @return false if no salt is known yet, seq is 0, or seq is a replay or
+ *         older than the window
+ */
+bool cuart_session_rx_check(const cuart_session_rx_t *rx, uint32_t seq);
+
+/**
+ * @brief Record a sequence number once its packet has been authenticated
+ *
+ * @param rx Pointer to receiver session
+ * @param seq Authenticated sequence number (must have passed rx_check)
+ */
+void cuart_session_rx_accept(cuart_session_rx_t *rx, uint32_t seq);
+
+#endif // CUART_SESSION_H
@@ -0,0 +1,200 @@
+/*
+ * Packet tracing: immediate dumps and the deferred ring, see cuart_trace.h
+ */
+
+#include <string.h>
+#include <stdatomic.h>
+#include "cuart_trace.h"
+
+#if defined(ESP_PLATFORM)
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#else
+#include <time.h>
+#endif
+
+_Static_assert((CUART_TRACE_RING_SLOTS & (CUART_TRACE_RING_SLOTS - 1)) == 0,
+               "CUART_TRACE_RING_SLOTS must be a power of two");
+
+// Drain task: stack, and how long it sleeps once the ring is empty
+#define CUART_TRACE_TASK_STACK 3072
+#define CUART_TRACE_DRAIN_MS 20
+
+static const char *TRACE_TAG = "CUART_TRACE";
+
+// Ring position rounded down to a whole number of laps
+#define LAP(pos) ((pos) & ~(uint32_t)(CUART_TRACE_RING_SLOTS - 1))
+
+// A deferred dump. lap says whose turn the slot is: LAP(pos) when free for
+// the producer claiming position pos, LAP(pos) + 1 once that producer has
+// filled it, LAP(pos) + CUART_TRACE_RING_SLOTS once printed. A zeroed ring
+// is an empty one.
+typedef struct {
+    _Atomic uint32_t lap;
+    uint32_t time_ms;
+    const char *tag;
+    const char *label;
+    uint16_t len;               // bytes dumped
+    uint16_t kept;              // bytes in data
+    uint8_t data[CUART_TRACE_SLOT_BYTES];
+} trace_slot_t;
+
+static trace_slot_t slots[CUART_TRACE_RING_SLOTS];
+static _Atomic uint32_t head;   // next position to claim
+static uint32_t tail;           // next position to print (drain task only)
+static _Atomic uint32_t dropped;
+static uint32_t dropped_reported;
+
+#if defined(ESP_PLATFORM)
+
+static uint32_t now_ms(void) {
+    return esp_log_timestamp();
+}
+
+static void print_dump(const char *tag, const char *label, const void *data, size_t len, size_t kept,
+                       uint32_t time_ms, bool deferred) {
+    if (!deferred) {
+        ESP_LOGI(tag, "%s (%u bytes):", label, (unsigned)len);
+    } else if (kept < len) {
+        ESP_LOGI(tag, "%s (%u bytes, first %u, at %u ms):", label, (unsigned)len, (unsigned)kept,
+                 (unsigned)time_ms);
+    } else {
+        ESP_LOGI(tag, "%s (%u bytes, at %u ms):", label, (unsigned)len, (unsigned)time_ms);
+    }
+    ESP_LOG_BUFFER_HEX_LEVEL(tag, data, kept, ESP_LOG_INFO);
+}
+
+static void report_dropped(uint32_t count) {
+    ESP_LOGW(TRACE_TAG, "%u dumps dropped, trace ring full", (unsigned)count);
+}
+
+#else
+
+static FILE *output;
+
+void cuart_trace_set_output(FILE *stream) {
+    output = stream;
+}
+
+static uint32_t now_ms(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+// The ESP-IDF console format: "I (ms) tag: ...", 16 bytes a hex line
+static void print_dump(const char *tag, const char *label, const void *data, size_t len, size_t kept,
+                       uint32_t time_ms, bool deferred) {
+    FILE *f = output ? output : stderr;
+    const uint8_t *bytes = data;
+    uint32_t ms = now_ms();
+
+    if (!deferred) {
+        fprintf(f, "I (%u) %s: %s (%u bytes):\n", (unsigned)ms, tag, label, (unsigned)len);
+    } else if (kept < len) {
+        fprintf(f, "I (%u) %s: %s (%u bytes, first %u, at %u ms):\n", (unsigned)ms, tag, label, (unsigned)len,
+                (unsigned)kept, (unsigned)time_ms);
+    } else {
+        fprintf(f, "I (%u) %s: %s (%u bytes, at %u ms):\n", (unsigned)ms, tag, label, (unsigned)len,
+                (unsigned)time_ms);
+    }
+    for (size_t line = 0; line < kept; line += 16) {
+        fprintf(f, "I (%u) %s:", (unsigned)ms, tag);
+        for (size_t i = line; i < kept && i < line + 16; i++) {
+            fprintf(f, " %02x", bytes[i]);
+        }
+        fputc('\n', f);
+    }
+    fflush(f);
+}
+
+static void report_dropped(uint32_t count) {
+    FILE *f = output ? output : stderr;
+
+    fprintf(f, "W (%u) %s: %u dumps dropped, trace ring full\n", (unsigned)now_ms(), TRACE_TAG, (unsigned)count);
+    fflush(f);
+}
+
+#endif
+
+void cuart_trace_hex(const char *tag, const char *label, const void *data, size_t len) {
+    print_dump(tag, label, data, len, len, 0, false);
+}
+
+bool cuart_trace_defer(const char *tag, const char *label, const void *data, size_t len) {
+    trace_slot_t *slot;
+    uint32_t pos;
+
+    pos = atomic_load_explicit(&head, memory_order_relaxed);
+    for (;;) {
+        slot = &slots[pos & (CUART_TRACE_RING_SLOTS - 1)];
+        int32_t diff = (int32_t)(atomic_load_explicit(&slot->lap, memory_order_acquire) - LAP(pos));
+
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&head, &pos, pos + 1, memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // Still holds a dump from a lap ago: full
+            atomic_fetch_add_explicit(&dropped, 1, memory_order_relaxed);
+            return false;
+        } else {
+            pos = atomic_load_explicit(&head, memory_order_relaxed);
+        }
+    }
+
+    slot->time_ms = now_ms();
+    slot->tag = tag;
+    slot->label = label;
+    slot->len = (uint16_t)(len > UINT16_MAX ? UINT16_MAX : len);
+    slot->kept = (uint16_t)(len < CUART_TRACE_SLOT_BYTES ? len : CUART_TRACE_SLOT_BYTES);
+    memcpy(slot->data, data, slot->kept);
+    atomic_store_explicit(&slot->lap, LAP(pos) + 1, memory_order_release);
+    return true;
+}
+
+size_t cuart_trace_drain(size_t max) {
+    size_t printed = 0;
+    uint32_t lost = atomic_load_explicit(&dropped, memory_order_relaxed);
+
+    while (printed < max) {
+        trace_slot_t *slot = &slots[tail & (CUART_TRACE_RING_SLOTS - 1)];
+
+        // Empty, or claimed and still being filled
+        if (atomic_load_explicit(&slot->lap, memory_order_acquire) != LAP(tail) + 1) {
+            break;
+        }
+        print_dump(slot->tag, slot->label, slot->data, slot->len, slot->kept, slot->time_ms, true);
+        atomic_store_explicit(&slot->lap, LAP(tail) + CUART_TRACE_RING_SLOTS, memory_order_release);
+        tail++;
+        printed++;
+    }
+    if (lost != dropped_reported) {
+        report_dropped(lost - dropped_reported);
+        dropped_reported = lost;
+    }
+    return printed;
+}
+
+uint32_t cuart_trace_dropped(void) {
+    return atomic_load_explicit(&dropped, memory_order_relaxed);
+}
+
+#if defined(ESP_PLATFORM)
+
+static void drain_task(void *arg) {
+    while (1) {
+        cuart_trace_drain(SIZE_MAX);
+        vTaskDelay(pdMS_TO_TICKS(CUART_TRACE_DRAIN_MS));
+    }
+}
+
+bool cuart_trace_start(void) {
+    return xTaskCreate(drain_task, "cuart_trace", CUART_TRACE_TASK_STACK, NULL, tskIDLE_PRIORITY + 1, NULL) ==
+           pdPASS;
+}
+
+#endif
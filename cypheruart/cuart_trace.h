@@ -0,0 +1,175 @@
+#ifndef CUART_TRACE_H
+#define CUART_TRACE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#if !defined(ESP_PLATFORM)
+#include <stdio.h>
+#endif
+
+/*
+ * Packet tracing: hex dumps of packet fields, with the verbosity fixed at
+ * build time so a production build carries none of them.
+ *
+ *   CUART_TRACE_LEVEL_NONE     every dump compiled out
+ *   CUART_TRACE_LEVEL_FIELDS   nonces, MACs and tags, session salts
+ *   CUART_TRACE_LEVEL_PAYLOAD  also ciphertext and plaintext
+ *   CUART_TRACE_LEVEL_PACKET   also every whole packet the sender seals
+ *
+ * The level comes from menuconfig under ESP-IDF (CONFIG_CUART_TRACE_LEVEL_*)
+ * and from -DCUART_TRACE_LEVEL on the host. A dump above it expands to
+ * nothing, arguments included.
+ *
+ * A dump prints at once by default (ESP_LOG_BUFFER_HEX at INFO) and holds
+ * the calling task until the console has taken it: at 115200 baud a 24-byte
+ * packet's dumps take the console about 60 ms, against well under 1 ms to
+ * verify and decrypt it. With CUART_TRACE_DEFERRED (CONFIG_CUART_TRACE_DEFERRED)
+ * a dump is copied into a ring of fixed-size slots instead, up to
+ * CUART_TRACE_SLOT_BYTES of it, and a low-priority task (cuart_trace_start())
+ * prints it when nothing else wants the CPU. Any task on either core can
+ * trace: a slot is claimed with a compare-and-swap on the ring's head and
+ * published with its sequence number, so nothing blocks. A full ring drops
+ * the dump and counts it.
+ */
+
+#define CUART_TRACE_LEVEL_NONE 0
+#define CUART_TRACE_LEVEL_FIELDS 1
+#define CUART_TRACE_LEVEL_PAYLOAD 2
+#define CUART_TRACE_LEVEL_PACKET 3
+
+#ifndef CUART_TRACE_LEVEL
+#define CUART_TRACE_LEVEL CUART_TRACE_LEVEL_PAYLOAD
+#endif
+
+#ifndef CUART_TRACE_DEFERRED
+#define CUART_TRACE_DEFERRED 0
+#endif
+
+// Deferred dumps the ring holds (a power of two)
+#ifndef CUART_TRACE_RING_SLOTS
+#define CUART_TRACE_RING_SLOTS 64
+#endif
+
+// Bytes of a deferred dump kept; the rest is counted, not shown
+#ifndef CUART_TRACE_SLOT_BYTES
+#define CUART_TRACE_SLOT_BYTES 64
+#endif
+
+#if CUART_TRACE_LEVEL == CUART_TRACE_LEVEL_NONE
+#define CUART_TRACE_MODE_NAME "off"
+#elif CUART_TRACE_DEFERRED
+#define CUART_TRACE_MODE_NAME "deferred"
+#else
+#define CUART_TRACE_MODE_NAME "immediate"
+#endif
+
+#if CUART_TRACE_DEFERRED
+#define CUART_TRACE_HEX_(tag, label, data, len) cuart_trace_defer(tag, label, data, len)
+#else
+#define CUART_TRACE_HEX_(tag, label, data, len) cuart_trace_hex(tag, label, data, len)
+#endif
+
+#define CUART_TRACE_NOTHING_(tag, label, data, len) \
+    do {                                            \
+        (void)(tag);                                \
+        (void)(label);                              \
+        (void)(data);                               \
+        (void)(len);                                \
+    } while (0)
+
+/**
+ * @brief Dump a header field: nonce, MAC or tag, salt (level FIELDS and up)
+ *
+ * @param tag Log tag (kept by pointer: a string that lives forever)
+ * @param label What is dumped (likewise), printed as "label (N bytes):"
+ * @param data Pointer to bytes
+ * @param len Number of bytes
+ */
+#if CUART_TRACE_LEVEL >= CUART_TRACE_LEVEL_FIELDS
+#define CUART_TRACE_FIELD(tag, label, data, len) CUART_TRACE_HEX_(tag, label, data, len)
+#else
+#define CUART_TRACE_FIELD(tag, label, data, len) CUART_TRACE_NOTHING_(tag, label, data, len)
+#endif
+
+/**
+ * @brief Dump ciphertext or plaintext (level PAYLOAD)
+ */
+#if CUART_TRACE_LEVEL >= CUART_TRACE_LEVEL_PAYLOAD
+#define CUART_TRACE_DATA(tag, label, data, len) CUART_TRACE_HEX_(tag, label, data, len)
+#else
+#define CUART_TRACE_DATA(tag, label, data, len) CUART_TRACE_NOTHING_(tag, label, data, len)
+#endif
+
+/**
+ * @brief Dump a whole sealed packet (level PACKET)
+ *
+ * Above the default level: on the sender's crypto task, up to a 1 KB packet
+ * every packet would hold the pipeline to the console's pace.
+ */
+#if CUART_TRACE_LEVEL >= CUART_TRACE_LEVEL_PACKET
+#define CUART_TRACE_PACKET(tag, label, data, len) CUART_TRACE_HEX_(tag, label, data, len)
+#else
+#define CUART_TRACE_PACKET(tag, label, data, len) CUART_TRACE_NOTHING_(tag, label, data, len)
+#endif
+
+/**
+ * @brief Print a dump now
+ *
+ * Normally reached through CUART_TRACE_FIELD() / CUART_TRACE_DATA().
+ *
+ * @param tag Log tag
+ * @param label What is dumped
+ * @param data Pointer to bytes
+ * @param len Number of bytes
+ */
+void cuart_trace_hex(const char *tag, const char *label, const void *data, size_t len);
+
+/**
+ * @brief Copy a dump into the ring for the drain task to print
+ *
+ * Takes no lock and never waits. tag and label are kept by pointer.
+ *
+ * @param tag Log tag
+ * @param label What is dumped
+ * @param data Pointer to bytes (the first CUART_TRACE_SLOT_BYTES are kept)
+ * @param len Number of bytes
+ * @return false if the ring was full (the dump is counted as dropped)
+ */
+bool cuart_trace_defer(const char *tag, const char *label, const void *data, size_t len);
+
+/**
+ * @brief Print deferred dumps, oldest first
+ *
+ * Called by one task only: the drain task, or a host program's own thread.
+ * Reports dumps dropped since the last call.
+ *
+ * @param max Most dumps to print
+ * @return Number printed
+ */
+size_t cuart_trace_drain(size_t max);
+
+/**
+ * @brief Number of deferred dumps dropped because the ring was full
+ */
+uint32_t cuart_trace_dropped(void);
+
+#if defined(ESP_PLATFORM)
+/**
+ * @brief Start the task that prints deferred dumps
+ *
+ * Runs just above the idle task and wakes every CUART_TRACE_DRAIN_MS.
+ *
+ * @return false if the task could not be created
+ */
+bool cuart_trace_start(void);
+#else
+/**
+ * @brief Set where dumps are printed on the host (default stderr)
+ *
+ * @param stream Output stream
+ */
+void cuart_trace_set_output(FILE *stream);
+#endif
+
+#endif // CUART_TRACE_H
@@ -0,0 +1,42 @@
+#ifndef ESP_AES_MOCK_H
+#define ESP_AES_MOCK_H
+
+/*
+ * Host mock of ESP-IDF's hardware AES driver (components/mbedtls/port/include/aes/esp_aes.h).
+ *
+ * Only the subset used by the CUART_AES_ESP_HW backend is provided, with the
+ * same signatures and mbedtls CTR semantics (nc_off / stream_block). Blocks are
+ * computed in software with the T-table kernel, and every call is counted so
+ * host builds can check how the backend drives the peripheral.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include "aes_ttable.h"
+
+#define ESP_AES_MOCK 1
+
+#define ERR_ESP_AES_INVALID_KEY_LENGTH -0x0020
+
+typedef struct {
+    uint8_t key_bytes;
+    aes_tt_key_t key;
+} esp_aes_context;
+
+// Driver calls observed by the mock
+typedef struct {
+    unsigned long setkey_calls;
+    unsigned long crypt_calls;
+    unsigned long long blocks;      // AES block operations performed by the "peripheral"
+} esp_aes_mock_stats_t;
+
+extern esp_aes_mock_stats_t esp_aes_mock_stats;
+
+void esp_aes_init(esp_aes_context *ctx);
+void esp_aes_free(esp_aes_context *ctx);
+int esp_aes_setkey(esp_aes_context *ctx, const unsigned char *key, unsigned int keybits);
+int esp_aes_crypt_ctr(esp_aes_context *ctx, size_t length, size_t *nc_off,
+                      unsigned char nonce_counter[16], unsigned char stream_block[16],
+                      const unsigned char *input, unsigned char *output);
+
+#endif // ESP_AES_MOCK_H
@@ -0,0 +1,43 @@
+#ifndef UART_MOCK_H
+#define UART_MOCK_H
+
+/*
+ * Host mock of ESP-IDF's UART driver TX path (components/esp_driver_uart/include/driver/uart.h).
+ *
+ * Only uart_write_bytes() is provided. Like the real driver, every call takes
+ * the port's TX lock and copies the data into a TX ring buffer; the mock then
+ * "transmits" it by appending to a capture buffer. Calls and copied bytes
+ * are counted so host harnesses can see what a send path costs the driver.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Size of the mock TX ring buffer (the sender installs BUF_SIZE * 2)
+#define UART_MOCK_TX_RING 2048
+
+// Size of the capture buffer holding everything "transmitted"
+#define UART_MOCK_CAPTURE 65536
+
+typedef int uart_port_t;
+
+// Driver activity observed by the mock
+typedef struct {
+    unsigned long write_calls;          // one TX-lock acquisition each
+    unsigned long long bytes_copied;    // bytes copied into the TX ring buffer
+} uart_mock_stats_t;
+
+extern uart_mock_stats_t uart_mock_stats;
+
+// Everything written so far, in order
+extern uint8_t uart_mock_capture[UART_MOCK_CAPTURE];
+extern size_t uart_mock_capture_len;
+
+/**
+ * @brief Clear the statistics and the capture buffer
+ */
+void uart_mock_reset(void);
+
+int uart_write_bytes(uart_port_t uart_num, const void *src, size_t size);
+
+#endif // UART_MOCK_H
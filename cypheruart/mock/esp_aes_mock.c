@@ -0,0 +1,51 @@
+#include "aes/esp_aes.h"
+#include <string.h>
+
+esp_aes_mock_stats_t esp_aes_mock_stats;
+
+void esp_aes_init(esp_aes_context *ctx) {
+    memset(ctx, 0, sizeof(*ctx));
+}
+
+void esp_aes_free(esp_aes_context *ctx) {
+    memset(ctx, 0, sizeof(*ctx));
+}
+
+int esp_aes_setkey(esp_aes_context *ctx, const unsigned char *key, unsigned int keybits) {
+    // The mock only models AES-128, the only key size the wrapper uses
+    if (keybits != 128) {
+        return ERR_ESP_AES_INVALID_KEY_LENGTH;
+    }
+    aes_tt_setkey(&ctx->key, key);
+    ctx->key_bytes = 16;
+    esp_aes_mock_stats.setkey_calls++;
+    return 0;
+}
+
+int esp_aes_crypt_ctr(esp_aes_context *ctx, size_t length, size_t *nc_off,
+                      unsigned char nonce_counter[16], unsigned char stream_block[16],
+                      const unsigned char *input, unsigned char *output) {
+    size_t n = *nc_off;
+
+    if (ctx->key_bytes != 16) {
+        return ERR_ESP_AES_INVALID_KEY_LENGTH;
+    }
+    esp_aes_mock_stats.crypt_calls++;
+
+    for (size_t i = 0; i < length; i++) {
+        if (n == 0) {
+            aes_tt_encrypt_block(&ctx->key, nonce_counter, stream_block);
+            esp_aes_mock_stats.blocks++;
+            for (int j = 15; j >= 0; j--) {
+                if (++nonce_counter[j] != 0) {
+                    break;
+                }
+            }
+        }
+        output[i] = input[i] ^ stream_block[n];
+        n = (n + 1) & 0x0f;
+    }
+
+    *nc_off = n;
+    return 0;
+}
@@ -0,0 +1,42 @@
+#include "driver/uart.h"
+#include <pthread.h>
+#include <string.h>
+
+uart_mock_stats_t uart_mock_stats;
+uint8_t uart_mock_capture[UART_MOCK_CAPTURE];
+size_t uart_mock_capture_len;
+
+static pthread_mutex_t tx_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint8_t tx_ring[UART_MOCK_TX_RING];
+
+void uart_mock_reset(void) {
+    memset(&uart_mock_stats, 0, sizeof(uart_mock_stats));
+    uart_mock_capture_len = 0;
+}
+
+int uart_write_bytes(uart_port_t uart_num, const void *src, size_t size) {
+    const uint8_t *p = src;
+    size_t left = size;
+
+    (void)uart_num;
+    pthread_mutex_lock(&tx_lock);
+    uart_mock_stats.write_calls++;
+
+    // Copy through the ring buffer in ring-sized chunks, then drain to the capture
+    while (left > 0) {
+        size_t n = left < UART_MOCK_TX_RING ? left : UART_MOCK_TX_RING;
+
+        memcpy(tx_ring, p, n);
+        uart_mock_stats.bytes_copied += n;
+        if (uart_mock_capture_len + n > UART_MOCK_CAPTURE) {
+            uart_mock_capture_len = 0;
+        }
+        memcpy(uart_mock_capture + uart_mock_capture_len, tx_ring, n);
+        uart_mock_capture_len += n;
+        p += n;
+        left -= n;
+    }
+
+    pthread_mutex_unlock(&tx_lock);
+    return (int)size;
+}
@@ -0,0 +1,60 @@
+/*
+ * ESP-IDF port: hardware RNG, session epoch in NVS and mbedtls SHA-256 (SHA
+ * peripheral when CONFIG_MBEDTLS_HARDWARE_SHA is enabled)
+ */
+
+#include "cuart_port.h"
+#include "esp_err.h"
+#include "esp_system.h"
+#include "esp_random.h"
+#include "nvs.h"
+
+void cuart_port_random(uint8_t *buf, size_t len) {
+    // ESP32 hardware RNG
+    esp_fill_random(buf, len);
+}
+
+uint32_t cuart_port_next_epoch(void) {
+    // The application calls nvs_flash_init() before the first session
+    nvs_handle_t nvs;
+    uint32_t epoch = 0;
+    esp_err_t err;
+
+    ESP_ERROR_CHECK(nvs_open("cuart", NVS_READWRITE, &nvs));
+    err = nvs_get_u32(nvs, "tx_epoch", &epoch);
+    if (err != ESP_ERR_NVS_NOT_FOUND) {
+        ESP_ERROR_CHECK(err);
+    }
+    epoch++;
+    ESP_ERROR_CHECK(nvs_set_u32(nvs, "tx_epoch", epoch));
+    ESP_ERROR_CHECK(nvs_commit(nvs));
+    nvs_close(nvs);
+    return epoch;
+}
+
+void cuart_port_sha256_init(cuart_sha256_ctx_t *ctx) {
+    mbedtls_sha256_init(ctx);
+    mbedtls_sha256_starts(ctx, 0); // 0 = SHA-256 (not SHA-224)
+}
+
+void cuart_port_sha256_update(cuart_sha256_ctx_t *ctx, const uint8_t *data, size_t len) {
+    mbedtls_sha256_update(ctx, data, len);
+}
+
+void cuart_port_sha256_clone(cuart_sha256_ctx_t *dst, const cuart_sha256_ctx_t *src) {
+    // On the original ESP32 a context running on the SHA engine is cloned
+    // into a software state; ESP32-S3 contexts keep their state in RAM
+    mbedtls_sha256_init(dst);
+    mbedtls_sha256_clone(dst, src);
+}
+
+void cuart_port_sha256_free(cuart_sha256_ctx_t *ctx) {
+    mbedtls_sha256_free(ctx);
+}
+
+void cuart_port_sha256_final(cuart_sha256_ctx_t *ctx, uint8_t *digest) {
+    mbedtls_sha256_finish(ctx, digest);
+
+    // Releases the SHA peripheral if this context held it
+    mbedtls_sha256_free(ctx);
+}
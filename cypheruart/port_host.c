@@ -0,0 +1,55 @@
+/*
+ * Linux/POSIX host port: getrandom() and portable SHA-256
+ */
+
+#include "cuart_port.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/random.h>
+
+void cuart_port_random(uint8_t *buf, size_t len) {
+    while (len > 0) {
+        ssize_t n = getrandom(buf, len, 0);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("getrandom");
+            abort();
+        }
+        buf += n;
+        len -= (size_t)n;
+    }
+}
+
+uint32_t cuart_port_next_epoch(void) {
+    // No persistent store on the host: seconds since the epoch keep a
+    // restarted process ahead of the last one
+    static uint32_t last;
+    uint32_t now = (uint32_t)time(NULL);
+
+    last = now > last ? now : last + 1;
+    return last;
+}
+
+void cuart_port_sha256_init(cuart_sha256_ctx_t *ctx) {
+    sha256_init(ctx);
+}
+
+void cuart_port_sha256_update(cuart_sha256_ctx_t *ctx, const uint8_t *data, size_t len) {
+    sha256_update(ctx, data, len);
+}
+
+void cuart_port_sha256_clone(cuart_sha256_ctx_t *dst, const cuart_sha256_ctx_t *src) {
+    *dst = *src;
+}
+
+void cuart_port_sha256_free(cuart_sha256_ctx_t *ctx) {
+    (void)ctx;
+}
+
+void cuart_port_sha256_final(cuart_sha256_ctx_t *ctx, uint8_t *digest) {
+    sha256_final(ctx, digest);
+}
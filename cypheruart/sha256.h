@@ -0,0 +1,34 @@
+#ifndef SHA256_H
+#define SHA256_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// SHA-256 digest size in bytes
+#define SHA256_DIGEST_SIZE 32
+
+/*
+ * Portable SHA-256 (FIPS 180-4) used by the host port.
+ * The ESP-IDF port uses mbedtls instead, which is hardware-accelerated.
+ */
+typedef struct {
+    uint32_t state[8];
+    uint64_t total_len;
+    uint8_t buffer[64];
+    size_t buffer_len;
+} sha256_ctx;
+
+void sha256_init(sha256_ctx *ctx);
+void sha256_update(sha256_ctx *ctx, const uint8_t *data, size_t len);
+void sha256_final(sha256_ctx *ctx, uint8_t *digest);
+
+/**
+ * @brief One-shot SHA-256
+ *
+ * @param data Pointer to data to hash
+ * @param len Length of data
+ * @param digest Pointer to 32-byte buffer for digest output
+ */
+void sha256(const uint8_t *data, size_t len, uint8_t *digest);
+
+#endif // SHA256_H
@@ -2,10 +2,22 @@
 #include <string.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/queue.h"
 #include "driver/uart.h"
 #include "driver/gpio.h"
 #include "esp_log.h"
+#include "esp_cpu.h"
+#include "nvs_flash.h"
 #include "aes_wrapper.h"
+#include "aes_gcm.h"
+#include "cuart_session.h"
+#include "cuart_frame.h"
+#include "cuart_parser.h"
+#include "cuart_batch.h"
+#include "cuart_compress.h"
+#include "cuart_link.h"
+#include "cuart_arq.h"
+#include "cuart_trace.h"
 
 static const char *TAG = "RECEIVER";
 
@@ -16,6 +28,16 @@ static const char *TAG = "RECEIVER";
 #define UART_BAUD_RATE 115200
 #define BUF_SIZE 1024
 
+// Receiver task stack (bytes). Packets are read straight into the static
+// parser's frame buffer and decrypted there, so nothing packet-sized is on it.
+#define RECEIVER_TASK_STACK_SIZE 4096
+
+// UART event queue length
+#define UART_EVENT_QUEUE_LEN 20
+
+// Drop a partial frame after this long without data
+#define RX_FRAME_TIMEOUT_MS 500
+
 // AES-128 Pre-shared Key (must match sender)
 static const uint8_t AES_SHARED_KEY[AES_KEY_SIZE] = {
     0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6,
@@ -30,14 +52,143 @@ static const uint8_t HMAC_KEY[32] = {
     0x87, 0x96, 0xa5, 0xb4, 0xc3, 0xd2, 0xe1, 0xf0
 };
 
-// Packet structure: [NONCE(16 bytes)][LENGTH(2 bytes)][ENCRYPTED_DATA][HMAC(32 bytes)]
-typedef struct {
-    uint8_t nonce[AES_BLOCK_SIZE];
-    uint16_t data_len;
-    uint8_t encrypted_data[BUF_SIZE];
-    uint8_t decrypted_data[BUF_SIZE];
-    uint8_t received_hmac[HMAC_SIZE];
-} packet_t;
+// HMAC key pads, precomputed once in app_main()
+static hmac_sha256_key_t hmac_key;
+
+// Packet wire format from menuconfig: AES-128-GCM or AES-CTR + HMAC-SHA256
+#if CONFIG_CUART_WIRE_AEAD
+#define WIRE_AEAD 1
+#else
+#define WIRE_AEAD 0
+#endif
+
+// Session nonces from menuconfig: the NONCE field carries a 4-byte sequence
+// number and the IV is derived from a per-session salt (see cuart_session.h)
+#if CONFIG_CUART_SESSION_NONCES
+#define SESSION_NONCES 1
+#else
+#define SESSION_NONCES 0
+#endif
+
+// Sync framing from menuconfig: packets are preceded by a sync word and header
+// CRC, and the parser resynchronizes on them after lost or corrupted bytes
+#if CONFIG_CUART_SYNC_FRAMING
+#define SYNC_FRAMING 1
+#else
+#define SYNC_FRAMING 0
+#endif
+
+// Batching from menuconfig: each data packet carries a table of
+// length-prefixed records (see cuart_batch.h)
+#if CONFIG_CUART_BATCHING
+#define BATCHING 1
+#else
+#define BATCHING 0
+#endif
+
+// Link negotiation from menuconfig: answer the sender's bring-up on the TX
+// line and follow it to the fastest rate both ends run (see cuart_link.h);
+// RTS/CTS is offered only when both pins are wired
+#if CONFIG_CUART_LINK_NEGOTIATION
+#define LINK_NEGOTIATION 1
+#define LINK_MAX_BAUD CONFIG_CUART_LINK_MAX_BAUD
+#define RTS_PIN CONFIG_CUART_LINK_RTS_GPIO
+#define CTS_PIN CONFIG_CUART_LINK_CTS_GPIO
+#else
+#define LINK_NEGOTIATION 0
+#define LINK_MAX_BAUD CUART_LINK_SAFE_BAUD
+#define RTS_PIN -1
+#define CTS_PIN -1
+#endif
+#define LINK_FLOW (RTS_PIN >= 0 && CTS_PIN >= 0)
+
+// Reliable delivery from menuconfig: payloads start with a sequence number,
+// duplicates are dropped, and what has arrived is acknowledged in link frames
+// (see cuart_arq.h)
+#if CONFIG_CUART_RELIABLE
+#define RELIABLE 1
+#else
+#define RELIABLE 0
+#endif
+
+// How often the link's timers run while the line is quiet, and the RX FIFO
+// level at which RTS holds the sender back
+#define LINK_POLL_MS 10
+#define LINK_POLL_TICKS (pdMS_TO_TICKS(LINK_POLL_MS) > 0 ? pdMS_TO_TICKS(LINK_POLL_MS) : 1)
+#define LINK_RTS_THRESHOLD 122
+
+// AES contexts, keyed once in app_main()
+static aes_ctr_ctx_t ctr_ctx;
+static aes_gcm_ctx_t gcm_ctx;
+
+// Keys and wire format for verifying packets
+static cuart_frame_ctx_t frame_ctx;
+
+// Decompressed payload of a packet flagged CUART_FRAME_FLAG_COMPRESSED
+static uint8_t inflated[CUART_FRAME_MAX_PAYLOAD];
+
+// UART event queue filled by the driver
+static QueueHandle_t uart_queue;
+
+// Incremental packet parser (holds one full frame)
+static cuart_parser_t parser;
+
+// Session salt and replay window
+static cuart_session_rx_t session;
+
+// Link negotiation state and the settings applied to the UART
+static cuart_link_t link;
+static uint32_t link_baud = CUART_LINK_SAFE_BAUD;
+static bool link_flow;
+
+// Reliable delivery state, the sender boot it belongs to, and whether a
+// data packet arrived since the last ACK
+static cuart_arq_rx_t arq_rx;
+static uint8_t arq_peer_boot;
+static bool ack_due;
+
+/**
+ * @brief Initialize NVS, which holds the newest session epoch accepted
+ */
+static void nvs_init(void) {
+    esp_err_t err = nvs_flash_init();
+
+    if (err == ESP_ERR_NVS_NO_FREE_PAGES || err == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        ESP_ERROR_CHECK(nvs_flash_erase());
+        err = nvs_flash_init();
+    }
+    ESP_ERROR_CHECK(err);
+}
+
+/**
+ * @brief Newest session epoch accepted before this boot, 0 if none
+ */
+static uint32_t session_epoch_load(void) {
+    nvs_handle_t nvs;
+    uint32_t epoch = 0;
+    esp_err_t err;
+
+    ESP_ERROR_CHECK(nvs_open("cuart", NVS_READWRITE, &nvs));
+    err = nvs_get_u32(nvs, "rx_epoch", &epoch);
+    if (err != ESP_ERR_NVS_NOT_FOUND) {
+        ESP_ERROR_CHECK(err);
+    }
+    nvs_close(nvs);
+    return epoch;
+}
+
+/**
+ * @brief Remember a new session's epoch, so a restart does not go back to an
+ *        older session
+ */
+static void session_epoch_store(uint32_t epoch) {
+    nvs_handle_t nvs;
+
+    ESP_ERROR_CHECK(nvs_open("cuart", NVS_READWRITE, &nvs));
+    ESP_ERROR_CHECK(nvs_set_u32(nvs, "rx_epoch", epoch));
+    ESP_ERROR_CHECK(nvs_commit(nvs));
+    nvs_close(nvs);
+}
 
 /**
  * @brief Initialize UART for communication
@@ -53,139 +204,424 @@ static void uart_init(void) {
     };
 
     // Install UART driver (RX buffer, TX buffer, queue size, queue handle, interrupt flags)
-    ESP_ERROR_CHECK(uart_driver_install(UART_NUM, BUF_SIZE * 2, BUF_SIZE * 2, 0, NULL, 0));
+    ESP_ERROR_CHECK(uart_driver_install(UART_NUM, BUF_SIZE * 2, BUF_SIZE * 2, UART_EVENT_QUEUE_LEN, &uart_queue, 0));
     ESP_ERROR_CHECK(uart_param_config(UART_NUM, &uart_config));
-    ESP_ERROR_CHECK(uart_set_pin(UART_NUM, TXD_PIN, RXD_PIN, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE));
+    ESP_ERROR_CHECK(uart_set_pin(UART_NUM, TXD_PIN, RXD_PIN,
+                                 RTS_PIN >= 0 ? RTS_PIN : UART_PIN_NO_CHANGE,
+                                 CTS_PIN >= 0 ? CTS_PIN : UART_PIN_NO_CHANGE));
 
     ESP_LOGI(TAG, "UART initialized on RX: GPIO%d, TX: GPIO%d", RXD_PIN, TXD_PIN);
 }
 
+static uint32_t link_now_ms(void) {
+    return (uint32_t)(xTaskGetTickCount() * portTICK_PERIOD_MS);
+}
+
 /**
- * @brief Receive and decrypt data from UART with HMAC verification
+ * @brief Send what the link asks for, then apply its rate and flow control
+ *
+ * Bytes received around a change were sent at the other rate, so the input
+ * and any partial frame are dropped.
  */
-static bool receive_and_decrypt(packet_t *packet) {
-    uint8_t hmac_input[AES_BLOCK_SIZE + 2 + BUF_SIZE];
-    size_t hmac_input_len;
-    uint8_t length_bytes[2];
+static void link_service(void) {
+    uint8_t out[CUART_LINK_FRAME_SIZE];
+    uint32_t baud;
 
-    // Read nonce first (16 bytes)
-    int nonce_len = uart_read_bytes(UART_NUM, packet->nonce, AES_BLOCK_SIZE, pdMS_TO_TICKS(1000));
+    while (cuart_link_poll(&link, link_now_ms(), out) > 0) {
+        uart_write_bytes(UART_NUM, out, sizeof(out));
+    }
 
-    if (nonce_len != AES_BLOCK_SIZE) {
-        if (nonce_len > 0) {
-            ESP_LOGW(TAG, "Incomplete nonce received: %d bytes", nonce_len);
-        }
-        return false;
+    baud = cuart_link_baud(&link);
+    if (baud == link_baud && link.flow == link_flow) {
+        return;
+    }
+    uart_wait_tx_done(UART_NUM, pdMS_TO_TICKS(100));
+    uart_set_baudrate(UART_NUM, baud);
+    uart_set_hw_flow_ctrl(UART_NUM, link.flow ? UART_HW_FLOWCTRL_CTS_RTS : UART_HW_FLOWCTRL_DISABLE,
+                          LINK_RTS_THRESHOLD);
+    uart_flush_input(UART_NUM);
+    cuart_parser_reset(&parser);
+
+    if (baud < link_baud) {
+        ESP_LOGW(TAG, "Link: fell back to %u baud (%u fallbacks so far)", (unsigned)baud,
+                 (unsigned)(link.stats.fallbacks + link.stats.check_failures));
+    } else {
+        ESP_LOGI(TAG, "Link: %u baud%s", (unsigned)baud, link.flow ? ", RTS/CTS" : "");
     }
+    link_baud = baud;
+    link_flow = link.flow;
+}
 
-    ESP_LOGI(TAG, "Received nonce:");
-    ESP_LOG_BUFFER_HEX_LEVEL(TAG, packet->nonce, AES_BLOCK_SIZE, ESP_LOG_INFO);
+/**
+ * @brief Count a packet, or a UART error, towards the link's error rate
+ */
+static void link_report(bool good) {
+    if (LINK_NEGOTIATION) {
+        cuart_link_report(&link, good, link_now_ms());
+    }
+}
 
-    // Wait a bit for length to arrive
-    vTaskDelay(pdMS_TO_TICKS(10));
+/**
+ * @brief Acknowledge what has arrived, once per batch of packets read
+ */
+static void send_ack(void) {
+    uint8_t state[CUART_ARQ_ACK_SIZE];
+    uint8_t out[CUART_LINK_FRAME_SIZE];
 
-    // Read length (2 bytes, big-endian)
-    int length_len = uart_read_bytes(UART_NUM, length_bytes, 2, pdMS_TO_TICKS(500));
+    if (!ack_due || !arq_rx.synced) {
+        return;
+    }
+    ack_due = false;
+    cuart_arq_rx_ack(&arq_rx, state);
+    cuart_link_build_acks(out, state);
+    uart_write_bytes(UART_NUM, out, sizeof(out));
+}
 
-    if (length_len != 2) {
-        ESP_LOGE(TAG, "Incomplete or no length received: %d bytes", length_len);
+/**
+ * @brief Strip the reliable delivery header and drop copies of packets
+ *        already delivered
+ *
+ * A restarted sender numbers from 0 again; the link tells it apart by its
+ * BOOT ID.
+ *
+ * @param body Set past the header
+ * @param length Set to the bytes after it
+ * @return false if the packet must be dropped
+ */
+static bool arq_accept(const cuart_frame_view_t *frame, const uint8_t **body, size_t *length) {
+    uint16_t seq;
+
+    if (frame->length < CUART_ARQ_HEADER_SIZE) {
+        ESP_LOGE(TAG, "Authentic packet without a sequence number (sender without reliable delivery?), dropped");
+        return false;
+    }
+    if (link.known_peer && link.peer_boot != arq_peer_boot) {
+        cuart_arq_rx_init(&arq_rx);
+        arq_peer_boot = link.peer_boot;
+    }
+    if (!cuart_arq_rx_accept(&arq_rx, frame->body, &seq)) {
+        ESP_LOGW(TAG, "Copy of packet %u dropped, already delivered", (unsigned)seq);
         return false;
     }
+    ESP_LOGI(TAG, "Packet %u", (unsigned)seq);
+    *body = frame->body + CUART_ARQ_HEADER_SIZE;
+    *length = frame->length - CUART_ARQ_HEADER_SIZE;
+    return true;
+}
 
-    // Parse length from big-endian
-    packet->data_len = ((uint16_t)length_bytes[0] << 8) | length_bytes[1];
+/**
+ * @brief Resolve the IV for a received NONCE field
+ *
+ * Without session nonces the field is the IV. In session mode it is a
+ * sequence number: replays and packets arriving before any salt are dropped
+ * here, before any crypto runs. A salt announcement (seq 0) is authenticated
+ * under an IV derived from the salt it carries.
+ *
+ * @param frame Pointer to received packet
+ * @param iv Pointer to 16-byte IV
+ * @param seq Set to the sequence number in session mode
+ * @return false if the packet must be dropped
+ */
+static bool packet_iv(const cuart_frame_view_t *frame, uint8_t *iv, uint32_t *seq) {
+    if (!SESSION_NONCES) {
+        memset(iv, 0, AES_BLOCK_SIZE);
+        memcpy(iv, frame->nonce, frame->nonce_len);
+        return true;
+    }
 
-    ESP_LOGI(TAG, "Received length: %d bytes", packet->data_len);
+    *seq = cuart_session_get_seq(frame->nonce);
+    if (*seq == CUART_SESSION_ANNOUNCE_SEQ) {
+        if (frame->length != CUART_SESSION_ANNOUNCE_SIZE) {
+            ESP_LOGE(TAG, "Malformed salt announcement: %d bytes", (int)frame->length);
+            return false;
+        }
+        cuart_session_iv(frame->body, CUART_SESSION_ANNOUNCE_SEQ, iv);
+        return true;
+    }
 
-    // Validate length
-    if (packet->data_len == 0 || packet->data_len > BUF_SIZE) {
-        ESP_LOGE(TAG, "Invalid data length: %d bytes", packet->data_len);
+    if (!cuart_session_rx_check(&session, *seq)) {
+        if (session.have_salt) {
+            ESP_LOGW(TAG, "Replayed or stale sequence number %u dropped", (unsigned)*seq);
+        } else {
+            ESP_LOGW(TAG, "No session salt yet, packet %u dropped", (unsigned)*seq);
+        }
         return false;
     }
+    cuart_session_iv(session.salt, *seq, iv);
+    return true;
+}
 
-    // Wait a bit for encrypted data to arrive
-    vTaskDelay(pdMS_TO_TICKS(10));
-
-    // Read exactly data_len bytes of encrypted data
-    int data_len = uart_read_bytes(UART_NUM, packet->encrypted_data, packet->data_len, pdMS_TO_TICKS(500));
+/**
+ * @brief Act on an authenticated packet's sequence number
+ *
+ * @return true if the packet carries a message, false for a salt announcement
+ */
+static bool session_accept(const cuart_frame_view_t *frame, uint32_t seq) {
+    if (!SESSION_NONCES) {
+        return true;
+    }
 
-    if (data_len != packet->data_len) {
-        ESP_LOGE(TAG, "Incomplete encrypted data received: %d of %d bytes", data_len, packet->data_len);
+    if (seq == CUART_SESSION_ANNOUNCE_SEQ) {
+        switch (cuart_session_rx_announce(&session, frame->body)) {
+        case CUART_SESSION_NEW:
+            ESP_LOGI(TAG, "New session, epoch %u", (unsigned)session.epoch);
+            CUART_TRACE_FIELD(TAG, "Session salt", session.salt, CUART_SESSION_SALT_SIZE);
+            session_epoch_store(session.epoch);
+            break;
+        case CUART_SESSION_STALE:
+            ESP_LOGW(TAG, "Announcement of an earlier session ignored (replayed?)");
+            break;
+        case CUART_SESSION_REPEAT:
+            break;
+        }
         return false;
     }
 
-    ESP_LOGI(TAG, "Received encrypted data (%d bytes):", data_len);
-    ESP_LOG_BUFFER_HEX_LEVEL(TAG, packet->encrypted_data, data_len, ESP_LOG_INFO);
-
-    // Wait for HMAC to arrive
-    vTaskDelay(pdMS_TO_TICKS(10));
+    cuart_session_rx_accept(&session, seq);
+    return true;
+}
 
-    // Read HMAC (32 bytes)
-    int hmac_len = uart_read_bytes(UART_NUM, packet->received_hmac, HMAC_SIZE, pdMS_TO_TICKS(500));
+/**
+ * @brief Verify and decrypt a complete packet in the parser's buffer
+ *
+ * Packet structure: [NONCE(16 bytes)][LENGTH(2 bytes)][ENCRYPTED_DATA][HMAC(32 bytes)]
+ * AEAD packets: [NONCE(12 bytes)][LENGTH(2 bytes)][ENCRYPTED_DATA][TAG(16 bytes)]
+ *
+ * The HMAC or GCM tag is checked before anything is decrypted; the payload is
+ * then decrypted in place, in the frame buffer it was received into. With
+ * reliable delivery the sequence number in front is stripped. A payload
+ * flagged as compressed is decompressed into inflated[].
+ *
+ * @param frame Pointer to received packet
+ * @param plaintext Set to the plaintext (frame->body, or inflated[])
+ * @param plaintext_len Set to its length
+ * @param cycles Set to the CPU cycles spent verifying, decrypting and decompressing it,
+ *               without the tracing around it
+ */
+static bool verify_and_decrypt(const cuart_frame_view_t *frame, const uint8_t **plaintext,
+                               size_t *plaintext_len, uint32_t *cycles) {
+    uint8_t iv[AES_BLOCK_SIZE];
+    uint32_t seq = 0;
+    uint32_t start;
+    bool announce;
+    bool authentic;
+
+    CUART_TRACE_FIELD(TAG, "Received nonce", frame->nonce, frame->nonce_len);
+    CUART_TRACE_DATA(TAG, (frame->flags & CUART_FRAME_FLAG_COMPRESSED) ? "Received encrypted data, compressed"
+                                                                       : "Received encrypted data",
+                     frame->body, frame->length);
+    CUART_TRACE_FIELD(TAG, WIRE_AEAD ? "Received tag" : "Received HMAC", frame->mac, frame->mac_len);
+
+    // Timed from here to the plaintext, without the tracing around it
+    start = esp_cpu_get_cycle_count();
+    if (!packet_iv(frame, iv, &seq)) {
+        return false;
+    }
 
-    if (hmac_len != HMAC_SIZE) {
-        ESP_LOGE(TAG, "Incomplete or no HMAC received: %d bytes", hmac_len);
+    // A salt announcement carries its payload in clear
+    announce = SESSION_NONCES && seq == CUART_SESSION_ANNOUNCE_SEQ;
+    authentic = cuart_frame_open(&frame_ctx, frame, iv, frame->body, !announce);
+    *cycles = esp_cpu_get_cycle_count() - start;
+    link_report(authentic);
+    if (!authentic) {
+        ESP_LOGE(TAG, "%s verification FAILED! Message may be corrupted or tampered!",
+                 WIRE_AEAD ? "GCM tag" : "HMAC");
+        // A byte lost inside this frame means it swallowed the start of the next one
+        cuart_parser_resync(&parser);
         return false;
     }
 
-    ESP_LOGI(TAG, "Received HMAC:");
-    ESP_LOG_BUFFER_HEX_LEVEL(TAG, packet->received_hmac, HMAC_SIZE, ESP_LOG_INFO);
+    ESP_LOGI(TAG, "✓ %s verification PASSED - Message authentic", WIRE_AEAD ? "GCM tag" : "HMAC");
 
-    // Verify HMAC before decryption (authenticate then decrypt)
-    // HMAC is computed over [NONCE || LENGTH || ENCRYPTED_DATA]
-    memcpy(hmac_input, packet->nonce, AES_BLOCK_SIZE);
-    memcpy(hmac_input + AES_BLOCK_SIZE, length_bytes, 2);
-    memcpy(hmac_input + AES_BLOCK_SIZE + 2, packet->encrypted_data, packet->data_len);
-    hmac_input_len = AES_BLOCK_SIZE + 2 + packet->data_len;
+    if (!session_accept(frame, seq)) {
+        return false;
+    }
 
-    if (!verify_hmac_sha256(hmac_input, hmac_input_len, HMAC_KEY, sizeof(HMAC_KEY), packet->received_hmac)) {
-        ESP_LOGE(TAG, "HMAC verification FAILED! Message may be corrupted or tampered!");
+    *plaintext = frame->body;
+    *plaintext_len = frame->length;
+    if (RELIABLE && !arq_accept(frame, plaintext, plaintext_len)) {
         return false;
     }
+    if (frame->flags & CUART_FRAME_FLAG_COMPRESSED) {
+        size_t packed_len = *plaintext_len;
+
+        start = esp_cpu_get_cycle_count();
+        *plaintext_len = cuart_decompress(*plaintext, packed_len, inflated, sizeof(inflated));
+        *cycles += esp_cpu_get_cycle_count() - start;
+        if (*plaintext_len == 0) {
+            ESP_LOGE(TAG, "Compressed payload does not decompress (sender built with another dictionary?), dropped");
+            return false;
+        }
+        *plaintext = inflated;
+        ESP_LOGI(TAG, "Decompressed %d -> %d bytes", (int)packed_len, (int)*plaintext_len);
+    }
 
-    ESP_LOGI(TAG, "✓ HMAC verification PASSED - Message authentic");
+    CUART_TRACE_DATA(TAG, "Decrypted data", *plaintext, *plaintext_len);
 
-    // Decrypt the data (only after successful authentication)
-    aes_decrypt_ctr(packet->encrypted_data, packet->decrypted_data, packet->data_len, packet->nonce);
+    return true;
+}
 
-    ESP_LOGI(TAG, "Decrypted data:");
-    ESP_LOG_BUFFER_HEX_LEVEL(TAG, packet->decrypted_data, packet->data_len, ESP_LOG_INFO);
+/**
+ * @brief Report a decrypted packet: its message, or each record of a batch
+ *
+ * @return Number of messages reported
+ */
+static int report_message(const cuart_frame_view_t *frame, const uint8_t *plaintext, size_t plaintext_len,
+                          int message_count, uint32_t cycles, uint32_t frame_cycles) {
+    int records = 1;
 
-    return true;
+    ESP_LOGI(TAG, "\n========================================");
+
+    if (BATCHING) {
+        const uint8_t *record;
+        size_t record_len;
+        size_t offset = 0;
+
+        records = cuart_batch_count(plaintext, plaintext_len);
+        if (records < 0) {
+            ESP_LOGE(TAG, "Malformed record table in an authentic packet, dropped");
+            return 0;
+        }
+        ESP_LOGI(TAG, "Batch of %d messages successfully decrypted!", records);
+        ESP_LOGI(TAG, "========================================");
+        while (cuart_batch_next(plaintext, plaintext_len, &offset, &record, &record_len)) {
+            ESP_LOGI(TAG, "Message #%d: \"%.*s\"", ++message_count, (int)record_len, (const char *)record);
+        }
+    } else {
+        ESP_LOGI(TAG, "Message #%d successfully decrypted!", message_count + 1);
+        ESP_LOGI(TAG, "========================================");
+
+        // Try to display as string (bounded: the MAC follows the plaintext)
+        ESP_LOGI(TAG, "Plaintext message: \"%.*s\"", (int)plaintext_len, (const char *)plaintext);
+    }
+
+    ESP_LOGI(TAG, "Total packet size: %d bytes (nonce: %d + length: 2 + data: %d + %s: %d)",
+             (int)(frame->nonce_len + 2 + frame->length + frame->mac_len), (int)frame->nonce_len,
+             (int)frame->length, WIRE_AEAD ? "tag" : "hmac", (int)frame->mac_len);
+    ESP_LOGI(TAG, "Verify + decrypt%s: %u CPU cycles",
+             (frame->flags & CUART_FRAME_FLAG_COMPRESSED) ? " + decompress" : "", (unsigned)cycles);
+    ESP_LOGI(TAG, "Whole frame, tracing %s: %u CPU cycles", CUART_TRACE_MODE_NAME, (unsigned)frame_cycles);
+    ESP_LOGI(TAG, "receiver_task stack high-water mark: %u bytes free",
+             (unsigned)uxTaskGetStackHighWaterMark(NULL));
+    ESP_LOGI(TAG, "========================================\n");
+    return records;
 }
 
 /**
  * @brief Main receiver task
+ *
+ * Blocks on the UART event queue and reads whatever bytes arrived straight
+ * into the parser's frame buffer, field by field; a packet is handled as soon
+ * as its last byte is in. A frame left incomplete for RX_FRAME_TIMEOUT_MS is
+ * dropped. With link negotiation the same bytes are scanned for link frames,
+ * and the link's timers run at least every LINK_POLL_MS. With reliable
+ * delivery, each batch of packets read is acknowledged, copies the sender
+ * sent again included (in session mode they are dropped as replays).
  */
 static void receiver_task(void *arg) {
-    packet_t packet;
+    cuart_frame_view_t frame;
+    const uint8_t *plaintext;
+    size_t plaintext_len;
+    uart_event_t event;
+    uint32_t cycles;
+    TickType_t last_rx = xTaskGetTickCount();
     int message_count = 0;
 
     ESP_LOGI(TAG, "Receiver task started, waiting for encrypted messages...");
 
     while (1) {
-        // Clear packet buffer
-        memset(&packet, 0, sizeof(packet));
-
-        // Receive and decrypt packet
-        if (receive_and_decrypt(&packet)) {
-            message_count++;
-
-            ESP_LOGI(TAG, "\n========================================");
-            ESP_LOGI(TAG, "Message #%d successfully decrypted!", message_count);
-            ESP_LOGI(TAG, "========================================");
+        TickType_t wait = cuart_parser_busy(&parser) ? pdMS_TO_TICKS(RX_FRAME_TIMEOUT_MS) : portMAX_DELAY;
 
-            // Try to display as string
-            packet.decrypted_data[packet.data_len] = '\0';  // Null terminate
-            ESP_LOGI(TAG, "Plaintext message: \"%s\"", (char *)packet.decrypted_data);
-
-            ESP_LOGI(TAG, "Total packet size: %d bytes (nonce: %d + length: 2 + data: %d + hmac: %d)",
-                     AES_BLOCK_SIZE + 2 + packet.data_len + HMAC_SIZE, AES_BLOCK_SIZE, packet.data_len, HMAC_SIZE);
-            ESP_LOGI(TAG, "========================================\n");
+        if (LINK_NEGOTIATION && wait > LINK_POLL_TICKS) {
+            wait = LINK_POLL_TICKS;
+        }
+        if (xQueueReceive(uart_queue, &event, wait) != pdTRUE) {
+            if (LINK_NEGOTIATION) {
+                link_service();
+            }
+            if (cuart_parser_busy(&parser) &&
+                xTaskGetTickCount() - last_rx >= pdMS_TO_TICKS(RX_FRAME_TIMEOUT_MS)) {
+                ESP_LOGW(TAG, "Incomplete frame dropped after %d ms of silence", RX_FRAME_TIMEOUT_MS);
+                cuart_parser_reset(&parser);
+            }
+            continue;
+        }
+        last_rx = xTaskGetTickCount();
+
+        switch (event.type) {
+        case UART_DATA:
+            break;
+
+        case UART_FRAME_ERR:
+        case UART_BREAK:
+            // Usually the sender on another rate than ours
+            link_report(false);
+            if (LINK_NEGOTIATION) {
+                link_service();
+            }
+            continue;
+
+        case UART_FIFO_OVF:
+        case UART_BUFFER_FULL:
+            // Bytes were lost: the partial frame is garbage
+            ESP_LOGW(TAG, "UART RX overflow, flushing input");
+            uart_flush_input(UART_NUM);
+            xQueueReset(uart_queue);
+            cuart_parser_reset(&parser);
+            continue;
+
+        default:
+            continue;
         }
 
-        // Small delay to prevent tight loop
-        vTaskDelay(pdMS_TO_TICKS(10));
+        // Drain everything buffered so far, not just this event's bytes. Each
+        // read lands where the parser wants it, so the driver's ring buffer
+        // copy is the only one.
+        while (1) {
+            uint8_t *dst;
+            size_t want;
+            cuart_parse_result_t result = cuart_parser_poll(&parser, &dst, &want);
+
+            if (result == CUART_PARSE_FRAME) {
+                // The whole frame, tracing included
+                uint32_t start = esp_cpu_get_cycle_count();
+
+                ack_due = true;
+                cuart_parser_view(&parser, &frame);
+                if (verify_and_decrypt(&frame, &plaintext, &plaintext_len, &cycles)) {
+                    message_count += report_message(&frame, plaintext, plaintext_len, message_count, cycles,
+                                                    esp_cpu_get_cycle_count() - start);
+                }
+                continue;
+            }
+            if (result == CUART_PARSE_BAD_LENGTH) {
+                ESP_LOGE(TAG, "Invalid data length, frame dropped");
+                link_report(false);
+                continue;
+            }
+
+            int n = uart_read_bytes(UART_NUM, dst, want, 0);
+            if (n <= 0) {
+                break;
+            }
+            cuart_parser_commit(&parser, (size_t)n);
+
+            // A link frame is never part of a packet: drop the one it landed
+            // in, and keep the bytes after it, which start the next packet
+            if (LINK_NEGOTIATION) {
+                size_t link_end = cuart_link_input(&link, dst, (size_t)n, link_now_ms());
+
+                if (link_end > 0) {
+                    cuart_parser_restart(&parser, (size_t)n - link_end);
+                }
+            }
+        }
+        if (RELIABLE) {
+            send_ack();
+        }
+        if (LINK_NEGOTIATION) {
+            link_service();
+        }
     }
 }
 
@@ -194,14 +630,47 @@ void app_main(void) {
     ESP_LOGI(TAG, "Initializing AES-128 CTR decryption...");
 
     // Initialize AES with pre-shared key
-    aes_init(AES_SHARED_KEY);
+    aes_ctr_setkey(&ctr_ctx, AES_SHARED_KEY);
+    hmac_sha256_setkey(&hmac_key, HMAC_KEY, sizeof(HMAC_KEY));
+    aes_gcm_setkey(&gcm_ctx, AES_SHARED_KEY);
+    frame_ctx.wire = WIRE_AEAD ? CUART_WIRE_AEAD : CUART_WIRE_HMAC;
+    frame_ctx.ctr = &ctr_ctx;
+    frame_ctx.hmac_key = &hmac_key;
+    frame_ctx.gcm = &gcm_ctx;
+    if (SESSION_NONCES) {
+        nvs_init();
+        cuart_session_rx_resume(&session, session_epoch_load());
+    } else {
+        cuart_session_rx_init(&session);
+    }
+    if (LINK_NEGOTIATION) {
+        cuart_link_init(&link, CUART_LINK_RESPONDER, cuart_link_rates_upto(LINK_MAX_BAUD), LINK_FLOW,
+                        link_now_ms());
+    }
+    cuart_parser_init(&parser,
+                      SESSION_NONCES ? CUART_SESSION_SEQ_SIZE : (WIRE_AEAD ? AES_GCM_NONCE_SIZE : AES_BLOCK_SIZE),
+                      cuart_frame_mac_size(frame_ctx.wire), SYNC_FRAMING);
+    ESP_LOGI(TAG, "Wire format: %s%s%s%s", WIRE_AEAD ? "AES-128-GCM" : "AES-128-CTR + HMAC-SHA256",
+             SESSION_NONCES ? ", session nonces" : "", SYNC_FRAMING ? ", sync framing" : "",
+             BATCHING ? ", batched records" : "");
+    if (LINK_NEGOTIATION) {
+        ESP_LOGI(TAG, "Link negotiation: up to %d baud%s", LINK_MAX_BAUD, LINK_FLOW ? ", RTS/CTS wired" : "");
+    }
+    if (RELIABLE) {
+        cuart_arq_rx_init(&arq_rx);
+        ESP_LOGI(TAG, "Reliable delivery: duplicates dropped, arrivals acknowledged");
+    }
     ESP_LOGI(TAG, "AES initialized with shared key");
+    ESP_LOGI(TAG, "Packet tracing: %s", CUART_TRACE_MODE_NAME);
+    if (CUART_TRACE_DEFERRED && !cuart_trace_start()) {
+        ESP_LOGE(TAG, "Trace task not started, deferred dumps will not be printed");
+    }
 
     // Initialize UART
     uart_init();
 
     // Create receiver task
-    xTaskCreate(receiver_task, "receiver_task", 8192, NULL, 5, NULL);
+    xTaskCreate(receiver_task, "receiver_task", RECEIVER_TASK_STACK_SIZE, NULL, 5, NULL);
 
     ESP_LOGI(TAG, "Receiver ready, waiting for encrypted data...");
 }
@@ -0,0 +1,644 @@
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "aes_wrapper.h"
+#include "aes_gcm.h"
+#include "cuart_session.h"
+#include "cuart_pool.h"
+#include "cuart_batch.h"
+#include "cuart_compress.h"
+#include "cuart_link.h"
+#include "cuart_arq.h"
+#include "cuart_trace.h"
+#include "cuart_send.h"
+
+static const char *TAG = "CUART_SEND";
+
+// Session nonces from menuconfig: the NONCE field carries a 4-byte sequence
+// number and the IV is derived from a per-session salt (see cuart_session.h)
+#if CONFIG_CUART_SESSION_NONCES
+#define SESSION_NONCES 1
+#define SESSION_ANNOUNCE_INTERVAL CONFIG_CUART_SESSION_ANNOUNCE_INTERVAL
+#else
+#define SESSION_NONCES 0
+#define SESSION_ANNOUNCE_INTERVAL 1
+#endif
+
+// Sync framing from menuconfig: each packet is preceded by a sync word and
+// header CRC so the receiver can resynchronize after lost bytes
+#if CONFIG_CUART_SYNC_FRAMING
+#define SYNC_FRAMING 1
+#else
+#define SYNC_FRAMING 0
+#endif
+
+// Batching from menuconfig: messages queued within the window share one
+// packet as length-prefixed records (see cuart_batch.h)
+#if CONFIG_CUART_BATCHING
+#define BATCHING 1
+#define BATCH_MAX_BYTES CONFIG_CUART_BATCH_MAX_BYTES
+#define BATCH_WINDOW_US CONFIG_CUART_BATCH_WINDOW_US
+#else
+#define BATCHING 0
+#define BATCH_MAX_BYTES 0
+#define BATCH_WINDOW_US 0
+#endif
+
+// Compression from menuconfig: payloads that shrink are sent compressed,
+// flagged in the LEN field (see cuart_compress.h)
+#if CONFIG_CUART_COMPRESSION
+#define COMPRESSION 1
+#else
+#define COMPRESSION 0
+#endif
+
+// Link negotiation from menuconfig: the TX task brings the line up at the
+// safe rate and moves it to the fastest rate the receiver can run (see
+// cuart_link.h); RTS/CTS is offered only when both pins are wired
+#if CONFIG_CUART_LINK_NEGOTIATION
+#define LINK_NEGOTIATION 1
+#define LINK_MAX_BAUD CONFIG_CUART_LINK_MAX_BAUD
+#define LINK_FLOW (CONFIG_CUART_LINK_RTS_GPIO >= 0 && CONFIG_CUART_LINK_CTS_GPIO >= 0)
+#else
+#define LINK_NEGOTIATION 0
+#define LINK_MAX_BAUD CUART_LINK_SAFE_BAUD
+#define LINK_FLOW 0
+#endif
+
+// Reliable delivery from menuconfig: payloads start with a sequence number,
+// and the TX task keeps data frames until the receiver acknowledges them over
+// the link (see cuart_arq.h)
+#if CONFIG_CUART_RELIABLE
+#define RELIABLE 1
+#define ARQ_WINDOW CONFIG_CUART_RELIABLE_WINDOW
+#define ARQ_TIMEOUT_MS CONFIG_CUART_RELIABLE_TIMEOUT_MS
+#define ARQ_MAX_TRIES CONFIG_CUART_RELIABLE_MAX_TRIES
+#else
+#define RELIABLE 0
+#define ARQ_WINDOW 0
+#define ARQ_TIMEOUT_MS 0
+#define ARQ_MAX_TRIES 0
+#endif
+#define ARQ_HEADER (RELIABLE ? CUART_ARQ_HEADER_SIZE : 0)
+
+// How often the TX task runs the link while no frame is queued, and the RX
+// FIFO level at which RTS holds the receiver's sender back
+#define LINK_POLL_MS 10
+#define LINK_POLL_TICKS (pdMS_TO_TICKS(LINK_POLL_MS) > 0 ? pdMS_TO_TICKS(LINK_POLL_MS) : 1)
+#define LINK_RTS_THRESHOLD 122
+
+// Batching window in ticks, rounded up
+#define BATCH_WINDOW_TICKS ((TickType_t)(((uint64_t)BATCH_WINDOW_US * configTICK_RATE_HZ + 999999) / 1000000))
+
+// Crypto on the application core, UART writes on the protocol core (where
+// the UART driver's interrupt is installed); one core on single-core chips
+#if CONFIG_FREERTOS_UNICORE
+#define CRYPTO_TASK_CORE 0
+#define TX_TASK_CORE 0
+#else
+#define CRYPTO_TASK_CORE 1
+#define TX_TASK_CORE 0
+#endif
+
+// Task stacks (bytes): frames live in the pool, so only locals and logging
+#define CRYPTO_TASK_STACK_SIZE 4096
+#define TX_TASK_STACK_SIZE 3072
+
+// The TX task runs above the crypto task so the UART never waits on crypto
+#define CRYPTO_TASK_PRIORITY 5
+#define TX_TASK_PRIORITY 6
+
+// Every frame in the pool fits in either queue, so queue sends never block
+#define QUEUE_LEN (CUART_POOL_SMALL_FRAMES + CUART_POOL_LARGE_FRAMES)
+
+// Batch frames: one filling in the crypto task while the other is on the
+// wire, plus those held for the window with reliable delivery
+#define BATCH_FRAMES (2 + (BATCHING ? ARQ_WINDOW : 0))
+
+// Record table room in a batch frame, after the reliable delivery header
+#define BATCH_LIMIT (BATCH_MAX_BYTES - ARQ_HEADER)
+
+// Keys and wire format, and the NONCE field length they imply
+static cuart_frame_ctx_t frame_ctx;
+static size_t nonce_len;
+static uart_port_t uart_num;
+
+// Frames holding plaintext (cuart_send() -> crypto task) and sealed frames
+// (crypto task -> TX task), passed by pointer
+static QueueHandle_t plain_queue;
+static QueueHandle_t tx_queue;
+
+// Given by the TX task each time it returns a frame to the pool; counting, so
+// every producer waiting in cuart_send() wakes when several frames come back
+static SemaphoreHandle_t frame_freed;
+
+// Session salt and sequence number, and packets sealed since the salt was
+// last announced (crypto task only)
+static cuart_session_tx_t session;
+static uint32_t packets_since_announce;
+
+// Frame reserved for salt announcements, so producers that exhaust the pool
+// cannot starve them; the TX task gives announce_done instead of freeing it
+static cuart_pool_frame_t *announce_frame;
+static SemaphoreHandle_t announce_done;
+
+// Batch frames, outside the pool so that producers filling the pool cannot
+// keep the crypto task from batching; the TX task hands them back through
+// batch_spare
+static uint8_t batch_blocks[BATCH_FRAMES][CUART_POOL_BLOCK_FOR(BATCH_MAX_BYTES)];
+static cuart_pool_frame_t batch_frames[BATCH_FRAMES];
+static QueueHandle_t batch_spare;
+
+// Compressor state and compressed payload, encrypted from here into the
+// frame (crypto task only)
+static cuart_compress_t compressor;
+static uint8_t packed[CUART_FRAME_MAX_PAYLOAD];
+
+// Link negotiation state and the settings applied to the UART (TX task only)
+static cuart_link_t link;
+static uint32_t link_baud;
+static bool link_flow;
+
+// Reliable delivery: the sender window (TX task only), the next sequence
+// number (crypto task only), the window's oldest packet as the crypto task
+// sees it, and a credit per packet the window has room for, given by the TX
+// task as acknowledged packets leave the window
+static cuart_arq_tx_t arq_tx;
+static uint16_t arq_seq;
+static volatile uint16_t arq_base;
+static SemaphoreHandle_t window_open;
+
+// Copy of the last salt announcement, sent again with timed-out packets in
+// case it was the one lost: the receiver cannot open them without it
+static uint8_t announce_copy_block[CUART_POOL_BLOCK_FOR(CUART_SESSION_ANNOUNCE_SIZE)];
+static cuart_pool_frame_t announce_copy = {
+    .data = announce_copy_block,
+    .capacity = sizeof(announce_copy_block),
+};
+
+// queued and waits are written by cuart_send() callers, the rest by one task each
+static cuart_send_stats_t stats;
+
+/**
+ * @brief Start of the payload in a frame: the plaintext is staged where the
+ *        ciphertext goes, after the reliable delivery header if enabled, and
+ *        encrypted in place
+ */
+static uint8_t *frame_body(cuart_pool_frame_t *frame) {
+    return cuart_pool_packet(frame) + nonce_len + 2 + ARQ_HEADER;
+}
+
+/**
+ * @brief Give a written or consumed frame back to where it came from
+ */
+static void release_frame(cuart_pool_frame_t *frame) {
+    if (frame == announce_frame) {
+        xSemaphoreGive(announce_done);
+    } else if (frame >= batch_frames && frame < batch_frames + BATCH_FRAMES) {
+        xQueueSend(batch_spare, &frame, 0);
+    } else {
+        cuart_pool_free(frame);
+        xSemaphoreGive(frame_freed);
+    }
+}
+
+/**
+ * @brief Fill a packet's NONCE field and the IV it stands for
+ *
+ * In session mode the field is the next sequence number and the IV is
+ * salt || seq || 0; otherwise the field is a fresh random nonce and is the IV.
+ *
+ * @param field Pointer to the NONCE field
+ * @param iv Pointer to 16-byte IV
+ */
+static void next_nonce(uint8_t *field, uint8_t *iv) {
+    if (SESSION_NONCES) {
+        uint32_t seq = cuart_session_next_seq(&session, NULL);
+
+        cuart_session_put_seq(seq, field);
+        cuart_session_iv(session.salt, seq, iv);
+        packets_since_announce++;
+        return;
+    }
+
+    cuart_port_random(field, nonce_len);
+    memset(iv, 0, AES_BLOCK_SIZE);
+    memcpy(iv, field, nonce_len);
+}
+
+/**
+ * @brief Add the sync header if enabled and queue a sealed frame for the TX task
+ */
+static void queue_sealed(cuart_pool_frame_t *frame, size_t field_len) {
+    if (SYNC_FRAMING) {
+        cuart_frame_sync_header(frame->data, cuart_pool_packet(frame), field_len);
+    }
+    xQueueSend(tx_queue, &frame, portMAX_DELAY);
+}
+
+/**
+ * @brief Seal a salt announcement: [SEQ 0][LENGTH 12][SALT][EPOCH][HMAC or TAG]
+ *
+ * The salt and epoch are sent in clear and authenticated under
+ * IV = salt || 0 || 0, the same way as a data packet of the configured wire
+ * format.
+ */
+static void announce_salt(void) {
+    cuart_pool_frame_t *frame = announce_frame;
+    uint8_t iv[AES_BLOCK_SIZE];
+    uint8_t announce[CUART_SESSION_ANNOUNCE_SIZE];
+
+    // The previous announcement is normally long gone
+    xSemaphoreTake(announce_done, portMAX_DELAY);
+
+    uint8_t *packet = cuart_pool_packet(frame);
+    cuart_session_put_seq(CUART_SESSION_ANNOUNCE_SEQ, packet);
+    cuart_session_iv(session.salt, CUART_SESSION_ANNOUNCE_SEQ, iv);
+    cuart_session_put_announce(&session, announce);
+    frame->len = cuart_frame_seal(&frame_ctx, packet, packet, CUART_SESSION_SEQ_SIZE, iv,
+                                  announce, sizeof(announce), false);
+    queue_sealed(frame, CUART_SESSION_SEQ_SIZE);
+
+    packets_since_announce = 0;
+    stats.announcements++;
+    CUART_TRACE_FIELD(TAG, "Announced session", announce, sizeof(announce));
+}
+
+/**
+ * @brief Announce the salt when due: at start, every SESSION_ANNOUNCE_INTERVAL
+ *        packets (so a restarted receiver resynchronizes), and after a new salt
+ */
+static void announce_salt_if_due(void) {
+    // Start a new session before the sequence number space runs out
+    if (session.seq == UINT32_MAX) {
+        cuart_session_tx_init(&session);
+        packets_since_announce = SESSION_ANNOUNCE_INTERVAL;
+    }
+
+    if (packets_since_announce >= SESSION_ANNOUNCE_INTERVAL) {
+        announce_salt();
+    }
+}
+
+/**
+ * @brief Copy queued messages into a batch frame as records
+ *
+ * Starts with first and keeps taking messages until BATCH_WINDOW_TICKS have
+ * passed since then, the queue stays empty that long, or the next message
+ * does not fit (it stays queued and starts the next batch). Each message's
+ * frame goes back to the pool as soon as it is copied, so producers are not
+ * held up by the window.
+ *
+ * @param first Frame holding the first message
+ * @return Batch frame with the record table as its plaintext
+ */
+static cuart_pool_frame_t *collect_batch(cuart_pool_frame_t *first) {
+    cuart_pool_frame_t *batch_frame;
+    cuart_pool_frame_t *frame = first;
+    cuart_batch_t batch;
+    TickType_t start = xTaskGetTickCount();
+
+    xQueueReceive(batch_spare, &batch_frame, portMAX_DELAY);
+    cuart_batch_init(&batch, frame_body(batch_frame), BATCH_LIMIT);
+
+    while (1) {
+        // Fits: cuart_send() limits messages to an empty batch
+        cuart_batch_add(&batch, frame_body(frame), frame->len);
+        release_frame(frame);
+        stats.records++;
+
+        // Ticks left in the window; the difference wraps once it is over
+        TickType_t wait = start + BATCH_WINDOW_TICKS - xTaskGetTickCount();
+        if (wait > BATCH_WINDOW_TICKS) {
+            wait = 0;
+        }
+
+        if (!cuart_batch_fits(&batch, 1) ||
+            xQueuePeek(plain_queue, &frame, wait) != pdTRUE ||
+            !cuart_batch_fits(&batch, frame->len)) {
+            break;
+        }
+        xQueueReceive(plain_queue, &frame, 0);
+    }
+
+    batch_frame->len = (uint16_t)batch.len;
+    ESP_LOGD(TAG, "Batched %u records, %u payload bytes", (unsigned)batch.count, (unsigned)batch.len);
+    return batch_frame;
+}
+
+/**
+ * @brief Crypto task: nonce, encrypt and authenticate each queued frame in place
+ *
+ * frame->len holds the plaintext length on the way in and the packet length
+ * on the way out. With batching, the frame sealed is a batch frame carrying
+ * this message and whatever follows it within the window. With reliable
+ * delivery, a data packet is sealed only when the window has room for it.
+ */
+static void crypto_task(void *arg) {
+    cuart_pool_frame_t *frame;
+    uint8_t iv[AES_BLOCK_SIZE];
+
+    while (1) {
+        xQueueReceive(plain_queue, &frame, portMAX_DELAY);
+
+        if (SESSION_NONCES) {
+            announce_salt_if_due();
+        }
+        if (BATCHING) {
+            frame = collect_batch(frame);
+        } else {
+            stats.records++;
+        }
+
+        // The reliable delivery header goes in front, never compressed
+        uint8_t *payload = frame_body(frame) - ARQ_HEADER;
+        size_t length = frame->len;
+        uint16_t flags = 0;
+
+        // Only worth a flag if it saves at least a byte
+        if (COMPRESSION) {
+            size_t packed_len = cuart_compress(&compressor, frame_body(frame), length,
+                                               packed + ARQ_HEADER, length - 1);
+
+            if (packed_len > 0) {
+                stats.compressed++;
+                stats.bytes_saved += length - packed_len;
+                payload = packed;
+                length = packed_len;
+                flags = CUART_FRAME_FLAG_COMPRESSED;
+            }
+        }
+        if (RELIABLE) {
+            xSemaphoreTake(window_open, portMAX_DELAY);
+            cuart_arq_put_header(payload, arq_seq, arq_base);
+            arq_seq = (arq_seq + 1) & CUART_ARQ_SEQ_MASK;
+            length += ARQ_HEADER;
+        }
+
+        uint8_t *packet = cuart_pool_packet(frame);
+        next_nonce(packet, iv);
+        frame->len = cuart_frame_seal_flags(&frame_ctx, packet, packet, nonce_len, iv,
+                                            payload, length, true, flags);
+        CUART_TRACE_PACKET(TAG, "Sealed packet", packet, frame->len);
+
+        stats.sealed++;
+        queue_sealed(frame, nonce_len);
+    }
+}
+
+static uint32_t link_now_ms(void) {
+    return (uint32_t)(xTaskGetTickCount() * portTICK_PERIOD_MS);
+}
+
+/**
+ * @brief Apply the link's rate and flow control once what was sent before is out
+ */
+static void link_apply(void) {
+    uint32_t baud = cuart_link_baud(&link);
+
+    if (baud == link_baud && link.flow == link_flow) {
+        return;
+    }
+    uart_wait_tx_done(uart_num, pdMS_TO_TICKS(100));
+    uart_set_baudrate(uart_num, baud);
+    uart_set_hw_flow_ctrl(uart_num, link.flow ? UART_HW_FLOWCTRL_CTS_RTS : UART_HW_FLOWCTRL_DISABLE,
+                          LINK_RTS_THRESHOLD);
+    // Whatever arrived around the change was sent at the other rate
+    uart_flush_input(uart_num);
+
+    if (baud < link_baud) {
+        ESP_LOGW(TAG, "Link: fell back to %u baud", (unsigned)baud);
+    } else {
+        ESP_LOGI(TAG, "Link: %u baud%s", (unsigned)baud, link.flow ? ", RTS/CTS" : "");
+    }
+    link_baud = baud;
+    link_flow = link.flow;
+    stats.link_baud = baud;
+}
+
+/**
+ * @brief Feed the return wire to the link and send what it asks for
+ */
+static void link_service(void) {
+    uint8_t rx[64];
+    uint8_t out[CUART_LINK_FRAME_SIZE];
+    uint32_t now = link_now_ms();
+    int got;
+
+    while ((got = uart_read_bytes(uart_num, rx, sizeof(rx), 0)) > 0) {
+        cuart_link_input(&link, rx, (size_t)got, now);
+    }
+    while (cuart_link_poll(&link, now, out) > 0) {
+        uart_write_bytes(uart_num, out, sizeof(out));
+        link_apply();
+    }
+    link_apply();
+    stats.link_fallbacks = link.stats.fallbacks + link.stats.check_failures;
+}
+
+/**
+ * @brief Write a sealed frame, sync header included, in one driver call
+ */
+static void write_frame(cuart_pool_frame_t *frame) {
+    const uint8_t *out = SYNC_FRAMING ? frame->data : cuart_pool_packet(frame);
+    size_t len = (SYNC_FRAMING ? CUART_FRAME_SYNC_SIZE : 0) + frame->len;
+    int sent = uart_write_bytes(uart_num, out, len);
+
+    if (sent != (int)len) {
+        stats.tx_errors++;
+        ESP_LOGE(TAG, "Failed to send packet (%d of %d bytes)", sent, (int)len);
+        return;
+    }
+    stats.frames_sent++;
+    stats.bytes_sent += len;
+}
+
+/**
+ * @brief Take in the receiver's ACKs, send again what they or the timeout
+ *        call for, and free what has left the window
+ */
+static void arq_service(void) {
+    cuart_pool_frame_t *frame;
+    uint32_t timeouts = arq_tx.stats.timeouts;
+    int opened = 0;
+
+    if (link.acks_new) {
+        link.acks_new = false;
+        cuart_arq_tx_ack(&arq_tx, link.acks);
+    }
+    while ((frame = cuart_arq_tx_resend(&arq_tx, link_now_ms())) != NULL) {
+        // Nothing heard back: the salt may be what the receiver is missing
+        if (SESSION_NONCES && arq_tx.stats.timeouts != timeouts && announce_copy.len > 0) {
+            write_frame(&announce_copy);
+            timeouts = arq_tx.stats.timeouts;
+        }
+        write_frame(frame);
+    }
+    while ((frame = cuart_arq_tx_release(&arq_tx)) != NULL) {
+        release_frame(frame);
+        opened++;
+    }
+
+    // The crypto task reads the new base once it has the credit
+    arq_base = arq_tx.base;
+    for (; opened > 0; opened--) {
+        xSemaphoreGive(window_open);
+    }
+    stats.retransmits = arq_tx.stats.fast_retransmits + arq_tx.stats.timeouts;
+    stats.abandoned = arq_tx.stats.abandoned;
+}
+
+/**
+ * @brief TX task: write each sealed frame in one driver call and free it
+ *
+ * With link negotiation it also runs the link, and holds frames back while
+ * the link is not up; the pool then pushes back on cuart_send(). With
+ * reliable delivery, data frames stay in the window once written and are
+ * freed by arq_service() when acknowledged.
+ */
+static void tx_task(void *arg) {
+    cuart_pool_frame_t *frame;
+
+    while (1) {
+        if (LINK_NEGOTIATION) {
+            link_service();
+            if (!cuart_link_up(&link)) {
+                vTaskDelay(LINK_POLL_TICKS);
+                continue;
+            }
+            if (RELIABLE) {
+                arq_service();
+            }
+            if (xQueueReceive(tx_queue, &frame, LINK_POLL_TICKS) != pdTRUE) {
+                continue;
+            }
+        } else {
+            xQueueReceive(tx_queue, &frame, portMAX_DELAY);
+        }
+
+        write_frame(frame);
+
+        if (RELIABLE && frame == announce_frame) {
+            memcpy(announce_copy.data, frame->data, announce_copy.capacity);
+            announce_copy.len = frame->len;
+        } else if (RELIABLE) {
+            cuart_arq_tx_sent(&arq_tx, frame, link_now_ms());
+            continue;
+        }
+        release_frame(frame);
+    }
+}
+
+esp_err_t cuart_send_start(const cuart_frame_ctx_t *ctx, uart_port_t uart) {
+    frame_ctx = *ctx;
+    uart_num = uart;
+    if (SESSION_NONCES) {
+        nonce_len = CUART_SESSION_SEQ_SIZE;
+    } else {
+        nonce_len = (ctx->wire == CUART_WIRE_AEAD) ? AES_GCM_NONCE_SIZE : AES_BLOCK_SIZE;
+    }
+
+    plain_queue = xQueueCreate(QUEUE_LEN, sizeof(cuart_pool_frame_t *));
+    tx_queue = xQueueCreate(QUEUE_LEN + BATCH_FRAMES, sizeof(cuart_pool_frame_t *));
+    frame_freed = xSemaphoreCreateCounting(QUEUE_LEN, 0);
+    announce_done = xSemaphoreCreateBinary();
+    if (plain_queue == NULL || tx_queue == NULL || frame_freed == NULL || announce_done == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    cuart_pool_init();
+    stats.link_baud = CUART_LINK_SAFE_BAUD;
+    if (LINK_NEGOTIATION) {
+        link_baud = CUART_LINK_SAFE_BAUD;
+        cuart_link_init(&link, CUART_LINK_INITIATOR, cuart_link_rates_upto(LINK_MAX_BAUD), LINK_FLOW,
+                        link_now_ms());
+    }
+    if (COMPRESSION) {
+        cuart_compress_init(&compressor);
+    }
+    if (RELIABLE) {
+        window_open = xSemaphoreCreateCounting(ARQ_WINDOW, ARQ_WINDOW);
+        if (window_open == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+        cuart_arq_tx_init(&arq_tx, ARQ_WINDOW, ARQ_TIMEOUT_MS, ARQ_MAX_TRIES);
+    }
+    if (SESSION_NONCES) {
+        // One RNG draw per session instead of one per packet
+        cuart_session_tx_init(&session);
+        packets_since_announce = SESSION_ANNOUNCE_INTERVAL;
+        announce_frame = cuart_pool_alloc(CUART_SESSION_ANNOUNCE_SIZE);
+        xSemaphoreGive(announce_done);
+    }
+    if (BATCHING) {
+        batch_spare = xQueueCreate(BATCH_FRAMES, sizeof(cuart_pool_frame_t *));
+        if (batch_spare == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+        for (int i = 0; i < BATCH_FRAMES; i++) {
+            cuart_pool_frame_t *frame = &batch_frames[i];
+
+            frame->data = batch_blocks[i];
+            frame->capacity = sizeof(batch_blocks[i]);
+            xQueueSend(batch_spare, &frame, 0);
+        }
+    }
+
+    if (xTaskCreatePinnedToCore(tx_task, "cuart_tx", TX_TASK_STACK_SIZE, NULL,
+                                TX_TASK_PRIORITY, NULL, TX_TASK_CORE) != pdPASS ||
+        xTaskCreatePinnedToCore(crypto_task, "cuart_crypto", CRYPTO_TASK_STACK_SIZE, NULL,
+                                CRYPTO_TASK_PRIORITY, NULL, CRYPTO_TASK_CORE) != pdPASS) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG, "Pipeline started: crypto on core %d, TX on core %d%s%s",
+             CRYPTO_TASK_CORE, TX_TASK_CORE, SYNC_FRAMING ? ", sync framing" : "",
+             SESSION_NONCES ? ", session nonces" : "");
+    if (SESSION_NONCES) {
+        ESP_LOGI(TAG, "Session nonces: salt announced every %d packets", SESSION_ANNOUNCE_INTERVAL);
+    }
+    if (COMPRESSION) {
+        ESP_LOGI(TAG, "Compression: preset-dictionary LZ, flagged packets");
+    }
+    if (LINK_NEGOTIATION) {
+        ESP_LOGI(TAG, "Link negotiation: up to %d baud%s", LINK_MAX_BAUD, LINK_FLOW ? ", RTS/CTS wired" : "");
+    }
+    if (RELIABLE) {
+        ESP_LOGI(TAG, "Reliable delivery: window %d, timeout %d ms, %d tries", ARQ_WINDOW, ARQ_TIMEOUT_MS,
+                 ARQ_MAX_TRIES);
+    }
+    if (BATCHING) {
+        ESP_LOGI(TAG, "Batching: up to %d payload bytes or %d us per packet", BATCH_MAX_BYTES, BATCH_WINDOW_US);
+    }
+    return ESP_OK;
+}
+
+esp_err_t cuart_send(const uint8_t *buf, size_t len) {
+    cuart_pool_frame_t *frame;
+
+    if (len == 0 || len > (BATCHING ? BATCH_LIMIT - CUART_BATCH_RECORD_HEADER : CUART_FRAME_MAX_PAYLOAD - ARQ_HEADER)) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (plain_queue == NULL) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // Every frame is queued or on the wire: wait for the TX task to free one
+    while ((frame = cuart_pool_alloc(len + ARQ_HEADER)) == NULL) {
+        stats.waits++;
+        xSemaphoreTake(frame_freed, portMAX_DELAY);
+    }
+
+    memcpy(frame_body(frame), buf, len);
+    frame->len = (uint16_t)len;
+    stats.queued++;
+    xQueueSend(plain_queue, &frame, portMAX_DELAY);
+    return ESP_OK;
+}
+
+void cuart_send_stats(cuart_send_stats_t *out) {
+    *out = stats;
+}
@@ -0,0 +1,106 @@
+#ifndef CUART_SEND_H
+#define CUART_SEND_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "driver/uart.h"
+#include "cuart_frame.h"
+
+/*
+ * Pipelined sender: cuart_send() copies a message into a frame from the
+ * frame pool (cuart_pool.h) and queues it. A crypto task pinned to one core
+ * assigns the nonce, encrypts and authenticates the frame in place and
+ * passes it on; a TX task pinned to the other core writes it to the UART and
+ * returns it to the pool. Frame N+1 is sealed while frame N is on the wire,
+ * and only pointers move between the tasks.
+ *
+ *   cuart_send() --plain queue--> crypto task --TX queue--> TX task --> UART
+ *        ^                                                     |
+ *        +------------------- frame pool <---------------------+
+ *
+ * Session salt announcements (CONFIG_CUART_SESSION_NONCES) are sealed by the
+ * crypto task in order with the data packets, and sync headers
+ * (CONFIG_CUART_SYNC_FRAMING) are added there too, so the TX task only ever
+ * does one uart_write_bytes() per frame.
+ *
+ * With batching (CONFIG_CUART_BATCHING) the crypto task copies the messages
+ * queued within CONFIG_CUART_BATCH_WINDOW_US of the first, up to
+ * CONFIG_CUART_BATCH_MAX_BYTES, into one batch frame as records
+ * (cuart_batch.h) and seals them as one packet.
+ *
+ * With compression (CONFIG_CUART_COMPRESSION) the crypto task compresses
+ * each payload (cuart_compress.h) and encrypts the compressed bytes into the
+ * frame when they are fewer, flagging the packet.
+ *
+ * With link negotiation (CONFIG_CUART_LINK_NEGOTIATION) the TX task also
+ * runs the sender's end of the link (cuart_link.h) over the UART's RX line,
+ * changes the UART's rate and flow control as it moves, and holds frames
+ * back while it is not up.
+ *
+ * With reliable delivery (CONFIG_CUART_RELIABLE) the crypto task puts a
+ * sequence number in front of each payload (cuart_arq.h), sealing no more
+ * than the window ahead of what the receiver has acknowledged, and the TX
+ * task holds each data frame after writing it until it is acknowledged,
+ * sending it again when it is lost.
+ *
+ * Backpressure comes from the pool: when every fitting frame is queued or on
+ * the wire, cuart_send() waits for the TX task to free one. Producers can
+ * call it as fast as they like and are paced at line rate.
+ */
+
+/**
+ * @brief Pipeline counters
+ */
+typedef struct {
+    uint32_t queued;            // messages accepted by cuart_send()
+    uint32_t waits;             // times cuart_send() waited for a free frame
+    uint32_t records;           // messages sealed into data packets
+    uint32_t sealed;            // data packets sealed by the crypto task
+    uint32_t compressed;        // data packets sent compressed
+    uint32_t bytes_saved;       // payload bytes saved by compression
+    uint32_t announcements;     // salt announcements sealed
+    uint32_t frames_sent;       // frames written to the UART
+    uint32_t bytes_sent;        // bytes written to the UART, sync headers included
+    uint32_t tx_errors;         // short or failed UART writes
+    uint32_t link_baud;         // line rate in use
+    uint32_t link_fallbacks;    // rates abandoned by link negotiation
+    uint32_t retransmits;       // data packets sent again by reliable delivery
+    uint32_t abandoned;         // data packets given up after the last try
+} cuart_send_stats_t;
+
+/**
+ * @brief Start the crypto and TX tasks
+ *
+ * Initializes the frame pool. The UART driver must already be installed, and
+ * with session nonces NVS too (nvs_flash_init()): it holds the session epoch.
+ *
+ * @param ctx Keys and wire format (copied; the contexts it points to must stay valid)
+ * @param uart UART to send on
+ * @return ESP_OK, or ESP_ERR_NO_MEM if a queue or task could not be created
+ */
+esp_err_t cuart_send_start(const cuart_frame_ctx_t *ctx, uart_port_t uart);
+
+/**
+ * @brief Queue a message for encryption and transmission
+ *
+ * Copies the message, so buf can be reused as soon as this returns. Blocks
+ * while the frame pool is exhausted. Safe to call from several tasks.
+ *
+ * @param buf Pointer to plaintext
+ * @param len Length of plaintext (1 to CUART_FRAME_MAX_PAYLOAD, or to
+ *            CONFIG_CUART_BATCH_MAX_BYTES - 2 with batching; 2 less with
+ *            reliable delivery)
+ * @return ESP_OK, ESP_ERR_INVALID_SIZE for an empty or oversized message, or
+ *         ESP_ERR_INVALID_STATE before cuart_send_start()
+ */
+esp_err_t cuart_send(const uint8_t *buf, size_t len);
+
+/**
+ * @brief Snapshot the pipeline counters
+ *
+ * @param stats Pointer to output
+ */
+void cuart_send_stats(cuart_send_stats_t *stats);
+
+#endif // CUART_SEND_H
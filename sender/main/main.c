@@ -5,7 +5,13 @@
 #include "driver/uart.h"
 #include "driver/gpio.h"
 #include "esp_log.h"
+#include "nvs_flash.h"
 #include "aes_wrapper.h"
+#include "aes_gcm.h"
+#include "cuart_frame.h"
+#include "cuart_pool.h"
+#include "cuart_send.h"
+#include "cuart_trace.h"
 
 static const char *TAG = "SENDER";
 
@@ -16,6 +22,22 @@ static const char *TAG = "SENDER";
 #define UART_BAUD_RATE 115200
 #define BUF_SIZE 1024
 
+// RTS/CTS pins for link negotiation; unwired pins stay unassigned
+#if CONFIG_CUART_LINK_NEGOTIATION
+#define RTS_PIN CONFIG_CUART_LINK_RTS_GPIO
+#define CTS_PIN CONFIG_CUART_LINK_CTS_GPIO
+#else
+#define RTS_PIN UART_PIN_NO_CHANGE
+#define CTS_PIN UART_PIN_NO_CHANGE
+#endif
+
+// Demo task stack (bytes). It only queues messages: sealing and UART writes
+// happen in the pipeline tasks (cuart_send.c).
+#define SENDER_TASK_STACK_SIZE 3072
+
+// Delay between demo messages; 0 streams them back to back at line rate
+#define MESSAGE_INTERVAL_MS 5000
+
 // AES-128 Pre-shared Key (16 bytes)
 // In production, this should be securely stored and managed
 static const uint8_t AES_SHARED_KEY[AES_KEY_SIZE] = {
@@ -31,13 +53,35 @@ static const uint8_t HMAC_KEY[32] = {
     0x87, 0x96, 0xa5, 0xb4, 0xc3, 0xd2, 0xe1, 0xf0
 };
 
-// Packet structure: [NONCE(16 bytes)][LENGTH(2 bytes)][ENCRYPTED_DATA][HMAC(32 bytes)]
-typedef struct {
-    uint8_t nonce[AES_BLOCK_SIZE];
-    uint16_t data_len;
-    uint8_t data[BUF_SIZE];
-    uint8_t hmac[HMAC_SIZE];
-} encrypted_packet_t;
+// HMAC key pads, precomputed once in app_main()
+static hmac_sha256_key_t hmac_key;
+
+// Packet wire format from menuconfig: AES-128-GCM or AES-CTR + HMAC-SHA256
+#if CONFIG_CUART_WIRE_AEAD
+#define WIRE_AEAD 1
+#else
+#define WIRE_AEAD 0
+#endif
+
+// AES-128-CTR and AES-128-GCM contexts, keyed once in app_main()
+static aes_ctr_ctx_t ctr_ctx;
+static aes_gcm_ctx_t gcm_ctx;
+
+// Keys and wire format for the send pipeline
+static cuart_frame_ctx_t frame_ctx;
+
+/**
+ * @brief Initialize NVS, which holds the session epoch counter
+ */
+static void nvs_init(void) {
+    esp_err_t err = nvs_flash_init();
+
+    if (err == ESP_ERR_NVS_NO_FREE_PAGES || err == ESP_ERR_NVS_NEW_VERSION_FOUND) {
+        ESP_ERROR_CHECK(nvs_flash_erase());
+        err = nvs_flash_init();
+    }
+    ESP_ERROR_CHECK(err);
+}
 
 /**
  * @brief Initialize UART for communication
@@ -55,82 +99,59 @@ static void uart_init(void) {
     // Install UART driver (RX buffer, TX buffer, queue size, queue handle, interrupt flags)
     ESP_ERROR_CHECK(uart_driver_install(UART_NUM, BUF_SIZE * 2, BUF_SIZE * 2, 0, NULL, 0));
     ESP_ERROR_CHECK(uart_param_config(UART_NUM, &uart_config));
-    ESP_ERROR_CHECK(uart_set_pin(UART_NUM, TXD_PIN, RXD_PIN, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE));
+    ESP_ERROR_CHECK(uart_set_pin(UART_NUM, TXD_PIN, RXD_PIN,
+                                 RTS_PIN >= 0 ? RTS_PIN : UART_PIN_NO_CHANGE,
+                                 CTS_PIN >= 0 ? CTS_PIN : UART_PIN_NO_CHANGE));
 
     ESP_LOGI(TAG, "UART initialized on TX: GPIO%d, RX: GPIO%d", TXD_PIN, RXD_PIN);
 }
 
 /**
- * @brief Encrypt and send data over UART with HMAC authentication
+ * @brief Log frame pool occupancy and exhaustion counters
  */
-static void send_encrypted_data(const uint8_t *plaintext, size_t length) {
-    encrypted_packet_t packet;
-    uint8_t hmac_input[AES_BLOCK_SIZE + 2 + BUF_SIZE];
-    size_t hmac_input_len;
-    uint8_t length_bytes[2];
-
-    // Generate random nonce
-    aes_generate_nonce(packet.nonce);
-
-    // Encrypt the data
-    aes_encrypt_ctr(plaintext, packet.data, length, packet.nonce);
-    packet.data_len = (uint16_t)length;
-
-    // Prepare length as big-endian 2 bytes
-    length_bytes[0] = (packet.data_len >> 8) & 0xFF;
-    length_bytes[1] = packet.data_len & 0xFF;
-
-    // Compute HMAC over [NONCE || LENGTH || ENCRYPTED_DATA]
-    memcpy(hmac_input, packet.nonce, AES_BLOCK_SIZE);
-    memcpy(hmac_input + AES_BLOCK_SIZE, length_bytes, 2);
-    memcpy(hmac_input + AES_BLOCK_SIZE + 2, packet.data, length);
-    hmac_input_len = AES_BLOCK_SIZE + 2 + length;
-    compute_hmac_sha256(hmac_input, hmac_input_len, HMAC_KEY, sizeof(HMAC_KEY), packet.hmac);
-
-    // Log the operation
-    ESP_LOGI(TAG, "Encrypting %d bytes", length);
-    ESP_LOG_BUFFER_HEX_LEVEL(TAG, plaintext, length, ESP_LOG_INFO);
-    ESP_LOGI(TAG, "Nonce:");
-    ESP_LOG_BUFFER_HEX_LEVEL(TAG, packet.nonce, AES_BLOCK_SIZE, ESP_LOG_INFO);
-    ESP_LOGI(TAG, "Encrypted data:");
-    ESP_LOG_BUFFER_HEX_LEVEL(TAG, packet.data, length, ESP_LOG_INFO);
-    ESP_LOGI(TAG, "HMAC:");
-    ESP_LOG_BUFFER_HEX_LEVEL(TAG, packet.hmac, HMAC_SIZE, ESP_LOG_INFO);
-
-    // Send nonce first (16 bytes)
-    int nonce_sent = uart_write_bytes(UART_NUM, packet.nonce, AES_BLOCK_SIZE);
-    if (nonce_sent != AES_BLOCK_SIZE) {
-        ESP_LOGE(TAG, "Failed to send nonce");
-        return;
-    }
+static void log_pool_stats(void) {
+    cuart_pool_stats_t stats;
 
-    // Send length (2 bytes, big-endian)
-    int length_sent = uart_write_bytes(UART_NUM, length_bytes, 2);
-    if (length_sent != 2) {
-        ESP_LOGE(TAG, "Failed to send length");
-        return;
-    }
+    cuart_pool_stats(&stats);
+    for (int c = 0; c < CUART_POOL_CLASSES; c++) {
+        const cuart_pool_class_stats_t *cls = &stats.classes[c];
 
-    // Send encrypted data
-    int data_sent = uart_write_bytes(UART_NUM, packet.data, length);
-    if (data_sent != length) {
-        ESP_LOGE(TAG, "Failed to send encrypted data");
-        return;
+        ESP_LOGI(TAG, "Frame pool %s: %u/%u in use, high-water %u, %u allocs, %u exhausted",
+                 c == CUART_POOL_SMALL ? "small" : "large", (unsigned)cls->in_use, (unsigned)cls->frames,
+                 (unsigned)cls->high_water, (unsigned)cls->allocs, (unsigned)cls->exhausted);
     }
-
-    // Send HMAC (32 bytes)
-    int hmac_sent = uart_write_bytes(UART_NUM, packet.hmac, HMAC_SIZE);
-    if (hmac_sent != HMAC_SIZE) {
-        ESP_LOGE(TAG, "Failed to send HMAC");
-        return;
+    if (stats.failures > 0) {
+        ESP_LOGW(TAG, "Frame pool: %u allocations failed", (unsigned)stats.failures);
     }
+}
 
-    ESP_LOGI(TAG, "Sent %d bytes (nonce: %d + length: %d + data: %d + hmac: %d)",
-             nonce_sent + length_sent + data_sent + hmac_sent, nonce_sent, length_sent, data_sent, hmac_sent);
+/**
+ * @brief Log the send pipeline counters
+ */
+static void log_send_stats(void) {
+    cuart_send_stats_t stats;
+
+    cuart_send_stats(&stats);
+    ESP_LOGI(TAG, "Pipeline: %u queued, %u sealed in %u packets, %u announcements, %u frames / %u bytes sent, "
+             "%u waits for a frame, %u TX errors",
+             (unsigned)stats.queued, (unsigned)stats.records, (unsigned)stats.sealed, (unsigned)stats.announcements,
+             (unsigned)stats.frames_sent, (unsigned)stats.bytes_sent, (unsigned)stats.waits,
+             (unsigned)stats.tx_errors);
+    if (stats.link_baud != UART_BAUD_RATE || stats.link_fallbacks > 0) {
+        ESP_LOGI(TAG, "Link: %u baud, %u fallbacks", (unsigned)stats.link_baud, (unsigned)stats.link_fallbacks);
+    }
+    if (stats.compressed > 0) {
+        ESP_LOGI(TAG, "Compression: %u packets compressed, %u payload bytes saved",
+                 (unsigned)stats.compressed, (unsigned)stats.bytes_saved);
+    }
+    if (stats.retransmits > 0 || stats.abandoned > 0) {
+        ESP_LOGI(TAG, "Reliable delivery: %u packets sent again, %u given up",
+                 (unsigned)stats.retransmits, (unsigned)stats.abandoned);
+    }
 }
 
 /**
- * @brief Main sender task
+ * @brief Demo task: queue the example messages for the send pipeline
  */
 static void sender_task(void *arg) {
     // Example messages to send
@@ -143,22 +164,35 @@ static void sender_task(void *arg) {
 
     int msg_index = 0;
     int total_messages = sizeof(messages) / sizeof(messages[0]);
+    uint32_t sent = 0;
 
     while (1) {
         const char *message = messages[msg_index];
         size_t msg_len = strlen(message);
 
-        ESP_LOGI(TAG, "\n=== Sending message %d ===", msg_index + 1);
-        ESP_LOGI(TAG, "Plaintext: %s", message);
-
-        // Encrypt and send the message
-        send_encrypted_data((const uint8_t *)message, msg_len);
+        // Copied into a pool frame; blocks only while every frame is in flight
+        esp_err_t err = cuart_send((const uint8_t *)message, msg_len);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Message %d not queued: %s", msg_index + 1, esp_err_to_name(err));
+        }
+        sent++;
+
+        // Streaming: report every few hundred messages instead of every one
+        if (MESSAGE_INTERVAL_MS > 0 || sent % 256 == 0) {
+            ESP_LOGI(TAG, "Queued message %d: %s", msg_index + 1, message);
+            log_send_stats();
+            log_pool_stats();
+            ESP_LOGI(TAG, "sender_task stack high-water mark: %u bytes free",
+                     (unsigned)uxTaskGetStackHighWaterMark(NULL));
+        }
 
         // Move to next message
         msg_index = (msg_index + 1) % total_messages;
 
         // Wait before sending next message
-        vTaskDelay(pdMS_TO_TICKS(5000));
+        if (MESSAGE_INTERVAL_MS > 0) {
+            vTaskDelay(pdMS_TO_TICKS(MESSAGE_INTERVAL_MS));
+        }
     }
 }
 
@@ -167,14 +201,29 @@ void app_main(void) {
     ESP_LOGI(TAG, "Initializing AES-128 CTR encryption...");
 
     // Initialize AES with pre-shared key
-    aes_init(AES_SHARED_KEY);
+    aes_ctr_setkey(&ctr_ctx, AES_SHARED_KEY);
+    hmac_sha256_setkey(&hmac_key, HMAC_KEY, sizeof(HMAC_KEY));
+    aes_gcm_setkey(&gcm_ctx, AES_SHARED_KEY);
+    frame_ctx.wire = WIRE_AEAD ? CUART_WIRE_AEAD : CUART_WIRE_HMAC;
+    frame_ctx.ctr = &ctr_ctx;
+    frame_ctx.hmac_key = &hmac_key;
+    frame_ctx.gcm = &gcm_ctx;
+    ESP_LOGI(TAG, "Wire format: %s", WIRE_AEAD ? "AES-128-GCM" : "AES-128-CTR + HMAC-SHA256");
     ESP_LOGI(TAG, "AES initialized with shared key");
+    ESP_LOGI(TAG, "Packet tracing: %s", CUART_TRACE_MODE_NAME);
+    if (CUART_TRACE_DEFERRED && !cuart_trace_start()) {
+        ESP_LOGE(TAG, "Trace task not started, deferred dumps will not be printed");
+    }
 
-    // Initialize UART
+    // Initialize NVS and UART
+    nvs_init();
     uart_init();
 
-    // Create sender task (increased stack for HMAC operations)
-    xTaskCreate(sender_task, "sender_task", 8192, NULL, 5, NULL);
+    // Crypto and TX tasks, one per core
+    ESP_ERROR_CHECK(cuart_send_start(&frame_ctx, UART_NUM));
+
+    // Create sender task
+    xTaskCreate(sender_task, "sender_task", SENDER_TASK_STACK_SIZE, NULL, 5, NULL);
 
     ESP_LOGI(TAG, "Sender ready, starting transmission...");
 }
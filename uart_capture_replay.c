@@ -0,0 +1,549 @@
+/*
+ * Offline replay of sniffer captures (uart_decrypt_sniffer --capture)
+ * Uses libcypheruart to verify and decrypt every packet of a capture file
+ *
+ * The capture is mapped, not read, and its index (cuart_capture.h) says
+ * where every packet is, so nothing is parsed twice and any time range is
+ * found by binary search. The packets in range are split into runs of up to
+ * CUART_CAPTURE_INDEX_BLOCK and shared out among worker threads; each keeps
+ * its own keys, parser and counts, so gigabytes of capture take seconds
+ * rather than their time on the wire. The wire options are read from the
+ * capture; with session nonces, the salt announcements are checked first so
+ * every worker knows the salt in force for each packet. Replayed packets and
+ * reliable-delivery duplicates are not weeded out.
+ *
+ * Usage: uart_capture_replay [--from S] [--to S] [--workers N] [--decrypt] capture
+ *   --from, --to  seconds from the start of the capture (default: all of it)
+ *   --workers     worker threads (default: one per CPU)
+ *   --decrypt     write each message to stdout, in capture order:
+ *                 <time> <port> <message>, with non-printable bytes as \xNN
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "aes_wrapper.h"
+#include "aes_gcm.h"
+#include "cuart_session.h"
+#include "cuart_frame.h"
+#include "cuart_parser.h"
+#include "cuart_batch.h"
+#include "cuart_compress.h"
+#include "cuart_arq.h"
+#include "cuart_capture.h"
+
+// Runs of output held for in-order writing, per worker
+#define OUTPUT_AHEAD 4
+
+// AES-128 key (must match sender/receiver)
+static const uint8_t AES_SHARED_KEY[16] = {
+    0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6,
+    0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c
+};
+
+// HMAC-SHA256 key (must match sender/receiver)
+static const uint8_t HMAC_KEY[32] = {
+    0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef,
+    0xfe, 0xdc, 0xba, 0x98, 0x76, 0x54, 0x32, 0x10,
+    0x0f, 0x1e, 0x2d, 0x3c, 0x4b, 0x5a, 0x69, 0x78,
+    0x87, 0x96, 0xa5, 0xb4, 0xc3, 0xd2, 0xe1, 0xf0
+};
+
+// A salt announcement that verified: the salt for the port's packets after it
+typedef struct {
+    uint64_t n;                     // index entry of the announcement
+    uint8_t salt[CUART_SESSION_SALT_SIZE];
+} salt_t;
+
+typedef struct {
+    salt_t *salts;
+    size_t count;
+    size_t capacity;
+    cuart_session_rx_t session;     // which announcements a receiver would take
+} salt_list_t;
+
+// Packets handled, per worker and in total
+typedef struct {
+    uint64_t packets;
+    uint64_t bytes;                 // packet bytes
+    uint64_t authentic;
+    uint64_t invalid;
+    uint64_t unreadable;            // index entry not pointing at a whole packet
+    uint64_t announcements;
+    uint64_t no_salt;               // sent before any salt announcement in the capture
+    uint64_t bad_payload;           // authentic, but no delivery header, bad record table or compression
+    uint64_t messages;
+    uint64_t port_authentic[CUART_CAPTURE_MAX_PORTS];
+    uint64_t port_invalid[CUART_CAPTURE_MAX_PORTS];
+} stats_t;
+
+// A run of index entries, the unit of work
+typedef struct {
+    uint64_t first;
+    uint64_t end;
+    char *out;                      // --decrypt: its messages
+    size_t out_len;
+    size_t out_cap;
+    int done;
+} run_t;
+
+typedef struct {
+    pthread_t thread;
+    aes_ctr_ctx_t ctr;
+    hmac_sha256_key_t hmac_key;
+    aes_gcm_ctx_t gcm;
+    cuart_frame_ctx_t frame_ctx;
+    cuart_parser_t parser;
+    uint8_t scratch[CUART_CAPTURE_PACKET_MAX];
+    uint8_t inflated[CUART_FRAME_MAX_PAYLOAD];
+    stats_t stats;
+} worker_t;
+
+static cuart_capture_reader_t capture;
+static uint32_t options;
+static int decrypt;
+static salt_list_t salts[CUART_CAPTURE_MAX_PORTS];
+
+// Runs handed out in order; with --decrypt, workers stay at most
+// OUTPUT_AHEAD runs each ahead of the output
+static run_t *runs;
+static size_t num_runs;
+static size_t next_run;
+static size_t written_runs;
+static size_t max_ahead;
+static pthread_mutex_t runs_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t runs_cond = PTHREAD_COND_INITIALIZER;
+
+static void setup_worker(worker_t *w) {
+    w->frame_ctx = (cuart_frame_ctx_t){ .ctr = &w->ctr, .hmac_key = &w->hmac_key, .gcm = &w->gcm };
+    w->frame_ctx.wire = (options & CUART_CAPTURE_AEAD) ? CUART_WIRE_AEAD : CUART_WIRE_HMAC;
+    aes_ctr_setkey(&w->ctr, AES_SHARED_KEY);
+    hmac_sha256_setkey(&w->hmac_key, HMAC_KEY, sizeof(HMAC_KEY));
+    aes_gcm_setkey(&w->gcm, AES_SHARED_KEY);
+    cuart_parser_init(&w->parser,
+                      (options & CUART_CAPTURE_SESSION) ? CUART_SESSION_SEQ_SIZE
+                          : ((options & CUART_CAPTURE_AEAD) ? AES_GCM_NONCE_SIZE : AES_BLOCK_SIZE),
+                      cuart_frame_mac_size(w->frame_ctx.wire), (options & CUART_CAPTURE_SYNC) != 0);
+}
+
+// Parse the packet an index entry points at; false if it is not one
+static bool load_packet(worker_t *w, const cuart_capture_entry_t *entry, cuart_frame_view_t *frame) {
+    const uint8_t *bytes;
+    size_t len = cuart_capture_bytes(&capture, entry, w->scratch, &bytes);
+    size_t used;
+
+    if (len == 0) {
+        return false;
+    }
+    cuart_parser_reset(&w->parser);
+    if (cuart_parser_feed(&w->parser, bytes, len, &used) != CUART_PARSE_FRAME || used != len) {
+        return false;
+    }
+    cuart_parser_view(&w->parser, frame);
+    return true;
+}
+
+// Salt in force for packet n of a port: the last announcement before it
+static const uint8_t *salt_for(int port, uint64_t n) {
+    const salt_list_t *list = &salts[port];
+    size_t lo = 0, hi = list->count;
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+
+        if (list->salts[mid].n < n) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo > 0 ? list->salts[lo - 1].salt : NULL;
+}
+
+// Check every salt announcement up to entry end, in order; like the receiver,
+// keep only those that start a newer session than the last
+static int collect_salts(worker_t *w, uint64_t end) {
+    for (uint64_t n = 0; n < end; n++) {
+        const cuart_capture_entry_t *entry = cuart_capture_entry(&capture, n);
+        salt_list_t *list = &salts[entry->port];
+        cuart_frame_view_t frame;
+        uint8_t iv[AES_BLOCK_SIZE];
+
+        if (!(entry->flags & CUART_CAPTURE_SALT) || !load_packet(w, entry, &frame) ||
+            frame.length != CUART_SESSION_ANNOUNCE_SIZE) {
+            continue;
+        }
+        cuart_session_iv(frame.body, CUART_SESSION_ANNOUNCE_SEQ, iv);
+        if (!cuart_frame_open(&w->frame_ctx, &frame, iv, NULL, false) ||
+            cuart_session_rx_announce(&list->session, frame.body) != CUART_SESSION_NEW) {
+            continue;
+        }
+        if (list->count == list->capacity) {
+            size_t grown = list->capacity ? 2 * list->capacity : 16;
+            salt_t *grown_salts = realloc(list->salts, grown * sizeof(*grown_salts));
+
+            if (!grown_salts) {
+                return -1;
+            }
+            list->salts = grown_salts;
+            list->capacity = grown;
+        }
+        list->salts[list->count].n = n;
+        memcpy(list->salts[list->count].salt, frame.body, CUART_SESSION_SALT_SIZE);
+        list->count++;
+    }
+    return 0;
+}
+
+static void out_reserve(run_t *run, size_t more) {
+    if (run->out_len + more > run->out_cap) {
+        size_t cap = run->out_cap ? run->out_cap : 65536;
+
+        while (cap < run->out_len + more) {
+            cap *= 2;
+        }
+        run->out = realloc(run->out, cap);
+        if (!run->out) {
+            perror("realloc");
+            exit(1);
+        }
+        run->out_cap = cap;
+    }
+}
+
+// "<time> <port> <message>\n"
+static void out_message(run_t *run, const cuart_capture_entry_t *entry, const uint8_t *data, size_t len) {
+    static const char hex[] = "0123456789abcdef";
+    const char *port = capture.port_names[entry->port];
+    char *p;
+
+    out_reserve(run, 32 + strlen(port) + 4 * len);
+    p = run->out + run->out_len;
+    p += sprintf(p, "%llu.%06llu %s ", (unsigned long long)(entry->timestamp_ns / 1000000000u),
+                 (unsigned long long)(entry->timestamp_ns % 1000000000u / 1000u), port);
+    for (size_t i = 0; i < len; i++) {
+        if (data[i] >= 32 && data[i] < 127 && data[i] != '\\') {
+            *p++ = (char)data[i];
+        } else {
+            *p++ = '\\';
+            *p++ = 'x';
+            *p++ = hex[data[i] >> 4];
+            *p++ = hex[data[i] & 15];
+        }
+    }
+    *p++ = '\n';
+    run->out_len = (size_t)(p - run->out);
+}
+
+// Verify and decrypt one packet
+static void replay_packet(worker_t *w, run_t *run, uint64_t n) {
+    const cuart_capture_entry_t *entry = cuart_capture_entry(&capture, n);
+    stats_t *stats = &w->stats;
+    cuart_frame_view_t frame;
+    uint8_t iv[AES_BLOCK_SIZE];
+
+    stats->packets++;
+    stats->bytes += entry->length;
+    if (!load_packet(w, entry, &frame)) {
+        stats->unreadable++;
+        return;
+    }
+
+    if (options & CUART_CAPTURE_SESSION) {
+        uint32_t seq = cuart_session_get_seq(frame.nonce);
+        const uint8_t *salt;
+
+        if (seq == CUART_SESSION_ANNOUNCE_SEQ) {
+            stats->announcements++;
+            return;
+        }
+        salt = salt_for(entry->port, n);
+        if (!salt) {
+            stats->no_salt++;
+            return;
+        }
+        cuart_session_iv(salt, seq, iv);
+    } else {
+        memset(iv, 0, sizeof(iv));
+        memcpy(iv, frame.nonce, frame.nonce_len);
+    }
+
+    if (!cuart_frame_open(&w->frame_ctx, &frame, iv, frame.body, true)) {
+        stats->invalid++;
+        stats->port_invalid[entry->port]++;
+        return;
+    }
+    stats->authentic++;
+    stats->port_authentic[entry->port]++;
+
+    const uint8_t *plaintext = frame.body;
+    size_t plaintext_len = frame.length;
+
+    if (options & CUART_CAPTURE_RELIABLE) {
+        if (plaintext_len < CUART_ARQ_HEADER_SIZE) {
+            stats->bad_payload++;
+            return;
+        }
+        plaintext += CUART_ARQ_HEADER_SIZE;
+        plaintext_len -= CUART_ARQ_HEADER_SIZE;
+    }
+    if (frame.flags & CUART_FRAME_FLAG_COMPRESSED) {
+        plaintext_len = cuart_decompress(plaintext, plaintext_len, w->inflated, sizeof(w->inflated));
+        if (plaintext_len == 0) {
+            stats->bad_payload++;
+            return;
+        }
+        plaintext = w->inflated;
+    }
+
+    if (options & CUART_CAPTURE_BATCH) {
+        const uint8_t *record;
+        size_t record_len;
+        size_t offset = 0;
+        int count = cuart_batch_count(plaintext, plaintext_len);
+
+        if (count < 0) {
+            stats->bad_payload++;
+            return;
+        }
+        stats->messages += (uint64_t)count;
+        while (decrypt && cuart_batch_next(plaintext, plaintext_len, &offset, &record, &record_len)) {
+            out_message(run, entry, record, record_len);
+        }
+    } else if (plaintext_len > 0) {
+        stats->messages++;
+        if (decrypt) {
+            out_message(run, entry, plaintext, plaintext_len);
+        }
+    }
+}
+
+static void *worker_main(void *arg) {
+    worker_t *w = arg;
+
+    while (1) {
+        size_t r;
+
+        pthread_mutex_lock(&runs_lock);
+        while (decrypt && next_run < num_runs && next_run >= written_runs + max_ahead) {
+            pthread_cond_wait(&runs_cond, &runs_lock);
+        }
+        if (next_run == num_runs) {
+            pthread_mutex_unlock(&runs_lock);
+            return NULL;
+        }
+        r = next_run++;
+        pthread_mutex_unlock(&runs_lock);
+
+        for (uint64_t n = runs[r].first; n < runs[r].end; n++) {
+            replay_packet(w, &runs[r], n);
+        }
+
+        pthread_mutex_lock(&runs_lock);
+        runs[r].done = 1;
+        pthread_cond_broadcast(&runs_cond);
+        pthread_mutex_unlock(&runs_lock);
+    }
+}
+
+// Runs of at most one index block each, covering entries [first, end)
+static int plan_runs(uint64_t first, uint64_t end) {
+    runs = calloc(capture.num_blocks + 1, sizeof(*runs));
+    if (!runs) {
+        return -1;
+    }
+    for (size_t b = 0; b < capture.num_blocks; b++) {
+        const cuart_capture_block_t *block = &capture.blocks[b];
+        uint64_t lo = block->first > first ? block->first : first;
+        uint64_t hi = block->first + block->count < end ? block->first + block->count : end;
+
+        if (lo < hi) {
+            runs[num_runs].first = lo;
+            runs[num_runs].end = hi;
+            num_runs++;
+        }
+    }
+    return 0;
+}
+
+static double now_s(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[]) {
+    const char *path = NULL;
+    double from = 0, to = -1;
+    int nworkers = 0;
+    worker_t *workers;
+    stats_t total;
+    FILE *report;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--from") == 0 && i + 1 < argc) {
+            from = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--to") == 0 && i + 1 < argc) {
+            to = atof(argv[++i]);
+        } else if ((strcmp(argv[i], "--workers") == 0 || strcmp(argv[i], "-j") == 0) && i + 1 < argc &&
+                   atoi(argv[i + 1]) > 0) {
+            nworkers = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--decrypt") == 0) {
+            decrypt = 1;
+        } else if (argv[i][0] != '-' && !path) {
+            path = argv[i];
+        } else {
+            path = NULL;
+            break;
+        }
+    }
+    if (!path) {
+        fprintf(stderr, "Usage: %s [--from S] [--to S] [--workers N] [--decrypt] capture\n", argv[0]);
+        return 1;
+    }
+    if (nworkers == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        nworkers = cpus > 0 ? (int)cpus : 1;
+    }
+    // Messages go to stdout with --decrypt, the report to stderr
+    report = decrypt ? stderr : stdout;
+
+    if (cuart_capture_open(&capture, path) < 0) {
+        fprintf(stderr, "Cannot read %s: %s\n", path,
+                errno == EINVAL ? "not a capture file, or a damaged one" : strerror(errno));
+        return 1;
+    }
+    options = capture.header->options;
+
+    fprintf(report, "================================================================================\n");
+    fprintf(report, " 🔁 Capture Replay (using libcypheruart)\n");
+    fprintf(report, "================================================================================\n");
+    fprintf(report, " Capture: %s, %.1f MB, %d port%s, %llu packets indexed%s\n", path, capture.size / 1e6,
+            capture.num_ports, capture.num_ports == 1 ? "" : "s", (unsigned long long)capture.packets,
+            capture.truncated ? " (cut short)" : "");
+    fprintf(report, " Packet Format: %s[%s][LENGTH][ENCRYPTED %s%s][%s] (%s)\n",
+            (options & CUART_CAPTURE_SYNC) ? "[SYNC][HCRC]" : "",
+            (options & CUART_CAPTURE_SESSION) ? "4-byte SEQ"
+                : ((options & CUART_CAPTURE_AEAD) ? "12-byte NONCE" : "16-byte NONCE"),
+            (options & CUART_CAPTURE_RELIABLE) ? "DELIVERY SEQ + " : "",
+            (options & CUART_CAPTURE_BATCH) ? "RECORDS" : "DATA",
+            (options & CUART_CAPTURE_AEAD) ? "16-byte TAG" : "32-byte HMAC",
+            (options & CUART_CAPTURE_AEAD) ? "AES-128-GCM" : "AES-128-CTR + HMAC-SHA256");
+    fprintf(report, " AES Implementation: %s, %d worker thread%s\n", aes_backend_name(), nworkers,
+            nworkers == 1 ? "" : "s");
+    fprintf(report, "================================================================================\n\n");
+
+    // Time range to index entries
+    uint64_t start_ns = capture.header->created_ns;
+    uint64_t first = cuart_capture_find(&capture, start_ns + (uint64_t)(from * 1e9));
+    uint64_t end = (to < 0) ? capture.packets : cuart_capture_find(&capture, start_ns + (uint64_t)(to * 1e9));
+
+    if (end < first) {
+        end = first;
+    }
+
+    workers = calloc((size_t)nworkers, sizeof(*workers));
+    if (!workers || plan_runs(first, end) < 0) {
+        perror("calloc");
+        return 1;
+    }
+    for (int i = 0; i < nworkers; i++) {
+        setup_worker(&workers[i]);
+    }
+    max_ahead = (size_t)nworkers * OUTPUT_AHEAD;
+
+    double t0 = now_s();
+    if ((options & CUART_CAPTURE_SESSION) && collect_salts(&workers[0], end) < 0) {
+        perror("realloc");
+        return 1;
+    }
+    for (int i = 0; i < nworkers; i++) {
+        if (pthread_create(&workers[i].thread, NULL, worker_main, &workers[i]) != 0) {
+            fprintf(stderr, "Cannot start worker thread %d\n", i);
+            return 1;
+        }
+    }
+
+    // With --decrypt, write each run's messages as soon as the runs before it are out
+    for (size_t r = 0; decrypt && r < num_runs; r++) {
+        pthread_mutex_lock(&runs_lock);
+        while (!runs[r].done) {
+            pthread_cond_wait(&runs_cond, &runs_lock);
+        }
+        pthread_mutex_unlock(&runs_lock);
+
+        fwrite(runs[r].out, 1, runs[r].out_len, stdout);
+        free(runs[r].out);
+        runs[r].out = NULL;
+
+        pthread_mutex_lock(&runs_lock);
+        written_runs++;
+        pthread_cond_broadcast(&runs_cond);
+        pthread_mutex_unlock(&runs_lock);
+    }
+    for (int i = 0; i < nworkers; i++) {
+        pthread_join(workers[i].thread, NULL);
+    }
+    fflush(stdout);
+    double elapsed = now_s() - t0;
+
+    memset(&total, 0, sizeof(total));
+    for (int i = 0; i < nworkers; i++) {
+        const stats_t *s = &workers[i].stats;
+
+        total.packets += s->packets;
+        total.bytes += s->bytes;
+        total.authentic += s->authentic;
+        total.invalid += s->invalid;
+        total.unreadable += s->unreadable;
+        total.announcements += s->announcements;
+        total.no_salt += s->no_salt;
+        total.bad_payload += s->bad_payload;
+        total.messages += s->messages;
+        for (int p = 0; p < capture.num_ports; p++) {
+            total.port_authentic[p] += s->port_authentic[p];
+            total.port_invalid[p] += s->port_invalid[p];
+        }
+    }
+
+    if (end > first) {
+        fprintf(report, "📦 Packets %llu–%llu, %.3f–%.3f s into the capture\n", (unsigned long long)first,
+                (unsigned long long)end - 1,
+                (cuart_capture_entry(&capture, first)->timestamp_ns - start_ns) / 1e9,
+                (cuart_capture_entry(&capture, end - 1)->timestamp_ns - start_ns) / 1e9);
+    } else {
+        fprintf(report, "📦 No packets in range\n");
+    }
+    fprintf(report, "   %llu packets (%.1f MB): %llu ✓ authentic, %llu ✗ INVALID, %llu unreadable\n",
+            (unsigned long long)total.packets, total.bytes / 1e6, (unsigned long long)total.authentic,
+            (unsigned long long)total.invalid, (unsigned long long)total.unreadable);
+    if (options & CUART_CAPTURE_SESSION) {
+        fprintf(report, "   %llu salt announcements, %llu packets before any salt\n",
+                (unsigned long long)total.announcements, (unsigned long long)total.no_salt);
+    }
+    fprintf(report, "   %llu messages%s", (unsigned long long)total.messages,
+            total.bad_payload ? "" : "\n");
+    if (total.bad_payload) {
+        fprintf(report, ", %llu authentic packets with a malformed payload\n",
+                (unsigned long long)total.bad_payload);
+    }
+    for (int p = 0; p < capture.num_ports; p++) {
+        fprintf(report, "   %s: %llu authentic, %llu invalid\n", capture.port_names[p],
+                (unsigned long long)total.port_authentic[p], (unsigned long long)total.port_invalid[p]);
+    }
+    fprintf(report, "⏱️  %.3f s: %.0f packets/s, %.1f MB/s\n", elapsed, total.packets / elapsed,
+            total.bytes / 1e6 / elapsed);
+
+    for (int p = 0; p < capture.num_ports; p++) {
+        free(salts[p].salts);
+    }
+    free(runs);
+    free(workers);
+    cuart_capture_release(&capture);
+    return 0;
+}
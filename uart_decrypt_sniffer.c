@@ -1,21 +1,76 @@
 /*
  * UART Sniffer with AES-128 CTR Decryption
- * Uses tiny-AES-c library to decrypt messages in real-time
+ * Uses libcypheruart to verify and decrypt messages in real-time
+ *
+ * Packets are framed by their LENGTH field (cuart_parser.h) as bytes arrive,
+ * whatever the read boundaries, and checked against their HMAC or GCM tag
+ * before anything is shown.
+ *
+ * Any number of ports (ttys, ptys or FIFOs) are watched at once. They are
+ * dealt out to a pool of worker threads, each waiting on its share in one
+ * epoll set and reading without blocking; a port's parser, session and link
+ * state belong to the worker that reads it, so workers share nothing but
+ * stdout. Each worker renders its packets into its own buffer
+ * (cuart_format.h) and writes a read's worth at once.
+ *
+ * With --capture, everything read is also kept in a capture file
+ * (cuart_capture.h) with an index of the packets in it, for
+ * uart_capture_replay to decrypt and verify later.
+ *
+ * Usage: uart_decrypt_sniffer [--aead] [--session] [--sync] [--batch] [--link [--reliable]]
+ *                             [--workers N] [--capture FILE] [--quiet | --json | --summary] [port...]
+ *   --aead     packets use the AES-128-GCM wire format (CONFIG_CUART_WIRE_AEAD);
+ *              default AES-128-CTR + HMAC-SHA256
+ *   --session  NONCE field is a sequence number (CONFIG_CUART_SESSION_NONCES)
+ *   --sync     packets carry the sync word + header CRC (CONFIG_CUART_SYNC_FRAMING)
+ *   --batch    payloads are tables of length-prefixed records (CONFIG_CUART_BATCHING)
+ *   --link     follow the line rate negotiated by sender and receiver (CONFIG_CUART_LINK_NEGOTIATION)
+ *   --reliable payloads start with a delivery sequence number (CONFIG_CUART_RELIABLE)
+ *   --workers  worker threads (default: one per CPU, at most one per port)
+ *   --capture  write everything read to FILE
+ *   --quiet    one line per packet instead of hex dumps
+ *   --json     one JSON object per packet or event (JSON Lines); the banner goes to stderr
+ *   --summary  nothing per packet, a table of totals when every port has closed
+ *   port       serial devices (default /dev/ttyUSB0)
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdarg.h>
+#include <errno.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <termios.h>
 #include <time.h>
-#include "aes.h"
+#include <pthread.h>
+#include <sys/epoll.h>
+#include "aes_wrapper.h"
+#include "aes_gcm.h"
+#include "cuart_session.h"
+#include "cuart_frame.h"
+#include "cuart_parser.h"
+#include "cuart_compress.h"
+#include "cuart_link.h"
+#include "cuart_arq.h"
+#include "cuart_capture.h"
+#include "cuart_format.h"
 
 #define SERIAL_PORT "/dev/ttyUSB0"
 #define BAUD_RATE B115200
-#define NONCE_SIZE 16
-#define BUF_SIZE 1024
+
+// Bytes taken from the port per read(): many back-to-back packets at
+// multi-megabaud rates, one system call
+#define READ_CHUNK 65536
+
+// Ready ports taken from epoll per wakeup
+#define MAX_EVENTS 16
+
+// Packets of one read indexed per trip to the capture file
+#define MAX_MARKS 256
+
+// Output a worker may render before it writes it out, mid-read
+#define OUT_FLUSH (256 * 1024)
 
 // AES-128 Pre-shared Key (must match sender/receiver)
 static const uint8_t AES_SHARED_KEY[16] = {
@@ -23,66 +78,26 @@ static const uint8_t AES_SHARED_KEY[16] = {
     0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c
 };
 
-void print_hex(const char *label, const uint8_t *data, size_t len) {
-    printf("%s\n", label);
-    for (size_t i = 0; i < len; i++) {
-        printf("%02x ", data[i]);
-        if ((i + 1) % 16 == 0) {
-            printf(" |");
-            for (size_t j = i - 15; j <= i; j++) {
-                printf("%c", (data[j] >= 32 && data[j] < 127) ? data[j] : '.');
-            }
-            printf("|\n");
-        }
-    }
-    if (len % 16 != 0) {
-        size_t remaining = len % 16;
-        for (size_t i = 0; i < (16 - remaining) * 3; i++) {
-            printf(" ");
-        }
-        printf(" |");
-        for (size_t i = len - remaining; i < len; i++) {
-            printf("%c", (data[i] >= 32 && data[i] < 127) ? data[i] : '.');
-        }
-        printf("|\n");
-    }
-}
-
-void print_plaintext(const char *label, const uint8_t *data, size_t len) {
-    printf("%s \"", label);
-    for (size_t i = 0; i < len; i++) {
-        if (data[i] >= 32 && data[i] < 127) {
-            printf("%c", data[i]);
-        } else if (data[i] == 0) {
-            break;
-        } else {
-            printf(".");
-        }
-    }
-    printf("\"\n");
-}
-
-void decrypt_aes_ctr(const uint8_t *encrypted, uint8_t *decrypted, size_t len,
-                     const uint8_t *nonce, const uint8_t *key) {
-    struct AES_ctx ctx;
-
-    // Initialize AES context with key and nonce
-    AES_init_ctx_iv(&ctx, key, nonce);
-
-    // Copy encrypted data to output buffer
-    memcpy(decrypted, encrypted, len);
-
-    // Decrypt in CTR mode (same operation as encryption)
-    AES_CTR_xcrypt_buffer(&ctx, decrypted, len);
-}
+// HMAC Key (must match sender/receiver)
+static const uint8_t HMAC_KEY[32] = {
+    0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef,
+    0xfe, 0xdc, 0xba, 0x98, 0x76, 0x54, 0x32, 0x10,
+    0x0f, 0x1e, 0x2d, 0x3c, 0x4b, 0x5a, 0x69, 0x78,
+    0x87, 0x96, 0xa5, 0xb4, 0xc3, 0xd2, 0xe1, 0xf0
+};
 
 int setup_serial(const char *port) {
-    int fd = open(port, O_RDONLY | O_NOCTTY);
+    int fd = open(port, O_RDONLY | O_NOCTTY | O_NONBLOCK);
     if (fd < 0) {
         perror("Error opening serial port");
         return -1;
     }
 
+    // A FIFO has no line settings
+    if (!isatty(fd)) {
+        return fd;
+    }
+
     struct termios options;
     tcgetattr(fd, &options);
 
@@ -95,13 +110,14 @@ int setup_serial(const char *port) {
     options.c_cflag &= ~CSIZE;
     options.c_cflag |= CS8;      // 8 data bits
 
-    // Raw input mode
+    // Raw input mode (no CR/NL translation or XON/XOFF: packets are binary)
     options.c_lflag &= ~(ICANON | ECHO | ECHOE | ISIG);
+    options.c_iflag &= ~(IXON | IXOFF | IXANY | ICRNL | INLCR | IGNCR | ISTRIP | BRKINT | PARMRK);
     options.c_oflag &= ~OPOST;
 
-    // Set read timeout
-    options.c_cc[VMIN] = 0;
-    options.c_cc[VTIME] = 5;  // 0.5 second timeout
+    // Reads never wait (O_NONBLOCK): epoll says when bytes are there
+    options.c_cc[VMIN] = 1;
+    options.c_cc[VTIME] = 0;
 
     tcsetattr(fd, TCSANOW, &options);
     tcflush(fd, TCIFLUSH);
@@ -109,100 +125,698 @@ int setup_serial(const char *port) {
     return fd;
 }
 
-void print_timestamp() {
-    time_t now;
-    struct tm *tm_info;
-    char time_str[64];
+// termios constants for the negotiated rates; a rate without one cannot be followed
+static const struct {
+    uint32_t baud;
+    speed_t speed;
+} LINK_SPEEDS[] = {
+    { 115200, B115200 },
+    { 230400, B230400 },
+#ifdef B460800
+    { 460800, B460800 },
+#endif
+#ifdef B921600
+    { 921600, B921600 },
+#endif
+#ifdef B1000000
+    { 1000000, B1000000 },
+#endif
+#ifdef B1500000
+    { 1500000, B1500000 },
+#endif
+#ifdef B2000000
+    { 2000000, B2000000 },
+#endif
+#ifdef B2500000
+    { 2500000, B2500000 },
+#endif
+#ifdef B3000000
+    { 3000000, B3000000 },
+#endif
+#ifdef B4000000
+    { 4000000, B4000000 },
+#endif
+};
 
-    time(&now);
-    tm_info = localtime(&now);
-    strftime(time_str, sizeof(time_str), "%H:%M:%S", tm_info);
-    printf("@ %s", time_str);
+// Switch the port's input rate; -1 if this system has no constant for it
+int set_serial_baud(int fd, uint32_t baud) {
+    struct termios options;
+
+    for (size_t i = 0; i < sizeof(LINK_SPEEDS) / sizeof(LINK_SPEEDS[0]); i++) {
+        if (LINK_SPEEDS[i].baud == baud) {
+            tcgetattr(fd, &options);
+            cfsetispeed(&options, LINK_SPEEDS[i].speed);
+            tcsetattr(fd, TCSANOW, &options);
+            // Whatever is buffered arrived at the old rate
+            tcflush(fd, TCIFLUSH);
+            return 0;
+        }
+    }
+    return -1;
 }
 
-int main() {
-    uint8_t buffer[BUF_SIZE];
-    uint8_t nonce[NONCE_SIZE];
-    uint8_t encrypted[BUF_SIZE];
-    uint8_t decrypted[BUF_SIZE];
-    int packet_count = 0;
-
-    printf("================================================================================\n");
-    printf(" 🔐 UART Sniffer with AES-128 CTR Decryption (using tiny-AES-c)\n");
-    printf("================================================================================\n");
-    printf(" Port: %s @ 115200 baud\n", SERIAL_PORT);
-    printf(" Packet Format: [16-byte NONCE][ENCRYPTED DATA]\n");
-    printf(" AES Key: ");
-    for (int i = 0; i < 16; i++) printf("%02x ", AES_SHARED_KEY[i]);
-    printf("\n");
-    printf("================================================================================\n\n");
-
-    // Open serial port
-    int fd = setup_serial(SERIAL_PORT);
-    if (fd < 0) {
-        fprintf(stderr, "Failed to open %s\n", SERIAL_PORT);
-        fprintf(stderr, "Check:\n");
-        fprintf(stderr, "  • FTDI connected: ls -l /dev/ttyUSB*\n");
-        fprintf(stderr, "  • Wiring: Sender GPIO17 → FTDI RX, GND connected\n");
-        return 1;
+// Link negotiation timestamps
+uint32_t now_ms(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+// Wall-clock time of a read, for the packets in it
+uint64_t wall_ns(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+// Wire options from the command line, the same for every port
+typedef struct {
+    int aead;
+    int session;
+    int sync;
+    int batch;
+    int link;
+    int reliable;
+    const char *capture;            // capture file, or NULL
+    cuart_format_mode_t format;     // what is printed per packet
+} sniff_options_t;
+
+static sniff_options_t opts;
+
+// Capture file, shared by the workers under capture_lock. A write error
+// stops the capture, not the sniffer.
+static cuart_capture_writer_t capture;
+static int capturing;
+static pthread_mutex_t capture_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// Held while a worker writes out its output buffer
+static pthread_mutex_t stdout_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// One monitored port and what has been learned from its traffic. Only the
+// worker it is dealt to touches it.
+typedef struct {
+    const char *name;
+    bool tag;                       // name the port in its output (several ports)
+    int id;                         // capture port ID
+    int fd;
+    uint32_t baud;                  // input rate the port is set to
+    cuart_parser_t parser;
+    cuart_session_rx_t session;
+    cuart_link_t link;
+    uint8_t held[CUART_LINK_FRAME_SIZE];    // may start a link frame: not parsed yet
+    size_t held_len;
+    cuart_arq_rx_t arq;
+    int packet_count;               // message packets shown
+    int invalid_count;              // packets that failed verification
+    unsigned long long bytes;       // bytes read
+} port_t;
+
+// A packet that ended in the current read, for the capture index
+typedef struct {
+    int32_t end;                    // relative to the start of the read
+    uint16_t length;
+    uint8_t flags;
+} packet_mark_t;
+
+// A worker thread: its share of the ports in one epoll set, plus its own
+// keyed contexts (CTR keeps its keystream in the context), read buffer and
+// output buffer
+typedef struct {
+    pthread_t thread;
+    int epfd;
+    int open_ports;
+    aes_ctr_ctx_t ctr;
+    hmac_sha256_key_t hmac_key;
+    aes_gcm_ctx_t gcm;
+    cuart_frame_ctx_t frame_ctx;
+    uint8_t chunk[CUART_LINK_FRAME_SIZE + READ_CHUNK]; // a port's held bytes, then the read
+    packet_mark_t marks[MAX_MARKS];
+    size_t num_marks;
+    cuart_out_t out;                // rendered packets, written once per read
+    uint64_t read_ns;               // wall-clock time of the current read
+} worker_t;
+
+// Write out what the worker has rendered, in one write(): a read's
+// packets never interleave with another worker's
+static void flush_output(worker_t *w) {
+    if (w->out.len == 0) {
+        return;
     }
+    pthread_mutex_lock(&stdout_lock);
+    cuart_out_write(&w->out, STDOUT_FILENO);
+    pthread_mutex_unlock(&stdout_lock);
+}
+
+// Something about a port that is not a packet
+static void show_event(worker_t *w, const port_t *port, const char *icon, const char *event,
+                       const char *fmt, ...) __attribute__((format(printf, 5, 6)));
 
-    printf("✓ Connected to %s\n", SERIAL_PORT);
-    printf("✓ Listening for encrypted packets... (Press Ctrl+C to exit)\n\n");
+static void show_event(worker_t *w, const port_t *port, const char *icon, const char *event,
+                       const char *fmt, ...) {
+    char text[160];
+    va_list ap;
 
-    while (1) {
-        // Read nonce (first 16 bytes)
-        int nonce_read = 0;
-        while (nonce_read < NONCE_SIZE) {
-            int n = read(fd, nonce + nonce_read, NONCE_SIZE - nonce_read);
-            if (n > 0) {
-                nonce_read += n;
-            } else if (n < 0) {
-                perror("Error reading nonce");
+    va_start(ap, fmt);
+    vsnprintf(text, sizeof(text), fmt, ap);
+    va_end(ap);
+    cuart_format_event(&w->out, port->name, port->tag, w->read_ns, icon, event, text);
+}
+
+// Packet: [NONCE(16, or 12 for GCM) or SEQ(4)][LENGTH(2, big-endian)][ENCRYPTED DATA]
+// [HMAC(32) or TAG(16)], as parsed by the port's parser. With --session the
+// nonce is a sequence number; with --batch the plaintext is split into its
+// records. A payload flagged as compressed is decompressed before it is
+// shown. With --link the link is told whether the packet verified; with
+// --reliable the delivery sequence number comes off the front, and copies
+// the sender sent again are shown only as such.
+// The packet is rendered into the worker's output buffer (cuart_format.h).
+// Returns 0 if a message packet was displayed.
+int show_packet(worker_t *w, port_t *port) {
+    cuart_frame_ctx_t *ctx = &w->frame_ctx;
+    const char *mac_name = (ctx->wire == CUART_WIRE_AEAD) ? "Tag" : "HMAC";
+    cuart_parser_t *parser = &port->parser;
+    cuart_session_rx_t *session = opts.session ? &port->session : NULL;
+    cuart_arq_rx_t *arq = opts.reliable ? &port->arq : NULL;
+    cuart_frame_view_t frame;
+    uint8_t iv[AES_BLOCK_SIZE];
+    uint8_t decrypted[CUART_FRAME_MAX_PAYLOAD];
+    uint8_t inflated[CUART_FRAME_MAX_PAYLOAD];
+    uint32_t seq = 0;
+    int shown = 0;
+
+    cuart_parser_view(parser, &frame);
+    int payload_len = (int)frame.length;
+
+    if (session) {
+        seq = cuart_session_get_seq(frame.nonce);
+
+        if (seq == CUART_SESSION_ANNOUNCE_SEQ) {
+            // Salt announcement: LENGTH || SALT || EPOCH is authenticated, not encrypted
+            if (payload_len != CUART_SESSION_ANNOUNCE_SIZE) {
+                show_event(w, port, "⚠️ ", "malformed_salt", "Malformed salt announcement (%d bytes)", payload_len);
+                return -1;
+            }
+            cuart_session_iv(frame.body, CUART_SESSION_ANNOUNCE_SEQ, iv);
+            if (!cuart_frame_open(ctx, &frame, iv, NULL, false)) {
+                show_event(w, port, "⚠️ ", "invalid_salt", "Salt announcement with INVALID %s", mac_name);
+                cuart_parser_resync(parser);
+                return -1;
+            }
+            switch (cuart_session_rx_announce(session, frame.body)) {
+            case CUART_SESSION_NEW: {
+                char salt[2 * CUART_SESSION_SALT_SIZE + 1];
+
+                for (int i = 0; i < CUART_SESSION_SALT_SIZE; i++) {
+                    snprintf(salt + 2 * i, 3, "%02x", frame.body[i]);
+                }
+                show_event(w, port, "🧂", "session", "New session, epoch %u, salt: %s", session->epoch, salt);
                 break;
             }
+            case CUART_SESSION_STALE:
+                show_event(w, port, "⚠️ ", "stale_session", "Announcement of an earlier session (epoch %u) ignored",
+                           cuart_session_get_seq(frame.body + CUART_SESSION_SALT_SIZE));
+                break;
+            case CUART_SESSION_REPEAT:
+                break;
+            }
+            return -1;
+        }
+
+        if (!cuart_session_rx_check(session, seq)) {
+            if (session->have_salt) {
+                show_event(w, port, "⚠️ ", "replayed", "Replayed or stale packet (seq %u)", seq);
+            } else {
+                show_event(w, port, "⚠️ ", "no_salt", "No session salt yet, packet seq %u skipped", seq);
+            }
+            return -1;
+        }
+        cuart_session_iv(session->salt, seq, iv);
+    } else {
+        memset(iv, 0, sizeof(iv));
+        memcpy(iv, frame.nonce, frame.nonce_len);
+    }
+
+    bool authentic = cuart_frame_open(ctx, &frame, iv, decrypted, true);
+    if (opts.link) {
+        cuart_link_report(&port->link, authentic, now_ms());
+    }
+    if (authentic && session) {
+        cuart_session_rx_accept(session, seq);
+    }
+
+    cuart_packet_info_t packet = {
+        .port = port->name,
+        .tag = port->tag,
+        .number = port->packet_count + 1,
+        .time_ns = w->read_ns,
+        .wire = ctx->wire,
+        .frame = &frame,
+        .session = session != NULL,
+        .seq = seq,
+        .authentic = authentic,
+        .wire_len = (parser->sync ? CUART_FRAME_SYNC_SIZE : 0) + frame.nonce_len + 2 + frame.length + frame.mac_len,
+    };
+
+    if (!authentic) {
+        port->invalid_count++;
+    } else {
+        packet.decrypted = decrypted;
+        packet.message = decrypted;
+        packet.message_len = (size_t)payload_len;
+
+        if (arq) {
+            if (packet.message_len < CUART_ARQ_HEADER_SIZE) {
+                packet.delivery = CUART_DELIVERY_MISSING;
+            } else if (!cuart_arq_rx_accept(arq, decrypted, &packet.delivery_seq)) {
+                packet.delivery = CUART_DELIVERY_AGAIN;
+            } else {
+                packet.delivery = CUART_DELIVERY_NEW;
+                packet.message += CUART_ARQ_HEADER_SIZE;
+                packet.message_len -= CUART_ARQ_HEADER_SIZE;
+            }
+        }
+
+        if (packet.delivery == CUART_DELIVERY_MISSING || packet.delivery == CUART_DELIVERY_AGAIN) {
+            shown = -1;
+        } else if (frame.flags & CUART_FRAME_FLAG_COMPRESSED) {
+            size_t inflated_len = cuart_decompress(packet.message, packet.message_len, inflated, sizeof(inflated));
+
+            if (inflated_len == 0) {
+                packet.inflate_failed = true;
+            } else {
+                packet.packed_len = packet.message_len;
+                packet.message = inflated;
+                packet.message_len = inflated_len;
+            }
+        }
+        packet.batch = opts.batch;
+    }
+
+    cuart_format_packet(&w->out, &packet);
+
+    // The packet was displayed; with sync framing, still look for a packet
+    // that a lost byte may have pulled into this one
+    if (!authentic) {
+        cuart_parser_resync(parser);
+    }
+    return shown;
+}
+
+// Append a read to the capture file
+static void capture_chunk(const port_t *port, const uint8_t *data, size_t len) {
+    pthread_mutex_lock(&capture_lock);
+    if (capturing && cuart_capture_chunk(&capture, port->id, data, len) < 0) {
+        fprintf(stderr, "Capture stopped: %s\n", strerror(errno));
+        capturing = 0;
+    }
+    pthread_mutex_unlock(&capture_lock);
+}
+
+// Index the packets marked in the port's latest read
+static void capture_marks(worker_t *w, const port_t *port) {
+    pthread_mutex_lock(&capture_lock);
+    for (size_t i = 0; capturing && i < w->num_marks; i++) {
+        const packet_mark_t *mark = &w->marks[i];
+
+        if (cuart_capture_packet(&capture, port->id, mark->end, mark->length, mark->flags) < 0) {
+            fprintf(stderr, "Capture stopped: %s\n", strerror(errno));
+            capturing = 0;
+        }
+    }
+    pthread_mutex_unlock(&capture_lock);
+    w->num_marks = 0;
+}
+
+// Note where the packet just parsed ends in the read, before anything
+// rescans it; consumed counts from the start of the read (below 0 in bytes
+// held from the previous one)
+static void mark_packet(worker_t *w, port_t *port, int32_t consumed) {
+    packet_mark_t *mark = &w->marks[w->num_marks++];
+    cuart_frame_view_t frame;
+
+    cuart_parser_view(&port->parser, &frame);
+    mark->end = consumed - (int32_t)cuart_parser_trailing(&port->parser);
+    mark->length = (uint16_t)port->parser.frame_len;
+    mark->flags = (opts.session && cuart_session_get_seq(frame.nonce) == CUART_SESSION_ANNOUNCE_SEQ)
+                      ? CUART_CAPTURE_SALT : 0;
+    if (w->num_marks == MAX_MARKS) {
+        capture_marks(w, port);
+    }
+}
+
+// Hand bytes[from, to) to the port's parser, packet by packet; bytes starts
+// held bytes before the read
+static void parse_packets(worker_t *w, port_t *port, const uint8_t *bytes, size_t held, size_t from,
+                          size_t to) {
+    cuart_parse_result_t result;
+    const uint8_t *p = bytes + from;
+    size_t left = to - from;
+
+    do {
+        size_t used;
+
+        result = cuart_parser_feed(&port->parser, p, left, &used);
+        p += used;
+        left -= used;
+        if (result == CUART_PARSE_BAD_LENGTH) {
+            show_event(w, port, "⚠️ ", "bad_length", "Invalid length, skipping");
+            if (opts.link) {
+                cuart_link_report(&port->link, false, now_ms());
+            }
+        } else if (result == CUART_PARSE_FRAME) {
+            if (opts.capture) {
+                mark_packet(w, port, (int32_t)(p - bytes) - (int32_t)held);
+            }
+            if (show_packet(w, port) == 0) {
+                port->packet_count++;
+            }
+            if (w->out.len >= OUT_FLUSH) {
+                flush_output(w);
+            }
         }
+    } while (left > 0 || result == CUART_PARSE_FRAME);
+}
 
-        if (nonce_read < NONCE_SIZE) {
-            continue;
+// Read whatever the port has and hand it to its parser, packet by packet:
+// a packet may span reads and a read may hold many packets, and nothing
+// waits for more bytes than the port already has. With --link the same
+// bytes are scanned for link frames and the port follows the rate they
+// settle on; the parser gets only the bytes between them, and a tail that
+// may start one waits for the next read.
+// Returns -1 once the port is gone: its writer closed it (pty, FIFO) or it
+// failed (device unplugged).
+int sniff(worker_t *w, port_t *port) {
+    uint8_t *data = w->chunk + CUART_LINK_FRAME_SIZE;
+    ssize_t n = read(port->fd, data, READ_CHUNK);
+
+    if (n < 0 && (errno == EAGAIN || errno == EINTR)) {
+        return 0;
+    }
+    if (n < 0) {
+        // A pty whose other side closed reports EIO, which is its end of input
+        if (errno != EIO) {
+            fprintf(stderr, "Error reading %s: %s\n", port->name, strerror(errno));
         }
+        return -1;
+    }
+    if (n == 0) {
+        return -1;
+    }
+    port->bytes += (unsigned long long)n;
+    w->read_ns = wall_ns();
+    if (opts.capture) {
+        capture_chunk(port, data, (size_t)n);
+    }
 
-        // Read encrypted payload (read what's available, typically the message length)
-        usleep(10000);  // Wait 10ms for data to arrive
-        int payload_len = read(fd, encrypted, BUF_SIZE);
+    size_t held = port->held_len;
+    uint8_t *bytes = data - held;
+    size_t total = held + (size_t)n;
+    size_t parsed = 0;
+
+    memcpy(bytes, port->held, held);
+    if (opts.link) {
+        // The scanner has seen the held bytes already
+        size_t scanned = held;
+
+        while (scanned < total) {
+            size_t used;
+            bool found = cuart_link_scan(&port->link, bytes + scanned, total - scanned, now_ms(), &used);
+
+            scanned += used;
+            if (found) {
+                // The sender only sends link frames between packets: parse
+                // up to this one and drop what is left of a packet
+                parse_packets(w, port, bytes, held, parsed, scanned - CUART_LINK_FRAME_SIZE);
+                cuart_parser_reset(&port->parser);
+                parsed = scanned;
+            }
+        }
+        port->held_len = port->link.rx_len;
+        memcpy(port->held, bytes + total - port->held_len, port->held_len);
+    }
+    parse_packets(w, port, bytes, held, parsed, total - port->held_len);
 
-        if (payload_len <= 0) {
-            continue;
+    if (w->num_marks > 0) {
+        capture_marks(w, port);
+    }
+
+    if (opts.link && cuart_link_baud(&port->link) != port->baud) {
+        port->baud = cuart_link_baud(&port->link);
+        cuart_parser_reset(&port->parser);
+        if (set_serial_baud(port->fd, port->baud) < 0) {
+            show_event(w, port, "⚠️ ", "link", "Link moved to %u baud, which this system's termios cannot set",
+                       port->baud);
+        } else {
+            show_event(w, port, "🔗", "link", "Link: %u baud%s", port->baud, port->link.flow ? ", RTS/CTS" : "");
         }
+    }
+    flush_output(w);
+    return 0;
+}
+
+// Worker thread: serve the ports in its epoll set until all are gone
+void *worker_main(void *arg) {
+    worker_t *w = arg;
+    struct epoll_event events[MAX_EVENTS];
 
-        // Decrypt the data
-        decrypt_aes_ctr(encrypted, decrypted, payload_len, nonce, AES_SHARED_KEY);
+    while (w->open_ports > 0) {
+        int n = epoll_wait(w->epfd, events, MAX_EVENTS, -1);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("epoll_wait");
+            break;
+        }
+        for (int i = 0; i < n; i++) {
+            port_t *port = events[i].data.ptr;
+
+            if (sniff(w, port) < 0) {
+                epoll_ctl(w->epfd, EPOLL_CTL_DEL, port->fd, NULL);
+                close(port->fd);
+                port->fd = -1;
+                w->open_ports--;
+                fprintf(stderr, "%s closed\n", port->name);
+            }
+        }
+    }
+    return NULL;
+}
 
-        // Display packet
-        packet_count++;
-        printf("════════════════════════════════════════════════════════════════════════════════\n");
-        printf("📦 Packet #%d ", packet_count);
-        print_timestamp();
-        printf("\n");
-        printf("════════════════════════════════════════════════════════════════════════════════\n");
+int main(int argc, char *argv[]) {
+    int nports = 0;
+    int nworkers = 0;
+    port_t *ports = calloc((size_t)argc, sizeof(*ports));
+    static const char *default_port = SERIAL_PORT;
 
-        printf("\n🔑 Nonce (%d bytes):\n", NONCE_SIZE);
-        print_hex("", nonce, NONCE_SIZE);
+    if (!ports) {
+        perror("calloc");
+        return 1;
+    }
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--aead") == 0) {
+            opts.aead = 1;
+        } else if (strcmp(argv[i], "--session") == 0) {
+            opts.session = 1;
+        } else if (strcmp(argv[i], "--sync") == 0) {
+            opts.sync = 1;
+        } else if (strcmp(argv[i], "--batch") == 0) {
+            opts.batch = 1;
+        } else if (strcmp(argv[i], "--link") == 0) {
+            opts.link = 1;
+        } else if (strcmp(argv[i], "--reliable") == 0) {
+            opts.reliable = 1;
+        } else if ((strcmp(argv[i], "--workers") == 0 || strcmp(argv[i], "-j") == 0) && i + 1 < argc &&
+                   atoi(argv[i + 1]) > 0) {
+            nworkers = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc) {
+            opts.capture = argv[++i];
+        } else if (strcmp(argv[i], "--quiet") == 0) {
+            opts.format = CUART_FORMAT_QUIET;
+        } else if (strcmp(argv[i], "--json") == 0) {
+            opts.format = CUART_FORMAT_JSON;
+        } else if (strcmp(argv[i], "--summary") == 0) {
+            opts.format = CUART_FORMAT_SUMMARY;
+        } else if (argv[i][0] != '-') {
+            ports[nports++].name = argv[i];
+        } else {
+            fprintf(stderr,
+                    "Usage: %s [--aead] [--session] [--sync] [--batch] [--link [--reliable]] [--workers N]\n"
+                    "          [--capture FILE] [--quiet | --json | --summary] [port...]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+    if (opts.reliable && !opts.link) {
+        fprintf(stderr, "--reliable needs --link: reliable delivery runs over the negotiated link\n");
+        return 1;
+    }
+    if (nports == 0) {
+        ports[nports++].name = default_port;
+    }
+    if (opts.capture && nports > CUART_CAPTURE_MAX_PORTS) {
+        fprintf(stderr, "A capture holds at most %d ports\n", CUART_CAPTURE_MAX_PORTS);
+        return 1;
+    }
 
-        printf("\n🔒 ENCRYPTED Data (%d bytes):\n", payload_len);
-        print_hex("", encrypted, payload_len);
+    // One worker per CPU, but never one without a port
+    if (nworkers == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        nworkers = cpus > 0 ? (int)cpus : 1;
+    }
+    if (nworkers > nports) {
+        nworkers = nports;
+    }
 
-        printf("\n🔓 DECRYPTED Plaintext (%d bytes):\n", payload_len);
-        print_hex("", decrypted, payload_len);
+    // JSON output is nothing but packets and events; the banner goes to stderr
+    FILE *info = (opts.format == CUART_FORMAT_JSON) ? stderr : stdout;
+
+    fprintf(info, "================================================================================\n");
+    fprintf(info, " 🔐 UART Sniffer with AES-128 CTR Decryption (using libcypheruart)\n");
+    fprintf(info, "================================================================================\n");
+    if (nports == 1) {
+        fprintf(info, " Port: %s @ 115200 baud%s\n", ports[0].name, opts.link ? ", following link negotiation" : "");
+    } else {
+        fprintf(info, " Ports: %d @ 115200 baud%s, %d worker thread%s\n", nports,
+                      opts.link ? ", following link negotiation" : "", nworkers, nworkers == 1 ? "" : "s");
+    }
+    fprintf(info, " Packet Format: %s[%s][LENGTH][ENCRYPTED %s%s][%s] (%s)\n",
+                  opts.sync ? "[SYNC][HCRC]" : "",
+                  opts.session ? "4-byte SEQ" : (opts.aead ? "12-byte NONCE" : "16-byte NONCE"),
+                  opts.reliable ? "DELIVERY SEQ + " : "", opts.batch ? "RECORDS" : "DATA",
+                  opts.aead ? "16-byte TAG" : "32-byte HMAC", opts.aead ? "AES-128-GCM" : "AES-128-CTR + HMAC-SHA256");
+    if (opts.capture) {
+        fprintf(info, " Capture: %s\n", opts.capture);
+    }
+    fprintf(info, " AES Implementation: %s\n", aes_backend_name());
+    fprintf(info, " AES Key: ");
+    for (int i = 0; i < 16; i++) fprintf(info, "%02x ", AES_SHARED_KEY[i]);
+    fprintf(info, "\n");
+    fprintf(info, "================================================================================\n\n");
+
+    if (opts.capture) {
+        uint32_t options = (opts.aead ? CUART_CAPTURE_AEAD : 0) | (opts.session ? CUART_CAPTURE_SESSION : 0) |
+                           (opts.sync ? CUART_CAPTURE_SYNC : 0) | (opts.batch ? CUART_CAPTURE_BATCH : 0) |
+                           (opts.link ? CUART_CAPTURE_LINK : 0) | (opts.reliable ? CUART_CAPTURE_RELIABLE : 0);
+
+        if (cuart_capture_create(&capture, opts.capture, options) < 0) {
+            fprintf(stderr, "Cannot create %s: %s\n", opts.capture, strerror(errno));
+            return 1;
+        }
+        capturing = 1;
+    }
 
-        printf("\n📝 ");
-        print_plaintext("Message:", decrypted, payload_len);
+    // Open every port before any worker starts
+    for (int i = 0; i < nports; i++) {
+        port_t *port = &ports[i];
+
+        port->fd = setup_serial(port->name);
+        if (port->fd < 0) {
+            fprintf(stderr, "Failed to open %s\n", port->name);
+            fprintf(stderr, "Check:\n");
+            fprintf(stderr, "  • FTDI connected: ls -l /dev/ttyUSB*\n");
+            fprintf(stderr, "  • Wiring: Sender GPIO17 → FTDI RX, GND connected\n");
+            return 1;
+        }
+        port->tag = (nports > 1);
+        port->baud = CUART_LINK_SAFE_BAUD;
+        port->id = i;
+        if (capturing && cuart_capture_add_port(&capture, port->name) < 0) {
+            fprintf(stderr, "Cannot write %s: %s\n", opts.capture, strerror(errno));
+            return 1;
+        }
+        cuart_session_rx_init(&port->session);
+        cuart_parser_init(&port->parser,
+                          opts.session ? CUART_SESSION_SEQ_SIZE : (opts.aead ? AES_GCM_NONCE_SIZE : AES_BLOCK_SIZE),
+                          cuart_frame_mac_size(opts.aead ? CUART_WIRE_AEAD : CUART_WIRE_HMAC), opts.sync);
+        cuart_link_init(&port->link, CUART_LINK_MONITOR, cuart_link_rates_upto(UINT32_MAX), false, now_ms());
+        cuart_arq_rx_init(&port->arq);
+        fprintf(info, "✓ Connected to %s\n", port->name);
+    }
 
-        printf("\n📊 Total packet size: %d bytes\n\n", NONCE_SIZE + payload_len);
+    // Keys and wire format, set up once per worker; ports dealt out in turn
+    worker_t *workers = calloc((size_t)nworkers, sizeof(*workers));
+    if (!workers) {
+        perror("calloc");
+        return 1;
+    }
+    for (int i = 0; i < nworkers; i++) {
+        worker_t *w = &workers[i];
+
+        w->frame_ctx = (cuart_frame_ctx_t){ .ctr = &w->ctr, .hmac_key = &w->hmac_key, .gcm = &w->gcm };
+        w->frame_ctx.wire = opts.aead ? CUART_WIRE_AEAD : CUART_WIRE_HMAC;
+        aes_ctr_setkey(&w->ctr, AES_SHARED_KEY);
+        hmac_sha256_setkey(&w->hmac_key, HMAC_KEY, sizeof(HMAC_KEY));
+        aes_gcm_setkey(&w->gcm, AES_SHARED_KEY);
+        if (cuart_out_init(&w->out, opts.format, OUT_FLUSH + 65536) < 0) {
+            perror("malloc");
+            return 1;
+        }
+        w->epfd = epoll_create1(EPOLL_CLOEXEC);
+        if (w->epfd < 0) {
+            perror("epoll_create1");
+            return 1;
+        }
+    }
+    for (int i = 0; i < nports; i++) {
+        worker_t *w = &workers[i % nworkers];
+        struct epoll_event ev = { .events = EPOLLIN, .data.ptr = &ports[i] };
 
-        fflush(stdout);
+        if (epoll_ctl(w->epfd, EPOLL_CTL_ADD, ports[i].fd, &ev) < 0) {
+            fprintf(stderr, "Cannot watch %s: %s\n", ports[i].name, strerror(errno));
+            return 1;
+        }
+        w->open_ports++;
     }
 
-    close(fd);
+    fprintf(info, "✓ Listening for encrypted packets... (Press Ctrl+C to exit)\n\n");
+    fflush(info);
+
+    uint64_t start_ns = wall_ns();
+    for (int i = 0; i < nworkers; i++) {
+        if (pthread_create(&workers[i].thread, NULL, worker_main, &workers[i]) != 0) {
+            fprintf(stderr, "Cannot start worker thread %d\n", i);
+            return 1;
+        }
+    }
+    for (int i = 0; i < nworkers; i++) {
+        pthread_join(workers[i].thread, NULL);
+        close(workers[i].epfd);
+        cuart_out_free(&workers[i].out);
+    }
+    double seconds = (double)(wall_ns() - start_ns) / 1e9;
+
+    // Every port has closed
+    if (opts.format == CUART_FORMAT_SUMMARY) {
+        unsigned long long packets = 0, invalid = 0, bytes = 0;
+
+        printf("%-24s %10s %10s %14s\n", "Port", "Packets", "Invalid", "Bytes");
+        for (int i = 0; i < nports; i++) {
+            printf("%-24s %10d %10d %14llu\n", ports[i].name, ports[i].packet_count, ports[i].invalid_count,
+                   ports[i].bytes);
+            packets += (unsigned long long)ports[i].packet_count;
+            invalid += (unsigned long long)ports[i].invalid_count;
+            bytes += ports[i].bytes;
+        }
+        printf("%-24s %10llu %10llu %14llu\n", "Total", packets, invalid, bytes);
+        printf("%.2f s, %.0f packets/s, %.2f MB/s\n", seconds, seconds > 0 ? packets / seconds : 0.0,
+               seconds > 0 ? bytes / seconds / 1e6 : 0.0);
+    } else {
+        for (int i = 0; i < nports; i++) {
+            fprintf(stderr, "%s: %d packets, %d invalid, %llu bytes\n", ports[i].name, ports[i].packet_count,
+                    ports[i].invalid_count, ports[i].bytes);
+        }
+    }
+    if (opts.capture) {
+        if (cuart_capture_close(&capture) < 0) {
+            fprintf(stderr, "Error writing %s: %s\n", opts.capture, strerror(errno));
+        }
+        fprintf(stderr, "Captured %llu packets, %llu bytes to %s\n", (unsigned long long)capture.packets,
+                (unsigned long long)capture.offset, opts.capture);
+    }
+    free(workers);
+    free(ports);
     return 0;
 }